@@ -0,0 +1,81 @@
+/*
+ * failsafe.h – LoRa link-loss failsafe for the throttle and rudder
+ *
+ * The main loop feeds every received CTRL frame in; a periodic timer
+ * interrupt (TIM7, FAILSAFE_TICK_MS) checks the time since the last one.
+ * When no CTRL frame has arrived for timeout_ms the outputs are slewed to
+ * their safe values (throttle idle, rudder centred) at a limited rate, so
+ * the boat coasts down instead of stopping dead or holding full power.
+ * The next CTRL frame hands control back to the pilot.
+ *
+ * The controller refreshes CTRL at 1 Hz even with the sticks idle
+ * (ctrl_rate.h), so the default timeout rides out one lost heartbeat.
+ *
+ * Inter-arrival times of CTRL frames are kept in a log2 histogram:
+ *   bucket[0]      < 32 ms
+ *   bucket[i]      [2^(i+4), 2^(i+5)) ms
+ *   bucket[last]   everything above
+ *
+ * Inspect the global with the debugger (Live Expressions).
+ */
+
+#ifndef __FAILSAFE_H
+#define __FAILSAFE_H
+
+#include <stdint.h>
+
+// Link loss timeout; override with -DFAILSAFE_TIMEOUT_MS=<ms>
+#ifndef FAILSAFE_TIMEOUT_MS
+#define FAILSAFE_TIMEOUT_MS 2500
+#endif
+
+#define FAILSAFE_TICK_MS      10      // Timer interrupt period
+#define FAILSAFE_GAP_BUCKETS  8
+
+typedef struct
+{
+    // Configuration
+    uint32_t timeout_ms;              // CTRL gap that trips the failsafe
+    uint16_t thr_safe_us;             // Throttle pulse to ramp to
+    uint16_t rud_safe_us;             // Rudder pulse to ramp to
+    uint16_t thr_slew;                // Throttle ramp, µs per second
+    uint16_t rud_slew;                // Rudder ramp, µs per second
+
+    // State
+    volatile uint32_t last_rx_ms;     // Last CTRL frame
+    volatile uint8_t  armed;          // A CTRL frame has been received
+    volatile uint8_t  active;         // Outputs are under failsafe control
+    uint32_t last_tick_ms;
+
+    // Report for the controller (FRAME_LINK), raised on trip and recovery
+    volatile uint8_t  report_pending;
+    volatile uint16_t report_gap_ms;  // Gap when the report was raised
+
+    // Statistics
+    uint32_t frames;                  // CTRL frames fed
+    uint32_t max_gap_ms;              // Longest gap between CTRL frames
+    uint32_t gap[FAILSAFE_GAP_BUCKETS];   // Inter-arrival histogram
+    volatile uint8_t events;          // Failsafe trips (wraps)
+} Failsafe_t;
+
+#define FAILSAFE_INIT(thr_us, rud_us) { .timeout_ms = FAILSAFE_TIMEOUT_MS, \
+    .thr_safe_us = (thr_us), .rud_safe_us = (rud_us), .thr_slew = 500, .rud_slew = 1000 }
+
+/**
+ * @brief Record a received CTRL frame (main loop).
+ * Ends a failsafe in progress; the caller then writes the new outputs.
+ * @param now_ms  Current tick
+ * @retval 1 if this frame ended a failsafe
+ */
+uint8_t failsafe_feed(Failsafe_t *fs, uint32_t now_ms);
+
+/**
+ * @brief Periodic check (timer interrupt).
+ * @param now_ms  Current tick
+ * @param thr_us  In: current throttle setpoint, out: setpoint to hold
+ * @param rud_us  In: current rudder setpoint, out: setpoint to hold
+ * @retval 1 if the setpoints must be updated
+ */
+uint8_t failsafe_tick(Failsafe_t *fs, uint32_t now_ms, uint32_t *thr_us, uint32_t *rud_us);
+
+#endif /* __FAILSAFE_H */
@@ -0,0 +1,56 @@
+/*
+ * isr_timing.h – ISR execution time histograms (DWT cycle counter)
+ *
+ * Each histogram counts samples in power-of-two cycle buckets:
+ *   bucket[0]      < 64 cycles
+ *   bucket[i]      [2^(i+5), 2^(i+6)) cycles
+ *   bucket[last]   everything above
+ * At 84 MHz, 1 µs = 84 cycles.
+ *
+ * Inspect the globals with the debugger (Live Expressions).
+ */
+
+#ifndef __ISR_TIMING_H
+#define __ISR_TIMING_H
+
+#include "main.h"
+#include <stdint.h>
+
+#define ISR_HIST_BUCKETS 16
+
+typedef struct
+{
+    uint32_t count;                       // samples recorded
+    uint32_t max_cycles;                  // worst case seen
+    uint32_t bucket[ISR_HIST_BUCKETS];    // log2 histogram
+} IsrHist_t;
+
+extern IsrHist_t isr_hist_lora;   // UART4 RX event (LoRa)
+extern IsrHist_t isr_hist_gps;    // USART3 RX event (GPS)
+
+/**
+ * @brief Enable the DWT cycle counter.
+ */
+void isr_timing_init(void);
+
+/**
+ * @brief Current cycle count, taken at ISR entry.
+ */
+static inline uint32_t isr_timing_start(void)
+{
+    return DWT->CYCCNT;
+}
+
+/**
+ * @brief Record the time elapsed since @p start into a histogram.
+ * @param h      Histogram to update
+ * @param start  Value returned by isr_timing_start()
+ */
+void isr_timing_record(IsrHist_t *h, uint32_t start);
+
+/**
+ * @brief Clear a histogram.
+ */
+void isr_timing_reset(IsrHist_t *h);
+
+#endif /* __ISR_TIMING_H */
@@ -0,0 +1,90 @@
+/*
+ * pwm_out.h – Slew-limited, interpolated servo/ESC output stage
+ *
+ * Setpoints (pulse widths in µs) are handed over by the main loop; the
+ * compare registers are written only from the timer update interrupt,
+ * once per 20 ms PWM frame, with compare and auto-reload preload enabled
+ * so a new duty takes effect at the start of the next frame and a pulse
+ * is never cut short or stretched.
+ *
+ * Per frame, each channel:
+ *   1. moves its reference towards the latest setpoint, spreading the step
+ *      over the measured setpoint interval (linear interpolation between
+ *      received values; a held setpoint is reached in one interval)
+ *   2. follows the reference with the output velocity limited to
+ *      slew µs/frame and its change limited to accel µs/frame², slowing
+ *      down in time to stop on the reference
+ *
+ * Positions are kept in 1/16 µs so small per-frame steps do not stall.
+ */
+
+#ifndef __PWM_OUT_H
+#define __PWM_OUT_H
+
+#include <stdint.h>
+
+#define PWM_OUT_FRAME_MS      20      // Update interrupt period (50 Hz)
+#define PWM_OUT_INTERP_MAX_MS 500     // Longest interpolation; slower setpoints step
+
+typedef struct
+{
+    // Configuration
+    uint16_t min_us;
+    uint16_t max_us;
+    uint16_t slew;                    // µs per frame
+    uint16_t accel;                   // µs per frame per frame
+    volatile uint32_t *ccr;           // Compare register driven
+
+    // Setpoint (main loop)
+    volatile uint16_t target_us;      // Latest setpoint
+    volatile int32_t  step;           // Reference step per frame, 1/16 µs
+    uint32_t last_set_ms;
+
+    // Output (update interrupt)
+    int32_t  ref;                     // Interpolated reference, 1/16 µs
+    int32_t  pos;                     // Output, 1/16 µs
+    int32_t  vel;                     // 1/16 µs per frame
+} PwmOut_t;
+
+#define PWM_OUT_INIT(min, max, slew_us, accel_us) { .min_us = (min), .max_us = (max), \
+    .slew = (slew_us), .accel = (accel_us) }
+
+/**
+ * @brief Attach a channel to its compare register and start at @p us.
+ */
+void pwm_out_init(PwmOut_t *o, volatile uint32_t *ccr, uint16_t us);
+
+/**
+ * @brief New setpoint from the radio, interpolated over the setpoint interval.
+ * Call with the update interrupt masked.
+ * @param now_ms  Current tick
+ */
+void pwm_out_set(PwmOut_t *o, uint16_t us, uint32_t now_ms);
+
+/**
+ * @brief New setpoint taken as the reference at once (still slew limited).
+ * For the failsafe and local commands. Call with the update interrupt
+ * masked or from an interrupt of the same priority.
+ */
+void pwm_out_hold(PwmOut_t *o, uint16_t us);
+
+/**
+ * @brief Latest setpoint in µs.
+ */
+static inline uint16_t pwm_out_target(const PwmOut_t *o)
+{
+    return o->target_us;
+}
+
+/**
+ * @brief Pulse width in µs output in the last frame.
+ */
+uint16_t pwm_out_us(const PwmOut_t *o);
+
+/**
+ * @brief Advance one frame and write the compare register (update interrupt).
+ * @retval 1 if the compare value changed
+ */
+uint8_t pwm_out_update(PwmOut_t *o);
+
+#endif /* __PWM_OUT_H */
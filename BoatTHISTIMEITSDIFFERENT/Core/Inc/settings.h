@@ -0,0 +1,64 @@
+/*
+ * settings.h – Boat settings kept in flash
+ *
+ * Radio and failsafe parameters in the configuration store (config.h).
+ * They are changed from the app with CMD,SET,<name>,<value>, delivered
+ * through the acknowledged command channel, and read at boot: a change
+ * takes effect after a restart.
+ *
+ * The two store areas are flash sectors 6 and 7 (128 KB each), left out
+ * of the program region by the linker script. Switching areas erases a
+ * sector, which stalls the CPU for 1–2 s; it happens once per ~16000 SETs.
+ * The PWM keeps its last pulse and the failsafe cannot run meanwhile, so
+ * the boat only takes a SET with the throttle at neutral and replies
+ * SET,ARMED,<name>,<value> otherwise. Replies go to the debug UART: the
+ * controller only learns that the command was delivered.
+ */
+
+#ifndef __SETTINGS_H
+#define __SETTINGS_H
+
+#include "main.h"
+#include "config.h"
+#include "lora_at.h"
+
+#define SETTINGS_AREA0      0x08040000U   // Sector 6
+#define SETTINGS_AREA1      0x08060000U   // Sector 7
+#define SETTINGS_AREA_SIZE  0x20000U
+
+// Setting keys (append only: the index is stored with each record)
+typedef enum
+{
+    CFG_LORA_ADDRESS = 0,       // This module's address, 1..8 in a fleet (uplink slot)
+    CFG_LORA_NETWORK,           // Network ID
+    CFG_LORA_BAND,              // Carrier frequency in Hz
+    CFG_LORA_SF,                // Spreading factor
+    CFG_LORA_BW,                // Bandwidth code (7 = 125 kHz, 8 = 250 kHz, 9 = 500 kHz)
+    CFG_LORA_CR,                // Coding rate 1..4 (4/5 .. 4/8)
+    CFG_LORA_PREAMBLE,          // Preamble length in symbols
+    CFG_LORA_PEER,              // Controller address
+    CFG_FAILSAFE_TIMEOUT_MS,    // Link loss timeout (failsafe.h)
+    CFG_COUNT
+} SettingKey_t;
+
+extern Config_t settings;
+
+/**
+ * @brief Load the settings; call before the modules that use them.
+ */
+void settings_init(void);
+
+/**
+ * @brief Current value of a setting.
+ */
+static inline uint32_t setting(SettingKey_t key)
+{
+    return config_get(&settings, (uint8_t)key);
+}
+
+/**
+ * @brief LoRa module settings.
+ */
+void settings_lora(LoRaAtConfig_t *cfg);
+
+#endif /* __SETTINGS_H */
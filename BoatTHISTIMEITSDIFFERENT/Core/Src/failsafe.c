@@ -0,0 +1,77 @@
+/*
+ * failsafe.c – LoRa link-loss failsafe for the throttle and rudder
+ */
+
+#include "failsafe.h"
+
+// Move @p cur towards @p target by at most @p step
+static uint32_t slew_towards(uint32_t cur, uint32_t target, uint32_t step)
+{
+    if (cur > target)
+        return (cur - target > step) ? cur - step : target;
+    return (target - cur > step) ? cur + step : target;
+}
+
+static uint16_t clamp_u16(uint32_t v)
+{
+    return (v > 0xFFFF) ? 0xFFFF : (uint16_t)v;
+}
+
+uint8_t failsafe_feed(Failsafe_t *fs, uint32_t now_ms)
+{
+    uint8_t recovered = 0;
+
+    if (fs->armed)
+    {
+        uint32_t gap = now_ms - fs->last_rx_ms;
+
+        // bucket = bit length - 5, clamped to [0, FAILSAFE_GAP_BUCKETS - 1]
+        uint32_t idx = 0;
+        while (idx < FAILSAFE_GAP_BUCKETS - 1 && (gap >> (idx + 5)))
+            idx++;
+        fs->gap[idx]++;
+
+        if (gap > fs->max_gap_ms)
+            fs->max_gap_ms = gap;
+
+        if (fs->active)
+        {
+            fs->report_gap_ms = clamp_u16(gap);
+            fs->report_pending = 1;
+            recovered = 1;
+        }
+    }
+
+    fs->frames++;
+    fs->last_rx_ms = now_ms;
+    fs->armed = 1;
+    fs->active = 0;
+    return recovered;
+}
+
+uint8_t failsafe_tick(Failsafe_t *fs, uint32_t now_ms, uint32_t *thr_us, uint32_t *rud_us)
+{
+    uint32_t dt = now_ms - fs->last_tick_ms;
+    fs->last_tick_ms = now_ms;
+
+    // Nothing to protect before the first CTRL frame: outputs are at boot values
+    if (!fs->armed || now_ms - fs->last_rx_ms < fs->timeout_ms)
+        return 0;
+
+    if (!fs->active)
+    {
+        fs->active = 1;
+        fs->events++;
+        fs->report_gap_ms = clamp_u16(now_ms - fs->last_rx_ms);
+        fs->report_pending = 1;
+    }
+
+    uint32_t thr = slew_towards(*thr_us, fs->thr_safe_us, fs->thr_slew * dt / 1000);
+    uint32_t rud = slew_towards(*rud_us, fs->rud_safe_us, fs->rud_slew * dt / 1000);
+    if (thr == *thr_us && rud == *rud_us)
+        return 0;
+
+    *thr_us = thr;
+    *rud_us = rud;
+    return 1;
+}
@@ -0,0 +1,36 @@
+/*
+ * isr_timing.c – ISR execution time histograms (DWT cycle counter)
+ */
+
+#include "isr_timing.h"
+#include <string.h>
+
+IsrHist_t isr_hist_lora;
+IsrHist_t isr_hist_gps;
+
+void isr_timing_init(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+void isr_timing_record(IsrHist_t *h, uint32_t start)
+{
+    uint32_t cycles = DWT->CYCCNT - start;
+
+    // bucket = bit length - 6, clamped to [0, ISR_HIST_BUCKETS - 1]
+    int idx = cycles ? (32 - (int)__CLZ(cycles)) - 6 : 0;
+    if (idx < 0) idx = 0;
+    if (idx >= ISR_HIST_BUCKETS) idx = ISR_HIST_BUCKETS - 1;
+
+    h->bucket[idx]++;
+    h->count++;
+    if (cycles > h->max_cycles)
+        h->max_cycles = cycles;
+}
+
+void isr_timing_reset(IsrHist_t *h)
+{
+    memset(h, 0, sizeof(*h));
+}
@@ -2,29 +2,84 @@
  * RC Drone Boat – STM32 Firmware
  *
  * - Reads GPS NMEA sentences from UART3
- * - Parses $GPRMC/$GNRMC and validates NMEA checksum
- * - Sends GPS coordinates over LoRa (UART4) as "GPS,<lat>,<lon>"
- * - Receives control packets "CTRL,<thr>,<rud>" over LoRa
- * - Drives throttle (TIM3 CH1) and rudder servo (TIM1 CH1) via 50 Hz PWM
+ * - Streams bytes through the shared NMEA state machine (nmea.h),
+ *   checksum and fixed-point coordinates computed as bytes arrive
+ * - Sends GPS coordinates over LoRa (UART4) as binary GPS frames (frame.h)
+ * - Receives binary CTRL frames (thrust, rudder) over LoRa
+ * - Acknowledges CMD frames (cmd_arq.h) and executes each command once;
+ *   a broadcast GCMD frame is handled the same when its group includes
+ *   this boat's uplink slot
+ * - Maps CTRL values to pulse widths with per-channel endpoints, centre
+ *   trim and expo (ctrl_map.h), at the timers' 1 µs resolution
+ * - Drives throttle (TIM3 CH1) and rudder servo (TIM1 CH1) via 50 Hz PWM,
+ *   interpolated and slew limited by the output stage (pwm_out.h) in the
+ *   TIM3 update interrupt
+ * - Ramps throttle to idle and centres the rudder when CTRL frames stop
+ *   (failsafe.h, TIM7 tick) and reports it in a LINK frame
+ * - Shares the channel with up to 7 other boats (tdma.h): frame timing
+ *   comes from the controller's SYNC frames, corrected for clock drift and
+ *   on every other downlink, and ACK, LINK and GPS frames wait for this
+ *   boat's uplink slot (its address less the SYNC base)
+ * - Follows the controller's data rate (lora_adr.h): a RATE command
+ *   prepares a new SF/BW, RATE frames commit it at a frame boundary, and
+ *   the configured rate is restored when the controller falls silent
  *
- * Main loop is interrupt-driven:
- *  - UART RX callbacks assemble lines for GPS and LoRa
- *  - On complete line, handlers parse and update PWM or transmit GPS
+ * Work is split between interrupts and the main loop:
+ *  - UART RX runs on circular DMA; half/full/idle events assemble lines
+ *  - LoRa lines are pushed to a lock-free queue (bounded ISR time)
+ *  - GPS bytes go straight into the NMEA parser (constant cost per byte);
+ *    a valid RMC fix only raises a flag
+ *  - The main loop drains the LoRa queue first, then sends a pending ACK,
+ *    LINK report or GPS fix when the uplink slot allows, so NMEA traffic
+ *    never delays a CTRL packet
+ *  - ISR duration is recorded in DWT cycle histograms (isr_timing.h)
+ *  - The LoRa module is configured by the non-blocking AT command engine
+ *    (lora_at.h) from the stored settings (settings.h, CMD,SET from the
+ *    app); frames are only sent once it has acknowledged
+ *  - USART2 (ST-LINK virtual COM port) is a DMA-queued debug output; in
+ *    LAT_TRACE builds it carries the latency trace records (lat_trace.h)
  */
 
 #include "main.h"
+#include "uart_rx.h"
+#include "line_queue.h"
+#include "isr_timing.h"
+#include "nmea.h"
+#include "frame.h"
+#include "lora_at.h"
+#include "uart_tx.h"
+#include "lat_trace.h"
+#include "cmd_arq.h"
+#include "failsafe.h"
+#include "pwm_out.h"
+#include "ctrl_map.h"
+#include "settings.h"
+#include "lora_airtime.h"
+#include "tdma.h"
+#include "lora_adr.h"
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <ctype.h>
 
 
+// UART2: debug port (ST-LINK VCP)
 // UART3: GPS
 // UART4: LoRa module
 
+UART_HandleTypeDef huart2;
 UART_HandleTypeDef huart3;
 UART_HandleTypeDef huart4;
 
+// UART RX DMA
+// DMA1 Stream1 Ch4: USART3_RX
+// DMA1 Stream2 Ch4: UART4_RX
+DMA_HandleTypeDef hdma_usart3_rx;
+DMA_HandleTypeDef hdma_uart4_rx;
+
+// UART TX DMA
+// DMA1 Stream6 Ch4: USART2_TX
+DMA_HandleTypeDef hdma_usart2_tx;
+
 
 
 // PWM timers
@@ -33,26 +88,115 @@ UART_HandleTypeDef huart4;
 TIM_HandleTypeDef htim1;
 TIM_HandleTypeDef htim3;
 
-uint8_t gps_rx;
-char gps_line[128];
-uint8_t gps_pos = 0;
+// Failsafe tick
+// TIM7: 100 Hz update interrupt
+TIM_HandleTypeDef htim7;
+
+static void GPS_Feed(char c);
+static void LoRa_Enqueue(char *line);
+
+uint8_t gps_dma[128];
+UartRx_t gps_rx = UART_RX_INIT_RAW(&huart3, gps_dma, GPS_Feed);
+NmeaParser_t gps_nmea;
+
+// Latest RMC fix, handed from the GPS ISR to the main loop
+volatile uint8_t gps_fix_pending = 0;
+volatile int32_t gps_fix_lat_e7;
+volatile int32_t gps_fix_lon_e7;
 
-uint8_t lora_rx;
+uint8_t lora_dma[256];
 char lora_line[128];
-uint8_t lora_pos = 0;
+UartRx_t lora_rx = UART_RX_INIT(&huart4, lora_dma, lora_line, 0, LoRa_Enqueue);
+
+// Deferred work: ISR -> main loop
+char lora_slots[4][128];
+LineQueue_t lora_q = LINE_QUEUE_INIT(lora_slots);
+
+// Receive time of each queued LoRa line, indexed like lora_slots; the
+// tick places SYNC frames, the µs stamp feeds the latency trace
+static uint32_t lora_rx_ms[sizeof(lora_slots) / sizeof(lora_slots[0])];
+static uint32_t lora_line_ms;
+#ifdef LAT_TRACE
+static uint32_t lora_rx_us[sizeof(lora_slots) / sizeof(lora_slots[0])];
+static uint32_t lora_line_us;
+#endif
+
+// Debug port transmit queue; the control ring holds two of the longest
+// replies (SET,...), which are dropped rather than waited for when it is full
+uint8_t dbg_tx_dma[128];
+uint8_t dbg_tx_ctrl[160];
+uint8_t dbg_tx_telem[512];
+UartTx_t dbg_tx = UART_TX_INIT(&huart2, dbg_tx_dma, dbg_tx_ctrl, dbg_tx_telem);
+
+// Binary frame sequence number
+static uint8_t lora_seq = 0;
+
+// Acknowledged commands from the controller
+CmdArqRx_t cmd_rx;
+
+// Channel schedule, timed by the controller's SYNC frames
+static LoRaPhy_t lora_phy = LORA_PHY_DEFAULT;
+Tdma_t tdma;
+
+// ACK waiting for the uplink slot; a newer one covers the same commands
+static Frame_t ack_frame;
+static uint8_t ack_pending = 0;
+
+// Data rate: the configured one (home), the one in use, the one a RATE
+// command prepared (-1 = none) and a switch committed by RATE frames
+static int8_t rate_home = -1;
+static uint8_t rate_now;
+static int8_t rate_prepared = -1;
+static uint8_t rate_switch_pending = 0;
+static uint32_t rate_switch_ms;
+static uint32_t lora_heard_ms;          // Last frame from the controller
+static LoRaAtScript_t lora_rate_script;
+
+// Output calibration (µs). The ESC has no reverse: throttle is one-sided,
+// neutral (idle) at THR_MIN_US and reverse thrust maps to idle. For a
+// reversible ESC set THR_CENTER_US to its neutral pulse. RUD_CENTER_US
+// trims the rudder's straight-ahead.
+#define THR_MIN_US      1000
+#define THR_CENTER_US   THR_MIN_US
+#define THR_MAX_US      2000
+#define THR_EXPO        20          // % cubic, finer control at low power
+#define RUD_MIN_US      1000
+#define RUD_CENTER_US   1500
+#define RUD_MAX_US      2000
+#define RUD_EXPO        30
+
+static const uint16_t thr_curve[CTRL_MAP_POINTS] = CTRL_MAP_CURVE(THR_EXPO);
+static const uint16_t rud_curve[CTRL_MAP_POINTS] = CTRL_MAP_CURVE(RUD_EXPO);
+static const CtrlMapCal_t thr_cal = { THR_MIN_US, THR_CENTER_US, THR_MAX_US, thr_curve };
+static const CtrlMapCal_t rud_cal = { RUD_MIN_US, RUD_CENTER_US, RUD_MAX_US, rud_curve };
+
+// Output stage: throttle is eased more than the rudder to spare the ESC
+// and battery (limits in µs per 20 ms frame and per frame²)
+PwmOut_t thr_out = PWM_OUT_INIT(THR_MIN_US, THR_MAX_US, 40, 10);
+PwmOut_t rud_out = PWM_OUT_INIT(RUD_MIN_US, RUD_MAX_US, 100, 25);
+
+#ifdef LAT_TRACE
+// CTRL frame whose setpoint awaits its first compare write, -1 = none
+static volatile int16_t lat_pwm_seq = -1;
+#endif
+
+// Link-loss failsafe: throttle neutral, rudder centred
+Failsafe_t failsafe = FAILSAFE_INIT(THR_CENTER_US, RUD_CENTER_US);
+
+// LoRa module configuration, run by the AT command engine at boot
+static void LoRa_AT(const char *cmd);
+LoRaAt_t lora_at = { .send = LoRa_AT };
+static LoRaAtScript_t lora_config;
 
 void SystemClock_Config(void);
 static void MX_GPIO_Init(void);
+static void MX_DMA_Init(void);
+static void MX_USART2_UART_Init(void);
 static void MX_USART3_UART_Init(void);
 static void MX_UART4_Init(void);
 static void MX_TIM1_Init(void);
 static void MX_TIM3_Init(void);
-
-static inline uint32_t pct_to_us(uint8_t pct)
-{
-    if (pct > 100) pct = 100;
-    return 1000 + (pct * 10);
-}
+static void MX_TIM7_Init(void);
 
 static void LoRa_Send(const char *s)
 {
@@ -65,208 +209,467 @@ static void LoRa_AT(const char *cmd)
     LoRa_Send(cmd);
 }
 
-static void LoRa_SendGPS(float lat, float lon)
+// Whether a GCMD group includes this boat: bit i is uplink slot i
+static uint8_t Cmd_InGroup(uint8_t group)
+{
+    uint16_t slot = (uint16_t)(setting(CFG_LORA_ADDRESS) - tdma.base);
+    return slot < tdma.boats && (group & (1U << slot));
+}
+
+// Send a frame in this boat's uplink slot; returns 0 if it has to wait
+static uint8_t LoRa_SendFrame(Frame_t *f)
 {
-    char payload[64];
-    snprintf(payload, sizeof(payload), "GPS,%.6f,%.6f", lat, lon);
+    // Until configured, +OK replies must belong to the AT script
+    if (!lora_at_ready(&lora_at)) return 0;
+
+    // Outside the schedule (address below the base or beyond the fleet)
+    // the slot matches no frame and the boat stays silent
+    uint16_t slot = (uint16_t)(setting(CFG_LORA_ADDRESS) - tdma.base);
+    if (slot >= tdma.boats) return 0;
+
+    char payload[FRAME_MAX_ENCODED];
+    f->seq = lora_seq;
+    if (frame_encode(f, payload, sizeof(payload)) == 0) return 1;    // Dropped
+
+    uint32_t air = lora_airtime_us(&lora_phy, (uint16_t)strlen(payload));
+    if (!tdma_may_send(&tdma, 1, (uint8_t)slot, air, HAL_GetTick())) return 0;
+    lora_seq++;
 
-    char cmd[96];
-    snprintf(cmd, sizeof(cmd), "AT+SEND=2,%u,%s",
+    char cmd[FRAME_MAX_ENCODED + 16];
+    snprintf(cmd, sizeof(cmd), "AT+SEND=%u,%u,%s",
+             (unsigned)setting(CFG_LORA_PEER),
              (unsigned)strlen(payload),
              payload);
 
     LoRa_Send(cmd);
+    return 1;
 }
 
-
-/**
- * @brief Verify NMEA checksum.
- * @param s  NMEA sentence string, e.g. "$GPRMC,...*CS"
- * @return 1 if checksum is valid, 0 otherwise.
- */
-static int gps_checksum_ok(const char *s)
+// Report a failsafe trip or recovery to the controller
+static uint8_t LoRa_SendLink(void)
 {
-    if (!s || s[0] != '$') return 0;
+    Frame_t f;
+    f.type = FRAME_LINK;
 
-    char *star = strrchr(s, '*');
-    if (!star) return 0;
-
-    uint8_t x = 0;
-    for (const char *p = s + 1; p < star; p++) x ^= *p;
+    __disable_irq();
+    f.u.link.failsafe = failsafe.active;
+    f.u.link.events = failsafe.events;
+    f.u.link.gap_ms = failsafe.report_gap_ms;
+    __enable_irq();
 
-    unsigned char h = (unsigned char)star[1];
-    unsigned char l = (unsigned char)star[2];
+    if (!LoRa_SendFrame(&f)) return 0;
 
-    uint8_t hi = isalpha(h) ? 10 + (toupper(h) - 'A') : (h - '0');
-    uint8_t lo = isalpha(l) ? 10 + (toupper(l) - 'A') : (l - '0');
+    // A later trip or recovery raises the flag again and is reported next
+    __disable_irq();
+    if (failsafe.active == f.u.link.failsafe && failsafe.events == f.u.link.events)
+        failsafe.report_pending = 0;
+    __enable_irq();
+    return 1;
+}
 
-    return x == ((hi << 4) | lo);
+static uint8_t LoRa_SendGPS(int32_t lat_e7, int32_t lon_e7)
+{
+    Frame_t f;
+    f.type = FRAME_GPS;
+    f.u.gps.lat_e7 = lat_e7;
+    f.u.gps.lon_e7 = lon_e7;
+    return LoRa_SendFrame(&f);
 }
 
-/**
- * @brief Convert NMEA DDMM.MMMM format to signed degrees (float).
- * @param ddmm  Latitude/longitude component in DDMM.MMMM
- * @param hemi  'N','S','E','W' for hemisphere
- * @param out   Output float degrees (e.g. 36.123456)
- * @return 1 on success.
- */
-static int gps_ddmm_to_e7(const char *ddmm, const char *hemi, float *out)
+// Reprogram the modulation; frame 0 of the schedule starts at start_ms
+static void Rate_Apply(uint8_t rate, uint32_t start_ms)
 {
-    double v = atof(ddmm);
-    int deg = v / 100;
-    double minutes = v - deg * 100;
-    double f = deg + minutes / 60.0;
-
-    if (*hemi == 'S' || *hemi == 'W')
-        f = -f;
-    *out = (float)f;
-    return 1;
+    LoRaAtConfig_t cfg;
+    settings_lora(&cfg);
+    cfg.sf = lora_adr_rates[rate].sf;
+    cfg.bw = lora_adr_rates[rate].bw;
+    lora_at_run(&lora_at, lora_rate_script.script, lora_at_phy_script(&lora_rate_script, &cfg),
+                HAL_GetTick());
+
+    lora_phy.sf = cfg.sf;
+    lora_phy.bw_hz = lora_bw_hz(cfg.bw);
+    tdma_plan(&tdma, &lora_phy, tdma.base, tdma.boats);
+    tdma.start_ms = start_ms;
+    tdma.sync_ms = start_ms;
+    lora_heard_ms = start_ms;
+    rate_now = rate;
+    rate_switch_pending = 0;
+
+    char line[24];
+    snprintf(line, sizeof(line), "RATE,%u,%u", (unsigned)cfg.sf, (unsigned)cfg.bw);
+    uart_tx_line(&dbg_tx, line, UART_TX_CONTROL);
 }
 
-static void GPS_Parse(char *line)
+// Commit a prepared rate: switch at the start of the frame `frames` after
+// the one this RATE frame arrived in
+static void Rate_Commit(const FrameRate_t *r)
 {
-    if (strncmp(line, "$GPRMC", 6) != 0 &&
-        strncmp(line, "$GNRMC", 6) != 0)
-        return;
+    TdmaWindow_t w;
 
-    if (!gps_checksum_ok(line))
-        return;
+    if (rate_prepared < 0 || lora_adr_find(r->sf, r->bw) != rate_prepared) return;
+    if (!tdma_window(&tdma, lora_line_ms, &w)) return;
+
+    uint32_t frame_start = w.up ? w.start_ms - tdma.down_ms : w.start_ms;
+    rate_switch_ms = frame_start + (uint32_t)r->frames * tdma_frame_ms(&tdma);
+    rate_switch_pending = 1;
+}
 
-    char *tok[16] = {0};
-    int n = 0;
-    char *p = strtok(line, ",");
+// Switch when a committed change is due; return to the home rate when the
+// controller has not been heard for LORA_ADR_LOST_FRAMES frames
+static void Rate_Poll(void)
+{
+    uint32_t now = HAL_GetTick();
 
-    while (p && n < 16)
+    if (rate_switch_pending && (int32_t)(now - rate_switch_ms) >= 0)
+    {
+        Rate_Apply((uint8_t)rate_prepared, rate_switch_ms);
+        rate_prepared = -1;
+    }
+    else if (rate_home >= 0 && rate_now != rate_home &&
+             now - lora_heard_ms > LORA_ADR_LOST_FRAMES * tdma_frame_ms(&tdma))
     {
-        tok[n++] = p;
-        p = strtok(NULL, ",");
+        // Silent until a SYNC at the home rate
+        Rate_Apply((uint8_t)rate_home, now);
+        rate_prepared = -1;
+        tdma.synced = 0;
     }
-    if (n < 7) return;
+}
 
-    if (*tok[2] != 'A') return;
+// Execute a command received through the ARQ (called once per command)
+static void Cmd_Handle(const char *text)
+{
+    // Stop: throttle to neutral, rudder centred
+    if (strcmp(text, "STOP") == 0)
+    {
+        __disable_irq();
+        pwm_out_hold(&thr_out, THR_CENTER_US);
+        pwm_out_hold(&rud_out, RUD_CENTER_US);
+        __enable_irq();
+    }
+    // Change a stored setting, effective after a restart: SET,<name>,<value>.
+    // Refused (SET,ARMED) unless the throttle is at neutral, setpoint and
+    // output: a SET may erase a flash sector (settings.h), which freezes
+    // the outputs and the failsafe for 1–2 s
+    else if (strncmp(text, "SET,", 4) == 0)
+    {
+        static const char *const status[] = { "OK", "UNKNOWN", "RANGE", "FAILED" };
+        const char *reply = "ARMED";
 
-    float lat, lon;
-    gps_ddmm_to_e7(tok[3], tok[4], &lat);
-    gps_ddmm_to_e7(tok[5], tok[6], &lon);
+        if (pwm_out_target(&thr_out) == THR_CENTER_US && pwm_out_us(&thr_out) == THR_CENTER_US)
+        {
+            int16_t key;
+            reply = status[config_set_text(&settings, text + 4, &key)];
+        }
+
+        char line[64];
+        snprintf(line, sizeof(line), "SET,%s,%s", reply, text + 4);
+        uart_tx_line(&dbg_tx, line, UART_TX_CONTROL);
+    }
+    // Prepare a data rate change, made when RATE frames commit it: RATE,<sf>,<bw>
+    else if (strncmp(text, "RATE,", 5) == 0)
+    {
+        char *end;
+        unsigned long sf = strtoul(text + 5, &end, 10);
+        unsigned long bw = (*end == ',') ? strtoul(end + 1, &end, 10) : 0;
 
-    LoRa_SendGPS(lat, lon);
+        rate_prepared = -1;
+        if (rate_home >= 0 && *end == 0 && sf <= 12 && bw <= 9)
+            rate_prepared = lora_adr_find((uint8_t)sf, (uint8_t)bw);
+    }
 }
 
 static void LoRa_Handle(char *line)
 {
-    char *payload = line;
+    LoRaRcv_t rcv;
+    Frame_t f;
+
+    if (!lora_at_parse_rcv(line, &rcv)) return;
+    if (!frame_decode(rcv.data, rcv.len, &f)) return;
+    lora_heard_ms = lora_line_ms;
 
-    if (strncmp(line, "+RCV=", 5) == 0)
+    // Every downlink marks the controller's window: keep the slot on it
+    if (f.type != FRAME_SYNC)
+        tdma_on_downlink(&tdma, lora_airtime_us(&lora_phy, rcv.len), lora_line_ms);
+
+    if (f.type == FRAME_CTRL)
     {
-        int commas = 0;
-        char *p = line;
-        while (*p && commas < 2)
-        {
-            if (*p == ',') commas++;
-            p++;
-        }
-        if (commas == 2) payload = p;
+        // Reverse thrust maps to idle with a one-sided throttle calibration
+        uint16_t thr_us = ctrl_map_us(&thr_cal, f.u.ctrl.thrust);
+        uint16_t rud_us = ctrl_map_us(&rud_cal, f.u.ctrl.rudder);
+
+#ifdef LAT_TRACE
+        lat_trace_record(LAT_RX, f.seq, lora_line_us);
+        lat_trace_record(LAT_PARSE, f.seq, lat_trace_now_us());
+#endif
+
+        // Ends a failsafe ramp; no tick or frame update between the three
+        uint32_t now = HAL_GetTick();
+        __disable_irq();
+        failsafe_feed(&failsafe, now);
+        pwm_out_set(&thr_out, thr_us, now);
+        pwm_out_set(&rud_out, rud_us, now);
+#ifdef LAT_TRACE
+        lat_pwm_seq = f.seq;
+#endif
+        __enable_irq();
+    }
+    else if (f.type == FRAME_CMD ||
+             (f.type == FRAME_GCMD && Cmd_InGroup(f.u.cmd.group)))
+    {
+        // Always ACK, duplicates too: the earlier ACK may have been lost.
+        // The ACK waits for the uplink slot; the latest one is cumulative
+        ack_frame.type = FRAME_ACK;
+        uint8_t fresh = cmd_arq_receive(&cmd_rx, &f, &ack_frame.u.ack);
+        ack_pending = 1;
+
+        if (fresh)
+            Cmd_Handle(f.u.cmd.text);
+    }
+    else if (f.type == FRAME_SYNC)
+    {
+        uint32_t air = lora_airtime_us(&lora_phy, rcv.len);
+        tdma_on_sync(&tdma, &f.u.sync, air, lora_line_ms);
+    }
+    else if (f.type == FRAME_RATE)
+    {
+        Rate_Commit(&f.u.rate);
     }
+}
+
+// ISR side: advance the NMEA state machine; flag each valid RMC fix
+static void GPS_Feed(char c)
+{
+    if (nmea_feed(&gps_nmea, c) != NMEA_RMC)
+        return;
+
+    if (!gps_nmea.data.fix_valid)
+        return;
+
+    gps_fix_lat_e7 = gps_nmea.data.lat_e7;
+    gps_fix_lon_e7 = gps_nmea.data.lon_e7;
+    gps_fix_pending = 1;
+}
+
+// ISR side: copy the line into a queue slot and return. The receive time
+// is stored only once the line has a slot: when the queue is full, the
+// slot at head is the oldest queued line's
+static void LoRa_Enqueue(char *line)
+{
+    uint8_t slot = lora_q.head & (lora_q.count - 1);
+    uint32_t now = HAL_GetTick();
+#ifdef LAT_TRACE
+    uint32_t now_us = lat_trace_now_us();
+#endif
+
+    if (!line_queue_push(&lora_q, line))
+        return;
+
+    lora_rx_ms[slot] = now;
+#ifdef LAT_TRACE
+    lora_rx_us[slot] = now_us;
+#endif
+}
 
-    if (strncmp(payload, "CTRL,", 5) == 0)
+#ifdef LAT_TRACE
+// Forward queued latency trace records to the debug port
+static void Trace_Drain(void)
+{
+    char line[24];
+
+    while (lat_trace_next(line, sizeof(line)))
+        uart_tx_line(&dbg_tx, line, UART_TX_TELEMETRY);
+}
+#endif
+
+/**
+ * @brief Main-loop dispatcher for work queued by the RX ISRs.
+ *
+ * All pending LoRa lines are handled before a GPS fix is sent so control
+ * latency is never affected by GPS traffic. Uplinks wait for this boat's
+ * slot, one frame at a time: a command ACK first, then a failsafe report,
+ * then the latest GPS fix.
+ */
+static void Dispatch_Lines(void)
+{
+    char *line;
+
+    while ((line = line_queue_front(&lora_q)) != NULL)
     {
-        char *p = payload + 5;
-        uint8_t thr = atoi(p);
+        lora_line_ms = lora_rx_ms[lora_q.tail & (lora_q.count - 1)];
+#ifdef LAT_TRACE
+        lora_line_us = lora_rx_us[lora_q.tail & (lora_q.count - 1)];
+#endif
+        if (!lora_at_on_line(&lora_at, line, HAL_GetTick()))
+            LoRa_Handle(line);
+        line_queue_pop(&lora_q);
+    }
 
-        char *comma = strchr(p, ',');
-        if (!comma) return;
+    lora_at_poll(&lora_at, HAL_GetTick());
+    Rate_Poll();
 
-        uint8_t rud = atoi(comma + 1);
+    if (ack_pending)
+    {
+        if (LoRa_SendFrame(&ack_frame))
+            ack_pending = 0;
+    }
+    else if (failsafe.report_pending)
+    {
+        LoRa_SendLink();
+    }
+    else if (gps_fix_pending)
+    {
+        __disable_irq();
+        int32_t lat = gps_fix_lat_e7;
+        int32_t lon = gps_fix_lon_e7;
+        __enable_irq();
 
-        __HAL_TIM_SET_COMPARE(&htim3, TIM_CHANNEL_1, pct_to_us(thr));
-        __HAL_TIM_SET_COMPARE(&htim1, TIM_CHANNEL_1, pct_to_us(rud));
+        // A newer fix arriving meanwhile stays pending
+        if (LoRa_SendGPS(lat, lon))
+        {
+            __disable_irq();
+            if (gps_fix_lat_e7 == lat && gps_fix_lon_e7 == lon)
+                gps_fix_pending = 0;
+            __enable_irq();
+        }
     }
+
+#ifdef LAT_TRACE
+    Trace_Drain();
+#endif
 }
 
 int main(void)
 {
     HAL_Init();
     SystemClock_Config();
+    isr_timing_init();
+    settings_init();
+    failsafe.timeout_ms = setting(CFG_FAILSAFE_TIMEOUT_MS);
+    nmea_init(&gps_nmea);
 
     MX_GPIO_Init();
+    MX_DMA_Init();
+    MX_USART2_UART_Init();
     MX_USART3_UART_Init();
     MX_UART4_Init();
     MX_TIM1_Init();
     MX_TIM3_Init();
+    MX_TIM7_Init();
 
     HAL_TIM_PWM_Start(&htim1, TIM_CHANNEL_1);
     HAL_TIM_PWM_Start(&htim3, TIM_CHANNEL_1);
 
-    __HAL_TIM_SET_COMPARE(&htim1, TIM_CHANNEL_1, pct_to_us(50));
-    __HAL_TIM_SET_COMPARE(&htim3, TIM_CHANNEL_1, pct_to_us(0));
+    pwm_out_init(&rud_out, &htim1.Instance->CCR1, RUD_CENTER_US);
+    pwm_out_init(&thr_out, &htim3.Instance->CCR1, THR_CENTER_US);
 
-    HAL_UART_Receive_IT(&huart4, &lora_rx, 1);
-    HAL_UART_Receive_IT(&huart3, &gps_rx, 1);
+    HAL_TIM_Base_Start_IT(&htim3);      // Output stage frame update
+    HAL_TIM_Base_Start_IT(&htim7);
 
-    LoRa_AT("AT+ADDRESS=1");
-    HAL_Delay(50);
-    LoRa_AT("AT+NETWORKID=18");
-    HAL_Delay(50);
-    LoRa_AT("AT+BAND=915000000");
-    HAL_Delay(50);
-    LoRa_AT("AT+PARAMETER=9,7,1,12");
-    HAL_Delay(50);
+    uart_rx_start(&lora_rx);
+    uart_rx_start(&gps_rx);
 
-    while (1) {}
-    // Main loop does nothing; logic runs in UART RX callbacks this function HAL_UART_RxCpltCallback
+    // Boot-to-link-ready time is lora_at.done_ms - lora_at.start_ms
+    LoRaAtConfig_t lora_cfg;
+    settings_lora(&lora_cfg);
+    lora_at_run(&lora_at, lora_config.script, lora_at_config_script(&lora_config, &lora_cfg),
+                HAL_GetTick());
+
+    // Air time of received SYNC frames; the schedule itself comes with them
+    lora_phy.sf = lora_cfg.sf;
+    lora_phy.bw_hz = lora_bw_hz(lora_cfg.bw);
+    lora_phy.cr = lora_cfg.cr;
+    lora_phy.preamble = lora_cfg.preamble;
+
+    // The controller may only change the rate if the configured one is a step
+    rate_home = lora_adr_find(lora_cfg.sf, lora_cfg.bw);
+    rate_now = (rate_home < 0) ? 0 : (uint8_t)rate_home;
+
+    while (1)
+    {
+        Dispatch_Lines();
+    }
 }
 
-void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
+/**
+ * @brief UART RX event: DMA half/full transfer or idle line.
+ * @param Size  DMA write position in the circular buffer.
+ */
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size)
 {
+    uint32_t t0 = isr_timing_start();
+
     if (huart == &huart4)
     {
-        char c = (char)lora_rx;
-
-        if (c == '\n' || c == '\r')
-        {
-            if (lora_pos > 0)
-            {
-                lora_line[lora_pos] = 0;
-                LoRa_Handle(lora_line);
-                lora_pos = 0;
-            }
-        }
-        else
-        {
-            if (lora_pos < sizeof(lora_line) - 1)
-                lora_line[lora_pos++] = c;
-            else
-                lora_pos = 0;
-        }
-
-        HAL_UART_Receive_IT(&huart4, &lora_rx, 1);
+        uart_rx_on_event(&lora_rx, Size);
+        isr_timing_record(&isr_hist_lora, t0);
     }
 
     if (huart == &huart3)
     {
-        char c = (char)gps_rx;
+        uart_rx_on_event(&gps_rx, Size);
+        isr_timing_record(&isr_hist_gps, t0);
+    }
+}
+
+/**
+ * @brief UART TX DMA complete: start the next queued batch.
+ */
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+    if (huart == &huart2)
+        uart_tx_on_complete(&dbg_tx);
+}
+
+/**
+ * @brief Timer update events.
+ * TIM3: PWM frame start, advance the output stage (preloaded compares
+ * take effect at the next frame).
+ * TIM7: failsafe tick, ramps the setpoints while the link is down.
+ */
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
+{
+    if (htim == &htim3)
+    {
+        pwm_out_update(&thr_out);
+        pwm_out_update(&rud_out);
 
-        if (c == '\n' || c == '\r')
+#ifdef LAT_TRACE
+        if (lat_pwm_seq >= 0)
         {
-            if (gps_pos > 0)
-            {
-                gps_line[gps_pos] = 0;
-                GPS_Parse(gps_line);
-                gps_pos = 0;
-            }
+            lat_trace_record(LAT_PWM, (uint8_t)lat_pwm_seq, lat_trace_now_us());
+            lat_pwm_seq = -1;
         }
-        else
+#endif
+    }
+
+    if (htim == &htim7)
+    {
+        uint32_t thr = pwm_out_target(&thr_out);
+        uint32_t rud = pwm_out_target(&rud_out);
+
+        if (failsafe_tick(&failsafe, HAL_GetTick(), &thr, &rud))
         {
-            if (gps_pos < sizeof(gps_line) - 1)
-                gps_line[gps_pos++] = c;
-            else
-                gps_pos = 0;
+            pwm_out_hold(&thr_out, (uint16_t)thr);
+            pwm_out_hold(&rud_out, (uint16_t)rud);
         }
-
-        HAL_UART_Receive_IT(&huart3, &gps_rx, 1);
     }
 }
 
+/**
+ * @brief UART error (overrun, noise, framing) aborts DMA RX; restart it.
+ */
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+    if (huart == &huart4)
+        uart_rx_start(&lora_rx);
+
+    if (huart == &huart3)
+        uart_rx_start(&gps_rx);
+
+    if (huart == &huart2)
+        uart_tx_on_error(&dbg_tx);
+}
+
 static void MX_TIM1_Init(void)
 {
     TIM_OC_InitTypeDef cfg = {0};
@@ -276,11 +679,11 @@ static void MX_TIM1_Init(void)
     htim1.Init.CounterMode = TIM_COUNTERMODE_UP;
     htim1.Init.Period = 20000 - 1;
     htim1.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
-    htim1.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+    htim1.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_ENABLE;
     HAL_TIM_PWM_Init(&htim1);
 
     cfg.OCMode = TIM_OCMODE_PWM1;
-    cfg.Pulse = pct_to_us(50);
+    cfg.Pulse = RUD_CENTER_US;
     cfg.OCPolarity = TIM_OCPOLARITY_HIGH;
     cfg.OCFastMode = TIM_OCFAST_DISABLE;
     HAL_TIM_PWM_ConfigChannel(&htim1, &cfg, TIM_CHANNEL_1);
@@ -297,11 +700,11 @@ static void MX_TIM3_Init(void)
     htim3.Init.CounterMode = TIM_COUNTERMODE_UP;
     htim3.Init.Period = 20000 - 1;
     htim3.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
-    htim3.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+    htim3.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_ENABLE;
     HAL_TIM_PWM_Init(&htim3);
 
     cfg.OCMode = TIM_OCMODE_PWM1;
-    cfg.Pulse = pct_to_us(0);
+    cfg.Pulse = THR_CENTER_US;
     cfg.OCPolarity = TIM_OCPOLARITY_HIGH;
     cfg.OCFastMode = TIM_OCFAST_DISABLE;
     HAL_TIM_PWM_ConfigChannel(&htim3, &cfg, TIM_CHANNEL_1);
@@ -309,6 +712,17 @@ static void MX_TIM3_Init(void)
     HAL_TIM_MspPostInit(&htim3);
 }
 
+static void MX_TIM7_Init(void)
+{
+    // 84 MHz / 8400 = 10 kHz count, FAILSAFE_TICK_MS period
+    htim7.Instance = TIM7;
+    htim7.Init.Prescaler = 8400 - 1;
+    htim7.Init.CounterMode = TIM_COUNTERMODE_UP;
+    htim7.Init.Period = FAILSAFE_TICK_MS * 10 - 1;
+    htim7.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+    HAL_TIM_Base_Init(&htim7);
+}
+
 static void MX_UART4_Init(void)
 {
     huart4.Instance = UART4;
@@ -322,6 +736,19 @@ static void MX_UART4_Init(void)
     HAL_UART_Init(&huart4);
 }
 
+static void MX_USART2_UART_Init(void)
+{
+    huart2.Instance = USART2;
+    huart2.Init.BaudRate = 115200;
+    huart2.Init.WordLength = UART_WORDLENGTH_8B;
+    huart2.Init.StopBits = UART_STOPBITS_1;
+    huart2.Init.Parity = UART_PARITY_NONE;
+    huart2.Init.Mode = UART_MODE_TX;
+    huart2.Init.HwFlowCtl = UART_HWCONTROL_NONE;
+    huart2.Init.OverSampling = UART_OVERSAMPLING_16;
+    HAL_UART_Init(&huart2);
+}
+
 static void MX_USART3_UART_Init(void)
 {
     huart3.Instance = USART3;
@@ -335,6 +762,18 @@ static void MX_USART3_UART_Init(void)
     HAL_UART_Init(&huart3);
 }
 
+static void MX_DMA_Init(void)
+{
+    __HAL_RCC_DMA1_CLK_ENABLE();
+
+    HAL_NVIC_SetPriority(DMA1_Stream1_IRQn, 1, 0);   // USART3_RX (GPS)
+    HAL_NVIC_EnableIRQ(DMA1_Stream1_IRQn);
+    HAL_NVIC_SetPriority(DMA1_Stream2_IRQn, 0, 0);   // UART4_RX (LoRa)
+    HAL_NVIC_EnableIRQ(DMA1_Stream2_IRQn);
+    HAL_NVIC_SetPriority(DMA1_Stream6_IRQn, 2, 0);   // USART2_TX (debug)
+    HAL_NVIC_EnableIRQ(DMA1_Stream6_IRQn);
+}
+
 static void MX_GPIO_Init(void)
 {
     __HAL_RCC_GPIOA_CLK_ENABLE();
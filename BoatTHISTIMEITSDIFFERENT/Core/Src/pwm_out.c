@@ -0,0 +1,137 @@
+/*
+ * pwm_out.c – Slew-limited, interpolated servo/ESC output stage
+ */
+
+#include "pwm_out.h"
+
+// Fixed-point scale of ref/pos/vel
+#define PWM_OUT_SUB 16
+
+static uint16_t clamp_us(const PwmOut_t *o, uint32_t us)
+{
+    if (us < o->min_us) return o->min_us;
+    if (us > o->max_us) return o->max_us;
+    return (uint16_t)us;
+}
+
+static int32_t clamp_abs(int32_t v, int32_t lim)
+{
+    if (v > lim) return lim;
+    if (v < -lim) return -lim;
+    return v;
+}
+
+// Integer square root (bitwise, no division)
+static uint32_t isqrt(uint32_t v)
+{
+    uint32_t r = 0;
+    uint32_t bit = 1UL << 30;
+
+    while (bit > v)
+        bit >>= 2;
+
+    while (bit)
+    {
+        if (v >= r + bit)
+        {
+            v -= r + bit;
+            r = (r >> 1) + bit;
+        }
+        else
+        {
+            r >>= 1;
+        }
+        bit >>= 2;
+    }
+    return r;
+}
+
+void pwm_out_init(PwmOut_t *o, volatile uint32_t *ccr, uint16_t us)
+{
+    us = clamp_us(o, us);
+
+    o->ccr = ccr;
+    o->target_us = us;
+    o->step = 0;
+    o->last_set_ms = 0;
+    o->ref = (int32_t)us * PWM_OUT_SUB;
+    o->pos = o->ref;
+    o->vel = 0;
+    *ccr = us;
+}
+
+void pwm_out_set(PwmOut_t *o, uint16_t us, uint32_t now_ms)
+{
+    uint32_t interval = now_ms - o->last_set_ms;
+    o->last_set_ms = now_ms;
+    us = clamp_us(o, us);
+
+    // Spread the step over the time the next setpoint is expected to take
+    int32_t frames = (interval > PWM_OUT_INTERP_MAX_MS) ? 1 : (int32_t)(interval / PWM_OUT_FRAME_MS);
+    if (frames < 1)
+        frames = 1;
+
+    int32_t d = (int32_t)us * PWM_OUT_SUB - o->ref;
+    if (d < 0)
+        d = -d;
+    o->step = d / frames ? d / frames : 1;
+    o->target_us = us;
+}
+
+void pwm_out_hold(PwmOut_t *o, uint16_t us)
+{
+    us = clamp_us(o, us);
+    o->target_us = us;
+    o->ref = (int32_t)us * PWM_OUT_SUB;
+}
+
+uint16_t pwm_out_us(const PwmOut_t *o)
+{
+    return (uint16_t)((o->pos + PWM_OUT_SUB / 2) / PWM_OUT_SUB);
+}
+
+uint8_t pwm_out_update(PwmOut_t *o)
+{
+    int32_t tgt = (int32_t)o->target_us * PWM_OUT_SUB;
+    int32_t step = o->step;
+
+    // 1. Reference towards the setpoint
+    if (o->ref < tgt)
+        o->ref = (tgt - o->ref > step) ? o->ref + step : tgt;
+    else if (o->ref > tgt)
+        o->ref = (o->ref - tgt > step) ? o->ref - step : tgt;
+
+    // 2. Output towards the reference, velocity and acceleration limited.
+    //    Braking from v at a per frame covers v(v+a)/2a, so
+    //    v <= (sqrt(a^2 + 8ad) - a) / 2 still stops on the reference
+    int32_t err = o->ref - o->pos;
+    int32_t amax = (int32_t)o->accel * PWM_OUT_SUB;
+    int32_t vmax = (int32_t)o->slew * PWM_OUT_SUB;
+    uint32_t dist = (uint32_t)(err < 0 ? -err : err);
+    int32_t vstop = ((int32_t)isqrt((uint32_t)(amax * amax) + 8U * (uint32_t)amax * dist) - amax) / 2;
+    if (vstop < vmax)
+        vmax = vstop;
+
+    int32_t want = clamp_abs(err, vmax);
+    o->vel += clamp_abs(want - o->vel, amax);
+    o->pos += o->vel;
+
+    // Reached the reference at low speed: settle on it instead of oscillating
+    uint8_t crossed = (err > 0 && o->pos >= o->ref) || (err < 0 && o->pos <= o->ref);
+    if (crossed && o->vel <= amax && o->vel >= -amax)
+    {
+        o->pos = o->ref;
+        o->vel = 0;
+    }
+
+    // Never past the configured range, whatever the dynamics did
+    if (o->pos < (int32_t)o->min_us * PWM_OUT_SUB) o->pos = (int32_t)o->min_us * PWM_OUT_SUB;
+    if (o->pos > (int32_t)o->max_us * PWM_OUT_SUB) o->pos = (int32_t)o->max_us * PWM_OUT_SUB;
+
+    uint32_t ccr = (uint32_t)((o->pos + PWM_OUT_SUB / 2) / PWM_OUT_SUB);
+    if (ccr == *o->ccr)
+        return 0;
+
+    *o->ccr = ccr;
+    return 1;
+}
@@ -0,0 +1,73 @@
+/*
+ * settings.c – Boat settings kept in flash
+ */
+
+#include "settings.h"
+#include "failsafe.h"
+
+static const ConfigKey_t settings_keys[CFG_COUNT] =
+{
+    [CFG_LORA_ADDRESS]        = { "LORA_ADDRESS",        1,                   0,         65535 },
+    [CFG_LORA_NETWORK]        = { "LORA_NETWORK",        18,                  0,         255 },
+    [CFG_LORA_BAND]           = { "LORA_BAND",           915000000,           862000000, 1020000000 },
+    [CFG_LORA_SF]             = { "LORA_SF",             9,                   7,         12 },
+    [CFG_LORA_BW]             = { "LORA_BW",             7,                   0,         9 },
+    [CFG_LORA_CR]             = { "LORA_CR",             1,                   1,         4 },
+    [CFG_LORA_PREAMBLE]       = { "LORA_PREAMBLE",       12,                  4,         25 },
+    [CFG_LORA_PEER]           = { "LORA_PEER",           100,                 0,         65535 },
+    [CFG_FAILSAFE_TIMEOUT_MS] = { "FAILSAFE_TIMEOUT_MS", FAILSAFE_TIMEOUT_MS, 500,       10000 },
+};
+
+static uint32_t settings_values[CFG_COUNT];
+
+static uint8_t settings_program(uintptr_t addr, uint32_t word);
+static uint8_t settings_erase(uint8_t area);
+
+Config_t settings = CONFIG_INIT(settings_keys, CFG_COUNT, settings_values,
+                                SETTINGS_AREA0, SETTINGS_AREA1, SETTINGS_AREA_SIZE,
+                                settings_program, settings_erase);
+
+// Program one flash word
+static uint8_t settings_program(uintptr_t addr, uint32_t word)
+{
+    HAL_StatusTypeDef st = HAL_FLASH_Unlock();
+    if (st == HAL_OK)
+        st = HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, (uint32_t)addr, word);
+    HAL_FLASH_Lock();
+    return st == HAL_OK;
+}
+
+// Erase the sector of an area (blocking, 1–2 s)
+static uint8_t settings_erase(uint8_t area)
+{
+    FLASH_EraseInitTypeDef erase =
+    {
+        .TypeErase = FLASH_TYPEERASE_SECTORS,
+        .Sector = area ? FLASH_SECTOR_7 : FLASH_SECTOR_6,
+        .NbSectors = 1,
+        .VoltageRange = FLASH_VOLTAGE_RANGE_3,
+    };
+    uint32_t bad_sector;
+
+    HAL_StatusTypeDef st = HAL_FLASH_Unlock();
+    if (st == HAL_OK)
+        st = HAL_FLASHEx_Erase(&erase, &bad_sector);
+    HAL_FLASH_Lock();
+    return st == HAL_OK;
+}
+
+void settings_init(void)
+{
+    config_init(&settings);
+}
+
+void settings_lora(LoRaAtConfig_t *cfg)
+{
+    cfg->address = (uint16_t)setting(CFG_LORA_ADDRESS);
+    cfg->network = (uint8_t)setting(CFG_LORA_NETWORK);
+    cfg->band_hz = setting(CFG_LORA_BAND);
+    cfg->sf = (uint8_t)setting(CFG_LORA_SF);
+    cfg->bw = (uint8_t)setting(CFG_LORA_BW);
+    cfg->cr = (uint8_t)setting(CFG_LORA_CR);
+    cfg->preamble = (uint16_t)setting(CFG_LORA_PREAMBLE);
+}
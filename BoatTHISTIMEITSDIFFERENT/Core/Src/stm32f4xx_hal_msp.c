@@ -9,6 +9,8 @@
   *  - TIM3_CH1 (PC6)  -> Motor ESC PWM
   *  - UART4   (PA0/PA1) -> LoRa @115200
   *  - USART3  (PC10/PC11) -> GPS @9600
+  *  - USART2  (PA2/PA3) -> Debug port (ST-LINK VCP) @115200
+  *  - TIM7               -> Link failsafe tick (update interrupt)
   ******************************************************************************
   */
 /* USER CODE END Header */
@@ -44,6 +46,58 @@
 /* USER CODE END ExternalFunctions */
 
 /* USER CODE BEGIN 0 */
+extern DMA_HandleTypeDef hdma_usart3_rx;
+extern DMA_HandleTypeDef hdma_uart4_rx;
+extern DMA_HandleTypeDef hdma_usart2_tx;
+
+/**
+  * @brief Configure a UART RX DMA stream in circular mode and link it
+  */
+static void UART_RxDMA_Init(UART_HandleTypeDef *huart, DMA_HandleTypeDef *hdma,
+                            DMA_Stream_TypeDef *stream, uint32_t channel,
+                            uint32_t priority)
+{
+  hdma->Instance                 = stream;
+  hdma->Init.Channel             = channel;
+  hdma->Init.Direction           = DMA_PERIPH_TO_MEMORY;
+  hdma->Init.PeriphInc           = DMA_PINC_DISABLE;
+  hdma->Init.MemInc              = DMA_MINC_ENABLE;
+  hdma->Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+  hdma->Init.MemDataAlignment    = DMA_MDATAALIGN_BYTE;
+  hdma->Init.Mode                = DMA_CIRCULAR;
+  hdma->Init.Priority            = priority;
+  hdma->Init.FIFOMode            = DMA_FIFOMODE_DISABLE;
+  if (HAL_DMA_Init(hdma) != HAL_OK)
+  {
+    Error_Handler();
+  }
+
+  __HAL_LINKDMA(huart, hdmarx, *hdma);
+}
+
+/**
+  * @brief Configure a UART TX DMA stream in normal mode and link it
+  */
+static void UART_TxDMA_Init(UART_HandleTypeDef *huart, DMA_HandleTypeDef *hdma,
+                            DMA_Stream_TypeDef *stream, uint32_t channel,
+                            uint32_t priority)
+{
+  hdma->Instance                 = stream;
+  hdma->Init.Channel             = channel;
+  hdma->Init.Direction           = DMA_MEMORY_TO_PERIPH;
+  hdma->Init.PeriphInc           = DMA_PINC_DISABLE;
+  hdma->Init.MemInc              = DMA_MINC_ENABLE;
+  hdma->Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+  hdma->Init.MemDataAlignment    = DMA_MDATAALIGN_BYTE;
+  hdma->Init.Mode                = DMA_NORMAL;
+  hdma->Init.Priority            = priority;
+  hdma->Init.FIFOMode            = DMA_FIFOMODE_DISABLE;
+  if (HAL_DMA_Init(hdma) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  __HAL_LINKDMA(huart, hdmatx, *hdma);
+}
 /* USER CODE END 0 */
 
 void HAL_TIM_MspPostInit(TIM_HandleTypeDef *htim);
@@ -72,6 +126,10 @@ void HAL_TIM_PWM_MspInit(TIM_HandleTypeDef* htim_pwm)
   else if (htim_pwm->Instance == TIM3)
   {
     __HAL_RCC_TIM3_CLK_ENABLE();
+
+    /* TIM3 interrupt Init (output stage frame update, below the UARTs) */
+    HAL_NVIC_SetPriority(TIM3_IRQn, 3, 0);
+    HAL_NVIC_EnableIRQ(TIM3_IRQn);
   }
 }
 
@@ -117,6 +175,36 @@ void HAL_TIM_PWM_MspDeInit(TIM_HandleTypeDef* htim_pwm)
   else if (htim_pwm->Instance == TIM3)
   {
     __HAL_RCC_TIM3_CLK_DISABLE();
+    HAL_NVIC_DisableIRQ(TIM3_IRQn);
+  }
+}
+
+/**
+  * @brief TIM_Base MSP Initialization
+  * @param htim_base: TIM_Base handle pointer
+  */
+void HAL_TIM_Base_MspInit(TIM_HandleTypeDef* htim_base)
+{
+  if (htim_base->Instance == TIM7)
+  {
+    __HAL_RCC_TIM7_CLK_ENABLE();
+
+    /* TIM7 interrupt Init (failsafe tick, same level as the TIM3 output
+       stage so neither preempts the other) */
+    HAL_NVIC_SetPriority(TIM7_IRQn, 3, 0);
+    HAL_NVIC_EnableIRQ(TIM7_IRQn);
+  }
+}
+
+/**
+  * @brief TIM_Base MSP De-Initialization
+  */
+void HAL_TIM_Base_MspDeInit(TIM_HandleTypeDef* htim_base)
+{
+  if (htim_base->Instance == TIM7)
+  {
+    __HAL_RCC_TIM7_CLK_DISABLE();
+    HAL_NVIC_DisableIRQ(TIM7_IRQn);
   }
 }
 
@@ -141,6 +229,9 @@ void HAL_UART_MspInit(UART_HandleTypeDef* huart)
     GPIO_InitStruct.Alternate = GPIO_AF8_UART4;
     HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
 
+    /* UART4_RX -> DMA1 Stream2 Channel4, circular */
+    UART_RxDMA_Init(huart, &hdma_uart4_rx, DMA1_Stream2, DMA_CHANNEL_4, DMA_PRIORITY_HIGH);
+
     /* UART4 interrupt Init */
     HAL_NVIC_SetPriority(UART4_IRQn, 0, 0);
     HAL_NVIC_EnableIRQ(UART4_IRQn);
@@ -158,10 +249,33 @@ void HAL_UART_MspInit(UART_HandleTypeDef* huart)
     GPIO_InitStruct.Alternate = GPIO_AF7_USART3;
     HAL_GPIO_Init(GPIOC, &GPIO_InitStruct);
 
-    /* USART3 interrupt Init (IMPORTANT for GPS RX IT) */
+    /* USART3_RX -> DMA1 Stream1 Channel4, circular */
+    UART_RxDMA_Init(huart, &hdma_usart3_rx, DMA1_Stream1, DMA_CHANNEL_4, DMA_PRIORITY_LOW);
+
+    /* USART3 interrupt Init (needed for idle-line events) */
     HAL_NVIC_SetPriority(USART3_IRQn, 1, 0);
     HAL_NVIC_EnableIRQ(USART3_IRQn);
   }
+  else if (huart->Instance == USART2)
+  {
+    /* ----- Debug USART2 (PA2 TX, PA3 RX) - ST-LINK virtual COM port ----- */
+    __HAL_RCC_USART2_CLK_ENABLE();
+    __HAL_RCC_GPIOA_CLK_ENABLE();
+
+    GPIO_InitStruct.Pin       = GPIO_PIN_2 | GPIO_PIN_3;
+    GPIO_InitStruct.Mode      = GPIO_MODE_AF_PP;
+    GPIO_InitStruct.Pull      = GPIO_NOPULL;
+    GPIO_InitStruct.Speed     = GPIO_SPEED_FREQ_VERY_HIGH;
+    GPIO_InitStruct.Alternate = GPIO_AF7_USART2;
+    HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
+
+    /* USART2_TX -> DMA1 Stream6 Channel4, normal */
+    UART_TxDMA_Init(huart, &hdma_usart2_tx, DMA1_Stream6, DMA_CHANNEL_4, DMA_PRIORITY_LOW);
+
+    /* USART2 interrupt Init (transfer completion) */
+    HAL_NVIC_SetPriority(USART2_IRQn, 2, 0);
+    HAL_NVIC_EnableIRQ(USART2_IRQn);
+  }
 }
 
 /**
@@ -173,14 +287,23 @@ void HAL_UART_MspDeInit(UART_HandleTypeDef* huart)
   {
     __HAL_RCC_UART4_CLK_DISABLE();
     HAL_GPIO_DeInit(GPIOA, GPIO_PIN_0 | GPIO_PIN_1);
+    HAL_DMA_DeInit(huart->hdmarx);
     HAL_NVIC_DisableIRQ(UART4_IRQn);
   }
   else if (huart->Instance == USART3)
   {
     __HAL_RCC_USART3_CLK_DISABLE();
     HAL_GPIO_DeInit(GPIOC, GPIO_PIN_10 | GPIO_PIN_11);
+    HAL_DMA_DeInit(huart->hdmarx);
     HAL_NVIC_DisableIRQ(USART3_IRQn);
   }
+  else if (huart->Instance == USART2)
+  {
+    __HAL_RCC_USART2_CLK_DISABLE();
+    HAL_GPIO_DeInit(GPIOA, GPIO_PIN_2 | GPIO_PIN_3);
+    HAL_DMA_DeInit(huart->hdmatx);
+    HAL_NVIC_DisableIRQ(USART2_IRQn);
+  }
 }
 
 /**
@@ -50,6 +50,12 @@
 /* External variables --------------------------------------------------------*/
 extern UART_HandleTypeDef huart4;  // LoRa
 extern UART_HandleTypeDef huart3;  // GPS
+extern UART_HandleTypeDef huart2;  // Debug port
+extern DMA_HandleTypeDef hdma_uart4_rx;   // LoRa RX
+extern DMA_HandleTypeDef hdma_usart3_rx;  // GPS RX
+extern DMA_HandleTypeDef hdma_usart2_tx;  // Debug TX
+extern TIM_HandleTypeDef htim3;           // Throttle PWM, output stage update
+extern TIM_HandleTypeDef htim7;           // Failsafe tick
 /* USER CODE BEGIN EV */
 /* USER CODE END EV */
 
@@ -128,5 +134,53 @@ void USART3_IRQHandler(void)
   HAL_UART_IRQHandler(&huart3);
 }
 
+/**
+  * @brief This function handles DMA1 stream1 global interrupt (GPS RX).
+  */
+void DMA1_Stream1_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(&hdma_usart3_rx);
+}
+
+/**
+  * @brief This function handles DMA1 stream2 global interrupt (LoRa RX).
+  */
+void DMA1_Stream2_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(&hdma_uart4_rx);
+}
+
+/**
+  * @brief This function handles USART2 global interrupt (debug port).
+  */
+void USART2_IRQHandler(void)
+{
+  HAL_UART_IRQHandler(&huart2);
+}
+
+/**
+  * @brief This function handles DMA1 stream6 global interrupt (debug TX).
+  */
+void DMA1_Stream6_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(&hdma_usart2_tx);
+}
+
+/**
+  * @brief This function handles TIM3 global interrupt (output stage update).
+  */
+void TIM3_IRQHandler(void)
+{
+  HAL_TIM_IRQHandler(&htim3);
+}
+
+/**
+  * @brief This function handles TIM7 global interrupt (failsafe tick).
+  */
+void TIM7_IRQHandler(void)
+{
+  HAL_TIM_IRQHandler(&htim7);
+}
+
 /* USER CODE BEGIN 1 */
 /* USER CODE END 1 */
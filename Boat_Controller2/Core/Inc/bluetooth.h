@@ -5,9 +5,9 @@
 #include "main.h"
 
 /**
-  * @brief Start Bluetooth UART receive interrupt
+  * @brief Start Bluetooth UART circular DMA reception
   */
-void StartBTRxIT(void);
+void StartBTRxDMA(void);
 
 /**
   * @brief Send a line of text over Bluetooth
@@ -15,27 +15,51 @@ void StartBTRxIT(void);
   */
 void bt_send_line(const char* s);
 
+/**
+  * @brief Send a state change over Bluetooth, queued ahead of telemetry
+  * @param s: Null-terminated string to send
+  */
+void bt_send_event(const char* s);
+
 /**
   * @brief Send GPS coordinates over Bluetooth
-  * @param lat: Latitude in decimal degrees
-  * @param lon: Longitude in decimal degrees
+  * @param lat_e7: Latitude in degrees * 1e7
+  * @param lon_e7: Longitude in degrees * 1e7
   */
-void bt_send_gps(float lat, float lon);
+void bt_send_gps(int32_t lat_e7, int32_t lon_e7);
 
 /**
   * @brief Check Bluetooth connection state and send notifications
   */
 void bt_check_state(void);
 
+#ifdef LAT_TRACE
+/**
+  * @brief Forward queued latency trace records over Bluetooth
+  */
+void bt_trace_task(void);
+#endif
+
 /**
-  * @brief Process received Bluetooth command line
+  * @brief Process the queued Bluetooth command lines (EV_BT_LINE)
   */
 void bt_process_line(void);
 
 /**
-  * @brief UART receive callback for Bluetooth
+  * @brief UART receive event callback for Bluetooth
+  * @param pos: DMA write position reported by HAL
+  */
+void bt_rx_callback(uint16_t pos);
+
+/**
+  * @brief UART transmit complete callback for Bluetooth
+  */
+void bt_tx_callback(void);
+
+/**
+  * @brief UART error callback for Bluetooth
   */
-void bt_rx_callback(void);
+void bt_error_callback(void);
 
 /**
   * @brief Initialize Bluetooth module
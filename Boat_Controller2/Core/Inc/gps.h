@@ -1,4 +1,4 @@
-/* gps.h - GPS receiver interface with NMEA parsing */
+/* gps.h - GPS receiver interface with streaming NMEA parsing */
 #ifndef __GPS_H
 #define __GPS_H
 
@@ -7,36 +7,43 @@
 
 /**
   * @brief GPS data structure
-  * Contains current position and validity status
+  * The controller's own position and validity status
   */
 typedef struct {
   uint8_t valid;              /* 1 if GPS fix is valid, 0 otherwise */
-  float latitude;             /* Latitude in decimal degrees */
-  float longitude;            /* Longitude in decimal degrees */
+  int32_t lat_e7;             /* Latitude in degrees * 1e7 */
+  int32_t lon_e7;             /* Longitude in degrees * 1e7 */
   uint32_t last_update_ms;    /* Timestamp of last GPS update */
 } GPSData_t;
 
-/* Global GPS data - updated by GPS parser, read by other modules */
-extern GPSData_t received_gps;
-
 /* GPIO definitions for GPS button */
 #define GPS_BUTTON_PORT GPIOB
 #define GPS_BUTTON_PIN  GPIO_PIN_4
+#define GPS_DEBOUNCE_MS 20
 
 /**
-  * @brief Start GPS UART receive interrupt
+  * @brief Start GPS UART circular DMA reception
   */
-void StartGPSRxIT(void);
+void StartGPSRxDMA(void);
 
 /**
-  * @brief GPS periodic task - parse NMEA and handle button
+  * @brief GPS periodic task - handle button
   */
 void gps_task(void);
 
 /**
-  * @brief UART receive callback for GPS
+  * @brief Copy the controller's own GPS fix
+  * The fix is written by the UART interrupt; it is copied with interrupts
+  * masked so latitude and longitude always belong together
+  * @param fix: Copy of the fix (valid is 0 without one)
+  */
+void gps_get_fix(GPSData_t* fix);
+
+/**
+  * @brief UART receive event callback for GPS
+  * @param pos: DMA write position reported by HAL
   */
-void gps_rx_callback(void);
+void gps_rx_callback(uint16_t pos);
 
 /**
   * @brief Check if GPS button is pressed
@@ -3,27 +3,67 @@
 #define __JOYSTICK_H
 
 #include "main.h"
+#include "ctrl_rate.h"
+#include "ctrl_merge.h"
+#include "ctrl_arb.h"
 #include <stdint.h>
 
 /* ADC channel assignments for joystick axes */
 #define ADC_CHANNEL_THRUST  ADC_CHANNEL_9   /* PA7 - Left Joystick Y (thrust) */
 #define ADC_CHANNEL_RUDDER  ADC_CHANNEL_6   /* PB0 - Right Joystick X (steering) */
 
+/* ADC scan: TIM6 triggers one oversampled conversion of both axes every
+ * JOY_SAMPLE_US; DMA fills two halves of JOY_SCANS scans each. Channels are
+ * stored in ascending channel number order (rudder IN6, then thrust IN9). */
+#define JOY_SAMPLE_US       1000            /* Trigger period (1 kHz) */
+#define JOY_SCANS           8               /* Scans per DMA half (125 Hz output) */
+#define JOY_CHANNELS        2
+#define JOY_IDX_RUDDER      0
+#define JOY_IDX_THRUST      1
+#define JOY_IIR_SHIFT       1               /* IIR weight 1/2 per half buffer */
+
 /* ADC parameters for 12-bit resolution */
 #define ADC_CENTER_VALUE    2048            /* Center position value */
 #define ADC_MAX_VALUE       4095            /* Maximum ADC reading */
-#define THRUST_DEADBAND     100             /* Deadband around center for thrust */
-#define RUDDER_DEADBAND     100             /* Deadband around center for rudder */
 
-/* Control value ranges */
-#define THRUST_MIN          0               /* Minimum thrust percentage */
-#define THRUST_MAX          100             /* Maximum thrust percentage */
-#define RUDDER_MIN          0               /* Minimum rudder value (full left) */
-#define RUDDER_MAX          100             /* Maximum rudder value (full right) */
+/* Stick shaping defaults (settings THRUST_DEADBAND etc., settings.h).
+ * Values are signed: thrust pulled back is reverse, which the boat maps to
+ * idle unless its ESC is reversible. Expo here shapes the stick feel; the
+ * boat applies its own output curve (ctrl_map.h). */
+#define THRUST_DEADBAND     100             /* Deadband around center for thrust (ADC counts) */
+#define RUDDER_DEADBAND     100             /* Deadband around center for rudder (ADC counts) */
+#define THRUST_EXPO         0               /* Expo in percent, 0 = linear */
+#define RUDDER_EXPO         0
+
+/* Calibration: the centre of each stick is captured at every boot, its
+ * end stops in a calibration session (BT "CAL", or both sticks held in the
+ * bottom-right corner at power-up) and kept in data EEPROM. */
+#define JOY_SETTLE_MS       100             /* Filter settling before the centre capture */
+#define JOY_CENTER_MS       300             /* Centre capture window */
+#define JOY_CENTER_SPREAD   32              /* Largest movement while capturing the centre */
+#define JOY_CENTER_TOL      256             /* Largest shift from the stored centre */
+#define JOY_CAL_MS          10000           /* Calibration session: move both sticks to every end stop */
+#define JOY_CAL_MIN_TRAVEL  512             /* Least travel each side of the centre */
+#define JOY_CAL_END_MARGIN  16              /* Full scale this far inside the end stops */
+#define JOY_CAL_GESTURE     256             /* Boot gesture: within this of the end stops */
 
-/* Update timing */
-#define RUDDER_UPDATE_MS    200             /* Send rudder update every 200ms */
-#define THRUST_UPDATE_MS    200             /* Send thrust update every 200ms */
+/**
+  * @brief Calibration of one stick, in ADC counts
+  */
+typedef struct {
+  uint16_t min;
+  uint16_t center;
+  uint16_t max;
+} JoyCal_t;
+
+/**
+  * @brief Calibration state
+  */
+typedef struct {
+  JoyCal_t axis[JOY_CHANNELS];              /* Indexed by JOY_IDX_* */
+  uint8_t  stored;                          /* End stops loaded from or saved to EEPROM */
+  uint8_t  running;                         /* Calibration session in progress */
+} JoyCalState_t;
 
 /**
   * @brief Initialize joystick module
@@ -36,12 +76,60 @@ void joystick_init(void);
 void joystick_task(void);
 
 /**
-  * @brief Read ADC value from specified channel
-  * @param channel: ADC channel to read
+  * @brief Read filtered ADC value for a joystick channel
+  * Non-blocking: returns the latest value produced by the DMA scan
+  * @param channel: ADC_CHANNEL_THRUST or ADC_CHANNEL_RUDDER
   * @retval ADC value (0-4095)
   */
 uint16_t joystick_read_adc(uint32_t channel);
 
+/**
+  * @brief ADC DMA callback - filter a completed half of the scan buffer
+  * @param half: 0 for the first half, 1 for the second
+  */
+void joystick_adc_callback(uint8_t half);
+
+/**
+  * @brief Adaptive send rate state and per-reason send counters
+  * @retval Sender state (read only)
+  */
+const CtrlRate_t* joystick_rate_stats(void);
+
+/**
+  * @brief Take a thrust or rudder value from the app
+  * Updates within APP_MERGE_MS of the first one go out as one CTRL frame,
+  * if the app has control (ctrl_arb.h)
+  * @param axis: CTRL_MERGE_THRUST or CTRL_MERGE_RUDDER
+  * @param value: FRAME_CTRL units
+  */
+void joystick_app_update(uint8_t axis, int16_t value);
+
+/**
+  * @brief App control coalescing counters
+  * @retval Coalescer state (read only)
+  */
+const CtrlMerge_t* joystick_app_stats(void);
+
+/**
+  * @brief Control source arbitration state and counters
+  * @retval Arbiter state (read only)
+  */
+const CtrlArb_t* joystick_arb_stats(void);
+
+/**
+  * @brief Start a calibration session
+  * Neutral controls are sent while it runs; the result is reported on
+  * Bluetooth as CAL,OK or CAL,FAILED after JOY_CAL_MS.
+  * @retval 1 if started, 0 if one is already running
+  */
+uint8_t joystick_cal_start(void);
+
+/**
+  * @brief Current stick calibration
+  * @retval Calibration state (read only)
+  */
+const JoyCalState_t* joystick_cal_stats(void);
+
 /**
   * @brief Check if joystick controller is actively being used
   * @retval 1 if controller active, 0 if inactive/timed out
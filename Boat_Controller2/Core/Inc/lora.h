@@ -3,33 +3,221 @@
 #define __LORA_H
 
 #include "main.h"
+#include "frame.h"
+#include "uart_tx.h"
+#include "lora_at.h"
+#include "lora_airtime.h"
+#include "cmd_arq.h"
+#include "tdma.h"
+#include "lora_adr.h"
+#include "line_queue.h"
 
 /**
-  * @brief Start LoRa UART receive interrupt
+  * @brief Downlink queue counters
+  * Frames wait for a downlink window of the channel schedule (tdma.h)
   */
-void StartLoRaRxIT(void);
+typedef struct {
+  uint32_t waited;            /* Frames not sent at once */
+  uint32_t replaced;          /* CTRL frames replaced by a newer one while waiting */
+  uint32_t dropped;           /* Frames dropped: queue full, or too long for a window */
+} LoRaDownStats_t;
+
+/**
+  * @brief Receive path counters
+  * The RX interrupt only queues complete lines; lora_rx_task parses them
+  * and forwards them to Bluetooth
+  */
+typedef struct {
+  uint32_t isr_runs;          /* RX events handled */
+  uint32_t isr_cycles;        /* Core cycles spent in them */
+  uint32_t isr_max_cycles;    /* Longest one */
+  uint32_t handled;           /* Lines taken from the queue */
+} LoRaRxStats_t;
+
+/**
+  * @brief Latest state heard from one boat of the fleet
+  */
+typedef struct {
+  uint32_t heard_ms;          /* Last packet, 0 = never */
+  uint32_t packets;           /* Packets received */
+  int16_t  rssi;              /* Of the last packet, dBm */
+  int16_t  snr;               /* Of the last packet, dB */
+  uint8_t  failsafe;          /* Last LINK report: 1 = failsafe active */
+  uint8_t  gps_valid;         /* Position received */
+  int32_t  lat_e7;            /* Latitude, degrees * 1e7 */
+  int32_t  lon_e7;            /* Longitude, degrees * 1e7 */
+  uint32_t gps_ms;            /* Position received at */
+} LoRaBoat_t;
+
+/**
+  * @brief Start LoRa UART circular DMA reception
+  */
+void StartLoRaRxDMA(void);
 
 /**
   * @brief Initialize LoRa module with network parameters
-  * Configures address, network ID, frequency band, and RF parameters
+  * Starts the non-blocking configuration script
   */
 void lora_init(void);
 
 /**
-  * @brief Send payload over LoRa network
+  * @brief LoRa periodic task - AT command timeouts and retries
+  */
+void lora_task(void);
+
+/**
+  * @brief Handle the lines queued by the RX interrupt (EV_LORA_RX)
+  * Module replies, boat frames and text forwarded to Bluetooth
+  */
+void lora_rx_task(void);
+
+/**
+  * @brief Check whether the module acknowledged its configuration
+  * @retval 1 if ready to send
+  */
+uint8_t lora_ready(void);
+
+/**
+  * @brief Modulation parameters programmed into the module
+  * @retval Parameters from the settings (read only)
+  */
+const LoRaPhy_t* lora_phy(void);
+
+/**
+  * @brief AT command engine state and counters
+  * @retval Engine state (read only)
+  */
+const LoRaAt_t* lora_at_stats(void);
+
+/**
+  * @brief Send payload to the selected boat
   * @param payload: Null-terminated string to transmit
   */
 void lora_send_payload(const char* payload);
 
+/**
+  * @brief Send a command with acknowledged delivery (retransmitted until ACKed)
+  * to the selected boat
+  * @param text: Command text (at most FRAME_CMD_TEXT_MAX characters)
+  * @retval 1 if queued, 0 if rejected
+  */
+uint8_t lora_send_command(const char* text);
+
+/**
+  * @brief Send a command with acknowledged delivery to a group of boats,
+  * in one broadcast frame
+  * The outcome follows as GROUP,<OK|FAILED>,<group>,<acked>,<text>
+  * @param text: Command text (at most FRAME_CMD_TEXT_MAX characters)
+  * @param group: Boats, bit i = boat i + 1 (limited to the fleet)
+  * @retval 1 if queued, 0 if rejected
+  */
+uint8_t lora_send_group(const char* text, uint8_t group);
+
+/**
+  * @brief Boats of the fleet (setting TDMA_BOATS)
+  * @retval Mask, bit i = boat i + 1
+  */
+uint8_t lora_fleet_mask(void);
+
+/**
+  * @brief Latest state heard from a boat of the fleet
+  * @param boat: Selector position, 0..TDMA_BOATS_MAX-1
+  * @retval Boat state (read only)
+  */
+const LoRaBoat_t* lora_fleet_boat(uint8_t boat);
+
+/**
+  * @brief Latest state heard from the selected boat (its position is the
+  * one shown to the app)
+  * @retval Boat state (read only)
+  */
+const LoRaBoat_t* lora_selected_boat(void);
+
+/**
+  * @brief Send a binary frame to the selected boat
+  * @param f: Frame to transmit (seq is assigned here)
+  */
+void lora_send_frame(Frame_t* f);
+
+/**
+  * @brief Select the boat that receives CTRL frames and commands
+  * @param boat: Selector position, 0..7 (address LORA_PEER + boat)
+  */
+void lora_select_boat(uint8_t boat);
+
+/**
+  * @brief Report the selected boat to the app (BOAT,<number>,<address>)
+  */
+void lora_send_boat(void);
+
 /**
   * @brief Process received LoRa message line
   */
 void lora_process_line(void);
 
 /**
-  * @brief UART receive callback for LoRa module
+  * @brief UART receive event callback for LoRa module
+  * @param pos: DMA write position reported by HAL
+  */
+void lora_rx_callback(uint16_t pos);
+
+/**
+  * @brief UART transmit complete callback for LoRa module
+  */
+void lora_tx_callback(void);
+
+/**
+  * @brief UART error callback for LoRa module
+  */
+void lora_error_callback(void);
+
+/**
+  * @brief LoRa transmit queue counters
+  * @retval Queue state (read only)
+  */
+const UartTx_t* lora_tx_stats(void);
+
+/**
+  * @brief Acknowledged command delivery counters
+  * @retval Sender state (read only)
+  */
+const CmdArqTx_t* lora_arq_stats(void);
+
+/**
+  * @brief Channel schedule and its counters
+  * @retval Schedule state (read only)
+  */
+const Tdma_t* lora_tdma_stats(void);
+
+/**
+  * @brief Downlink queue counters
+  * @retval Counters (read only)
+  */
+const LoRaDownStats_t* lora_down_stats(void);
+
+/**
+  * @brief Adaptive data rate state and counters
+  * @retval Rate controller state (read only)
+  */
+const LoRaAdr_t* lora_adr_stats(void);
+
+/**
+  * @brief Check whether the configured rate is an adaptive data rate step
+  * @retval 1 if LORA_ADR can change the rate, 0 if it stays fixed
+  */
+uint8_t lora_adr_possible(void);
+
+/**
+  * @brief Receive queue between the RX interrupt and lora_rx_task
+  * @retval Queue and its counters (read only)
+  */
+const LineQueue_t* lora_rx_queue(void);
+
+/**
+  * @brief Receive path counters
+  * @retval Counters (read only)
   */
-void lora_rx_callback(void);
+const LoRaRxStats_t* lora_rx_stats(void);
 
 #endif /* __LORA_H */
 
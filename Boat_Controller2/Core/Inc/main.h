@@ -17,7 +17,11 @@ void Error_Handler(void);
 /* Bluetooth state pin configuration */
 #define BT_STATE_PORT GPIOA
 #define BT_STATE_PIN  GPIO_PIN_8
-#define BT_IGNORE_STATE 1  /* Set to 1 to ignore connection state checking */
+#define BT_IGNORE_STATE 1  /* Default of the BT_IGNORE_STATE setting: 1 ignores connection state */
+
+/* Scheduler event flags (signalled from ISRs, see sched.h) */
+#define EV_BT_LINE      (1u << 0)  /* Bluetooth command line received */
+#define EV_LORA_RX      (1u << 1)  /* LoRa module line received */
 
 /* Global UART peripheral handles */
 extern UART_HandleTypeDef huart1;  /* Bluetooth module (9600 baud) */
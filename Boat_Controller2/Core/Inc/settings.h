@@ -0,0 +1,75 @@
+/* settings.h - Controller settings kept in data EEPROM */
+#ifndef __SETTINGS_H
+#define __SETTINGS_H
+
+#include "main.h"
+#include "config.h"
+#include "lora_at.h"
+
+/*
+ * Radio and control parameters, changed over Bluetooth with SET and kept
+ * in the configuration store (config.h). LoRa settings are programmed
+ * into the module at boot, so they take effect after a restart; the
+ * others are read where they are used and apply at once.
+ *
+ * The two store areas are the first 3040 bytes of each data EEPROM bank;
+ * the joystick calibration record follows the second one.
+ */
+
+#define SETTINGS_AREA_SIZE  0xBE0
+
+/* Default addresses: boats from 1 up, the controller above any fleet */
+#define LORA_CONTROLLER_ADDR  100
+#define LORA_BOAT0_ADDR       1
+
+/**
+  * @brief Setting keys (append only: the index is stored with each record)
+  */
+typedef enum {
+  CFG_LORA_ADDRESS = 0,       /* This module's address */
+  CFG_LORA_NETWORK,           /* Network ID */
+  CFG_LORA_BAND,              /* Carrier frequency in Hz */
+  CFG_LORA_SF,                /* Spreading factor */
+  CFG_LORA_BW,                /* Bandwidth code (7 = 125 kHz, 8 = 250 kHz, 9 = 500 kHz) */
+  CFG_LORA_CR,                /* Coding rate 1..4 (4/5 .. 4/8) */
+  CFG_LORA_PREAMBLE,          /* Preamble length in symbols */
+  CFG_LORA_PEER,              /* Address of boat 0; the selector adds its position */
+  CFG_THRUST_DEADBAND,        /* ADC counts around the centre */
+  CFG_RUDDER_DEADBAND,
+  CFG_THRUST_EXPO,            /* Percent */
+  CFG_RUDDER_EXPO,
+  CFG_CTRL_THRESHOLD,         /* CTRL rate (ctrl_rate.h), FRAME_CTRL units */
+  CFG_CTRL_MIN_GAP_MS,
+  CFG_CTRL_ACTIVE_MS,
+  CFG_CTRL_HOLD_MS,
+  CFG_CTRL_HEARTBEAT_MS,
+  CFG_BT_IGNORE_STATE,        /* 1 = treat Bluetooth as always connected */
+  CFG_TDMA_BOATS,             /* Uplink slots in the LoRa schedule (tdma.h) */
+  CFG_LORA_ADR,               /* 1 = adapt SF/BW to the link (lora_adr.h), LORA_SF/LORA_BW as home rate */
+  CFG_APP_MERGE_MS,           /* App THRUST/RUDDER coalescing window (ctrl_merge.h) */
+  CFG_CTRL_HANDOVER_MS,       /* Least time a control source keeps control (ctrl_arb.h) */
+  CFG_APP_TIMEOUT_MS,         /* App silence that hands control back to the joystick */
+  CFG_COUNT
+} SettingKey_t;
+
+extern Config_t settings;
+
+/**
+  * @brief Load the settings; call before the modules that use them
+  */
+void settings_init(void);
+
+/**
+  * @brief Current value of a setting
+  */
+static inline uint32_t setting(SettingKey_t key) {
+  return config_get(&settings, (uint8_t)key);
+}
+
+/**
+  * @brief LoRa module settings
+  * @param cfg: Filled from the stored values
+  */
+void settings_lora(LoRaAtConfig_t* cfg);
+
+#endif /* __SETTINGS_H */
@@ -17,6 +17,9 @@ void SysTick_Handler(void);
 void USART4_5_IRQHandler(void);  /* LoRa module (USART4) */
 void USART2_IRQHandler(void);    /* GPS module */
 void USART1_IRQHandler(void);    /* Bluetooth module */
+void DMA1_Channel1_IRQHandler(void);        /* Joystick ADC DMA */
+void DMA1_Channel2_3_IRQHandler(void);      /* LoRa / Bluetooth RX DMA */
+void DMA1_Channel4_5_6_7_IRQHandler(void);  /* Bluetooth TX / GPS RX / LoRa TX DMA */
 
 #ifdef __cplusplus
 }
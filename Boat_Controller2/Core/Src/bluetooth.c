@@ -2,89 +2,582 @@
 #include "bluetooth.h"
 #include "lora.h"
 #include "gps.h"
+#include "uart_rx.h"
+#include "uart_tx.h"
+#include "nmea.h"
+#include "sched.h"
+#include "joystick.h"
+#include "frame.h"
+#include "lora_airtime.h"
+#include "lat_trace.h"
+#include "settings.h"
+#include "line_queue.h"
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
 
-#define BT_BUF 128
+#define BT_BUF     64     /* Longest app line: GROUP,<mask>, and a 40-character command */
+#define BT_RX_SLOTS 8
+#define BT_DMA_BUF 64
+#define BT_TX_DMA  128
 
-/* Bluetooth receive state */
-static uint8_t  bt_rx_byte;
-static char     bt_line[BT_BUF];
-static volatile size_t  bt_len = 0;
-static volatile uint8_t bt_ready = 0;
+/* Control ring space BTCMD needs before it handles a line: the longest
+ * message (any single reply, or both AIRTIME lines) */
+#define BT_REPLY_ROOM BT_TX_DMA
+
+/* Settle time before notifying a newly connected app */
+#define BT_CONNECT_SETTLE_MS 100
+
+/* Bluetooth receive state: lines wait in slots until BTCMD handles them,
+ * so commands sent back to back are not lost between two runs */
+static void bt_on_line(char* line);
+static uint8_t  bt_dma_buf[BT_DMA_BUF];
+static char     bt_rx_line[BT_BUF];
+static UartRx_t bt_rx = UART_RX_INIT(&huart1, bt_dma_buf, bt_rx_line, 0, bt_on_line);
+static char     bt_slots[BT_RX_SLOTS][BT_BUF];
+static LineQueue_t bt_q = LINE_QUEUE_INIT(bt_slots);
+
+/* Bluetooth transmit queue: command replies are control, the rest telemetry.
+ * The control ring holds a full reply with room left for events. */
+static uint8_t  bt_tx_dma[BT_TX_DMA];
+static uint8_t  bt_tx_ctrl[256];
+static uint8_t  bt_tx_telem[384];
+static UartTx_t bt_tx = UART_TX_INIT(&huart1, bt_tx_dma, bt_tx_ctrl, bt_tx_telem);
+
+/* Multi-line reply in progress: BTCMD sends the lines that fit in the
+ * control ring and resumes on a later run, woken by the DMA completion */
+typedef enum {
+  BT_REPLY_NONE = 0,
+  BT_REPLY_GET,
+  BT_REPLY_FLEET,
+  BT_REPLY_STATS,
+  BT_REPLY_TXSTATS
+} BtReply_t;
+
+static BtReply_t bt_reply = BT_REPLY_NONE;
+static uint8_t   bt_reply_next = 0;
+static volatile uint8_t bt_tx_wait = 0;
 
 /* Connection state tracking */
 static uint8_t  bt_was_connected = 0;
-static uint32_t bt_last_conn_check = 0;
+static uint8_t  bt_notify_pending = 0;
+static uint32_t bt_connect_ms = 0;
 
 /**
   * @brief Check if Bluetooth is currently connected
+  * Always connected with the BT_IGNORE_STATE setting
   * @retval 1 if connected, 0 otherwise
   */
 static uint8_t bt_connected(void) {
-#if BT_IGNORE_STATE
-  return 1;
-#else
+  if(setting(CFG_BT_IGNORE_STATE)) return 1;
   return HAL_GPIO_ReadPin(BT_STATE_PORT, BT_STATE_PIN) == GPIO_PIN_SET;
-#endif
 }
 
 /**
   * @brief Send a line of text over Bluetooth
+  * Queued as telemetry: the oldest queued line is dropped if the link is slow
   * @param s: String to send (null-terminated)
   */
 void bt_send_line(const char* s) {
-#if !BT_IGNORE_STATE
   if(!bt_connected()) return;
-#endif
-  HAL_UART_Transmit(&huart1, (uint8_t*)s, strlen(s), HAL_MAX_DELAY);
-  HAL_UART_Transmit(&huart1, (uint8_t*)"\r\n", 2, HAL_MAX_DELAY);
+  uart_tx_line(&bt_tx, s, UART_TX_TELEMETRY);
+}
+
+/**
+  * @brief Send a reply to an app command over Bluetooth
+  * Queued as control: sent ahead of telemetry and never evicted by it.
+  * BTCMD checks for room first; a full ring drops the line (TXSTATS).
+  * @param s: String to send (null-terminated)
+  */
+static void bt_send_reply(const char* s) {
+  if(!bt_connected()) return;
+  uart_tx_line(&bt_tx, s, UART_TX_CONTROL);
+}
+
+/**
+  * @brief Send an unsolicited state change over Bluetooth
+  * Queued as control, like replies; dropped (TXSTATS) only if the control
+  * ring is full
+  * @param s: String to send (null-terminated)
+  */
+void bt_send_event(const char* s) {
+  bt_send_reply(s);
 }
 
 /**
   * @brief Send GPS coordinates over Bluetooth
-  * @param lat: Latitude in decimal degrees
-  * @param lon: Longitude in decimal degrees
+  * @param lat_e7: Latitude in degrees * 1e7
+  * @param lon_e7: Longitude in degrees * 1e7
   */
-void bt_send_gps(float lat, float lon) {
-#if !BT_IGNORE_STATE
+void bt_send_gps(int32_t lat_e7, int32_t lon_e7) {
   if(!bt_connected()) return;
-#endif
+  char lat[16], lon[16];
   char msg[128];
-  int n = snprintf(msg, sizeof(msg), "GPS,%.6f,%.6f", lat, lon);
+  nmea_format_deg_e7(lat, sizeof(lat), lat_e7);
+  nmea_format_deg_e7(lon, sizeof(lon), lon_e7);
+  int n = snprintf(msg, sizeof(msg), "GPS,%s,%s", lat, lon);
   if(n > 0) {
-    HAL_UART_Transmit(&huart1, (uint8_t*)msg, (size_t)n, HAL_MAX_DELAY);
-    HAL_UART_Transmit(&huart1, (uint8_t*)"\r\n", 2, HAL_MAX_DELAY);
+    uart_tx_line(&bt_tx, msg, UART_TX_TELEMETRY);
   }
 }
 
 /**
   * @brief Check Bluetooth connection state and send updates
-  * Sends connection notification and current GPS position on connect
+  * Sends connection notification and current GPS position once the
+  * link has been up for BT_CONNECT_SETTLE_MS. Scheduled periodically.
   */
 void bt_check_state(void) {
   uint32_t now = HAL_GetTick();
-  
-  /* Check connection state every 500ms */
-  if(now - bt_last_conn_check < 500) return;
-  bt_last_conn_check = now;
-
   uint8_t c = bt_connected();
   
-  /* Send notification on connection state change */
+  /* Start the settle timer on connection */
   if(c != bt_was_connected) {
-    if(c) {
-      HAL_Delay(100);
-      bt_send_line("SYSTEM,CONNECTED");
-      
-      /* Send current GPS position if available and recent */
-      if(received_gps.valid && (HAL_GetTick() - received_gps.last_update_ms) < 10000) {
-        bt_send_gps(received_gps.latitude, received_gps.longitude);
-      }
-    }
+    bt_notify_pending = c;
+    bt_connect_ms = now;
     bt_was_connected = c;
   }
+
+  if(bt_notify_pending && now - bt_connect_ms >= BT_CONNECT_SETTLE_MS) {
+    bt_notify_pending = 0;
+    bt_send_reply("SYSTEM,CONNECTED");
+    
+    /* Send the selected boat's position if available and recent */
+    const LoRaBoat_t* b = lora_selected_boat();
+    if(b->gps_valid && (now - b->gps_ms) < 10000) {
+      bt_send_gps(b->lat_e7, b->lon_e7);
+    }
+  }
+}
+
+#ifdef LAT_TRACE
+/**
+  * @brief Forward queued latency trace records to the app as LT lines
+  * Scheduled periodically; a few lines per run keep the telemetry ring
+  * from evicting its own records
+  */
+void bt_trace_task(void) {
+  char line[24];
+  for(uint8_t i = 0; i < 4 && lat_trace_next(line, sizeof(line)); i++) {
+    bt_send_line(line);
+  }
+}
+#endif
+
+/**
+  * @brief Report payload size and time on air of one message, text vs binary
+  * Reply: AIRTIME,<name>,<text bytes>,<text us>,<binary bytes>,<binary us>
+  * @param name: Message name
+  * @param text: Message in the legacy text protocol
+  * @param f: Same message as a binary frame
+  */
+static void bt_report_airtime(const char* name, const char* text, const Frame_t* f) {
+  const LoRaPhy_t* phy = lora_phy();
+  char bin[FRAME_MAX_ENCODED];
+  char line[64];
+
+  unsigned text_len = (unsigned)strlen(text);
+  unsigned bin_len = (unsigned)frame_encode(f, bin, sizeof(bin));
+
+  snprintf(line, sizeof(line), "AIRTIME,%s,%u,%lu,%u,%lu", name,
+           text_len, (unsigned long)lora_airtime_us(phy, text_len),
+           bin_len, (unsigned long)lora_airtime_us(phy, bin_len));
+  bt_send_reply(line);
+}
+
+/**
+  * @brief Format transmit queue counters
+  * Reply: TXSTATS,<name>,<queued bytes>,<peak bytes>,<bytes>,<drops>,<control drops>
+  * Drops are telemetry evicted or refused; control drops are replies and
+  * events lost to a full control ring
+  * @param name: Queue name
+  * @param tx: Queue state
+  */
+static void bt_format_tx_stats(char* line, size_t size, const char* name, const UartTx_t* tx) {
+  snprintf(line, size, "TXSTATS,%s,%u,%u,%lu,%lu,%lu", name,
+           (unsigned)uart_tx_queued(tx), (unsigned)tx->peak,
+           (unsigned long)tx->bytes, (unsigned long)tx->drops,
+           (unsigned long)tx->ctrl_drops);
+}
+
+/**
+  * @brief Report Bluetooth receive queue counters
+  * Reply: BTRX,<queued>,<peak>,<lines>,<dropped>,<overlong>
+  * Lines are dropped when every slot is still waiting, overlong ones
+  * (more than BT_BUF - 1 characters) when they arrive
+  */
+static void bt_send_rx_stats(void) {
+  char line[64];
+  snprintf(line, sizeof(line), "BTRX,%u,%u,%lu,%lu,%lu",
+           (unsigned)(uint8_t)(bt_q.head - bt_q.tail), (unsigned)bt_q.high_water,
+           (unsigned long)bt_q.pushed, (unsigned long)bt_q.dropped,
+           (unsigned long)bt_rx.overflows);
+  bt_send_reply(line);
+}
+
+/**
+  * @brief Report LoRa receive path counters
+  * Reply: LORARX,<queued>,<peak>,<handled>,<dropped>,<isr runs>,<isr avg us>,<isr max us>
+  * Lines are dropped when the RX interrupt finds every slot still queued
+  */
+static void bt_send_lora_rx_stats(void) {
+  const LineQueue_t* q = lora_rx_queue();
+  const LoRaRxStats_t* r = lora_rx_stats();
+  uint32_t mhz = SystemCoreClock / 1000000U;
+  uint32_t avg = r->isr_runs ? r->isr_cycles / r->isr_runs / mhz : 0;
+  char line[96];
+  snprintf(line, sizeof(line), "LORARX,%u,%u,%lu,%lu,%lu,%lu,%lu",
+           (unsigned)(uint8_t)(q->head - q->tail), (unsigned)q->high_water,
+           (unsigned long)r->handled, (unsigned long)q->dropped,
+           (unsigned long)r->isr_runs, (unsigned long)avg,
+           (unsigned long)(r->isr_max_cycles / mhz));
+  bt_send_reply(line);
+}
+
+/**
+  * @brief Report acknowledged command delivery counters
+  * Reply: ARQ,<queued>,<delivered>,<failed>,<rejected>,<sent>,<resent>,
+  *        <avg ms>,<max ms>,<rto ms>,<pending>
+  * Retransmit rate is resent/sent; latency is first send to ACK
+  */
+static void bt_send_arq_stats(void) {
+  const CmdArqTx_t* a = lora_arq_stats();
+  uint32_t avg = a->delivered ? a->latency_total_ms / a->delivered : 0;
+  char line[128];
+  snprintf(line, sizeof(line), "ARQ,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%u",
+           (unsigned long)a->queued, (unsigned long)a->delivered,
+           (unsigned long)a->failed, (unsigned long)a->rejected,
+           (unsigned long)a->transmissions, (unsigned long)a->retransmits,
+           (unsigned long)avg, (unsigned long)a->latency_max_ms,
+           (unsigned long)a->rto_ms, (unsigned)cmd_arq_pending(a));
+  bt_send_reply(line);
+}
+
+/**
+  * @brief Queue an app command for acknowledged delivery
+  * Reply CMD,BUSY if it cannot be queued (too long or too many in flight)
+  * @param text: Command text without the CMD, prefix
+  */
+static void bt_send_command(const char* text) {
+  if(!lora_send_command(text)) {
+    bt_send_reply("CMD,BUSY");
+  }
+}
+
+/**
+  * @brief Queue a command for a group of boats
+  * Reply GROUP,BUSY if it cannot be queued (no boat of the fleet addressed,
+  * too long or too many in flight)
+  * @param arg: "<mask|ALL>,<command>", decimal mask, bit i = boat i + 1
+  */
+static void bt_send_group(const char* arg) {
+  unsigned long group;
+  char* end;
+
+  if(strncmp(arg, "ALL,", 4) == 0) {
+    group = lora_fleet_mask();
+    end = (char*)arg + 3;
+  }
+  else {
+    /* Decimal only, range checked before the cast: 257 must not address
+     * boat 1, and an empty group is refused by lora_send_group */
+    group = 0;
+    end = (char*)arg;
+    if(arg[0] >= '0' && arg[0] <= '9') group = strtoul(arg, &end, 10);
+    if(group > 0xFF) group = 0;
+  }
+  if(*end != ',' || !lora_send_group(end + 1, (uint8_t)group)) {
+    bt_send_reply("GROUP,BUSY");
+  }
+}
+
+/**
+  * @brief Format the latest state heard from one boat of the fleet
+  * Reply: FLEET,<n>,STATE,<address>,<age ms>,<rssi>,<snr>,<packets>,<failsafe>,<lat>,<lon>
+  * Age is since the last packet, -1 if never heard; position empty if unknown
+  * @param i: Fleet index (boat i + 1)
+  */
+static void bt_format_fleet(char* line, size_t size, uint8_t i) {
+  const Tdma_t* t = lora_tdma_stats();
+  const LoRaBoat_t* b = lora_fleet_boat(i);
+  char age[12], lat[16] = "", lon[16] = "";
+
+  if(b->packets) snprintf(age, sizeof(age), "%lu", (unsigned long)(HAL_GetTick() - b->heard_ms));
+  else snprintf(age, sizeof(age), "-1");
+  if(b->gps_valid) {
+    nmea_format_deg_e7(lat, sizeof(lat), b->lat_e7);
+    nmea_format_deg_e7(lon, sizeof(lon), b->lon_e7);
+  }
+  snprintf(line, size, "FLEET,%u,STATE,%u,%s,%d,%d,%lu,%u,%s,%s", (unsigned)i + 1,
+           (unsigned)(t->base + i), age, b->rssi, b->snr, (unsigned long)b->packets,
+           (unsigned)b->failsafe, lat, lon);
+}
+
+/**
+  * @brief Format the run-time statistics of one scheduler task
+  * Reply: STATS,<task>,<runs>,<avg us>,<max us>,<overruns>,<misses>
+  * @param i: Task index
+  */
+static void bt_format_sched_stats(char* line, size_t size, uint8_t i) {
+  const SchedTask_t* t = sched_task(i);
+  uint32_t avg = t->runs ? t->total_us / t->runs : 0;
+  snprintf(line, size, "STATS,%s,%lu,%lu,%lu,%lu,%lu", t->name,
+           (unsigned long)t->runs, (unsigned long)avg, (unsigned long)t->max_us,
+           (unsigned long)t->overruns, (unsigned long)t->misses);
+}
+
+/**
+  * @brief Report LoRa module configuration state
+  * Reply: LINK,<READY|BUSY|FAILED|IDLE>,<boot-to-ready ms>,<oks>,<errors>,<timeouts>,<retries>
+  */
+static void bt_send_link(void) {
+  static const char* const states[] = { "IDLE", "BUSY", "READY", "FAILED" };
+  const LoRaAt_t* at = lora_at_stats();
+  char line[64];
+  snprintf(line, sizeof(line), "LINK,%s,%lu,%lu,%lu,%lu,%lu", states[at->state & 3],
+           (unsigned long)(at->done_ms - at->start_ms), (unsigned long)at->oks,
+           (unsigned long)at->errors, (unsigned long)at->timeouts,
+           (unsigned long)at->retries);
+  bt_send_reply(line);
+}
+
+/**
+  * @brief Report the stick calibration
+  * Reply: CAL,<STORED|DEFAULT|RUNNING>,<thrust min>,<center>,<max>,<rudder min>,<center>,<max>
+  */
+static void bt_send_cal(void) {
+  const JoyCalState_t* c = joystick_cal_stats();
+  const JoyCal_t* t = &c->axis[JOY_IDX_THRUST];
+  const JoyCal_t* r = &c->axis[JOY_IDX_RUDDER];
+  char line[64];
+  snprintf(line, sizeof(line), "CAL,%s,%u,%u,%u,%u,%u,%u",
+           c->running ? "RUNNING" : c->stored ? "STORED" : "DEFAULT",
+           t->min, t->center, t->max, r->min, r->center, r->max);
+  bt_send_reply(line);
+}
+
+/**
+  * @brief Format one setting
+  * Reply: GET,<name>,<value>
+  */
+static void bt_format_setting(char* line, size_t size, uint8_t key) {
+  snprintf(line, size, "GET,%s,%lu", settings.keys[key].name,
+           (unsigned long)config_get(&settings, key));
+}
+
+/**
+  * @brief Report one setting
+  */
+static void bt_send_setting(uint8_t key) {
+  char line[48];
+  bt_format_setting(line, sizeof(line), key);
+  bt_send_reply(line);
+}
+
+/**
+  * @brief Change and store a setting
+  * Reply: SET,<OK|RANGE|FAILED>,<name>,<value> or SET,UNKNOWN
+  * @param arg: "<name>,<value>"
+  */
+static void bt_set_setting(const char* arg) {
+  static const char* const status[] = { "OK", "UNKNOWN", "RANGE", "FAILED" };
+  int16_t key;
+  ConfigStatus_t st = config_set_text(&settings, arg, &key);
+  if(key < 0) {
+    bt_send_reply("SET,UNKNOWN");
+    return;
+  }
+
+  char line[48];
+  snprintf(line, sizeof(line), "SET,%s,%s,%lu", status[st], settings.keys[key].name,
+           (unsigned long)config_get(&settings, (uint8_t)key));
+  bt_send_reply(line);
+}
+
+/**
+  * @brief Report configuration store state
+  * Reply: CONFIG,<area>,<epoch>,<bytes used>,<area bytes>,<loaded>,<writes>,<switches>,<errors>
+  */
+static void bt_send_config_stats(void) {
+  char line[96];
+  snprintf(line, sizeof(line), "CONFIG,%u,%u,%lu,%lu,%lu,%lu,%lu,%lu",
+           (unsigned)settings.area, (unsigned)settings.epoch,
+           (unsigned long)config_used(&settings), (unsigned long)settings.size,
+           (unsigned long)settings.loaded, (unsigned long)settings.writes,
+           (unsigned long)settings.compactions, (unsigned long)settings.errors);
+  bt_send_reply(line);
+}
+
+/**
+  * @brief Report the channel schedule
+  * Reply: TDMA,<boats>,<frame ms>,<down ms>,<up ms>,<sent>,<syncs>,<waited>,<replaced>,<dropped>
+  */
+static void bt_send_tdma_stats(void) {
+  const Tdma_t* t = lora_tdma_stats();
+  const LoRaDownStats_t* d = lora_down_stats();
+  char line[96];
+  snprintf(line, sizeof(line), "TDMA,%u,%lu,%u,%u,%lu,%lu,%lu,%lu,%lu",
+           (unsigned)t->boats, (unsigned long)tdma_frame_ms(t), (unsigned)t->down_ms,
+           (unsigned)t->up_ms, (unsigned long)t->sent, (unsigned long)t->syncs,
+           (unsigned long)d->waited, (unsigned long)d->replaced, (unsigned long)d->dropped);
+  bt_send_reply(line);
+}
+
+/**
+  * @brief Report the adaptive data rate
+  * Reply: ADR,<ON|OFF|FIXED>,<sf>,<bw>,<margin dB>,<faster>,<slower>,<fallbacks>,<aborted>
+  * FIXED: the configured rate is not one of the steps (lora_adr.h)
+  */
+static void bt_send_adr_stats(void) {
+  const LoRaAdr_t* a = lora_adr_stats();
+  const char* mode = !lora_adr_possible() ? "FIXED" : setting(CFG_LORA_ADR) ? "ON" : "OFF";
+  uint8_t bw = lora_adr_possible() ? lora_adr_rates[a->rate].bw : (uint8_t)setting(CFG_LORA_BW);
+  char line[80];
+
+  snprintf(line, sizeof(line), "ADR,%s,%u,%u,%d,%lu,%lu,%lu,%lu", mode,
+           (unsigned)lora_phy()->sf, (unsigned)bw,
+           a->margin_db10 / 10, (unsigned long)a->faster, (unsigned long)a->slower,
+           (unsigned long)a->fallbacks, (unsigned long)a->aborted);
+  bt_send_reply(line);
+}
+
+/**
+  * @brief Compare the text and binary protocols for CTRL and GPS messages
+  * Uses full-scale CTRL values and the selected boat's last position
+  */
+static void bt_send_airtime(void) {
+  const LoRaBoat_t* b = lora_selected_boat();
+  Frame_t f = { 0 };
+  char text[48];
+
+  f.type = FRAME_CTRL;
+  f.u.ctrl.thrust = FRAME_CTRL_MAX;
+  f.u.ctrl.rudder = FRAME_CTRL_MAX;
+  bt_report_airtime("CTRL", "CTRL,100,100", &f);
+
+  char lat[16], lon[16];
+  nmea_format_deg_e7(lat, sizeof(lat), b->lat_e7);
+  nmea_format_deg_e7(lon, sizeof(lon), b->lon_e7);
+  snprintf(text, sizeof(text), "GPS,%s,%s", lat, lon);
+
+  f.type = FRAME_GPS;
+  f.u.gps.lat_e7 = b->lat_e7;
+  f.u.gps.lon_e7 = b->lon_e7;
+  bt_report_airtime("GPS", text, &f);
+}
+
+/**
+  * @brief Take a thrust or rudder value from the app
+  * Reply THRUST,INVALID or RUDDER,INVALID if it is not -100..100
+  * @param axis: CTRL_MERGE_THRUST or CTRL_MERGE_RUDDER
+  * @param arg: Percent of full scale, negative for reverse or left
+  */
+static void bt_app_ctrl(uint8_t axis, const char* arg) {
+  char* end;
+  long pct = strtol(arg, &end, 10);
+  if(end == arg || *end || pct < -100 || pct > 100) {
+    bt_send_reply(axis == CTRL_MERGE_THRUST ? "THRUST,INVALID" : "RUDDER,INVALID");
+    return;
+  }
+  joystick_app_update(axis, (int16_t)(pct * FRAME_CTRL_MAX / 100));
+}
+
+/**
+  * @brief Report app control coalescing counters
+  * Reply: MERGE,<updates>,<frames>,<saved>,<saved last minute>,<window ms>
+  * Saved counts THRUST/RUDDER lines that did not need a CTRL frame of their own
+  */
+static void bt_send_merge_stats(void) {
+  const CtrlMerge_t* m = joystick_app_stats();
+  char line[64];
+  snprintf(line, sizeof(line), "MERGE,%lu,%lu,%lu,%lu,%u",
+           (unsigned long)m->updates, (unsigned long)m->frames,
+           (unsigned long)ctrl_merge_saved(m), (unsigned long)m->saved_last_minute,
+           (unsigned)m->window_ms);
+  bt_send_reply(line);
+}
+
+/**
+  * @brief Report the control source and hand-over counters
+  * Reply: ARB,<JOYSTICK|APP>,<ms in control>,<to app>,<to joystick>,<timeouts>,<app lines dropped>
+  */
+static void bt_send_arb_stats(void) {
+  const CtrlArb_t* a = joystick_arb_stats();
+  char line[80];
+  snprintf(line, sizeof(line), "ARB,%s,%lu,%lu,%lu,%lu,%lu",
+           a->source == CTRL_SRC_APP ? "APP" : "JOYSTICK",
+           (unsigned long)(HAL_GetTick() - a->since_ms), (unsigned long)a->to_app,
+           (unsigned long)a->to_joystick, (unsigned long)a->timeouts,
+           (unsigned long)joystick_app_stats()->dropped);
+  bt_send_reply(line);
+}
+
+/**
+  * @brief Format line n of the reply in progress
+  * @retval 1 if formatted, 0 if the reply is complete
+  */
+static uint8_t bt_reply_line(char* line, size_t size, uint8_t n) {
+  switch(bt_reply) {
+  case BT_REPLY_GET:
+    if(n >= settings.count) return 0;
+    bt_format_setting(line, size, n);
+    return 1;
+  case BT_REPLY_FLEET:
+    if(n >= lora_tdma_stats()->boats) return 0;
+    bt_format_fleet(line, size, n);
+    return 1;
+  case BT_REPLY_STATS:
+    if(n >= sched_task_count()) return 0;
+    bt_format_sched_stats(line, size, n);
+    return 1;
+  case BT_REPLY_TXSTATS:
+    if(n >= 2) return 0;
+    if(n == 0) bt_format_tx_stats(line, size, "BT", &bt_tx);
+    else bt_format_tx_stats(line, size, "LORA", lora_tx_stats());
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+/**
+  * @brief Check the control ring has room for the next reply line
+  * Otherwise arm the wake-up from the DMA completion callback
+  * @retval 1 if there is room
+  */
+static uint8_t bt_reply_room(void) {
+  /* Armed before the check so a completion in between still wakes BTCMD */
+  bt_tx_wait = 1;
+  if(uart_tx_room(&bt_tx, UART_TX_CONTROL) < BT_REPLY_ROOM) return 0;
+  bt_tx_wait = 0;
+  return 1;
+}
+
+/**
+  * @brief Send the lines of the reply in progress that fit in the control ring
+  * @retval 1 if the reply is complete, 0 if it resumes on a later run
+  */
+static uint8_t bt_reply_resume(void) {
+  char line[112];
+
+  while(bt_reply != BT_REPLY_NONE) {
+    if(!bt_reply_room()) return 0;
+    if(!bt_reply_line(line, sizeof(line), bt_reply_next)) {
+      bt_reply = BT_REPLY_NONE;
+      break;
+    }
+    bt_send_reply(line);
+    bt_reply_next++;
+  }
+  return 1;
+}
+
+/**
+  * @brief Start a multi-line reply; BTCMD sends it before the next command
+  * @param r: Reply to send
+  */
+static void bt_reply_start(BtReply_t r) {
+  bt_reply = r;
+  bt_reply_next = 0;
 }
 
 /**
@@ -101,32 +594,154 @@ static void handle_bt_line(char* s) {
 
   /* Handle diagnostic commands */
   if(strcmp(s, "PING") == 0) { 
-    bt_send_line("PONG"); 
+    bt_send_reply("PONG"); 
     return; 
   }
 
   if(strcmp(s, "STATUS") == 0) {
-    if(received_gps.valid) {
-      uint32_t age = HAL_GetTick() - received_gps.last_update_ms;
+    const LoRaBoat_t* b = lora_selected_boat();
+    if(b->gps_valid) {
+      uint32_t age = HAL_GetTick() - b->gps_ms;
       if(age < 10000) {
-        bt_send_gps(received_gps.latitude, received_gps.longitude);
+        bt_send_gps(b->lat_e7, b->lon_e7);
       } else {
-        bt_send_line("STATUS,GPS_STALE");
+        bt_send_reply("STATUS,GPS_STALE");
       }
     } else {
-      bt_send_line("STATUS,NO_GPS");
+      bt_send_reply("STATUS,NO_GPS");
     }
     return;
   }
 
-  /* Forward control commands to LoRa */
+  if(strcmp(s, "AIRTIME") == 0) {
+    bt_send_airtime();
+    return;
+  }
+
+  if(strcmp(s, "STATS") == 0) {
+    bt_reply_start(BT_REPLY_STATS);
+    return;
+  }
+
+  if(strcmp(s, "STATS,RESET") == 0) {
+    sched_reset_stats();
+    bt_send_reply("STATS,OK");
+    return;
+  }
+
+  if(strcmp(s, "LINK") == 0) {
+    bt_send_link();
+    return;
+  }
+
+  if(strcmp(s, "CTRLRATE") == 0) {
+    const CtrlRate_t* r = joystick_rate_stats();
+    char line[64];
+    snprintf(line, sizeof(line), "CTRLRATE,%lu,%lu,%lu",
+             (unsigned long)r->sends[CTRL_RATE_CHANGE],
+             (unsigned long)r->sends[CTRL_RATE_ACTIVE],
+             (unsigned long)r->sends[CTRL_RATE_HEARTBEAT]);
+    bt_send_reply(line);
+    return;
+  }
+
+  if(strcmp(s, "ARQ") == 0) {
+    bt_send_arq_stats();
+    return;
+  }
+
+  /* Stick calibration session; the result follows as CAL,OK or CAL,FAILED */
+  if(strcmp(s, "CAL") == 0) {
+    bt_send_reply(joystick_cal_start() ? "CAL,STARTED" : "CAL,BUSY");
+    return;
+  }
+
+  if(strcmp(s, "CAL,GET") == 0) {
+    bt_send_cal();
+    return;
+  }
+
+  /* Settings; LoRa ones take effect after a restart */
+  if(strncmp(s, "SET,", 4) == 0) {
+    bt_set_setting(s + 4);
+    return;
+  }
+
+  if(strcmp(s, "GET") == 0) {
+    bt_reply_start(BT_REPLY_GET);
+    return;
+  }
+
+  if(strncmp(s, "GET,", 4) == 0) {
+    int16_t key = config_find(&settings, s + 4);
+    if(key < 0) {
+      bt_send_reply("GET,UNKNOWN");
+    } else {
+      bt_send_setting((uint8_t)key);
+    }
+    return;
+  }
+
+  if(strcmp(s, "CONFIG") == 0) {
+    bt_send_config_stats();
+    return;
+  }
+
+  /* Boat selector position; also sent when it changes */
+  if(strcmp(s, "BOAT") == 0) {
+    lora_send_boat();
+    return;
+  }
+
+  if(strcmp(s, "TDMA") == 0) {
+    bt_send_tdma_stats();
+    return;
+  }
+
+  if(strcmp(s, "FLEET") == 0) {
+    bt_reply_start(BT_REPLY_FLEET);
+    return;
+  }
+
+  if(strcmp(s, "ADR") == 0) {
+    bt_send_adr_stats();
+    return;
+  }
+
+  if(strcmp(s, "TXSTATS") == 0) {
+    bt_reply_start(BT_REPLY_TXSTATS);
+    return;
+  }
+
+  if(strcmp(s, "BTRX") == 0) {
+    bt_send_rx_stats();
+    return;
+  }
+
+  if(strcmp(s, "LORARX") == 0) {
+    bt_send_lora_rx_stats();
+    return;
+  }
+
+  /* App control: coalesced into CTRL frames */
   if(strncmp(s, "THRUST,", 7) == 0) {
-    lora_send_payload(s);
+    bt_app_ctrl(CTRL_MERGE_THRUST, s + 7);
     return;
   }
 
   if(strncmp(s, "RUDDER,", 7) == 0) {
-    lora_send_payload(s);
+    bt_app_ctrl(CTRL_MERGE_RUDDER, s + 7);
+    return;
+  }
+
+  if(strcmp(s, "MERGE") == 0) {
+    bt_send_merge_stats();
+    return;
+  }
+
+  /* Control source; hand-overs are sent as SOURCE,... */
+  if(strcmp(s, "ARB") == 0) {
+    bt_send_arb_stats();
     return;
   }
 
@@ -135,62 +750,82 @@ static void handle_bt_line(char* s) {
     return;
   }
 
+  /* Commands are acknowledged by the boat and resent until they arrive */
   if(strncmp(s, "CMD,", 4) == 0) {
-    lora_send_payload(s);
+    bt_send_command(s + 4);
     return;
   }
 
-  /* Wrap unknown commands and forward */
-  char payload[96];
-  int n = snprintf(payload, sizeof(payload), "CMD,%s", s);
-  if(n > 0) {
-    lora_send_payload(payload);
+  /* One command for several boats: GROUP,<mask|ALL>,<command> */
+  if(strncmp(s, "GROUP,", 6) == 0) {
+    bt_send_group(s + 6);
+    return;
   }
+
+  /* Unknown commands are forwarded as commands */
+  bt_send_command(s);
 }
 
 /**
-  * @brief Process complete line from Bluetooth receive buffer
+  * @brief Process every queued line from Bluetooth, oldest first
+  * Each line is handled in its slot, which is released afterwards. A line
+  * waits while the control ring lacks room for its reply, and multi-line
+  * replies are finished first, so a slow link never stalls the loop and
+  * replies keep the order of the commands.
   */
 void bt_process_line(void) {
-  if(bt_ready) {
-    char buf[BT_BUF];
-    strncpy(buf, bt_line, BT_BUF - 1);
-    buf[BT_BUF - 1] = 0;
-    handle_bt_line(buf);
-    bt_len = 0;
-    bt_ready = 0;
+  char* line;
+
+  while(bt_reply_resume() && (line = line_queue_front(&bt_q)) != NULL) {
+    if(!bt_reply_room()) return;
+    handle_bt_line(line);
+    line_queue_pop(&bt_q);
   }
 }
 
 /**
-  * @brief Start Bluetooth UART receive interrupt
+  * @brief Queue a complete line for the main loop (RX interrupt)
+  * Dropped and counted if every slot is still waiting
+  * @param line: Received line without line ending
   */
-void StartBTRxIT(void) {
-  HAL_UART_Receive_IT(&huart1, &bt_rx_byte, 1);
+static void bt_on_line(char* line) {
+  if(line_queue_push(&bt_q, line)) sched_signal(EV_BT_LINE);
 }
 
 /**
-  * @brief UART receive callback for Bluetooth
-  * Accumulates characters until line ending is received
+  * @brief Start Bluetooth UART circular DMA reception
   */
-void bt_rx_callback(void) {
-  char c = (char)bt_rx_byte;
-  
-  if(c == '\n' || c == '\r') {
-    if(bt_len > 0) {
-      bt_line[bt_len] = 0;
-      bt_ready = 1;
-    }
-  }
-  else if(!bt_ready && bt_len < BT_BUF - 1) {
-    bt_line[bt_len++] = c;
-  }
-  else if(bt_len >= BT_BUF - 1) {
-    /* Buffer overflow - reset */
-    bt_len = 0;
+void StartBTRxDMA(void) {
+  uart_rx_start(&bt_rx);
+}
+
+/**
+  * @brief UART receive event callback for Bluetooth
+  * @param pos: DMA write position reported by HAL
+  */
+void bt_rx_callback(uint16_t pos) {
+  uart_rx_on_event(&bt_rx, pos);
+}
+
+/**
+  * @brief UART transmit complete callback for Bluetooth
+  * Wakes BTCMD if it is waiting for room in the control ring
+  */
+void bt_tx_callback(void) {
+  uart_tx_on_complete(&bt_tx);
+  if(bt_tx_wait) {
+    bt_tx_wait = 0;
+    sched_signal(EV_BT_LINE);
   }
-  
-  StartBTRxIT();
+}
+
+/**
+  * @brief UART error callback for Bluetooth
+  * Restarts reception and any transfer the error aborted
+  */
+void bt_error_callback(void) {
+  StartBTRxDMA();
+  uart_tx_on_error(&bt_tx);
 }
 
 /**
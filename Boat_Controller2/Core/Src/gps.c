@@ -1,210 +1,112 @@
-/* gps.c - GPS receiver handler with NMEA parsing */
+/* gps.c - GPS receiver handler with streaming NMEA parsing */
 #include "gps.h"
 #include "bluetooth.h"
 #include "lora.h"
 #include "main.h"
+#include "uart_rx.h"
+#include "nmea.h"
 #include <string.h>
-#include <stdlib.h>
 #include <stdio.h>
 
-#define GPS_LINE_MAX 128
+#define GPS_DMA_BUF  128
 
-/* Global GPS data available to other modules */
-GPSData_t received_gps = {0};
+/* Own fix, written by the UART interrupt: read it through gps_get_fix */
+static GPSData_t gps_fix;
 
-/* GPS receive state */
-static uint8_t gps_rx_byte;
-static volatile char gps_line[GPS_LINE_MAX];
-static volatile size_t gps_lp = 0;
-static volatile uint8_t gps_ready = 0;
+/* GPS receive state - bytes go straight from DMA into the NMEA state machine */
+static void gps_on_byte(char c);
+static uint8_t gps_dma_buf[GPS_DMA_BUF];
+static UartRx_t gps_rx = UART_RX_INIT_RAW(&huart2, gps_dma_buf, gps_on_byte);
+static NmeaParser_t gps_nmea;   /* Zero-initialized = idle */
 
 /* Button debouncing state */
 static uint8_t last_button_state = 0;
+static uint32_t last_change_ms = 0;
 
 /**
-  * @brief Validate NMEA sentence checksum
-  * @param s: NMEA sentence string (e.g., "$GPRMC,...*4F")
-  * @retval 1 if checksum valid, 0 otherwise
+  * @brief Feed one GPS byte to the NMEA parser
+  * Runs in the UART RX event interrupt; cost per byte is constant.
+  * Updates gps_fix whenever a checksum-valid RMC sentence completes.
+  * @param c: Received character
   */
-static int gps_validate_checksum(const char* s) {
-    if(!s || s[0] != '$') return 0;
-    
-    const char* star = strrchr(s, '*');
-    if(!star || star - s < 2) return 0;
-    
-    /* Calculate XOR checksum of characters between $ and * */
-    uint8_t x = 0;
-    for(const char* p = s + 1; p < star; ++p) {
-        x ^= (uint8_t)(*p);
-    }
-    
-    /* Parse hex checksum after * */
-    uint8_t h = (uint8_t)((star[1] >= 'A' && star[1] <= 'F') ? 10 + star[1] - 'A' :
-                           (star[1] >= 'a' && star[1] <= 'f') ? 10 + star[1] - 'a' : 
-                           star[1] - '0');
-    uint8_t l = (uint8_t)((star[2] >= 'A' && star[2] <= 'F') ? 10 + star[2] - 'A' :
-                           (star[2] >= 'a' && star[2] <= 'f') ? 10 + star[2] - 'a' : 
-                           star[2] - '0');
-    
-    return x == ((h << 4) | l);
-}
-
-/**
-  * @brief Convert NMEA DDMM.MMMM format to decimal degrees
-  * @param ddmm: Coordinate string in DDMM.MMMM format
-  * @param hemi: Hemisphere character (N/S/E/W)
-  * @param out: Pointer to output float value
-  * @retval 1 if successful, 0 on error
-  */
-static int gps_parse_ddmm_to_float(const char* ddmm, const char* hemi, float* out) {
-    if(!ddmm || !*ddmm || !out) return 0;
-    
-    double v = atof(ddmm);
-    int deg = (int)(v / 100.0);
-    double minutes = v - (deg * 100.0);
-    double val = deg + minutes / 60.0;
-    
-    /* Apply negative sign for South or West */
-    if(hemi && (*hemi == 'S' || *hemi == 'W')) {
-        val = -val;
-    }
-    
-    *out = (float)val;
-    return 1;
-}
+static void gps_on_byte(char c) {
+    if(nmea_feed(&gps_nmea, c) != NMEA_RMC) return;
 
-/**
-  * @brief Parse GPRMC/GNRMC NMEA sentence and update GPS data
-  * @param buf: NMEA sentence buffer
-  */
-static void gps_parse_rmc(char* buf) {
-    if(!gps_validate_checksum(buf)) return;
-    
-    /* Strip line endings */
-    for(char* q = buf; *q; ++q) {
-        if(*q == '\r' || *q == '\n') *q = 0;
-    }
-    
-    /* Tokenize comma-separated values */
-    char* toks[16] = {0}; 
-    int nt = 0;
-    for(char* t = strtok(buf, ","); t && nt < 16; t = strtok(NULL, ",")) {
-        toks[nt++] = t;
-    }
-    
-    if(nt < 7) return;
-    
-    /* Verify sentence type */
-    if(strncmp(toks[0], "$GPRMC", 6) != 0 && strncmp(toks[0], "$GNRMC", 6) != 0) {
-        return;
-    }
-
-    /* Parse RMC fields: status, lat, N/S, lon, E/W */
-    const char* status = toks[2];
-    const char* lat = toks[3]; 
-    const char* ns = toks[4];
-    const char* lon = toks[5]; 
-    const char* ew = toks[6];
-    
     /* Check if fix is valid (A = active, V = void) */
-    if(!status || (*status != 'A' && *status != 'a')) { 
-        received_gps.valid = 0; 
-        return; 
+    if(!gps_nmea.data.fix_valid) {
+        gps_fix.valid = 0;
+        return;
     }
 
-    /* Convert coordinates to decimal degrees */
-    float latitude = 0, longitude = 0;
-    if(!gps_parse_ddmm_to_float(lat, ns, &latitude)) return;
-    if(!gps_parse_ddmm_to_float(lon, ew, &longitude)) return;
-
-    /* Update global GPS data */
-    received_gps.latitude = latitude;
-    received_gps.longitude = longitude;
-    received_gps.valid = 1;
-    received_gps.last_update_ms = HAL_GetTick();
+    gps_fix.lat_e7 = gps_nmea.data.lat_e7;
+    gps_fix.lon_e7 = gps_nmea.data.lon_e7;
+    gps_fix.valid = 1;
+    gps_fix.last_update_ms = HAL_GetTick();
 }
 
 /**
   * @brief Check if GPS button is pressed (with debouncing)
+  * A rising edge only counts as a press if the released level was stable
+  * for GPS_DEBOUNCE_MS, so contact bounce on press and release is ignored.
   * @retval 1 on button press (rising edge), 0 otherwise
   */
 uint8_t gps_button_pressed(void) {
     uint8_t current_state = HAL_GPIO_ReadPin(GPS_BUTTON_PORT, GPS_BUTTON_PIN);
+    uint32_t now = HAL_GetTick();
+    uint8_t pressed = 0;
 
-    /* Detect rising edge (button press) */
-    if(current_state == GPIO_PIN_SET && last_button_state == GPIO_PIN_RESET) {
+    if(current_state != last_button_state) {
+        /* Detect rising edge (button press) */
+        if(current_state == GPIO_PIN_SET && now - last_change_ms >= GPS_DEBOUNCE_MS) {
+            pressed = 1;
+        }
+        last_change_ms = now;
         last_button_state = current_state;
-        HAL_Delay(20); /* Simple debounce delay */
-        return 1;
     }
 
-    last_button_state = current_state;
-    return 0;
+    return pressed;
 }
 
 /**
-  * @brief GPS periodic task - parse received sentences and handle button
+  * @brief GPS periodic task - handle button
+  * Sentence parsing happens in gps_on_byte as data arrives.
   * Call from main loop
   */
 void gps_task(void) {
-    if(!gps_ready) return;
-    
-    /* Copy line to local buffer and process */
-    char buf[GPS_LINE_MAX];
-    strncpy(buf, (char*)gps_line, GPS_LINE_MAX - 1);
-    buf[GPS_LINE_MAX - 1] = 0;
-    gps_ready = 0;
-
-    /* Parse RMC sentences (position and time) */
-    if(strncmp(buf, "$GPRMC", 6) == 0 || strncmp(buf, "$GNRMC", 6) == 0) {
-        gps_parse_rmc(buf);
-    }
-
     /* Send GPS over LoRa when button is pressed */
-    if(gps_button_pressed() && received_gps.valid) {
-        char payload[64];
-        int n = snprintf(payload, sizeof(payload), "GPS,%.6f,%.6f",
-                         received_gps.latitude, received_gps.longitude);
-        if(n > 0) {
-            lora_send_payload(payload);
-        }
+    if(gps_button_pressed()) {
+        GPSData_t fix;
+        gps_get_fix(&fix);
+        if(!fix.valid) return;
+
+        Frame_t f;
+        f.type = FRAME_GPS;
+        f.u.gps.lat_e7 = fix.lat_e7;
+        f.u.gps.lon_e7 = fix.lon_e7;
+        lora_send_frame(&f);
     }
 }
 
 /**
-  * @brief Start GPS UART receive interrupt
+  * @brief Copy the controller's own GPS fix with interrupts masked
   */
-void StartGPSRxIT(void) {
-    HAL_UART_Receive_IT(&huart2, &gps_rx_byte, 1);
+void gps_get_fix(GPSData_t* fix) {
+    __disable_irq();
+    *fix = gps_fix;
+    __enable_irq();
 }
 
 /**
-  * @brief UART receive callback for GPS
-  * Accumulates NMEA sentence from $ to line ending
+  * @brief Start GPS UART circular DMA reception
   */
-void gps_rx_callback(void) {
-    char c = (char)gps_rx_byte;
-    
-    if(!gps_ready) {
-        if(gps_lp == 0 && c == '$') {
-            /* Start of NMEA sentence */
-            gps_line[gps_lp++] = c;
-        }
-        else if(c == '\n' || c == '\r') {
-            /* End of sentence */
-            gps_line[gps_lp] = 0;
-            gps_ready = 1;
-            gps_lp = 0;
-        }
-        else if(gps_lp < GPS_LINE_MAX - 1) {
-            /* Accumulate sentence characters */
-            gps_line[gps_lp++] = c;
-        }
-        else {
-            /* Buffer overflow - reset */
-            gps_lp = 0;
-        }
-    }
-    
-    StartGPSRxIT();
+void StartGPSRxDMA(void) {
+    uart_rx_start(&gps_rx);
+}
+
+/**
+  * @brief UART receive event callback for GPS
+  * @param pos: DMA write position reported by HAL
+  */
+void gps_rx_callback(uint16_t pos) {
+    uart_rx_on_event(&gps_rx, pos);
 }
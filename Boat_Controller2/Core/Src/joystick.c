@@ -2,123 +2,461 @@
 #include "joystick.h"
 #include "lora.h"
 #include "bluetooth.h"
+#include "ctrl_rate.h"
+#include "ctrl_merge.h"
+#include "ctrl_arb.h"
+#include "lat_trace.h"
+#include "ctrl_map.h"
+#include "settings.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 /* Controller state tracking */
-static int16_t last_thrust = -1;              /* -1 = not initialized */
-static uint8_t last_rudder = 50;              /* Center = 50 */
-static uint32_t last_thrust_send_ms = 0;
-static uint32_t last_rudder_send_ms = 0;
+static CtrlRate_t joy_rate = CTRL_RATE_DEFAULT;  /* Adaptive CTRL send rate */
+static CtrlMerge_t joy_app = CTRL_MERGE_DEFAULT; /* App THRUST/RUDDER lines coalesced into CTRL */
+static CtrlArb_t joy_arb = CTRL_ARB_DEFAULT;     /* Source driving the CTRL frames */
+static int16_t  joy_app_value[2];                /* Latest coalesced app values (CTRL_MERGE_*) */
+static uint8_t  joy_app_fresh = 0;               /* App update since the last run */
 static uint32_t last_joystick_activity = 0;  /* Track when joystick was last moved */
 
 #define JOYSTICK_TIMEOUT_MS  2000  /* Controller inactive after 2 seconds of no movement */
+#define BOAT_SELECT_STABLE_MS  50  /* Selector debounce */
+
+/* Boat selector state */
+static uint8_t  joy_boat;                                /* Selected boat */
+static uint8_t  joy_boat_raw;                            /* Last reading */
+static uint32_t joy_boat_ms;                             /* Reading unchanged since */
+
+/* ADC scan state */
+static uint16_t joy_dma[2][JOY_SCANS][JOY_CHANNELS];     /* DMA double buffer */
+static uint32_t joy_iir[JOY_CHANNELS];                   /* Filter state, value << 4 */
+static uint8_t  joy_iir_primed = 0;
+static volatile uint16_t joy_value[JOY_CHANNELS] = { ADC_CENTER_VALUE, ADC_CENTER_VALUE };
+#ifdef LAT_TRACE
+static volatile uint32_t joy_sample_us;                  /* Latest filter update */
+#endif
+
+/* Stick shaping, from the settings */
+static uint16_t joy_curve[JOY_CHANNELS][CTRL_MAP_POINTS];  /* Expo tables */
+static uint8_t  joy_expo[JOY_CHANNELS] = { 0xFF, 0xFF };  /* Expo of the tables, 0xFF = not built */
+static uint16_t joy_deadband[JOY_CHANNELS];
+
+/* Calibration */
+#define JOY_CAL_DEFAULT { 0, ADC_CENTER_VALUE, ADC_MAX_VALUE }
+
+typedef enum {
+  JOY_MODE_BOOT = 0,                                     /* Capturing the centre, nothing sent */
+  JOY_MODE_RUN,
+  JOY_MODE_CAL                                           /* Capturing the end stops, neutral sent */
+} JoyMode_t;
+
+static JoyCalState_t joy_cal = { { JOY_CAL_DEFAULT, JOY_CAL_DEFAULT }, 0, 0 };
+static JoyMode_t joy_mode = JOY_MODE_BOOT;
+static uint32_t  joy_mode_ms;                            /* Start of the current mode */
+static uint16_t  joy_lo[JOY_CHANNELS];                   /* Capture extremes */
+static uint16_t  joy_hi[JOY_CHANNELS];
+static uint32_t  joy_sum[JOY_CHANNELS];                  /* Centre capture */
+static uint16_t  joy_samples;
+
+/* Stored end stops: last bytes of data EEPROM, after the settings areas (settings.h) */
+#define JOY_CAL_MAGIC    0x4A43                          /* "JC" */
+#define JOY_CAL_VERSION  1
+
+typedef struct {
+  uint16_t magic;
+  uint16_t version;
+  JoyCal_t axis[JOY_CHANNELS];
+  uint16_t crc;                                          /* frame_crc16 of the fields above */
+  uint16_t reserved;
+} JoyCalRecord_t;
+
+#define JOY_CAL_ADDR     (DATA_EEPROM_BANK2_END + 1U - sizeof(JoyCalRecord_t))
+#define JOY_CAL_CRC_LEN  offsetof(JoyCalRecord_t, crc)
+
+/**
+  * @brief ADC DMA callback - filter a completed half of the scan buffer
+  * Each sample is already a 16x hardware-oversampled average; the half
+  * buffer is box-averaged and then smoothed by a first-order IIR filter.
+  * @param half: 0 for the first half, 1 for the second
+  */
+void joystick_adc_callback(uint8_t half) {
+  for(uint8_t ch = 0; ch < JOY_CHANNELS; ch++) {
+    uint32_t sum = 0;
+    for(uint8_t i = 0; i < JOY_SCANS; i++) {
+      sum += joy_dma[half][i][ch];
+    }
+
+    /* Box average with 4 extra fraction bits */
+    uint32_t avg = (sum << 4) / JOY_SCANS;
+
+    if(!joy_iir_primed) {
+      joy_iir[ch] = avg;
+    }
+    else {
+      joy_iir[ch] = joy_iir[ch] + (((int32_t)avg - (int32_t)joy_iir[ch]) >> JOY_IIR_SHIFT);
+    }
+
+    joy_value[ch] = (uint16_t)((joy_iir[ch] + 8) >> 4);
+  }
+  joy_iir_primed = 1;
+
+#ifdef LAT_TRACE
+  joy_sample_us = lat_trace_now_us();
+#endif
+}
 
 /**
-  * @brief Read ADC value from specified channel
-  * @param channel: ADC channel to read (e.g., ADC_CHANNEL_6)
+  * @brief Read filtered ADC value for a joystick channel
+  * @param channel: ADC_CHANNEL_THRUST or ADC_CHANNEL_RUDDER
   * @retval ADC value (0-4095 for 12-bit ADC)
   */
 uint16_t joystick_read_adc(uint32_t channel) {
-  ADC_ChannelConfTypeDef sConfig = {0};
+  if(channel == ADC_CHANNEL_THRUST) return joy_value[JOY_IDX_THRUST];
+  if(channel == ADC_CHANNEL_RUDDER) return joy_value[JOY_IDX_RUDDER];
+  return ADC_CENTER_VALUE;
+}
+
+/**
+  * @brief Load the stored end stops, if the record is intact
+  * @retval 1 if loaded
+  */
+static uint8_t joy_cal_load(void) {
+  JoyCalRecord_t r;
+  memcpy(&r, (const void*)JOY_CAL_ADDR, sizeof(r));
 
-  /* Configure the selected channel */
-  sConfig.Channel = channel;
-  sConfig.Rank = 1;
+  if(r.magic != JOY_CAL_MAGIC || r.version != JOY_CAL_VERSION) return 0;
+  if(r.crc != frame_crc16((const uint8_t*)&r, JOY_CAL_CRC_LEN)) return 0;
 
-  hadc.Instance->CHSELR = 0;
-  if(HAL_ADC_ConfigChannel(&hadc, &sConfig) != HAL_OK) {
-    return ADC_CENTER_VALUE; /* Return center value on error */
-  }
+  memcpy(joy_cal.axis, r.axis, sizeof(joy_cal.axis));
+  return 1;
+}
 
-  /* Perform ADC conversion */
-  HAL_ADC_Start(&hadc);
+/**
+  * @brief Store the end stops in data EEPROM
+  * Only changed words are programmed (about 3 ms each, blocking)
+  * @retval 1 if written and read back intact
+  */
+static uint8_t joy_cal_save(void) {
+  JoyCalRecord_t r = { 0 };
+  r.magic = JOY_CAL_MAGIC;
+  r.version = JOY_CAL_VERSION;
+  memcpy(r.axis, joy_cal.axis, sizeof(r.axis));
+  r.crc = frame_crc16((const uint8_t*)&r, JOY_CAL_CRC_LEN);
 
-  if(HAL_ADC_PollForConversion(&hadc, 100) == HAL_OK) {
-    uint16_t adc_value = HAL_ADC_GetValue(&hadc);
-    HAL_ADC_Stop(&hadc);
-    return adc_value;
+  const uint32_t* src = (const uint32_t*)&r;
+  volatile const uint32_t* dst = (volatile const uint32_t*)JOY_CAL_ADDR;
+  HAL_StatusTypeDef st = HAL_FLASHEx_DATAEEPROM_Unlock();
+  for(uint32_t i = 0; st == HAL_OK && i < sizeof(r) / 4; i++) {
+    if(dst[i] != src[i]) {
+      st = HAL_FLASHEx_DATAEEPROM_Program(FLASH_TYPEPROGRAMDATA_WORD, JOY_CAL_ADDR + 4 * i, src[i]);
+    }
   }
+  HAL_FLASHEx_DATAEEPROM_Lock();
 
-  HAL_ADC_Stop(&hadc);
-  return ADC_CENTER_VALUE; /* Return center value on timeout */
+  return st == HAL_OK && memcmp((const void*)JOY_CAL_ADDR, &r, sizeof(r)) == 0;
 }
 
 /**
-  * @brief Process thrust joystick (Left Y-axis)
-  * Maps joystick position to thrust percentage in 10% increments
-  * @retval Thrust value (0, 10, 20, 30, 40, 50, 60, 70, 80, 90, or 100)
+  * @brief Encode a stick position as a signed control value
+  * Each side of the calibrated centre is scaled to its own travel past the
+  * deadband, so the deadband edge is zero and the end stop full scale
+  * @param ch: JOY_IDX_THRUST or JOY_IDX_RUDDER
+  * @retval -FRAME_CTRL_MAX..FRAME_CTRL_MAX, positive for a high ADC reading
   */
-static uint8_t process_thrust(void) {
-  uint16_t adc_value = joystick_read_adc(ADC_CHANNEL_THRUST);
+static int16_t stick_value(uint8_t ch) {
+  const JoyCal_t* cal = &joy_cal.axis[ch];
+  int32_t offset = (int32_t)joy_value[ch] - cal->center;
+  int32_t span = (offset >= 0) ? cal->max - cal->center : cal->center - cal->min;
+  int32_t travel = abs(offset) - joy_deadband[ch];
 
-  /* Apply deadband around center - no thrust when stick is centered or pulled back */
-  if(adc_value >= (ADC_CENTER_VALUE - THRUST_DEADBAND)) {
+  span -= joy_deadband[ch];
+  if(travel <= 0 || span <= 0) {
     return 0;
   }
+  if(travel > span) travel = span;
+
+  /* Travel in Q15, through the expo curve, to FRAME_CTRL units */
+  uint32_t x = ((uint32_t)travel * CTRL_MAP_ONE + (uint32_t)span / 2) / (uint32_t)span;
+  uint32_t y = ctrl_map_curve(joy_curve[ch], x);
+  int16_t v = (int16_t)((y * FRAME_CTRL_MAX + CTRL_MAP_ONE / 2) >> 15);
 
-  /* Calculate thrust from center to max forward position
-   * ADC range: 0 (max forward) to ~2048 (center) to 4095 (max back)
-   * We only use 0 to center-deadband for thrust */
-  int16_t range_from_center = (ADC_CENTER_VALUE - THRUST_DEADBAND) - adc_value;
-  int16_t total_range = 4095 - (ADC_CENTER_VALUE + THRUST_DEADBAND);
+  return (offset < 0) ? -v : v;
+}
+
+/**
+  * @brief Process thrust joystick (Left Y-axis)
+  * ADC range: min (max forward) to center to max (max back)
+  * @retval Thrust in FRAME_CTRL units (-FRAME_CTRL_MAX full reverse .. +FRAME_CTRL_MAX full ahead)
+  */
+static int16_t process_thrust(void) {
+  return (int16_t)-stick_value(JOY_IDX_THRUST);
+}
+
+/**
+  * @brief Process rudder joystick (Right X-axis)
+  * @retval Rudder in FRAME_CTRL units (-FRAME_CTRL_MAX full left .. +FRAME_CTRL_MAX full right)
+  */
+static int16_t process_rudder(void) {
+  return stick_value(JOY_IDX_RUDDER);
+}
 
-  /* Map to 0-100 percentage */
-  uint8_t thrust_raw = (uint8_t)(((uint32_t)range_from_center * 100) / total_range);
+/**
+  * @brief Take over changed settings: deadbands, expo tables and CTRL rates
+  */
+static void joy_apply_settings(void) {
+  static const SettingKey_t expo_key[JOY_CHANNELS] = { CFG_RUDDER_EXPO, CFG_THRUST_EXPO };
 
-  /* Clamp to valid range */
-  if(thrust_raw > 100) thrust_raw = 100;
+  joy_deadband[JOY_IDX_THRUST] = (uint16_t)setting(CFG_THRUST_DEADBAND);
+  joy_deadband[JOY_IDX_RUDDER] = (uint16_t)setting(CFG_RUDDER_DEADBAND);
 
-  /* Round to nearest 10% sector for smoother control */
-  uint8_t thrust_sector = ((thrust_raw + 5) / 10) * 10;
-  if(thrust_sector > 100) thrust_sector = 100;
+  for(uint8_t ch = 0; ch < JOY_CHANNELS; ch++) {
+    uint8_t expo = (uint8_t)setting(expo_key[ch]);
+    if(expo != joy_expo[ch]) {
+      ctrl_map_build_curve(joy_curve[ch], expo);
+      joy_expo[ch] = expo;
+    }
+  }
 
-  return thrust_sector;
+  joy_rate.threshold = (uint16_t)setting(CFG_CTRL_THRESHOLD);
+  joy_rate.min_gap_ms = (uint16_t)setting(CFG_CTRL_MIN_GAP_MS);
+  joy_rate.active_ms = (uint16_t)setting(CFG_CTRL_ACTIVE_MS);
+  joy_rate.hold_ms = (uint16_t)setting(CFG_CTRL_HOLD_MS);
+  joy_rate.heartbeat_ms = (uint16_t)setting(CFG_CTRL_HEARTBEAT_MS);
+  joy_app.window_ms = (uint16_t)setting(CFG_APP_MERGE_MS);
+  joy_arb.hold_ms = (uint16_t)setting(CFG_CTRL_HANDOVER_MS);
+  joy_arb.app_timeout_ms = (uint16_t)setting(CFG_APP_TIMEOUT_MS);
 }
 
 /**
-  * @brief Process rudder joystick (Right X-axis)
-  * Maps joystick position to rudder angle percentage
-  * @retval Rudder value (0=full left, 50=center, 100=full right)
+  * @brief Enter a mode and reset the capture
   */
-static uint8_t process_rudder(void) {
-  uint16_t adc_value = joystick_read_adc(ADC_CHANNEL_RUDDER);
+static void joy_set_mode(JoyMode_t mode, uint32_t now) {
+  joy_mode = mode;
+  joy_mode_ms = now;
+  joy_samples = 0;
+  for(uint8_t ch = 0; ch < JOY_CHANNELS; ch++) {
+    joy_lo[ch] = joy_hi[ch] = joy_value[ch];
+    joy_sum[ch] = 0;
+  }
+}
+
+/**
+  * @brief Track the extremes of both sticks
+  */
+static void joy_track(void) {
+  for(uint8_t ch = 0; ch < JOY_CHANNELS; ch++) {
+    uint16_t v = joy_value[ch];
+    if(v < joy_lo[ch]) joy_lo[ch] = v;
+    if(v > joy_hi[ch]) joy_hi[ch] = v;
+    joy_sum[ch] += v;
+  }
+  joy_samples++;
+}
+
+/**
+  * @brief Boot: capture the centre of sticks left at rest
+  * A stick that moves or rests too far from the stored centre keeps the
+  * stored one. Both sticks held in the bottom-right corner (thrust full
+  * back, rudder full right) start a calibration session.
+  */
+static void joy_boot_task(uint32_t now) {
+  uint32_t elapsed = now - joy_mode_ms;
+  if(elapsed < JOY_SETTLE_MS) {
+    joy_set_mode(JOY_MODE_BOOT, joy_mode_ms);
+    return;
+  }
+
+  joy_track();
+  if(elapsed < JOY_SETTLE_MS + JOY_CENTER_MS) return;
 
-  /* Apply deadband around center position */
-  if(abs((int16_t)adc_value - ADC_CENTER_VALUE) < RUDDER_DEADBAND) {
-    return 50; /* Center position */
+  uint8_t steady = 1;
+  for(uint8_t ch = 0; ch < JOY_CHANNELS; ch++) {
+    uint16_t avg = (uint16_t)((joy_sum[ch] + joy_samples / 2) / joy_samples);
+    uint8_t still = (joy_hi[ch] - joy_lo[ch]) <= JOY_CENTER_SPREAD;
+    if(still && abs((int32_t)avg - joy_cal.axis[ch].center) <= JOY_CENTER_TOL) {
+      joy_cal.axis[ch].center = avg;
+    }
+    steady &= still;
+  }
+
+  if(steady && joy_lo[JOY_IDX_THRUST] >= ADC_MAX_VALUE - JOY_CAL_GESTURE &&
+     joy_lo[JOY_IDX_RUDDER] >= ADC_MAX_VALUE - JOY_CAL_GESTURE) {
+    joystick_cal_start();
+    return;
   }
+  joy_set_mode(JOY_MODE_RUN, now);
+}
 
-  /* Map full ADC range (0-4095) to rudder range (0-100)
-   * 0 = full left, 50 = center, 100 = full right */
-  uint8_t rudder = (uint8_t)(((uint32_t)adc_value * 100) / 4095);
+/**
+  * @brief Calibration session: capture the end stops, then check and store them
+  */
+static void joy_cal_task(uint32_t now) {
+  joy_track();
+  if(now - joy_mode_ms < JOY_CAL_MS) return;
+
+  uint8_t ok = 1;
+  for(uint8_t ch = 0; ch < JOY_CHANNELS; ch++) {
+    uint16_t center = joy_cal.axis[ch].center;
+    if(center - joy_lo[ch] < JOY_CAL_MIN_TRAVEL || joy_hi[ch] - center < JOY_CAL_MIN_TRAVEL) {
+      ok = 0;
+    }
+  }
 
-  /* Clamp to valid range */
-  if(rudder > 100) rudder = 100;
-  if(rudder < 0) rudder = 0;
+  if(ok) {
+    for(uint8_t ch = 0; ch < JOY_CHANNELS; ch++) {
+      joy_cal.axis[ch].min = joy_lo[ch] + JOY_CAL_END_MARGIN;
+      joy_cal.axis[ch].max = joy_hi[ch] - JOY_CAL_END_MARGIN;
+    }
+    joy_cal.stored = joy_cal_save();
+  }
 
-  return rudder;
+  joy_cal.running = 0;
+  joy_set_mode(JOY_MODE_RUN, now);
+  bt_send_line(!ok ? "CAL,FAILED" : joy_cal.stored ? "CAL,OK" : "CAL,NOT_SAVED");
 }
 
 /**
   * @brief Send combined thrust and rudder command over LoRa
-  * @param rudder: Rudder value (0-100)
-  * @param thrust: Thrust value (0-100)
+  * @param thrust: Thrust in FRAME_CTRL units
+  * @param rudder: Rudder in FRAME_CTRL units
+  */
+static void send_together(int16_t thrust, int16_t rudder) {
+  Frame_t f;
+  f.type = FRAME_CTRL;
+  f.u.ctrl.thrust = thrust;
+  f.u.ctrl.rudder = rudder;
+  lora_send_frame(&f);
+
+#ifdef LAT_TRACE
+  /* Stamped after sending: the sequence number is assigned by lora_send_frame */
+  if(joy_arb.source == CTRL_SRC_JOYSTICK) lat_trace_record(LAT_ADC, f.seq, joy_sample_us);
+#endif
+}
+
+/**
+  * @brief Hand the CTRL frames to the source the arbiter picks
+  * The new source's values go out at once; the app is told
+  * SOURCE,<JOYSTICK|APP>,<IDLE|PRIORITY|TIMEOUT>.
+  */
+static void joy_arb_task(uint32_t now) {
+  static const char* const reason[] = { "", "IDLE", "PRIORITY", "TIMEOUT" };
+  CtrlArbReason_t why = ctrl_arb_update(&joy_arb, joystick_is_active(), joy_app_fresh, now);
+  joy_app_fresh = 0;
+
+  if(why != CTRL_ARB_NONE) {
+    char line[32];
+    snprintf(line, sizeof(line), "SOURCE,%s,%s",
+             joy_arb.source == CTRL_SRC_APP ? "APP" : "JOYSTICK", reason[why]);
+    bt_send_event(line);
+    joy_rate.primed = 0;
+  }
+
+  /* App lines are dropped while the joystick has control */
+  if(joy_arb.source != CTRL_SRC_APP) {
+    ctrl_merge_drop(&joy_app);
+  }
+  else if(ctrl_merge_poll(&joy_app, now, joy_app_value)) {
+    joy_rate.primed = 0;
+  }
+}
+
+/**
+  * @brief Read boat selector switch state
+  * @retval Boat number (0-7): PB6 bit 0, PB7 bit 1, PB8 bit 2
+  */
+uint8_t joystick_read_boat_selector(void) {
+  return (uint8_t)((HAL_GPIO_ReadPin(GPIOB, GPIO_PIN_6) == GPIO_PIN_SET) |
+                   (HAL_GPIO_ReadPin(GPIOB, GPIO_PIN_7) == GPIO_PIN_SET) << 1 |
+                   (HAL_GPIO_ReadPin(GPIOB, GPIO_PIN_8) == GPIO_PIN_SET) << 2);
+}
+
+/**
+  * @brief Follow the boat selector
+  * A position held for BOAT_SELECT_STABLE_MS selects its boat; the next
+  * CTRL frame goes out at once so the new boat takes the sticks.
   */
-static void send_together(uint8_t rudder, uint8_t thrust) {
-  char payload[32];
-  snprintf(payload, sizeof(payload), "CTRL,%u,%u", (unsigned)thrust, (unsigned)rudder);
-  lora_send_payload(payload);
+static void joy_boat_task(uint32_t now) {
+  uint8_t boat = joystick_read_boat_selector();
+
+  if(boat != joy_boat_raw) {
+    joy_boat_raw = boat;
+    joy_boat_ms = now;
+    return;
+  }
+  if(boat == joy_boat || now - joy_boat_ms < BOAT_SELECT_STABLE_MS) return;
+
+  joy_boat = boat;
+  lora_select_boat(boat);
+  joy_rate.primed = 0;
 }
 
 /**
   * @brief Initialize joystick module
   */
 void joystick_init(void) {
-  last_thrust = -1;
-  last_rudder = 50;  /* Center */
-  last_thrust_send_ms = 0;
-  last_rudder_send_ms = 0;
+  /* Calibrate, then let TIM6 trigger conversions into the DMA buffer */
+  HAL_ADCEx_Calibration_Start(&hadc, ADC_SINGLE_ENDED);
+  HAL_ADC_Start_DMA(&hadc, (uint32_t*)joy_dma, sizeof(joy_dma) / sizeof(uint16_t));
+  TIM6->CR1 |= TIM_CR1_CEN;
+
+  joy_rate = (CtrlRate_t)CTRL_RATE_DEFAULT;
+  joy_apply_settings();
+
+  joy_cal.stored = joy_cal_load();
+  joy_set_mode(JOY_MODE_BOOT, HAL_GetTick());
+
+  /* The selector position at power-up needs no debounce */
+  joy_boat = joy_boat_raw = joystick_read_boat_selector();
+  joy_boat_ms = HAL_GetTick();
+  lora_select_boat(joy_boat);
+}
+
+/**
+  * @brief Start a calibration session
+  */
+uint8_t joystick_cal_start(void) {
+  if(joy_cal.running) return 0;
+
+  joy_cal.running = 1;
+  joy_set_mode(JOY_MODE_CAL, HAL_GetTick());
+  return 1;
+}
+
+/**
+  * @brief Current stick calibration
+  */
+const JoyCalState_t* joystick_cal_stats(void) {
+  return &joy_cal;
+}
+
+/**
+  * @brief Adaptive send rate state and per-reason send counters
+  */
+const CtrlRate_t* joystick_rate_stats(void) {
+  return &joy_rate;
+}
+
+/**
+  * @brief Take a thrust or rudder value from the app
+  */
+void joystick_app_update(uint8_t axis, int16_t value) {
+  ctrl_merge_update(&joy_app, axis, value, HAL_GetTick());
+  joy_app_fresh = 1;
+}
+
+/**
+  * @brief App control coalescing counters
+  */
+const CtrlMerge_t* joystick_app_stats(void) {
+  return &joy_app;
+}
+
+/**
+  * @brief Control source arbitration state and counters
+  */
+const CtrlArb_t* joystick_arb_stats(void) {
+  return &joy_arb;
 }
 
 /**
@@ -132,30 +470,45 @@ uint8_t joystick_is_active(void) {
 
 /**
   * @brief Joystick periodic task - reads and transmits controller state
+  * Samples the filtered sticks every run; a CTRL frame is only sent when
+  * the adaptive rate logic asks for one (change, active refresh or heartbeat).
+  * The frames carry the sticks or the app's values, whichever source has
+  * control (ctrl_arb.h), and go to the boat chosen with the selector switch.
   * Call from main loop
   */
 void joystick_task(void) {
   uint32_t now = HAL_GetTick();
+  int16_t thrust = 0;
+  int16_t rudder = 0;
 
-  /* Send controller updates every 200ms */
-  if(now - last_thrust_send_ms >= THRUST_UPDATE_MS) {
-    uint8_t current_thrust = process_thrust();
-    uint8_t current_rudder = process_rudder();
+  joy_apply_settings();
+  joy_boat_task(now);
 
-    /* Update activity timestamp if joystick is moved from center */
-    if(current_thrust != 0) {
-      last_joystick_activity = now;
-    }
+  if(joy_mode == JOY_MODE_BOOT) {
+    joy_boot_task(now);
+    return;
+  }
+  if(joy_mode == JOY_MODE_CAL) {
+    joy_cal_task(now);
+  }
+  else {
+    thrust = process_thrust();
+    rudder = process_rudder();
+  }
 
-    if(current_rudder != 50) {
-      last_joystick_activity = now;
-    }
+  /* Update activity timestamp if joystick is moved from center */
+  if(thrust != 0 || rudder != 0) {
+    last_joystick_activity = now;
+  }
+
+  joy_arb_task(now);
+  if(joy_arb.source == CTRL_SRC_APP) {
+    thrust = joy_app_value[CTRL_MERGE_THRUST];
+    rudder = joy_app_value[CTRL_MERGE_RUDDER];
+  }
 
-    /* Send combined control command */
-    send_together(current_rudder, current_thrust);
-    
-    last_thrust = current_thrust;
-    last_rudder = current_rudder;
-    last_thrust_send_ms = now;
+  /* Send combined control command */
+  if(ctrl_rate_update(&joy_rate, thrust, rudder, now) != CTRL_RATE_NONE) {
+    send_together(thrust, rudder);
   }
 }
\ No newline at end of file
@@ -1,118 +1,633 @@
 /* lora.c - LoRa radio communication handler using AT commands */
 #include "lora.h"
 #include "bluetooth.h"
-#include "gps.h"
+#include "uart_rx.h"
+#include "uart_tx.h"
+#include "nmea.h"
+#include "frame.h"
+#include "lora_at.h"
+#include "lora_airtime.h"
+#include "lat_trace.h"
+#include "cmd_arq.h"
+#include "settings.h"
+#include "tdma.h"
+#include "lora_adr.h"
+#include "line_queue.h"
+#include "sched.h"
 #include <string.h>
 #include <stdio.h>
 
-#define LBUF 128
+#define LBUF        128
+#define LORA_DMA_BUF 256
+#define LORA_TX_DMA  128
+#define LORA_DOWN_QUEUE 4
+#define LORA_RX_SLOTS 4
 
-/* LoRa receive state */
-static uint8_t lora_rx;
-static char lora_line[128];
-static uint8_t lora_pos = 0;
+/* LoRa receive state: the RX interrupt copies each line into a slot,
+ * lora_rx_task parses it and forwards it to Bluetooth */
+static void lora_rx_enqueue(char* s);
+static uint8_t lora_dma_buf[LORA_DMA_BUF];
+static char lora_line[LBUF];
+static UartRx_t lora_rx = UART_RX_INIT(&huart4, lora_dma_buf, lora_line, 0, lora_rx_enqueue);
+static char lora_slots[LORA_RX_SLOTS][LBUF];
+static LineQueue_t lora_q = LINE_QUEUE_INIT(lora_slots);
+static uint32_t lora_rx_ms[LORA_RX_SLOTS];   /* Receive tick of each slot */
+static uint32_t lora_line_ms;               /* Receive tick of the line being handled */
+static LoRaRxStats_t lora_rx_stat;
+
+/* LoRa transmit queue: commands and CTRL are control, GPS is telemetry */
+static uint8_t  lora_tx_dma[LORA_TX_DMA];
+static uint8_t  lora_tx_ctrl[256];
+static uint8_t  lora_tx_telem[128];
+static UartTx_t lora_tx = UART_TX_INIT(&huart4, lora_tx_dma, lora_tx_ctrl, lora_tx_telem);
+
+/* Binary frame sequence number */
+static uint8_t lora_seq = 0;
+
+/* Time-slotted channel shared with the boats (tdma.h). Frames wait for a
+ * downlink window: the latest CTRL frame in its own slot, everything else
+ * in order. The SYNC frame goes first in its window. */
+typedef enum {
+  LORA_DOWN_WAIT = 0,
+  LORA_DOWN_SENT,
+  LORA_DOWN_DROPPED
+} LoRaDownResult_t;
+
+typedef struct {
+  uint16_t dst;
+  uint8_t  cls;               /* UartTxClass_t */
+  uint8_t  seq;               /* Frame sequence number (CTRL) */
+  char     payload[FRAME_MAX_ENCODED];
+} LoRaDown_t;
+
+static Tdma_t     lora_tdma;
+static LoRaDown_t lora_down[LORA_DOWN_QUEUE];
+static uint8_t    lora_down_head;
+static uint8_t    lora_down_count;
+static LoRaDown_t lora_down_ctrl;
+static uint8_t    lora_down_ctrl_pending;
+static uint32_t   lora_sync_frame;          /* Frame of the last SYNC + 1, 0 = none */
+static LoRaDownStats_t lora_down_stat;
+
+/* Selected boat: position of the selector, address LORA_PEER + position */
+static uint8_t lora_boat = 0;
+
+/* Latest state heard from each boat of the fleet */
+static LoRaBoat_t lora_fleet[TDMA_BOATS_MAX];
+
+/* Acknowledged app commands, to one boat or a group */
+static void lora_arq_send(const Frame_t* f);
+static void lora_arq_done(const char* text, uint8_t group, uint8_t acked);
+static CmdArqTx_t lora_arq = CMD_ARQ_TX_INIT(lora_arq_send, lora_arq_done);
+
+/* Adaptive data rate (lora_adr.h): a change is prepared with a RATE
+ * command to every active boat, then committed with RATE frames counting
+ * down to the frame everyone switches at */
+typedef enum {
+  LORA_RATE_IDLE = 0,
+  LORA_RATE_PREPARE,          /* RATE command awaiting the boats' ACKs */
+  LORA_RATE_COMMIT            /* RATE frames announcing the switch */
+} LoRaRateState_t;
+
+static LoRaAdr_t lora_adr;
+static int8_t    lora_adr_home = -1;        /* Home rate index, -1 = not a step: fixed rate */
+static uint8_t   lora_rate_state;
+static uint8_t   lora_rate_next;            /* Rate being prepared or committed */
+static uint8_t   lora_rate_group;           /* Boats that prepared the rate in use or next */
+static uint32_t  lora_rate_frame;           /* Frame of the last RATE frame + 1, 0 = none yet */
+static uint32_t  lora_rate_switch_ms;       /* Start of the frame the rate changes at */
+static uint32_t  lora_rate_since_ms;        /* Rate in use since */
+static char      lora_rate_cmd[16];         /* RATE,<sf>,<bw> */
+static LoRaAtScript_t lora_rate_script;
+
+static void lora_lat_tx_queued(uint8_t seq);
+
+#ifdef LAT_TRACE
+/* CTRL frame followed through the UART: the transmit batch carrying it
+ * (0 = none) and whether that batch has started */
+static uint8_t  lora_lat_seq;
+static uint32_t lora_lat_batch;
+static uint8_t  lora_lat_started;
+#endif
+
+/* Module configuration from the settings, run by the AT command engine at boot */
+static void lora_at_send(const char* cmd);
+static LoRaAt_t lora_at = { .send = lora_at_send };
+static LoRaAtScript_t lora_config;
+static LoRaPhy_t lora_phy_cfg = LORA_PHY_DEFAULT;
 
 /**
-  * @brief Send AT command to LoRa module
+  * @brief Queue AT command to LoRa module
   * @param s: Command string to send
+  * @param cls: Back-pressure class
+  * @retval 1 if queued
   */
-static void lora_tx_line(const char* s) {
-  HAL_UART_Transmit(&huart4, (uint8_t*)s, strlen(s), HAL_MAX_DELAY);
-  HAL_UART_Transmit(&huart4, (uint8_t*)"\r\n", 2, HAL_MAX_DELAY);
+static uint8_t lora_tx_line(const char* s, UartTxClass_t cls) {
+  return uart_tx_line(&lora_tx, s, cls);
 }
 
 /**
-  * @brief Check if LoRa response indicates success
-  * @param s: Response string to check
-  * @retval 1 if response indicates OK, 0 otherwise
+  * @brief AT command engine output
+  * @param cmd: Command string to send
   */
-static int lora_line_ok(const char* s) {
-  return s && (strstr(s, "OK") || strstr(s, "+OK") || strstr(s, "OK+SEND") ||
-               strstr(s, "OK+SENT") || strstr(s, "SEND OK") || strstr(s, "SENT"));
+static void lora_at_send(const char* cmd) {
+  lora_tx_line(cmd, UART_TX_CONTROL);
 }
 
 /**
-  * @brief Check if LoRa response indicates error
-  * @param s: Response string to check
-  * @retval 1 if response indicates error, 0 otherwise
+  * @brief Queue an AT+SEND for a payload
+  * @param dst: Destination address, 0 = all boats
+  * @param payload: String payload to transmit
+  * @param cls: Back-pressure class
+  * @retval 1 if queued
   */
-static int lora_line_err(const char* s) {
-  return s && (strstr(s, "ERROR") || strstr(s, "ERR"));
+static uint8_t lora_transmit(uint16_t dst, const char* payload, UartTxClass_t cls) {
+  char cmd[128];
+  int n = snprintf(cmd, sizeof(cmd), "AT+SEND=%u,%u,%s", (unsigned)dst,
+                   (unsigned)strlen(payload), payload);
+  if(n > 0 && n < (int)sizeof(cmd)) {
+    return lora_tx_line(cmd, cls);
+  }
+  return 0;
 }
 
 /**
-  * @brief Send AT command and wait for OK response
-  * @param cmd: AT command string
-  * @param to_ms: Timeout in milliseconds
-  * @retval 1 if OK received, -1 if error, 0 if timeout
+  * @brief Send a waiting frame if the schedule allows it now
+  * @retval LORA_DOWN_WAIT to keep it, LORA_DOWN_SENT, or LORA_DOWN_DROPPED
+  * if it is too long for any downlink window
   */
-static int lora_cmd_expect_ok(const char* cmd, uint32_t to_ms) {
-    lora_tx_line(cmd);
+static LoRaDownResult_t lora_down_try(const LoRaDown_t* d, uint32_t now) {
+  uint32_t air = lora_airtime_us(&lora_phy_cfg, (uint16_t)strlen(d->payload));
+  if(!tdma_fits(&lora_tdma, 0, air)) {
+    lora_down_stat.dropped++;
+    return LORA_DOWN_DROPPED;
+  }
+  if(!tdma_may_send(&lora_tdma, 0, 0, air, now)) return LORA_DOWN_WAIT;
 
-    uint32_t t0 = HAL_GetTick();
+  lora_transmit(d->dst, d->payload, (UartTxClass_t)d->cls);
+  return LORA_DOWN_SENT;
+}
+
+/**
+  * @brief Size the schedule for the fleet
+  * Commands are not retransmitted before their ACK could have come back:
+  * a boat answers in its own uplink slot, up to a superframe later.
+  */
+static void lora_plan(uint16_t base, uint8_t boats) {
+  tdma_plan(&lora_tdma, &lora_phy_cfg, base, boats);
+  lora_arq.rto_floor_ms = tdma_frame_ms(&lora_tdma) * (lora_tdma.boats + 1U);
+}
+
+/**
+  * @brief Switch the module and the schedule to a rate, frame 0 starting
+  * at a given time, and tell the app: RATE,<sf>,<bw>,<FASTER|SLOWER|FALLBACK>
+  * @param rate: Index into lora_adr_rates
+  * @param start_ms: Start of the first frame at the new rate
+  * @param fallback: 1 when returning home on link loss
+  */
+static void lora_rate_apply(uint8_t rate, uint32_t start_ms, uint8_t fallback) {
+  static const char* const reason[] = { "SLOWER", "FASTER", "FALLBACK" };
+  const LoRaRate_t* r = &lora_adr_rates[rate];
+  uint8_t faster = rate > lora_adr.rate;
+  LoRaAtConfig_t cfg;
+  char line[40];
 
-    while(HAL_GetTick() - t0 < to_ms) {
-        lora_line[sizeof(lora_line)] = 0;
+  settings_lora(&cfg);
+  cfg.sf = r->sf;
+  cfg.bw = r->bw;
+  lora_phy_cfg.sf = cfg.sf;
+  lora_phy_cfg.bw_hz = lora_bw_hz(cfg.bw);
+  lora_at_run(&lora_at, lora_rate_script.script, lora_at_phy_script(&lora_rate_script, &cfg),
+              HAL_GetTick());
 
-        if(lora_line_ok(lora_line)) {
-            return 1;
-        }
+  /* New window lengths; SYNC opens the first frame */
+  lora_plan(lora_tdma.base, lora_tdma.boats);
+  tdma_start(&lora_tdma, start_ms);
+  lora_sync_frame = 0;
 
-        if(lora_line_err(lora_line)) {
-            return -1;
-        }
+  if(fallback) lora_adr_fallback(&lora_adr);
+  else lora_adr_switched(&lora_adr, rate);
+  lora_rate_state = LORA_RATE_IDLE;
+  lora_rate_since_ms = start_ms;
+
+  snprintf(line, sizeof(line), "RATE,%u,%u,%s", (unsigned)r->sf, (unsigned)r->bw,
+           reason[fallback ? 2 : faster]);
+  bt_send_event(line);
+}
+
+/**
+  * @brief Announce a committed rate change in this downlink window
+  * The first RATE frame fixes the switch LORA_ADR_COMMIT_FRAMES frames
+  * ahead; the following ones count down to it.
+  * @param w: Current downlink window
+  * @param now: Current tick
+  */
+static void lora_rate_announce(const TdmaWindow_t* w, uint32_t now) {
+  uint32_t frame_ms = tdma_frame_ms(&lora_tdma);
+  uint32_t at = lora_rate_frame ? lora_rate_switch_ms : w->start_ms + LORA_ADR_COMMIT_FRAMES * frame_ms;
+
+  Frame_t f;
+  LoRaDown_t d = { .dst = 0, .cls = UART_TX_CONTROL };
+  f.type = FRAME_RATE;
+  f.seq = lora_seq++;
+  f.u.rate.sf = lora_adr_rates[lora_rate_next].sf;
+  f.u.rate.bw = lora_adr_rates[lora_rate_next].bw;
+  f.u.rate.frames = (uint8_t)((at - w->start_ms) / frame_ms);
+  if(frame_encode(&f, d.payload, sizeof(d.payload)) == 0 || lora_down_try(&d, now) != LORA_DOWN_SENT) return;
+
+  lora_rate_switch_ms = at;
+  lora_rate_frame = w->frame + 1;
+}
+
+/**
+  * @brief Send what the current downlink window has room for
+  * Until the module has acknowledged its configuration nothing is sent,
+  * so the +OK replies of AT+SEND are never mistaken for configuration
+  * replies. The schedule starts then.
+  */
+static void lora_down_pump(void) {
+  uint32_t now = HAL_GetTick();
+  TdmaWindow_t w;
+
+  if(lora_rate_state == LORA_RATE_COMMIT && lora_rate_frame &&
+     (int32_t)(now - lora_rate_switch_ms) >= 0) {
+    lora_rate_apply(lora_rate_next, lora_rate_switch_ms, 0);
+  }
+  if(!lora_at_ready(&lora_at)) return;
+  if(!lora_tdma.synced) {
+    tdma_start(&lora_tdma, now);
+  }
+  if(!tdma_window(&lora_tdma, now, &w) || w.up) return;
+
+  /* SYNC opens every TDMA_SYNC_FRAMES-th downlink window; a new fleet
+   * size restarts the schedule there */
+  if(w.frame % TDMA_SYNC_FRAMES == 0 && lora_sync_frame != w.frame + 1) {
+    uint8_t boats = (uint8_t)setting(CFG_TDMA_BOATS);
+    uint16_t base = (uint16_t)setting(CFG_LORA_PEER);
+    if(boats != lora_tdma.boats || base != lora_tdma.base) {
+      lora_plan(base, boats);
+      tdma_start(&lora_tdma, w.start_ms);
+      tdma_window(&lora_tdma, now, &w);
     }
 
-    return 0; /* Timeout */
+    Frame_t f;
+    LoRaDown_t d = { .dst = 0, .cls = UART_TX_CONTROL };
+    f.type = FRAME_SYNC;
+    if(!tdma_sync_build(&lora_tdma, now, &f.u.sync)) return;
+    f.seq = lora_seq++;
+    if(frame_encode(&f, d.payload, sizeof(d.payload)) == 0 || lora_down_try(&d, now) != LORA_DOWN_SENT) return;
+
+    lora_sync_frame = w.frame + 1;
+    lora_tdma.syncs++;
+  }
+
+  if(lora_rate_state == LORA_RATE_COMMIT && lora_rate_frame != w.frame + 1) {
+    lora_rate_announce(&w, now);
+  }
+
+  while(lora_down_count && lora_down_try(&lora_down[lora_down_head], now) != LORA_DOWN_WAIT) {
+    lora_down_head = (uint8_t)((lora_down_head + 1) % LORA_DOWN_QUEUE);
+    lora_down_count--;
+  }
+
+  if(lora_down_ctrl_pending) {
+    LoRaDownResult_t r = lora_down_try(&lora_down_ctrl, now);
+    if(r != LORA_DOWN_WAIT) lora_down_ctrl_pending = 0;
+    if(r == LORA_DOWN_SENT) lora_lat_tx_queued(lora_down_ctrl.seq);
+  }
+}
+
+/**
+  * @brief Queue a payload for the next downlink window
+  * @param dst: Destination address
+  * @param payload: String payload
+  * @param cls: Back-pressure class
+  */
+static void lora_down_queue(uint16_t dst, const char* payload, UartTxClass_t cls) {
+  if(!lora_at_ready(&lora_at)) return;
+
+  size_t len = strlen(payload);
+  if(lora_down_count >= LORA_DOWN_QUEUE || len >= FRAME_MAX_ENCODED) {
+    lora_down_stat.dropped++;
+    return;
+  }
+
+  LoRaDown_t* d = &lora_down[(lora_down_head + lora_down_count) % LORA_DOWN_QUEUE];
+  d->dst = dst;
+  d->cls = (uint8_t)cls;
+  memcpy(d->payload, payload, len + 1);
+  lora_down_count++;
+
+  lora_down_pump();
+  if(lora_down_count) lora_down_stat.waited++;
 }
 
 /**
-  * @brief Send payload over LoRa network
+  * @brief Latency trace: record TX start once the batch carrying the
+  * traced frame is on the wire (after queueing and on each completion)
+  */
+static void lora_lat_tx_started(void) {
+#ifdef LAT_TRACE
+  if(lora_lat_batch && !lora_lat_started && lora_tx.batches == lora_lat_batch) {
+    lora_lat_started = 1;
+    lat_trace_record(LAT_TX_START, lora_lat_seq, lat_trace_now_us());
+  }
+#endif
+}
+
+/**
+  * @brief Latency trace: record TX end when the batch carrying the traced
+  * frame completes (before the next batch is started)
+  */
+static void lora_lat_tx_done(void) {
+#ifdef LAT_TRACE
+  if(lora_lat_started && lora_tx.batches == lora_lat_batch) {
+    lora_lat_batch = 0;
+    lora_lat_started = 0;
+    lat_trace_record(LAT_TX_END, lora_lat_seq, lat_trace_now_us());
+  }
+#endif
+}
+
+/**
+  * @brief Latency trace: follow a queued CTRL frame through the UART
+  * @param seq: Frame sequence number
+  */
+static void lora_lat_tx_queued(uint8_t seq) {
+#ifdef LAT_TRACE
+  __disable_irq();
+  lora_lat_seq = seq;
+  lora_lat_batch = lora_tx.last_batch;
+  lora_lat_started = 0;
+  lora_lat_tx_started();
+  __enable_irq();
+#endif
+}
+
+/**
+  * @brief Address of a boat of the fleet
+  * @param boat: Selector position, 0..TDMA_BOATS_MAX-1
+  */
+static uint16_t lora_boat_addr(uint8_t boat) {
+  return (uint16_t)(setting(CFG_LORA_PEER) + boat);
+}
+
+/**
+  * @brief Address of the selected boat
+  */
+static uint16_t lora_target(void) {
+  return lora_boat_addr(lora_boat);
+}
+
+/**
+  * @brief Send payload to the selected boat in the next downlink window
+  * App commands are control traffic: never evicted by queued telemetry
   * @param payload: String payload to transmit
   */
 void lora_send_payload(const char* payload) {
-  char cmd[128];
-  int n = snprintf(cmd, sizeof(cmd), "AT+SEND=1,%u,%s", (unsigned)strlen(payload), payload);
-  if(n > 0) {
-    lora_tx_line(cmd);
+  lora_down_queue(lora_target(), payload, UART_TX_CONTROL);
+}
+
+/**
+  * @brief ARQ output: queue a CMD frame to its boat, or a GCMD frame to
+  * all boats (each checks the group)
+  * @param f: CMD or GCMD frame to transmit
+  */
+static void lora_arq_send(const Frame_t* f) {
+  char payload[FRAME_MAX_ENCODED];
+  if(frame_encode(f, payload, sizeof(payload)) == 0) return;
+
+  uint8_t boat = 0;
+  while(boat < TDMA_BOATS_MAX - 1 && !(f->u.cmd.group & (1U << boat))) boat++;
+  lora_down_queue(f->type == FRAME_GCMD ? 0 : lora_boat_addr(boat), payload, UART_TX_CONTROL);
+}
+
+/**
+  * @brief ARQ outcome: tell the app about commands that never arrived and
+  * how group commands went
+  * CMD,FAILED,<text> for one boat; GROUP,<OK|FAILED>,<group>,<acked>,<text>
+  * for several, bit i of the masks = boat i + 1
+  * @param text: Command text
+  * @param group: Boats addressed
+  * @param acked: Boats that acknowledged
+  */
+static void lora_arq_done(const char* text, uint8_t group, uint8_t acked) {
+  char line[32 + FRAME_CMD_TEXT_MAX];
+
+  /* Rate change prepared: commit it only if every boat has it */
+  if(strcmp(text, lora_rate_cmd) == 0) {
+    if(lora_rate_state != LORA_RATE_PREPARE) return;
+    if(acked == group) {
+      lora_rate_state = LORA_RATE_COMMIT;
+      lora_rate_frame = 0;
+    }
+    else {
+      lora_rate_state = LORA_RATE_IDLE;
+      lora_adr.aborted++;
+    }
+    return;
+  }
+
+  if(group & (group - 1)) {
+    snprintf(line, sizeof(line), "GROUP,%s,%u,%u,%s", acked == group ? "OK" : "FAILED",
+             (unsigned)group, (unsigned)acked, text);
+  }
+  else if(acked != group) {
+    snprintf(line, sizeof(line), "CMD,FAILED,%s", text);
+  }
+  else {
+    return;
+  }
+  bt_send_line(line);
+}
+
+/**
+  * @brief Send a command with acknowledged delivery to the selected boat
+  * Resent by lora_task until the boat acknowledges it
+  * @param text: Command text (at most FRAME_CMD_TEXT_MAX characters)
+  * @retval 1 if queued, 0 if too long, not configured or too many in flight
+  */
+uint8_t lora_send_command(const char* text) {
+  return lora_send_group(text, (uint8_t)(1U << lora_boat));
+}
+
+/**
+  * @brief Send a command with acknowledged delivery to a group of boats
+  * One broadcast frame reaches the whole group; retransmissions only
+  * address the boats that have not acknowledged
+  * @param text: Command text (at most FRAME_CMD_TEXT_MAX characters)
+  * @param group: Boats, bit i = boat i + 1
+  * @retval 1 if queued, 0 if too long, not configured, too many in flight
+  * or no boat of the fleet addressed
+  */
+uint8_t lora_send_group(const char* text, uint8_t group) {
+  if(!lora_at_ready(&lora_at)) return 0;
+  group &= lora_fleet_mask();
+  return cmd_arq_send(&lora_arq, text, group, HAL_GetTick());
+}
+
+/**
+  * @brief Boats of the fleet (TDMA_BOATS), bit i = boat i + 1
+  */
+uint8_t lora_fleet_mask(void) {
+  return (uint8_t)((1U << setting(CFG_TDMA_BOATS)) - 1U);
+}
+
+/**
+  * @brief Send a binary frame to the selected boat
+  * Stamps the next sequence number into the frame before encoding. A CTRL
+  * frame still waiting for a downlink window is replaced by the new one.
+  * @param f: Frame to transmit
+  */
+void lora_send_frame(Frame_t* f) {
+  if(!lora_at_ready(&lora_at)) return;
+
+  f->seq = lora_seq++;
+  if(f->type != FRAME_CTRL) {
+    char payload[FRAME_MAX_ENCODED];
+    if(frame_encode(f, payload, sizeof(payload)) > 0) {
+      lora_down_queue(lora_target(), payload, UART_TX_TELEMETRY);
+    }
+    return;
+  }
+
+  if(frame_encode(f, lora_down_ctrl.payload, sizeof(lora_down_ctrl.payload)) == 0) return;
+  lat_trace_record(LAT_BUILD, f->seq, lat_trace_now_us());
+  if(lora_down_ctrl_pending) lora_down_stat.replaced++;
+  lora_down_ctrl.dst = lora_target();
+  lora_down_ctrl.cls = UART_TX_CONTROL;
+  lora_down_ctrl.seq = f->seq;
+  lora_down_ctrl_pending = 1;
+
+  lora_down_pump();
+  if(lora_down_ctrl_pending) lora_down_stat.waited++;
+}
+
+/**
+  * @brief Select the boat that receives CTRL frames and commands
+  * Commands already queued keep their boats; a CTRL frame still waiting
+  * is dropped. The app is told BOAT,<number>,<address>.
+  * @param boat: Selector position, 0..7
+  */
+void lora_select_boat(uint8_t boat) {
+  if(boat == lora_boat) return;
+
+  lora_boat = boat;
+  lora_down_ctrl_pending = 0;
+
+  lora_send_boat();
+}
+
+/**
+  * @brief Tell the app which boat is selected: BOAT,<number>,<address>
+  */
+void lora_send_boat(void) {
+  char line[24];
+  snprintf(line, sizeof(line), "BOAT,%u,%u", (unsigned)lora_boat + 1, (unsigned)lora_target());
+  bt_send_line(line);
+}
+
+/**
+  * @brief Send a line from a boat other than the selected one to the app,
+  * tagged FLEET,<number>,...
+  * @param boat: Selector position of the boat
+  * @param text: Line as the selected boat's would be sent
+  */
+static void lora_fleet_line(uint8_t boat, const char* text) {
+  char line[24 + LBUF];
+  snprintf(line, sizeof(line), "FLEET,%u,%s", (unsigned)boat + 1, text);
+  bt_send_line(line);
+}
+
+/**
+  * @brief Update a boat's position and notify the app
+  * The selected boat's position goes to the app as GPS lines (and STATUS)
+  * @param boat: Selector position of the boat
+  * @param lat_e7: Latitude, degrees * 1e7
+  * @param lon_e7: Longitude, degrees * 1e7
+  */
+static void lora_on_gps(uint8_t boat, int32_t lat_e7, int32_t lon_e7) {
+  LoRaBoat_t* b = &lora_fleet[boat];
+  b->lat_e7 = lat_e7;
+  b->lon_e7 = lon_e7;
+  b->gps_valid = 1;
+  b->gps_ms = lora_line_ms;
+
+  if(boat == lora_boat) {
+    bt_send_gps(lat_e7, lon_e7);  /* Send to app for map display */
+    return;
   }
+
+  char lat[16], lon[16], line[40];
+  nmea_format_deg_e7(lat, sizeof(lat), lat_e7);
+  nmea_format_deg_e7(lon, sizeof(lon), lon_e7);
+  snprintf(line, sizeof(line), "GPS,%s,%s", lat, lon);
+  lora_fleet_line(boat, line);
 }
 
 /**
   * @brief Parse received LoRa message and handle accordingly
+  * Every boat of the fleet is heard: the selected boat's telemetry goes
+  * to the app as before, the others' tagged with their number (FLEET,...)
   * @param s: Received line from LoRa module
   */
 static void parse_lora_line(char* s) {
-  /* Look for +RCV= prefix (received message) */
-  if(strncmp(s, "+RCV=", 5) != 0) return;
-  
-  /* Extract data field after second comma in +RCV=address,length,data */
-  char* data = NULL; 
-  int commas = 0;
-  for(char* p = s + 5; *p; p++) {
-    if(*p == ',') { 
-      commas++; 
-      if(commas == 2) { 
-        data = p + 1; 
-        break; 
-      } 
+  /* Until the first command: module reply timing in us is boot entropy */
+  if(!lora_arq.session) cmd_arq_seed(&lora_arq, sched_now_us());
+
+  if(lora_at_on_line(&lora_at, s, HAL_GetTick())) return;
+
+  LoRaRcv_t rcv;
+  if(!lora_at_parse_rcv(s, &rcv)) return;
+  if(!lora_arq.session) cmd_arq_seed(&lora_arq, ((uint32_t)(uint16_t)rcv.rssi << 16) | (uint16_t)rcv.snr);
+
+  char* data = rcv.data;
+
+  int32_t pos = (int32_t)rcv.addr - (int32_t)setting(CFG_LORA_PEER);
+  if(pos < 0 || pos >= TDMA_BOATS_MAX) return;
+  uint8_t boat = (uint8_t)pos;
+
+  LoRaBoat_t* b = &lora_fleet[boat];
+  b->heard_ms = lora_line_ms;
+  b->rssi = rcv.rssi;
+  b->snr = rcv.snr;
+  b->packets++;
+  lora_adr_on_packet(&lora_adr, boat, rcv.rssi, rcv.snr);
+
+  /* Binary frames are decoded here; the app only sees the text form */
+  if(frame_is_binary(data, rcv.len)) {
+    Frame_t f;
+    if(!frame_decode(data, rcv.len, &f)) return;
+
+    if(f.type == FRAME_GPS) {
+      lora_on_gps(boat, f.u.gps.lat_e7, f.u.gps.lon_e7);
+    }
+    else if(f.type == FRAME_ACK) {
+      cmd_arq_on_ack(&lora_arq, &f.u.ack, boat, lora_line_ms);
+    }
+    else if(f.type == FRAME_LINK) {
+      /* Boat failsafe tripped or cleared: FAILSAFE,<ACTIVE|CLEARED>,<trips>,<gap ms> */
+      char line[40];
+      b->failsafe = f.u.link.failsafe;
+      snprintf(line, sizeof(line), "FAILSAFE,%s,%u,%u", f.u.link.failsafe ? "ACTIVE" : "CLEARED",
+               (unsigned)f.u.link.events, (unsigned)f.u.link.gap_ms);
+      if(boat == lora_boat) bt_send_line(line);
+      else lora_fleet_line(boat, line);
     }
+    return;
   }
-  
-  if(!data) return;
 
-  /* Forward all received data to Bluetooth for monitoring */
-  bt_send_line(data);
+  /* Forward all received text to Bluetooth for monitoring */
+  if(boat == lora_boat) bt_send_line(data);
+  else lora_fleet_line(boat, data);
   
   /* Parse and update GPS data if received */
   if(strncmp(data, "GPS,", 4) == 0) {
-    float lat, lon;
-    if(sscanf(data, "GPS,%f,%f", &lat, &lon) == 2) {
-      received_gps.latitude = lat;
-      received_gps.longitude = lon;
-      received_gps.valid = 1;
-      received_gps.last_update_ms = HAL_GetTick();
-      bt_send_gps(lat, lon);  /* Send to app for map display */
+    const char* p = data + 4;
+    int32_t lat = nmea_parse_deg_e7(p, &p);
+    if(*p == ',') {
+      int32_t lon = nmea_parse_deg_e7(p + 1, NULL);
+      lora_on_gps(boat, lat, lon);
     }
     return;
   }
@@ -123,50 +638,251 @@ static void parse_lora_line(char* s) {
 
 /**
   * @brief Initialize LoRa module with network parameters
-  * Sets address, network ID, frequency band, and RF parameters
+  * Starts the configuration script (address, network ID, frequency band,
+  * RF parameters, from the settings); lora_task completes it without blocking.
   */
 void lora_init(void) {
-  HAL_Delay(200);
-  lora_cmd_expect_ok("AT+ADDRESS=2", 500);
-  HAL_Delay(200);
-  lora_cmd_expect_ok("AT+NETWORKID=18", 500);
-  HAL_Delay(200);
-  lora_cmd_expect_ok("AT+BAND=915000000", 500);
-  HAL_Delay(200);
-  lora_cmd_expect_ok("AT+PARAMETER=9,7,1,12", 500);
-  HAL_Delay(200);
+  LoRaAtConfig_t cfg;
+  settings_lora(&cfg);
+
+  /* The UID tells controllers apart; noise is mixed in as lines arrive */
+  cmd_arq_seed(&lora_arq, HAL_GetUIDw0());
+  cmd_arq_seed(&lora_arq, HAL_GetUIDw1());
+  cmd_arq_seed(&lora_arq, HAL_GetUIDw2());
+  lora_phy_cfg.sf = cfg.sf;
+  lora_phy_cfg.bw_hz = lora_bw_hz(cfg.bw);
+  lora_phy_cfg.cr = cfg.cr;
+  lora_phy_cfg.preamble = cfg.preamble;
+
+  uint8_t n = lora_at_config_script(&lora_config, &cfg);
+  lora_at_run(&lora_at, lora_config.script, n, HAL_GetTick());
+
+  /* The schedule starts once the module is configured */
+  lora_plan((uint16_t)setting(CFG_LORA_PEER), (uint8_t)setting(CFG_TDMA_BOATS));
+
+  /* Adaptive data rate starts from the configured rate, if it is a step */
+  lora_adr_home = lora_adr_find(cfg.sf, cfg.bw);
+  lora_adr_init(&lora_adr, lora_adr_home < 0 ? 0 : (uint8_t)lora_adr_home);
 }
 
 /**
-  * @brief Start LoRa UART receive interrupt
+  * @brief Adaptive data rate: fall back home when a boat that changed rate
+  * has gone quiet, else prepare the change the link reports call for
+  * With LORA_ADR off the fleet is brought back to the home rate.
   */
-void StartLoRaRxIT(void) {
-  HAL_UART_Receive_IT(&huart4, &lora_rx, 1);
+static void lora_rate_task(void) {
+  uint32_t now = HAL_GetTick();
+  uint32_t lost_ms = LORA_ADR_LOST_FRAMES * tdma_frame_ms(&lora_tdma);
+  uint8_t active = 0;
+  int8_t next;
+
+  if(lora_adr_home < 0) return;
+
+  for(uint8_t i = 0; i < lora_tdma.boats; i++) {
+    if(lora_fleet[i].packets && now - lora_fleet[i].heard_ms < lost_ms) active |= (uint8_t)(1U << i);
+  }
+
+  if(lora_adr.rate != lora_adr.home && now - lora_rate_since_ms >= lost_ms &&
+     (lora_rate_group & ~active)) {
+    lora_rate_apply(lora_adr.home, now, 1);
+    return;
+  }
+
+  if(lora_rate_state != LORA_RATE_IDLE || !lora_at_ready(&lora_at) || !active) return;
+
+  if(setting(CFG_LORA_ADR)) {
+    next = lora_adr_decide(&lora_adr, active);
+  }
+  else {
+    next = (lora_adr.rate != lora_adr.home) ? (int8_t)lora_adr.home : -1;
+  }
+  if(next < 0) return;
+
+  snprintf(lora_rate_cmd, sizeof(lora_rate_cmd), "RATE,%u,%u",
+           (unsigned)lora_adr_rates[next].sf, (unsigned)lora_adr_rates[next].bw);
+  if(!cmd_arq_send(&lora_arq, lora_rate_cmd, active, now)) return;
+
+  lora_rate_state = LORA_RATE_PREPARE;
+  lora_rate_next = (uint8_t)next;
+  lora_rate_group = active;
+}
+
+/**
+  * @brief Programmed modulation parameters
+  */
+const LoRaPhy_t* lora_phy(void) {
+  return &lora_phy_cfg;
 }
 
 /**
-  * @brief UART receive callback for LoRa module
-  * Accumulates response lines and parses complete messages
+  * @brief Handle the lines queued by the RX interrupt, oldest first
+  * Module replies go to the AT command engine, ACKs to the command
+  * transmitter, boat telemetry to the app.
   */
-void lora_rx_callback(void) {
-  char c = (char)lora_rx;
+void lora_rx_task(void) {
+  char* line;
 
-  if(c == '\n' || c == '\r') {
-    if(lora_pos > 0) {
-      lora_line[lora_pos] = 0;
-      parse_lora_line(lora_line);
-      lora_pos = 0;
-    }
+  while((line = line_queue_front(&lora_q)) != NULL) {
+    lora_line_ms = lora_rx_ms[lora_q.tail & (lora_q.count - 1)];
+    parse_lora_line(line);
+    line_queue_pop(&lora_q);
+    lora_rx_stat.handled++;
   }
-  else {
-    if(lora_pos < sizeof(lora_line) - 1) {
-      lora_line[lora_pos++] = c;
-    }
-    else {
-      /* Buffer overflow - reset */
-      lora_pos = 0;
-    }
+}
+
+/**
+  * @brief LoRa periodic task - AT command reply timeouts and retries,
+  * command retransmissions, downlink windows
+  */
+void lora_task(void) {
+  lora_at_poll(&lora_at, HAL_GetTick());
+  cmd_arq_poll(&lora_arq, HAL_GetTick());
+  lora_rate_task();
+  lora_down_pump();
+}
+
+/**
+  * @brief Check whether the module acknowledged its configuration
+  */
+uint8_t lora_ready(void) {
+  return lora_at_ready(&lora_at);
+}
+
+/**
+  * @brief AT command engine state and counters
+  */
+const LoRaAt_t* lora_at_stats(void) {
+  return &lora_at;
+}
+
+/**
+  * @brief Start LoRa UART circular DMA reception
+  */
+void StartLoRaRxDMA(void) {
+  uart_rx_start(&lora_rx);
+}
+
+/**
+  * @brief LoRa transmit queue counters
+  */
+const UartTx_t* lora_tx_stats(void) {
+  return &lora_tx;
+}
+
+/**
+  * @brief Acknowledged command delivery counters
+  */
+const CmdArqTx_t* lora_arq_stats(void) {
+  return &lora_arq;
+}
+
+/**
+  * @brief Channel schedule and its counters
+  */
+const Tdma_t* lora_tdma_stats(void) {
+  return &lora_tdma;
+}
+
+/**
+  * @brief Downlink queue counters
+  */
+const LoRaDownStats_t* lora_down_stats(void) {
+  return &lora_down_stat;
+}
+
+/**
+  * @brief Latest state heard from a boat of the fleet
+  */
+const LoRaBoat_t* lora_fleet_boat(uint8_t boat) {
+  return &lora_fleet[boat];
+}
+
+/**
+  * @brief Latest state heard from the selected boat
+  */
+const LoRaBoat_t* lora_selected_boat(void) {
+  return &lora_fleet[lora_boat];
+}
+
+/**
+  * @brief Adaptive data rate state and counters
+  */
+const LoRaAdr_t* lora_adr_stats(void) {
+  return &lora_adr;
+}
+
+/**
+  * @brief Check whether the configured rate is an adaptive data rate step
+  */
+uint8_t lora_adr_possible(void) {
+  return lora_adr_home >= 0;
+}
+
+/**
+  * @brief Receive queue between the RX interrupt and lora_rx_task
+  */
+const LineQueue_t* lora_rx_queue(void) {
+  return &lora_q;
+}
+
+/**
+  * @brief Receive path counters
+  */
+const LoRaRxStats_t* lora_rx_stats(void) {
+  return &lora_rx_stat;
+}
+
+/**
+  * @brief UART transmit complete callback for LoRa module
+  */
+void lora_tx_callback(void) {
+  lora_lat_tx_done();
+  uart_tx_on_complete(&lora_tx);
+  lora_lat_tx_started();
+}
+
+/**
+  * @brief UART error callback for LoRa module
+  * Restarts reception and any transfer the error aborted
+  */
+void lora_error_callback(void) {
+  StartLoRaRxDMA();
+  uart_tx_on_error(&lora_tx);
+}
+
+/**
+  * @brief Queue a complete line for lora_rx_task (RX interrupt)
+  * A full queue drops the line; line_queue counts it. The receive tick is
+  * stored only once the line has a slot: when full, the slot at head is
+  * the oldest queued line's.
+  * @param s: Received line
+  */
+static void lora_rx_enqueue(char* s) {
+  uint8_t slot = lora_q.head & (lora_q.count - 1);
+  uint32_t now = HAL_GetTick();
+
+  if(line_queue_push(&lora_q, s)) {
+    lora_rx_ms[slot] = now;
+    sched_signal(EV_LORA_RX);
   }
-  
-  StartLoRaRxIT();
+}
+
+/**
+  * @brief UART receive event callback for LoRa module
+  * Complete lines are only queued here. Time spent is measured on the
+  * SysTick down-counter, which runs at the core clock.
+  * @param pos: DMA write position reported by HAL
+  */
+void lora_rx_callback(uint16_t pos) {
+  uint32_t load = SysTick->LOAD + 1;
+  uint32_t ms = HAL_GetTick();
+  uint32_t val = SysTick->VAL;
+
+  uart_rx_on_event(&lora_rx, pos);
+
+  int32_t cycles = (int32_t)((HAL_GetTick() - ms) * load + val - SysTick->VAL);
+  if(cycles < 0) cycles += (int32_t)load;  /* Wrapped with the tick interrupt pending */
+  lora_rx_stat.isr_runs++;
+  lora_rx_stat.isr_cycles += (uint32_t)cycles;
+  if((uint32_t)cycles > lora_rx_stat.isr_max_cycles) lora_rx_stat.isr_max_cycles = (uint32_t)cycles;
 }
@@ -4,13 +4,22 @@
  * System Architecture:
  * - Bluetooth (UART1): Communication with mobile app
  * - GPS (UART2): NMEA sentence parsing for position data
- * - LoRa (UART4): Long-range communication with remote boat
- * - ADC: Analog joystick input for manual control
+ * - LoRa (UART4): Long-range communication with up to 8 boats on one
+ *   channel, time-slotted (tdma.h); the selector switch (PB6..PB8) picks
+ *   the boat that gets CTRL frames and commands
+ * - ADC: Analog joystick input for manual control, TIM6-triggered DMA scan
+ * - Data EEPROM: settings (BT commands SET/GET) and joystick calibration (CAL)
+ * - DMA: Circular receive buffers for all three UARTs, queued transmit
+ *   for Bluetooth and LoRa
  * 
  * This device acts as a bridge between:
  * 1. Mobile app control (via Bluetooth)
  * 2. Physical joystick control (via ADC)
- * 3. Remote boat (via LoRa radio)
+ * 3. Remote boats (via LoRa radio)
+ *
+ * The main loop is a cooperative scheduler (sched.h): tasks are released
+ * periodically or by event flags from ISRs, and their execution times are
+ * tracked against per-task budgets (BT command STATS).
  */
 
 #include "main.h"
@@ -18,17 +27,41 @@
 #include "lora.h"
 #include "gps.h"
 #include "joystick.h"
+#include "settings.h"
+#include "sched.h"
 
 /* Global peripheral handles */
 UART_HandleTypeDef huart1;  /* Bluetooth (USART1) */
 UART_HandleTypeDef huart2;  /* GPS (USART2) */
 UART_HandleTypeDef huart4;  /* LoRa (USART4) */
 ADC_HandleTypeDef hadc;     /* ADC for joystick inputs */
+DMA_HandleTypeDef hdma_usart1_rx;  /* Bluetooth RX (DMA1 Channel 3) */
+DMA_HandleTypeDef hdma_usart2_rx;  /* GPS RX (DMA1 Channel 5) */
+DMA_HandleTypeDef hdma_usart4_rx;  /* LoRa RX (DMA1 Channel 2) */
+DMA_HandleTypeDef hdma_usart1_tx;  /* Bluetooth TX (DMA1 Channel 4) */
+DMA_HandleTypeDef hdma_usart4_tx;  /* LoRa TX (DMA1 Channel 7) */
+DMA_HandleTypeDef hdma_adc;        /* Joystick ADC scan (DMA1 Channel 1) */
+
+/* Task table, highest priority first
+ *                name     body             period  deadline budget(us) events */
+static SchedTask_t tasks[] = {
+  SCHED_TASK("BTCMD", bt_process_line,   0,      20,       2000,      EV_BT_LINE),
+  SCHED_TASK("LORARX", lora_rx_task,     0,      20,       2000,      EV_LORA_RX),
+  SCHED_TASK("LORA",  lora_task,         10,     20,       200,       0),
+  SCHED_TASK("JOY",   joystick_task,     10,     10,       500,       0),
+  SCHED_TASK("GPS",   gps_task,          10,     20,       500,       0),
+  SCHED_TASK("BTSTA", bt_check_state,    100,    50,       500,       0),
+#ifdef LAT_TRACE
+  SCHED_TASK("TRACE", bt_trace_task,     10,     0,        500,       0),
+#endif
+};
 
 /* Function prototypes */
 void SystemClock_Config(void);
 static void MX_GPIO_Init(void);
+static void MX_DMA_Init(void);
 static void MX_ADC_Init(void);
+static void MX_TIM6_Init(void);
 static void MX_USART2_UART_Init(void);
 static void MX_USART1_UART_Init(void);
 static void MX_USART4_UART_Init(void);
@@ -40,46 +73,95 @@ int main(void) {
   
   /* Initialize peripherals */
   MX_GPIO_Init();
+  MX_DMA_Init();          /* Must precede UART init (DMA handles linked in MSP) */
   MX_ADC_Init();          /* Joystick analog inputs */
+  MX_TIM6_Init();         /* Joystick ADC trigger */
   MX_USART1_UART_Init();  /* Bluetooth */
   MX_USART2_UART_Init();  /* GPS */
   MX_USART4_UART_Init();  /* LoRa */
 
-  /* Start UART interrupt reception */
-  StartLoRaRxIT();
-  StartBTRxIT();
-  StartGPSRxIT();
+  /* Start UART circular DMA reception */
+  StartLoRaRxDMA();
+  StartBTRxDMA();
+  StartGPSRxDMA();
 
   /* Initialize modules */
+  settings_init();
   bt_init();
   lora_init();
   joystick_init();
 
-  /* Main loop - poll all communication interfaces */
+  sched_init(tasks, sizeof(tasks) / sizeof(tasks[0]));
+
+  /* Main loop - run released tasks, sleep when idle */
   while(1) {
-    bt_check_state();    /* Monitor Bluetooth connection state */
-    bt_process_line();   /* Process received Bluetooth commands */
-    gps_task();          /* Parse GPS data and handle button */
-    joystick_task();     /* Read and transmit joystick positions */
+    sched_run();
+  }
+}
 
-    HAL_Delay(2);        /* Small delay to prevent busy loop */
+/**
+  * @brief UART RX Event Callback
+  * Called on DMA half/full transfer and on UART idle line.
+  * Routes the new DMA write position to the appropriate handler
+  * @param huart: pointer to UART handle
+  * @param Size: DMA write position in the circular buffer
+  */
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef* huart, uint16_t Size) {
+  if(huart == &huart4) {
+    lora_rx_callback(Size);
+  }
+  else if(huart == &huart1) {
+    bt_rx_callback(Size);
+  }
+  else if(huart == &huart2) {
+    gps_rx_callback(Size);
   }
 }
 
 /**
-  * @brief UART RX Complete Callback
-  * Routes UART interrupts to appropriate handler
+  * @brief ADC DMA half transfer callback
+  * @param hadc: pointer to ADC handle
+  */
+void HAL_ADC_ConvHalfCpltCallback(ADC_HandleTypeDef* hadc) {
+  joystick_adc_callback(0);
+}
+
+/**
+  * @brief ADC DMA transfer complete callback
+  * @param hadc: pointer to ADC handle
+  */
+void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef* hadc) {
+  joystick_adc_callback(1);
+}
+
+/**
+  * @brief UART TX Complete Callback
+  * Starts the next queued DMA transfer
   * @param huart: pointer to UART handle
   */
-void HAL_UART_RxCpltCallback(UART_HandleTypeDef* huart) {
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef* huart) {
   if(huart == &huart4) {
-    lora_rx_callback();
+    lora_tx_callback();
   }
   else if(huart == &huart1) {
-    bt_rx_callback();
+    bt_tx_callback();
+  }
+}
+
+/**
+  * @brief UART Error Callback
+  * Errors such as overrun abort DMA reception - restart it
+  * @param huart: pointer to UART handle
+  */
+void HAL_UART_ErrorCallback(UART_HandleTypeDef* huart) {
+  if(huart == &huart4) {
+    lora_error_callback();
+  }
+  else if(huart == &huart1) {
+    bt_error_callback();
   }
   else if(huart == &huart2) {
-    gps_rx_callback();
+    StartGPSRxDMA();
   }
 }
 
@@ -132,8 +214,13 @@ void SystemClock_Config(void) {
   * Configures ADC for 12-bit resolution to read joystick analog inputs
   */
 static void MX_ADC_Init(void) {
+  ADC_ChannelConfTypeDef sConfig = {0};
+
   hadc.Instance = ADC1;
-  hadc.Init.OversamplingMode = DISABLE;
+  hadc.Init.OversamplingMode = ENABLE;
+  hadc.Init.Oversample.Ratio = ADC_OVERSAMPLING_RATIO_16;
+  hadc.Init.Oversample.RightBitShift = ADC_RIGHTBITSHIFT_4;   /* Keep 12-bit scale */
+  hadc.Init.Oversample.TriggeredMode = ADC_TRIGGEREDMODE_SINGLE_TRIGGER;
   hadc.Init.ClockPrescaler = ADC_CLOCK_SYNC_PCLK_DIV1;
   hadc.Init.Resolution = ADC_RESOLUTION_12B;
   hadc.Init.SamplingTime = ADC_SAMPLETIME_79CYCLES_5;
@@ -141,16 +228,43 @@ static void MX_ADC_Init(void) {
   hadc.Init.DataAlign = ADC_DATAALIGN_RIGHT;
   hadc.Init.ContinuousConvMode = DISABLE;
   hadc.Init.DiscontinuousConvMode = DISABLE;
-  hadc.Init.ExternalTrigConvEdge = ADC_EXTERNALTRIGCONVEDGE_NONE;
-  hadc.Init.ExternalTrigConv = ADC_SOFTWARE_START;
-  hadc.Init.DMAContinuousRequests = DISABLE;
-  hadc.Init.EOCSelection = ADC_EOC_SINGLE_CONV;
-  hadc.Init.Overrun = ADC_OVR_DATA_PRESERVED;
+  hadc.Init.ExternalTrigConvEdge = ADC_EXTERNALTRIGCONVEDGE_RISING;
+  hadc.Init.ExternalTrigConv = ADC_EXTERNALTRIGCONV_T6_TRGO;
+  hadc.Init.DMAContinuousRequests = ENABLE;                   /* Circular DMA */
+  hadc.Init.EOCSelection = ADC_EOC_SEQ_CONV;
+  hadc.Init.Overrun = ADC_OVR_DATA_OVERWRITTEN;
   hadc.Init.LowPowerAutoWait = DISABLE;
   hadc.Init.LowPowerFrequencyMode = DISABLE;
   hadc.Init.LowPowerAutoPowerOff = DISABLE;
   
   HAL_ADC_Init(&hadc);
+
+  /* Scan both joystick axes on every trigger */
+  sConfig.Rank = ADC_RANK_CHANNEL_NUMBER;
+  sConfig.Channel = ADC_CHANNEL_RUDDER;
+  if(HAL_ADC_ConfigChannel(&hadc, &sConfig) != HAL_OK) {
+    Error_Handler();
+  }
+  sConfig.Channel = ADC_CHANNEL_THRUST;
+  if(HAL_ADC_ConfigChannel(&hadc, &sConfig) != HAL_OK) {
+    Error_Handler();
+  }
+}
+
+/**
+  * @brief TIM6 Initialization Function
+  * Basic timer producing a TRGO pulse every JOY_SAMPLE_US to trigger the
+  * joystick ADC scan. Configured at register level because the HAL TIM
+  * driver is not part of this project. Started by joystick_init().
+  */
+static void MX_TIM6_Init(void) {
+  __HAL_RCC_TIM6_CLK_ENABLE();
+
+  TIM6->CR1 = 0;
+  TIM6->PSC = (SystemCoreClock / 1000000U) - 1;   /* 1 MHz count */
+  TIM6->ARR = JOY_SAMPLE_US - 1;
+  TIM6->CR2 = TIM_CR2_MMS_1;                      /* TRGO on update */
+  TIM6->EGR = TIM_EGR_UG;                         /* Load prescaler */
 }
 
 /**
@@ -216,6 +330,27 @@ static void MX_USART4_UART_Init(void) {
   }
 }
 
+/**
+  * @brief DMA Initialization
+  * Enables the DMA controller clock and the channel interrupts used
+  * by UART reception
+  */
+static void MX_DMA_Init(void) {
+  __HAL_RCC_DMA1_CLK_ENABLE();
+
+  /* Channel 1: Joystick ADC */
+  HAL_NVIC_SetPriority(DMA1_Channel1_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Channel1_IRQn);
+
+  /* Channel 2/3: LoRa and Bluetooth RX */
+  HAL_NVIC_SetPriority(DMA1_Channel2_3_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Channel2_3_IRQn);
+
+  /* Channel 4/5/7: Bluetooth TX, GPS RX, LoRa TX */
+  HAL_NVIC_SetPriority(DMA1_Channel4_5_6_7_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Channel4_5_6_7_IRQn);
+}
+
 /**
   * @brief GPIO Initialization
   * Configures GPIO pins for:
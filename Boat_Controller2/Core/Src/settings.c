@@ -0,0 +1,73 @@
+/* settings.c - Controller settings kept in data EEPROM */
+#include "settings.h"
+#include "joystick.h"
+#include "ctrl_rate.h"
+#include "ctrl_merge.h"
+#include "ctrl_arb.h"
+#include "tdma.h"
+
+static const ConfigKey_t settings_keys[CFG_COUNT] = {
+  [CFG_LORA_ADDRESS]      = { "LORA_ADDRESS",      LORA_CONTROLLER_ADDR,   0,         65535 },
+  [CFG_LORA_NETWORK]      = { "LORA_NETWORK",      18,                     0,         255 },
+  [CFG_LORA_BAND]         = { "LORA_BAND",         915000000,              862000000, 1020000000 },
+  [CFG_LORA_SF]           = { "LORA_SF",           9,                      7,         12 },
+  [CFG_LORA_BW]           = { "LORA_BW",           7,                      0,         9 },
+  [CFG_LORA_CR]           = { "LORA_CR",           1,                      1,         4 },
+  [CFG_LORA_PREAMBLE]     = { "LORA_PREAMBLE",     12,                     4,         25 },
+  [CFG_LORA_PEER]         = { "LORA_PEER",         LORA_BOAT0_ADDR,        1,         65535 - 7 },
+  [CFG_THRUST_DEADBAND]   = { "THRUST_DEADBAND",   THRUST_DEADBAND,        0,         1000 },
+  [CFG_RUDDER_DEADBAND]   = { "RUDDER_DEADBAND",   RUDDER_DEADBAND,        0,         1000 },
+  [CFG_THRUST_EXPO]       = { "THRUST_EXPO",       THRUST_EXPO,            0,         100 },
+  [CFG_RUDDER_EXPO]       = { "RUDDER_EXPO",       RUDDER_EXPO,            0,         100 },
+  [CFG_CTRL_THRESHOLD]    = { "CTRL_THRESHOLD",    CTRL_RATE_THRESHOLD,    1,         2047 },
+  [CFG_CTRL_MIN_GAP_MS]   = { "CTRL_MIN_GAP_MS",   CTRL_RATE_MIN_GAP_MS,   0,         1000 },
+  [CFG_CTRL_ACTIVE_MS]    = { "CTRL_ACTIVE_MS",    CTRL_RATE_ACTIVE_MS,    20,        1000 },
+  [CFG_CTRL_HOLD_MS]      = { "CTRL_HOLD_MS",      CTRL_RATE_HOLD_MS,      0,         5000 },
+  [CFG_CTRL_HEARTBEAT_MS] = { "CTRL_HEARTBEAT_MS", CTRL_RATE_HEARTBEAT_MS, 100,       2000 },
+  [CFG_BT_IGNORE_STATE]   = { "BT_IGNORE_STATE",   BT_IGNORE_STATE,        0,         1 },
+  [CFG_TDMA_BOATS]        = { "TDMA_BOATS",        1,                      1,         TDMA_BOATS_MAX },
+  [CFG_LORA_ADR]          = { "LORA_ADR",          0,                      0,         1 },
+  [CFG_APP_MERGE_MS]      = { "APP_MERGE_MS",      CTRL_MERGE_WINDOW_MS,   0,         500 },
+  [CFG_CTRL_HANDOVER_MS]  = { "CTRL_HANDOVER_MS",  CTRL_ARB_HOLD_MS,       0,         5000 },
+  [CFG_APP_TIMEOUT_MS]    = { "APP_TIMEOUT_MS",    CTRL_ARB_APP_TIMEOUT_MS, 200,      10000 },
+};
+
+static uint32_t settings_values[CFG_COUNT];
+
+static uint8_t settings_program(uintptr_t addr, uint32_t word);
+
+Config_t settings = CONFIG_INIT(settings_keys, CFG_COUNT, settings_values,
+                                DATA_EEPROM_BASE, DATA_EEPROM_BANK2_BASE, SETTINGS_AREA_SIZE,
+                                settings_program, NULL);
+
+/**
+  * @brief Program one data EEPROM word (about 3 ms, blocking)
+  */
+static uint8_t settings_program(uintptr_t addr, uint32_t word) {
+  HAL_StatusTypeDef st = HAL_FLASHEx_DATAEEPROM_Unlock();
+  if(st == HAL_OK) {
+    st = HAL_FLASHEx_DATAEEPROM_Program(FLASH_TYPEPROGRAMDATA_WORD, (uint32_t)addr, word);
+  }
+  HAL_FLASHEx_DATAEEPROM_Lock();
+  return st == HAL_OK;
+}
+
+/**
+  * @brief Load the settings
+  */
+void settings_init(void) {
+  config_init(&settings);
+}
+
+/**
+  * @brief LoRa module settings
+  */
+void settings_lora(LoRaAtConfig_t* cfg) {
+  cfg->address = (uint16_t)setting(CFG_LORA_ADDRESS);
+  cfg->network = (uint8_t)setting(CFG_LORA_NETWORK);
+  cfg->band_hz = setting(CFG_LORA_BAND);
+  cfg->sf = (uint8_t)setting(CFG_LORA_SF);
+  cfg->bw = (uint8_t)setting(CFG_LORA_BW);
+  cfg->cr = (uint8_t)setting(CFG_LORA_CR);
+  cfg->preamble = (uint16_t)setting(CFG_LORA_PREAMBLE);
+}
@@ -3,11 +3,74 @@
  * This file provides low-level hardware initialization for peripherals:
  * - Clock configuration
  * - GPIO pin mapping
+ * - DMA channel setup
  * - Interrupt priority setup
  */
 
 #include "main.h"
 
+/* UART DMA handles (defined in main.c) */
+extern DMA_HandleTypeDef hdma_usart1_rx;
+extern DMA_HandleTypeDef hdma_usart2_rx;
+extern DMA_HandleTypeDef hdma_usart4_rx;
+extern DMA_HandleTypeDef hdma_usart1_tx;
+extern DMA_HandleTypeDef hdma_usart4_tx;
+extern DMA_HandleTypeDef hdma_adc;
+
+/**
+  * @brief Configure a UART RX DMA channel in circular mode and link it
+  * @param huart: UART handle pointer
+  * @param hdma: DMA handle to configure
+  * @param channel: DMA channel instance
+  * @param request: DMA request mapping for the channel
+  * @param priority: DMA channel priority
+  */
+static void uart_rx_dma_init(UART_HandleTypeDef* huart, DMA_HandleTypeDef* hdma,
+                             DMA_Channel_TypeDef* channel, uint32_t request,
+                             uint32_t priority) {
+  hdma->Instance = channel;
+  hdma->Init.Request = request;
+  hdma->Init.Direction = DMA_PERIPH_TO_MEMORY;
+  hdma->Init.PeriphInc = DMA_PINC_DISABLE;
+  hdma->Init.MemInc = DMA_MINC_ENABLE;
+  hdma->Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+  hdma->Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+  hdma->Init.Mode = DMA_CIRCULAR;
+  hdma->Init.Priority = priority;
+
+  if(HAL_DMA_Init(hdma) != HAL_OK) {
+    Error_Handler();
+  }
+
+  __HAL_LINKDMA(huart, hdmarx, *hdma);
+}
+
+/**
+  * @brief Configure a UART TX DMA channel in normal mode and link it
+  * @param huart: UART handle pointer
+  * @param hdma: DMA handle to configure
+  * @param channel: DMA channel instance
+  * @param request: DMA request mapping for the channel
+  */
+static void uart_tx_dma_init(UART_HandleTypeDef* huart, DMA_HandleTypeDef* hdma,
+                             DMA_Channel_TypeDef* channel, uint32_t request) {
+  hdma->Instance = channel;
+  hdma->Init.Request = request;
+  hdma->Init.Direction = DMA_MEMORY_TO_PERIPH;
+  hdma->Init.PeriphInc = DMA_PINC_DISABLE;
+  hdma->Init.MemInc = DMA_MINC_ENABLE;
+  hdma->Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+  hdma->Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+  hdma->Init.Mode = DMA_NORMAL;
+  hdma->Init.Priority = DMA_PRIORITY_LOW;
+
+  if(HAL_DMA_Init(hdma) != HAL_OK) {
+    Error_Handler();
+  }
+
+  __HAL_LINKDMA(huart, hdmatx, *hdma);
+}
+
 /**
   * @brief Initialize the Global MSP
   * Called by HAL_Init() to configure system-level resources
@@ -47,6 +110,23 @@ void HAL_ADC_MspInit(ADC_HandleTypeDef* hadc) {
     GPIO_InitStruct.Mode = GPIO_MODE_ANALOG;
     GPIO_InitStruct.Pull = GPIO_NOPULL;
     HAL_GPIO_Init(GPIOB, &GPIO_InitStruct);
+
+    /* ADC on DMA1 Channel 1, circular half-word transfers */
+    hdma_adc.Instance = DMA1_Channel1;
+    hdma_adc.Init.Request = DMA_REQUEST_0;
+    hdma_adc.Init.Direction = DMA_PERIPH_TO_MEMORY;
+    hdma_adc.Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma_adc.Init.MemInc = DMA_MINC_ENABLE;
+    hdma_adc.Init.PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD;
+    hdma_adc.Init.MemDataAlignment = DMA_MDATAALIGN_HALFWORD;
+    hdma_adc.Init.Mode = DMA_CIRCULAR;
+    hdma_adc.Init.Priority = DMA_PRIORITY_MEDIUM;
+
+    if(HAL_DMA_Init(&hdma_adc) != HAL_OK) {
+      Error_Handler();
+    }
+
+    __HAL_LINKDMA(hadc, DMA_Handle, hdma_adc);
   }
 }
 
@@ -63,6 +143,7 @@ void HAL_ADC_MspDeInit(ADC_HandleTypeDef* hadc) {
     /* Deconfigure GPIO pins */
     HAL_GPIO_DeInit(GPIOA, GPIO_PIN_6 | GPIO_PIN_7);
     HAL_GPIO_DeInit(GPIOB, GPIO_PIN_0 | GPIO_PIN_1);
+    HAL_DMA_DeInit(hadc->DMA_Handle);
   }
 }
 
@@ -88,6 +169,12 @@ void HAL_UART_MspInit(UART_HandleTypeDef* huart) {
     GPIO_InitStruct.Alternate = GPIO_AF4_USART1;
     HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
 
+    /* USART1_RX on DMA1 Channel 3 */
+    uart_rx_dma_init(huart, &hdma_usart1_rx, DMA1_Channel3, DMA_REQUEST_3, DMA_PRIORITY_LOW);
+
+    /* USART1_TX on DMA1 Channel 4 */
+    uart_tx_dma_init(huart, &hdma_usart1_tx, DMA1_Channel4, DMA_REQUEST_3);
+
     /* Enable USART1 interrupt */
     HAL_NVIC_SetPriority(USART1_IRQn, 0, 0);
     HAL_NVIC_EnableIRQ(USART1_IRQn);
@@ -106,6 +193,9 @@ void HAL_UART_MspInit(UART_HandleTypeDef* huart) {
     GPIO_InitStruct.Alternate = GPIO_AF4_USART2;
     HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
 
+    /* USART2_RX on DMA1 Channel 5 */
+    uart_rx_dma_init(huart, &hdma_usart2_rx, DMA1_Channel5, DMA_REQUEST_4, DMA_PRIORITY_LOW);
+
     /* Enable USART2 interrupt */
     HAL_NVIC_SetPriority(USART2_IRQn, 0, 0);
     HAL_NVIC_EnableIRQ(USART2_IRQn);
@@ -124,6 +214,12 @@ void HAL_UART_MspInit(UART_HandleTypeDef* huart) {
     GPIO_InitStruct.Alternate = GPIO_AF6_USART4;
     HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
 
+    /* USART4_RX on DMA1 Channel 2 (highest rate link) */
+    uart_rx_dma_init(huart, &hdma_usart4_rx, DMA1_Channel2, DMA_REQUEST_12, DMA_PRIORITY_HIGH);
+
+    /* USART4_TX on DMA1 Channel 7 */
+    uart_tx_dma_init(huart, &hdma_usart4_tx, DMA1_Channel7, DMA_REQUEST_12);
+
     /* Enable USART4 interrupt */
     HAL_NVIC_SetPriority(USART4_5_IRQn, 0, 0);
     HAL_NVIC_EnableIRQ(USART4_5_IRQn);
@@ -139,16 +235,21 @@ void HAL_UART_MspDeInit(UART_HandleTypeDef* huart) {
   if(huart->Instance == USART1) {
     __HAL_RCC_USART1_CLK_DISABLE();
     HAL_GPIO_DeInit(GPIOA, GPIO_PIN_9 | GPIO_PIN_10);
+    HAL_DMA_DeInit(huart->hdmarx);
+    HAL_DMA_DeInit(huart->hdmatx);
     HAL_NVIC_DisableIRQ(USART1_IRQn);
   }
   else if(huart->Instance == USART2) {
     __HAL_RCC_USART2_CLK_DISABLE();
     HAL_GPIO_DeInit(GPIOA, GPIO_PIN_2 | GPIO_PIN_3);
+    HAL_DMA_DeInit(huart->hdmarx);
     HAL_NVIC_DisableIRQ(USART2_IRQn);
   }
   else if(huart->Instance == USART4) {
     __HAL_RCC_USART4_CLK_DISABLE();
     HAL_GPIO_DeInit(GPIOA, GPIO_PIN_0 | GPIO_PIN_1);
+    HAL_DMA_DeInit(huart->hdmarx);
+    HAL_DMA_DeInit(huart->hdmatx);
     HAL_NVIC_DisableIRQ(USART4_5_IRQn);
   }
 }
@@ -3,6 +3,7 @@
  * This file contains:
  * - Cortex-M0+ core exception handlers
  * - Peripheral interrupt handlers for UART communication
+ * - DMA channel interrupt handlers for UART reception and transmission
  */
 
 #include "main.h"
@@ -13,6 +14,14 @@ extern UART_HandleTypeDef huart4;  /* LoRa */
 extern UART_HandleTypeDef huart2;  /* GPS */
 extern UART_HandleTypeDef huart1;  /* Bluetooth */
 
+/* External DMA handles */
+extern DMA_HandleTypeDef hdma_usart4_rx;  /* LoRa RX */
+extern DMA_HandleTypeDef hdma_usart2_rx;  /* GPS RX */
+extern DMA_HandleTypeDef hdma_usart1_rx;  /* Bluetooth RX */
+extern DMA_HandleTypeDef hdma_usart1_tx;  /* Bluetooth TX */
+extern DMA_HandleTypeDef hdma_usart4_tx;  /* LoRa TX */
+extern DMA_HandleTypeDef hdma_adc;        /* Joystick ADC */
+
 /******************************************************************************/
 /*           Cortex-M0+ Processor Exception Handlers                          */
 /******************************************************************************/
@@ -79,4 +88,32 @@ void USART2_IRQHandler(void) {
   */
 void USART1_IRQHandler(void) {
   HAL_UART_IRQHandler(&huart1);
+}
+
+/**
+  * @brief DMA1 Channel 1 Interrupt Handler
+  * Handles joystick ADC scan DMA
+  */
+void DMA1_Channel1_IRQHandler(void) {
+  HAL_DMA_IRQHandler(&hdma_adc);
+}
+
+/**
+  * @brief DMA1 Channel 2 and 3 Interrupt Handler
+  * Handles LoRa (channel 2) and Bluetooth (channel 3) RX DMA
+  */
+void DMA1_Channel2_3_IRQHandler(void) {
+  HAL_DMA_IRQHandler(&hdma_usart4_rx);
+  HAL_DMA_IRQHandler(&hdma_usart1_rx);
+}
+
+/**
+  * @brief DMA1 Channel 4 to 7 Interrupt Handler
+  * Handles Bluetooth TX (channel 4), GPS RX (channel 5) and LoRa TX
+  * (channel 7) DMA
+  */
+void DMA1_Channel4_5_6_7_IRQHandler(void) {
+  HAL_DMA_IRQHandler(&hdma_usart1_tx);
+  HAL_DMA_IRQHandler(&hdma_usart2_rx);
+  HAL_DMA_IRQHandler(&hdma_usart4_tx);
 }
\ No newline at end of file
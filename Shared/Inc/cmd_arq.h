@@ -0,0 +1,174 @@
+/* cmd_arq.h - Selective-repeat acknowledged delivery for LoRa commands */
+#ifndef __CMD_ARQ_H
+#define __CMD_ARQ_H
+
+#include "frame.h"
+#include <stdint.h>
+
+/*
+ * Commands (FRAME_CMD) carry their own sequence number in the frame header.
+ * The receiver answers every CMD with an ACK holding the highest sequence
+ * number it has seen and a bitmap of the 32 before it, so one ACK confirms
+ * any mix of commands and a lost ACK is repaired by the next one. The
+ * sender keeps up to CMD_ARQ_WINDOW unacknowledged commands and resends
+ * each one on its own timeout until it is acknowledged or has been sent
+ * CMD_ARQ_TRIES times.
+ *
+ * The retransmit timeout follows the measured delivery time (twice the
+ * smoothed first-try delivery time, doubled per retry). Streaming CTRL
+ * frames do not go through here: they are latest-wins and resent by the
+ * adaptive rate logic (ctrl_rate.h).
+ *
+ * A new sender session (controller reboot) resets the receiver window so
+ * restarted sequence numbers are not mistaken for duplicates. The session
+ * and the first sequence number come from entropy gathered at boot
+ * (cmd_arq_seed): a session repeated across a reboot would make the
+ * receivers drop the new commands as duplicates.
+ *
+ * A command goes to a group of receivers (bit i = uplink slot i, tdma.h)
+ * that share the sequence numbers. One receiver gets a CMD frame; more
+ * get one broadcast GCMD frame. Each receiver acknowledges on its own,
+ * and a retransmission carries only the receivers still missing. The
+ * command is delivered once all have acknowledged.
+ */
+
+#define CMD_ARQ_WINDOW       8          /* Unacknowledged commands in flight */
+#define CMD_ARQ_TRIES        6          /* Transmissions before giving up */
+#define CMD_ARQ_RTO_INIT_MS  1500       /* Timeout before the first delivery is measured */
+#define CMD_ARQ_RTO_MIN_MS   400
+#define CMD_ARQ_RTO_MAX_MS   6000
+#define CMD_ARQ_GROUP_ALL    0xFF       /* Every receiver */
+
+/**
+  * @brief Frame output; must not call back into the ARQ
+  */
+typedef void (*CmdArqSendFn)(const Frame_t* f);
+
+/**
+  * @brief Outcome notification for a command (delivered or given up)
+  * @param group: Receivers addressed
+  * @param acked: Receivers that acknowledged (== group when delivered)
+  */
+typedef void (*CmdArqDoneFn)(const char* text, uint8_t group, uint8_t acked);
+
+/**
+  * @brief One command awaiting acknowledgement
+  */
+typedef struct {
+  char     text[FRAME_CMD_TEXT_MAX + 1];
+  uint8_t  len;
+  uint8_t  seq;
+  uint8_t  group;             /* Receivers addressed */
+  uint8_t  missing;           /* Receivers yet to acknowledge */
+  uint8_t  tries;             /* Transmissions so far, 0 = free slot */
+  uint32_t first_ms;          /* First transmission */
+  uint32_t sent_ms;           /* Last transmission */
+} CmdArqSlot_t;
+
+/**
+  * @brief Sender state
+  */
+typedef struct {
+  CmdArqSendFn send;
+  CmdArqDoneFn done;          /* Optional */
+  uint8_t  session;           /* 0 until the first command */
+  uint8_t  next_seq;
+  uint32_t seed;              /* Boot entropy (cmd_arq_seed) */
+  CmdArqSlot_t slot[CMD_ARQ_WINDOW];
+  uint32_t srtt_ms;           /* Smoothed first-try delivery time, 0 = none yet */
+  uint32_t rto_ms;            /* Current base retransmit timeout */
+  uint32_t rto_floor_ms;      /* Earliest possible ACK (slotted channel), 0 = none */
+
+  /* Statistics */
+  uint32_t queued;            /* Commands accepted */
+  uint32_t rejected;          /* Commands refused (window full or too long) */
+  uint32_t delivered;         /* Commands acknowledged by every receiver */
+  uint32_t failed;            /* Commands given up after CMD_ARQ_TRIES (some receiver missing) */
+  uint32_t transmissions;     /* CMD frames sent, including retransmissions */
+  uint32_t retransmits;       /* CMD frames sent again after a timeout */
+  uint32_t latency_total_ms;  /* Sum of first-send-to-ACK times (average = total/delivered) */
+  uint32_t latency_max_ms;    /* Longest first-send-to-ACK time */
+} CmdArqTx_t;
+
+/**
+  * @brief Receiver state
+  */
+typedef struct {
+  uint8_t  session;           /* Current sender session, 0 = none */
+  uint8_t  top;               /* Highest sequence number received */
+  uint32_t seen;              /* Bit i set: top - i received */
+
+  /* Statistics */
+  uint32_t accepted;          /* New commands delivered */
+  uint32_t duplicates;        /* Retransmissions of commands already delivered */
+} CmdArqRx_t;
+
+/**
+  * @brief Static initializer for a sender
+  * @param send_fn: Frame output
+  * @param done_fn: Outcome notification, or 0
+  */
+#define CMD_ARQ_TX_INIT(send_fn, done_fn) { .send = (send_fn), .done = (done_fn), \
+  .rto_ms = CMD_ARQ_RTO_INIT_MS }
+
+/**
+  * @brief Mix boot entropy into the session
+  * Call with device-unique and noisy values (UID, timing or RSSI LSBs)
+  * until the first command fixes the session
+  * @param tx: Sender state
+  * @param entropy: Value to mix in
+  */
+void cmd_arq_seed(CmdArqTx_t* tx, uint32_t entropy);
+
+/**
+  * @brief Queue a command and send it
+  * @param tx: Sender state
+  * @param text: Command text (1..FRAME_CMD_TEXT_MAX characters)
+  * @param group: Receivers, bit i = uplink slot i (not 0)
+  * @param now: Current tick in ms
+  * @retval 1 if queued, 0 if the window is full, the text too long or
+  * the group empty
+  */
+uint8_t cmd_arq_send(CmdArqTx_t* tx, const char* text, uint8_t group, uint32_t now);
+
+/**
+  * @brief Resend commands whose timeout expired, give up on exhausted ones
+  * @param tx: Sender state
+  * @param now: Current tick in ms
+  */
+void cmd_arq_poll(CmdArqTx_t* tx, uint32_t now);
+
+/**
+  * @brief Record the commands an ACK confirms for its sender
+  * ACKs for another session are ignored
+  * @param tx: Sender state
+  * @param ack: Received ACK payload
+  * @param from: Uplink slot of the receiver that sent it
+  * @param now: Tick the ACK arrived
+  */
+void cmd_arq_on_ack(CmdArqTx_t* tx, const FrameAck_t* ack, uint8_t from, uint32_t now);
+
+/**
+  * @brief Give up every command awaiting acknowledgement
+  * Each is reported through the done callback as not delivered (for
+  * example when the commands were meant for another receiver).
+  * @param tx: Sender state
+  */
+void cmd_arq_flush(CmdArqTx_t* tx);
+
+/**
+  * @brief Number of commands awaiting acknowledgement
+  * @param tx: Sender state
+  */
+uint8_t cmd_arq_pending(const CmdArqTx_t* tx);
+
+/**
+  * @brief Record a received command and build the ACK to send back
+  * @param rx: Receiver state
+  * @param f: Received FRAME_CMD, or FRAME_GCMD with this receiver in its group
+  * @param ack: ACK payload to send (always filled)
+  * @retval 1 if the command is new and must be executed, 0 if a duplicate
+  */
+uint8_t cmd_arq_receive(CmdArqRx_t* rx, const Frame_t* f, FrameAck_t* ack);
+
+#endif /* __CMD_ARQ_H */
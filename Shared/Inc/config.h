@@ -0,0 +1,149 @@
+/* config.h - Persistent key-value configuration store */
+#ifndef __CONFIG_H
+#define __CONFIG_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Settings are 32-bit values identified by their index in a table of keys.
+ * The table is append-only: an index keeps its meaning across firmware
+ * versions, and records for unknown or out-of-range keys are skipped.
+ *
+ * Storage is two memory-mapped areas used in turn as a log. Each SET
+ * appends one 8-byte record to the active area:
+ *
+ *   word 0   value
+ *   word 1   key | epoch << 8 | CRC-16 << 16
+ *
+ * The value is programmed before the header word, and the CRC (frame_crc16
+ * over key, epoch and value) covers both, so a record torn by a reset is
+ * never applied. When the area is full, the current values that differ
+ * from their defaults are copied to the other area, followed by its
+ * header (magic, epoch + 1) which commits the switch. At boot the area
+ * with the newer valid header is replayed up to its first invalid
+ * record, the last record of a key winning.
+ *
+ * Writes are spread over the whole area and each area is rewritten once
+ * per area-full of SETs, which levels the wear of EEPROM and flash. The
+ * epoch in every record lets an area be reused without erasing it (data
+ * EEPROM): records left from its previous use carry an older epoch and
+ * end the replay. Flash areas are erased before reuse.
+ *
+ * Load time is one CRC per stored record, a few microseconds each.
+ */
+
+#define CONFIG_MAGIC       0x31474643U      /* "CFG1" */
+#define CONFIG_HEADER_SIZE 8
+#define CONFIG_RECORD_SIZE 8
+
+/**
+  * @brief Result of a SET
+  */
+typedef enum {
+  CONFIG_OK = 0,
+  CONFIG_UNKNOWN,             /* No such key */
+  CONFIG_RANGE,               /* Value out of the key's range */
+  CONFIG_FAILED               /* Could not be stored (value unchanged) */
+} ConfigStatus_t;
+
+/**
+  * @brief One setting
+  */
+typedef struct {
+  const char* name;           /* Name for SET/GET */
+  uint32_t def;               /* Default */
+  uint32_t min;
+  uint32_t max;
+} ConfigKey_t;
+
+/**
+  * @brief Programs one aligned word of an area
+  * @retval 1 on success
+  */
+typedef uint8_t (*ConfigProgramFn)(uintptr_t addr, uint32_t word);
+
+/**
+  * @brief Erases an area before reuse (flash); NULL if words can be rewritten (EEPROM)
+  * @retval 1 on success
+  */
+typedef uint8_t (*ConfigEraseFn)(uint8_t area);
+
+/**
+  * @brief Store state
+  * Hardware independent: the areas are read through their addresses and
+  * written through the callbacks.
+  */
+typedef struct {
+  /* Configuration */
+  const ConfigKey_t* keys;    /* Key table */
+  uint8_t  count;             /* Number of keys */
+  uint32_t* values;           /* Current values, count entries */
+  uintptr_t base[2];          /* Area addresses, word aligned */
+  uint32_t size;              /* Bytes per area */
+  ConfigProgramFn program;
+  ConfigEraseFn   erase;
+
+  /* State */
+  uint8_t  area;              /* Active area */
+  uint8_t  formatted;         /* The active area has a valid header */
+  uint16_t epoch;             /* Epoch of the active area */
+  uint32_t next;              /* Offset of the next record in the active area */
+
+  /* Statistics */
+  uint32_t loaded;            /* Records replayed at boot */
+  uint32_t writes;            /* Records written since boot */
+  uint32_t compactions;       /* Area switches since boot */
+  uint32_t errors;            /* Failed or unverified writes */
+} Config_t;
+
+#define CONFIG_INIT(key_table, key_count, value_array, base0, base1, area_size, program_fn, erase_fn) { \
+  .keys = (key_table), .count = (key_count), .values = (value_array), \
+  .base = { (base0), (base1) }, .size = (area_size), .program = (program_fn), .erase = (erase_fn) }
+
+/**
+  * @brief Load the stored values; keys without a record take their default
+  * @param c: Store (configuration set)
+  */
+void config_init(Config_t* c);
+
+/**
+  * @brief Current value of a key
+  */
+static inline uint32_t config_get(const Config_t* c, uint8_t key) {
+  return c->values[key];
+}
+
+/**
+  * @brief Change and store a value
+  * Nothing is written if the value is unchanged.
+  * @param c: Store
+  * @param key: Key index
+  * @param value: New value
+  * @retval CONFIG_OK, CONFIG_UNKNOWN, CONFIG_RANGE or CONFIG_FAILED
+  */
+ConfigStatus_t config_set(Config_t* c, uint8_t key, uint32_t value);
+
+/**
+  * @brief Key index by name
+  * @retval Index, or -1 if there is no such key
+  */
+int16_t config_find(const Config_t* c, const char* name);
+
+/**
+  * @brief Change and store a value given as text
+  * @param c: Store
+  * @param arg: "<name>,<value>", value in decimal
+  * @param key: Key index, or -1 if the name is unknown
+  * @retval As config_set; CONFIG_RANGE for a malformed value
+  */
+ConfigStatus_t config_set_text(Config_t* c, const char* arg, int16_t* key);
+
+/**
+  * @brief Bytes used in the active area (header and records)
+  */
+static inline uint32_t config_used(const Config_t* c) {
+  return c->formatted ? c->next : 0;
+}
+
+#endif /* __CONFIG_H */
@@ -0,0 +1,70 @@
+/* ctrl_arb.h - Arbitration between the joystick and the app as control source */
+#ifndef __CTRL_ARB_H
+#define __CTRL_ARB_H
+
+#include <stdint.h>
+
+/*
+ * Exactly one source drives the CTRL frames; the other's input is ignored.
+ *
+ *   - The joystick has priority: sticks off centre take control from the app.
+ *   - The app takes control with an update while the joystick is idle.
+ *   - An app that sends nothing for app_timeout_ms loses control to the
+ *     joystick, which then sends its (centred) sticks.
+ *
+ * A source keeps control for at least hold_ms after taking it, except on
+ * the app timeout, so the two cannot flap on every update. The joystick
+ * counts as idle only after its own timeout (joystick_is_active), which is
+ * the hysteresis of the hand-over back to the app.
+ *
+ * Hardware independent: time is passed in.
+ */
+
+typedef enum {
+  CTRL_SRC_JOYSTICK = 0,
+  CTRL_SRC_APP
+} CtrlSource_t;
+
+typedef enum {
+  CTRL_ARB_NONE = 0,          /* Source unchanged */
+  CTRL_ARB_IDLE,              /* App took over from the idle joystick */
+  CTRL_ARB_PRIORITY,          /* Joystick took over from the app */
+  CTRL_ARB_TIMEOUT            /* App went silent, back to the joystick */
+} CtrlArbReason_t;
+
+#define CTRL_ARB_HOLD_MS         500
+#define CTRL_ARB_APP_TIMEOUT_MS  2000
+
+/**
+  * @brief Arbiter state
+  */
+typedef struct {
+  /* Configuration */
+  uint16_t hold_ms;           /* Least time in control before a hand-over */
+  uint16_t app_timeout_ms;    /* App silence that ends its control */
+
+  /* State */
+  uint8_t  source;            /* CtrlSource_t in control */
+  uint32_t since_ms;          /* In control since */
+  uint32_t app_ms;            /* Last app update */
+
+  /* Statistics */
+  uint32_t to_app;            /* Hand-overs to the app */
+  uint32_t to_joystick;       /* Hand-overs to the joystick, timeouts included */
+  uint32_t timeouts;          /* App silences */
+} CtrlArb_t;
+
+#define CTRL_ARB_DEFAULT { .hold_ms = CTRL_ARB_HOLD_MS, .app_timeout_ms = CTRL_ARB_APP_TIMEOUT_MS, \
+                           .source = CTRL_SRC_JOYSTICK }
+
+/**
+  * @brief Decide which source is in control
+  * @param a: Arbiter
+  * @param joy_active: Sticks moved recently
+  * @param app_update: App update since the last call
+  * @param now_ms: Current time in milliseconds
+  * @retval Reason of a hand-over, CTRL_ARB_NONE if the source is unchanged
+  */
+CtrlArbReason_t ctrl_arb_update(CtrlArb_t* a, uint8_t joy_active, uint8_t app_update, uint32_t now_ms);
+
+#endif /* __CTRL_ARB_H */
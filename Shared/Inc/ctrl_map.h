@@ -0,0 +1,80 @@
+/* ctrl_map.h - Calibrated control value to servo pulse mapping */
+#ifndef __CTRL_MAP_H
+#define __CTRL_MAP_H
+
+#include "frame.h"
+#include <stdint.h>
+
+/*
+ * Maps a signed FRAME_CTRL value (full 12-bit resolution) to a pulse width
+ * in microseconds for one output channel:
+ *
+ *   - the magnitude is shaped by an expo curve, a table of CTRL_MAP_POINTS
+ *     Q15 values interpolated linearly
+ *   - positive values span center_us..max_us, negative ones center_us..min_us,
+ *     so the centre trim does not change the endpoints
+ *   - a one-sided channel (ESC without reverse) sets center_us = min_us
+ *
+ * The curve is y = (1 - e) x + e x^3 for expo e in percent. CTRL_MAP_CURVE
+ * evaluates it in integer constant expressions, so the table is built by
+ * the compiler and lives in flash; ctrl_map_build_curve fills a RAM table
+ * with the same values for an expo chosen at run time.
+ */
+
+#define CTRL_MAP_POINTS   33          /* Table entries, 0..1 in 32 segments */
+#define CTRL_MAP_ONE      32768U      /* 1.0 in Q15 */
+
+/* Table input of entry i, Q15 */
+#define CTRL_MAP_X(i)     ((uint32_t)(i) * (CTRL_MAP_ONE / (CTRL_MAP_POINTS - 1)))
+
+/* Entry i of the expo curve for e percent (0..100), Q15 */
+#define CTRL_MAP_EXPO(i, e) ((uint16_t)(((100U - (e)) * CTRL_MAP_X(i) + \
+  (e) * (uint32_t)(((uint64_t)CTRL_MAP_X(i) * CTRL_MAP_X(i) * CTRL_MAP_X(i)) >> 30)) / 100U))
+
+/* Initializer for a const uint16_t[CTRL_MAP_POINTS] curve with e percent expo */
+#define CTRL_MAP_CURVE(e) { \
+  CTRL_MAP_EXPO(0, e), CTRL_MAP_EXPO(1, e), CTRL_MAP_EXPO(2, e), CTRL_MAP_EXPO(3, e), \
+  CTRL_MAP_EXPO(4, e), CTRL_MAP_EXPO(5, e), CTRL_MAP_EXPO(6, e), CTRL_MAP_EXPO(7, e), \
+  CTRL_MAP_EXPO(8, e), CTRL_MAP_EXPO(9, e), CTRL_MAP_EXPO(10, e), CTRL_MAP_EXPO(11, e), \
+  CTRL_MAP_EXPO(12, e), CTRL_MAP_EXPO(13, e), CTRL_MAP_EXPO(14, e), CTRL_MAP_EXPO(15, e), \
+  CTRL_MAP_EXPO(16, e), CTRL_MAP_EXPO(17, e), CTRL_MAP_EXPO(18, e), CTRL_MAP_EXPO(19, e), \
+  CTRL_MAP_EXPO(20, e), CTRL_MAP_EXPO(21, e), CTRL_MAP_EXPO(22, e), CTRL_MAP_EXPO(23, e), \
+  CTRL_MAP_EXPO(24, e), CTRL_MAP_EXPO(25, e), CTRL_MAP_EXPO(26, e), CTRL_MAP_EXPO(27, e), \
+  CTRL_MAP_EXPO(28, e), CTRL_MAP_EXPO(29, e), CTRL_MAP_EXPO(30, e), CTRL_MAP_EXPO(31, e), \
+  CTRL_MAP_EXPO(32, e) }
+
+/**
+  * @brief Calibration of one output channel
+  */
+typedef struct {
+  uint16_t min_us;            /* Pulse at -FRAME_CTRL_MAX */
+  uint16_t center_us;         /* Pulse at 0 (trim) */
+  uint16_t max_us;            /* Pulse at +FRAME_CTRL_MAX */
+  const uint16_t* curve;      /* CTRL_MAP_POINTS entries from CTRL_MAP_CURVE */
+} CtrlMapCal_t;
+
+/**
+  * @brief Fill a curve table for e percent expo at run time
+  * Gives the same entries as CTRL_MAP_CURVE(e)
+  * @param curve: CTRL_MAP_POINTS entries
+  * @param expo: Expo in percent (0..100, clamped)
+  */
+void ctrl_map_build_curve(uint16_t* curve, uint8_t expo);
+
+/**
+  * @brief Shape a magnitude through a curve table
+  * @param curve: CTRL_MAP_POINTS entries
+  * @param x: Magnitude in Q15, 0..CTRL_MAP_ONE
+  * @retval Shaped magnitude in Q15
+  */
+uint32_t ctrl_map_curve(const uint16_t* curve, uint32_t x);
+
+/**
+  * @brief Pulse width for a control value
+  * @param cal: Channel calibration
+  * @param v: Control value, -FRAME_CTRL_MAX..FRAME_CTRL_MAX (clamped)
+  * @retval Pulse width in microseconds
+  */
+uint16_t ctrl_map_us(const CtrlMapCal_t* cal, int16_t v);
+
+#endif /* __CTRL_MAP_H */
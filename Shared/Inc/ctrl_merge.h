@@ -0,0 +1,77 @@
+/* ctrl_merge.h - Coalescing of per-axis control updates into combined frames */
+#ifndef __CTRL_MERGE_H
+#define __CTRL_MERGE_H
+
+#include <stdint.h>
+
+/*
+ * The app sends thrust and rudder as separate lines. The first update
+ * after a quiet spell opens a window of window_ms; updates within it only
+ * replace the latest value of their axis, and when it closes both axes go
+ * out in one frame. An axis not updated keeps its last value.
+ *
+ * Hardware independent: time is passed in, values in the caller's units.
+ */
+
+#define CTRL_MERGE_THRUST      0
+#define CTRL_MERGE_RUDDER      1
+
+#define CTRL_MERGE_WINDOW_MS   30     /* Default: a THRUST/RUDDER pair at 9600 baud */
+#define CTRL_MERGE_MINUTE_MS   60000
+
+/**
+  * @brief Coalescer state
+  */
+typedef struct {
+  /* Configuration */
+  uint16_t window_ms;         /* Collection time from the first update, 0 = next poll */
+
+  /* State */
+  uint8_t  open;              /* Window running */
+  uint32_t open_ms;           /* Window opened at */
+  uint16_t pending;           /* Updates in the open window */
+  int16_t  value[2];          /* Latest value per axis (CTRL_MERGE_*) */
+
+  /* Statistics */
+  uint32_t updates;           /* Axis updates received */
+  uint32_t frames;            /* Combined frames emitted */
+  uint32_t dropped;           /* Updates discarded with ctrl_merge_drop */
+  uint32_t minute_ms;         /* Start of the current minute */
+  uint32_t minute_saved;      /* Frames saved in the current minute */
+  uint32_t saved_last_minute; /* Frames saved in the last complete minute */
+} CtrlMerge_t;
+
+#define CTRL_MERGE_DEFAULT { .window_ms = CTRL_MERGE_WINDOW_MS }
+
+/**
+  * @brief Take an update of one axis
+  * @param m: Coalescer
+  * @param axis: CTRL_MERGE_THRUST or CTRL_MERGE_RUDDER
+  * @param value: New value
+  * @param now_ms: Current time in milliseconds
+  */
+void ctrl_merge_update(CtrlMerge_t* m, uint8_t axis, int16_t value, uint32_t now_ms);
+
+/**
+  * @brief Close the window once it has run its time
+  * @param m: Coalescer
+  * @param now_ms: Current time in milliseconds
+  * @param out: Both axes to send, filled when the result is 1
+  * @retval 1 if a combined frame is due
+  */
+uint8_t ctrl_merge_poll(CtrlMerge_t* m, uint32_t now_ms, int16_t out[2]);
+
+/**
+  * @brief Discard the open window without emitting it
+  * @param m: Coalescer
+  */
+void ctrl_merge_drop(CtrlMerge_t* m);
+
+/**
+  * @brief Frames saved by coalescing since start
+  */
+static inline uint32_t ctrl_merge_saved(const CtrlMerge_t* m) {
+  return m->updates - m->pending - m->dropped - m->frames;
+}
+
+#endif /* __CTRL_MERGE_H */
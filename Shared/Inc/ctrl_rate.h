@@ -0,0 +1,63 @@
+/* ctrl_rate.h - Change-driven adaptive send rate for control frames */
+#ifndef __CTRL_RATE_H
+#define __CTRL_RATE_H
+
+#include <stdint.h>
+
+/**
+  * @brief Reason a control frame was sent
+  */
+typedef enum {
+  CTRL_RATE_NONE = 0,         /* Do not send */
+  CTRL_RATE_CHANGE,           /* Stick moved past the threshold */
+  CTRL_RATE_ACTIVE,           /* Stick moving: fast refresh */
+  CTRL_RATE_HEARTBEAT         /* Idle keepalive */
+} CtrlRateReason_t;
+
+/**
+  * @brief Adaptive sender state
+  * Values are compared in the units the caller passes (FRAME_CTRL units
+  * on the controller). Hardware independent: time is passed in.
+  */
+typedef struct {
+  /* Configuration */
+  uint16_t threshold;         /* Change from last sent value that sends at once */
+  uint16_t min_gap_ms;        /* Minimum spacing of change-triggered sends */
+  uint16_t active_ms;         /* Refresh interval while the stick is moving */
+  uint16_t hold_ms;           /* Time after the last motion that counts as moving */
+  uint16_t heartbeat_ms;      /* Refresh interval while idle */
+
+  /* State */
+  uint8_t  primed;            /* 0 until the first send */
+  int16_t  sent[2];           /* Last sent values */
+  int16_t  prev[2];           /* Previous sample (motion detection) */
+  uint32_t last_send_ms;
+  uint32_t last_motion_ms;
+
+  /* Statistics */
+  uint32_t sends[4];          /* Sends per CtrlRateReason_t */
+} CtrlRate_t;
+
+/* Defaults: ~2% threshold, 20 Hz while moving, 1 Hz heartbeat when idle */
+#define CTRL_RATE_THRESHOLD     40
+#define CTRL_RATE_MIN_GAP_MS    50
+#define CTRL_RATE_ACTIVE_MS     100
+#define CTRL_RATE_HOLD_MS       500
+#define CTRL_RATE_HEARTBEAT_MS  1000
+
+#define CTRL_RATE_DEFAULT { .threshold = CTRL_RATE_THRESHOLD, .min_gap_ms = CTRL_RATE_MIN_GAP_MS, \
+                            .active_ms = CTRL_RATE_ACTIVE_MS, .hold_ms = CTRL_RATE_HOLD_MS, \
+                            .heartbeat_ms = CTRL_RATE_HEARTBEAT_MS }
+
+/**
+  * @brief Decide whether to send a new sample
+  * Records the sample as sent when the result is not CTRL_RATE_NONE.
+  * @param r: Sender state
+  * @param a: First control value (thrust)
+  * @param b: Second control value (rudder)
+  * @param now_ms: Current time in milliseconds
+  * @retval Reason to send, CTRL_RATE_NONE to skip this sample
+  */
+CtrlRateReason_t ctrl_rate_update(CtrlRate_t* r, int16_t a, int16_t b, uint32_t now_ms);
+
+#endif /* __CTRL_RATE_H */
@@ -0,0 +1,176 @@
+/* frame.h - Compact binary control/telemetry frames for the LoRa link */
+#ifndef __FRAME_H
+#define __FRAME_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Frame layout before escaping:
+ *
+ *   [0]    1vvv tttt   bit 7 set (never set in the text protocol),
+ *                      v = FRAME_VERSION, t = FrameType_t
+ *   [1]    sequence number (wraps at 255)
+ *   [2..]  type-specific payload, big endian (CMD, GCMD: variable length)
+ *   [n-2]  CRC-16/CCITT-FALSE over bytes 0..n-3, big endian
+ *
+ * The radio is driven through a line-based AT interface, so the frame is
+ * escaped to never contain NUL, CR or LF: those bytes and FRAME_ESC are
+ * sent as FRAME_ESC followed by the byte XOR 0x20.
+ */
+
+#define FRAME_VERSION     1
+#define FRAME_ESC         0x7D
+
+/* Largest escaped frame including terminator */
+#define FRAME_MAX_ENCODED 96
+
+/* Longest CMD text */
+#define FRAME_CMD_TEXT_MAX 40
+
+/* Full-scale value of the signed 12-bit control fields */
+#define FRAME_CTRL_MAX    2047
+
+/**
+  * @brief Message types
+  */
+typedef enum {
+  FRAME_CTRL = 1,             /* Controller -> boat: thrust and rudder */
+  FRAME_GPS  = 2,             /* Position report (either direction) */
+  FRAME_CMD  = 3,             /* Controller -> boat: acknowledged command */
+  FRAME_ACK  = 4,             /* Boat -> controller: commands received */
+  FRAME_LINK = 5,             /* Boat -> controller: link-loss failsafe report */
+  FRAME_SYNC = 6,             /* Controller -> all boats: TDMA schedule and timing (tdma.h) */
+  FRAME_GCMD = 7,             /* Controller -> group of boats: acknowledged command, broadcast */
+  FRAME_RATE = 8              /* Controller -> all boats: commit a prepared data rate change (lora_adr.h) */
+} FrameType_t;
+
+/**
+  * @brief CTRL payload (3 bytes on air: two packed signed 12-bit values)
+  */
+typedef struct {
+  int16_t thrust;             /* -FRAME_CTRL_MAX (full reverse) .. +FRAME_CTRL_MAX */
+  int16_t rudder;             /* -FRAME_CTRL_MAX (full left) .. +FRAME_CTRL_MAX */
+} FrameCtrl_t;
+
+/**
+  * @brief GPS payload (8 bytes on air)
+  */
+typedef struct {
+  int32_t lat_e7;             /* Latitude, degrees * 1e7 */
+  int32_t lon_e7;             /* Longitude, degrees * 1e7 */
+} FrameGps_t;
+
+/**
+  * @brief CMD payload (2..FRAME_CMD_TEXT_MAX+1 bytes on air), also GCMD
+  * (3..FRAME_CMD_TEXT_MAX+2 bytes, the group byte after the session)
+  * The frame sequence number is the command sequence number, kept across
+  * retransmissions (cmd_arq.h)
+  */
+typedef struct {
+  uint8_t session;            /* Sender session, changes on every boot */
+  uint8_t group;              /* GCMD: boats addressed, bit i = uplink slot i (tdma.h) */
+  uint8_t len;                /* Text length, 1..FRAME_CMD_TEXT_MAX */
+  char    text[FRAME_CMD_TEXT_MAX + 1];   /* Null-terminated command text */
+} FrameCmd_t;
+
+/**
+  * @brief ACK payload (6 bytes on air)
+  */
+typedef struct {
+  uint8_t  session;           /* Session of the acknowledged commands */
+  uint8_t  top;               /* Highest command sequence number received */
+  uint32_t bitmap;            /* Bit i set: command top - i received */
+} FrameAck_t;
+
+/**
+  * @brief LINK payload (4 bytes on air)
+  * Sent by the boat when its failsafe trips and again when CTRL frames
+  * resume
+  */
+typedef struct {
+  uint8_t  failsafe;          /* 1: outputs ramping to safe values, 0: pilot in control */
+  uint8_t  events;            /* Failsafe trips since boot (wraps) */
+  uint16_t gap_ms;            /* Time without CTRL frames (saturates) */
+} FrameLink_t;
+
+/**
+  * @brief SYNC payload (9 bytes on air)
+  * Broadcast in a downlink window; the boats time their uplink slots from
+  * its reception (tdma.h)
+  */
+typedef struct {
+  uint16_t base;              /* Address of the boat in uplink slot 0 */
+  uint8_t  boats;             /* Uplink slots per superframe */
+  uint8_t  frame;             /* Frame of the superframe it was sent in */
+  uint8_t  offset_ms;         /* From the start of that frame to the send (saturates) */
+  uint16_t down_ms;           /* Downlink window per frame */
+  uint16_t up_ms;             /* Uplink slot per frame */
+} FrameSync_t;
+
+/**
+  * @brief RATE payload (3 bytes on air)
+  * Broadcast in the downlink windows before a data rate change; the boats
+  * that prepared the rate switch to it at the start of frame `frames`
+  * after the one it was received in (lora_adr.h)
+  */
+typedef struct {
+  uint8_t sf;                 /* Spreading factor */
+  uint8_t bw;                 /* Bandwidth code */
+  uint8_t frames;             /* Frames to the switch, 1.. */
+} FrameRate_t;
+
+/**
+  * @brief Decoded frame
+  */
+typedef struct {
+  uint8_t type;               /* FrameType_t */
+  uint8_t seq;                /* Sequence number */
+  union {
+    FrameCtrl_t ctrl;
+    FrameGps_t  gps;
+    FrameCmd_t  cmd;
+    FrameAck_t  ack;
+    FrameLink_t link;
+    FrameSync_t sync;
+    FrameRate_t rate;
+  } u;
+} Frame_t;
+
+/**
+  * @brief Check whether a received payload is a binary frame
+  * @param data: Payload bytes
+  * @param len: Payload length
+  * @retval 1 if the payload starts with a frame header
+  */
+static inline uint8_t frame_is_binary(const char* data, size_t len) {
+  return len > 0 && ((uint8_t)data[0] & 0x80);
+}
+
+/**
+  * @brief Encode and escape a frame
+  * @param f: Frame to encode
+  * @param out: Output buffer, null-terminated on success (text safe)
+  * @param size: Size of output buffer
+  * @retval Number of bytes written excluding terminator, 0 on error
+  */
+size_t frame_encode(const Frame_t* f, char* out, size_t size);
+
+/**
+  * @brief Unescape, verify and decode a frame
+  * @param in: Escaped frame bytes
+  * @param len: Number of bytes
+  * @param f: Decoded frame
+  * @retval 1 if valid, 0 on bad version, type, length or CRC
+  */
+uint8_t frame_decode(const char* in, size_t len, Frame_t* f);
+
+/**
+  * @brief CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF)
+  * @param data: Bytes to checksum
+  * @param len: Number of bytes
+  * @retval CRC value
+  */
+uint16_t frame_crc16(const uint8_t* data, size_t len);
+
+#endif /* __FRAME_H */
@@ -0,0 +1,84 @@
+/* lat_trace.h - Stick-to-servo latency trace records (LAT_TRACE builds only) */
+#ifndef __LAT_TRACE_H
+#define __LAT_TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Each board timestamps the stages a CTRL frame passes through and tags
+ * them with the frame sequence number. Records are queued from thread or
+ * interrupt context and drained by the main loop as text lines:
+ *
+ *   LT,<stage>,<seq>,<t_us>
+ *
+ * t_us is the board's own microsecond clock. The host tool
+ * Sim/tools/lat_merge.c matches the controller and boat logs by sequence
+ * number and reports per-stage percentiles.
+ *
+ * Instrumentation is compiled in only when LAT_TRACE is defined; otherwise
+ * the functions below are empty and the call sites cost nothing.
+ */
+
+/**
+  * @brief Trace points, in the order a CTRL frame passes them
+  */
+typedef enum {
+  LAT_ADC = 0,                /* Controller: ADC scan the frame was built from */
+  LAT_BUILD,                  /* Controller: frame encoded and queued */
+  LAT_TX_START,               /* Controller: UART DMA batch carrying AT+SEND started */
+  LAT_TX_END,                 /* Controller: that batch left the UART */
+  LAT_RX,                     /* Boat: +RCV line complete (RX ISR) */
+  LAT_PARSE,                  /* Boat: frame decoded in the main loop */
+  LAT_PWM,                    /* Boat: servo compare registers written */
+  LAT_STAGES
+} LatStage_t;
+
+/* Stage names used in the trace lines, indexed by LatStage_t */
+#define LAT_STAGE_NAMES { "ADC", "BUILD", "TXS", "TXE", "RX", "PARSE", "PWM" }
+
+/* Queued records; older records are kept and new ones dropped when full */
+#define LAT_TRACE_DEPTH 32
+
+#ifdef LAT_TRACE
+
+/**
+  * @brief Microsecond timestamp, safe from interrupt context
+  * Corrects for a SysTick wrap whose interrupt is still pending
+  * @retval Microseconds since boot (wraps every ~71 minutes)
+  */
+uint32_t lat_trace_now_us(void);
+
+/**
+  * @brief Queue a trace record (thread or interrupt context)
+  * @param stage: Trace point
+  * @param seq: Frame sequence number
+  * @param t_us: Timestamp from lat_trace_now_us()
+  */
+void lat_trace_record(LatStage_t stage, uint8_t seq, uint32_t t_us);
+
+/**
+  * @brief Take the oldest record and format it as a trace line
+  * @param line: Output buffer, null-terminated, without line ending
+  * @param size: Size of output buffer (24 bytes is always enough)
+  * @retval 1 if a line was produced, 0 if the queue is empty
+  */
+uint8_t lat_trace_next(char* line, size_t size);
+
+/**
+  * @brief Records dropped because the queue was full
+  */
+uint32_t lat_trace_dropped(void);
+
+#else
+
+static inline uint32_t lat_trace_now_us(void) { return 0; }
+static inline void lat_trace_record(LatStage_t stage, uint8_t seq, uint32_t t_us) {
+  (void)stage; (void)seq; (void)t_us;
+}
+static inline uint8_t lat_trace_next(char* line, size_t size) { (void)line; (void)size; return 0; }
+static inline uint32_t lat_trace_dropped(void) { return 0; }
+
+#endif /* LAT_TRACE */
+
+#endif /* __LAT_TRACE_H */
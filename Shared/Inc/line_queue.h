@@ -0,0 +1,59 @@
+/* line_queue.h - Lock-free single-producer/single-consumer queue of text lines */
+#ifndef __LINE_QUEUE_H
+#define __LINE_QUEUE_H
+
+#include "main.h"
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+  * @brief Fixed-slot line queue
+  * The producer (an ISR) only writes head, the consumer (main loop) only
+  * writes tail, so no locking is needed on a single core. Slot count must
+  * be a power of two no larger than 128.
+  */
+typedef struct {
+  char*    slots;               /* count * slot_size bytes of storage */
+  uint16_t slot_size;           /* Bytes per slot including terminator */
+  uint8_t  count;               /* Number of slots (power of two) */
+  volatile uint8_t head;        /* Free-running write counter (producer) */
+  volatile uint8_t tail;        /* Free-running read counter (consumer) */
+
+  /* Statistics */
+  uint32_t pushed;              /* Lines queued */
+  uint32_t dropped;             /* Lines dropped because the queue was full */
+  uint8_t  high_water;          /* Peak number of queued lines */
+} LineQueue_t;
+
+/**
+  * @brief Static initializer
+  * @param storage: Two-dimensional char array [count][slot_size]
+  */
+#define LINE_QUEUE_INIT(storage) { \
+  .slots = &(storage)[0][0], .slot_size = sizeof((storage)[0]), \
+  .count = sizeof(storage) / sizeof((storage)[0]) }
+
+/**
+  * @brief Copy a line into the next free slot (producer side)
+  * Lines longer than a slot are truncated
+  * @param q: Queue
+  * @param line: Null-terminated line
+  * @retval 1 if queued, 0 if the queue was full and the line was dropped
+  */
+uint8_t line_queue_push(LineQueue_t* q, const char* line);
+
+/**
+  * @brief Oldest queued line (consumer side)
+  * The slot stays owned by the consumer until line_queue_pop()
+  * @param q: Queue
+  * @retval Pointer to the line, or NULL if the queue is empty
+  */
+char* line_queue_front(LineQueue_t* q);
+
+/**
+  * @brief Release the slot returned by line_queue_front() (consumer side)
+  * @param q: Queue
+  */
+void line_queue_pop(LineQueue_t* q);
+
+#endif /* __LINE_QUEUE_H */
@@ -0,0 +1,136 @@
+/* lora_adr.h - Adaptive LoRa data rate: link margin per boat and rate choice */
+#ifndef __LORA_ADR_H
+#define __LORA_ADR_H
+
+#include <stdint.h>
+
+/*
+ * The controller picks the fastest modulation every active boat can still
+ * be received at with LORA_ADR_MARGIN_DB to spare. The margin of a rate is
+ * the smaller of
+ *
+ *   SNR margin   worst SNR heard, corrected for the noise bandwidth of the
+ *                rate, less the demodulation floor of its spreading factor
+ *   RSSI margin  worst RSSI heard less the sensitivity of the rate
+ *
+ * taken over the last LORA_ADR_SAMPLES packets from each boat. The rate
+ * goes one step faster when the faster rate keeps the margin, and falls to
+ * the fastest rate that keeps it as soon as the current one is
+ * LORA_ADR_HYST_DB short.
+ *
+ * All boats share the channel, so the whole fleet changes rate together in
+ * two phases: every active boat acknowledges a RATE,<sf>,<bw> command
+ * (cmd_arq.h), then RATE frames (FrameRate_t) in the next downlink windows
+ * count down to the frame at which the controller and the boats switch.
+ * A boat only switches to the rate it prepared.
+ *
+ * Either end that hears nothing from the other for LORA_ADR_LOST_FRAMES
+ * frames falls back to its home rate (the LORA_SF and LORA_BW settings),
+ * where both ends meet again; the controller then waits LORA_ADR_HOLD
+ * decisions before speeding up.
+ *
+ * Hardware independent: signal reports are passed in.
+ */
+
+#define LORA_ADR_RATES         8      /* Entries of lora_adr_rates */
+#define LORA_ADR_PEERS         8      /* Boats tracked (TDMA_BOATS_MAX) */
+#define LORA_ADR_MARGIN_DB     10     /* Margin kept at the chosen rate */
+#define LORA_ADR_HYST_DB       3      /* Margin lost before slowing down */
+#define LORA_ADR_SAMPLES       4      /* Packets from each boat per decision */
+#define LORA_ADR_HOLD          8      /* Decisions without speeding up after a fallback */
+#define LORA_ADR_COMMIT_FRAMES 3      /* Frames from the first RATE frame to the switch */
+#define LORA_ADR_LOST_FRAMES   24     /* Frames without hearing the other end before falling back */
+
+/**
+  * @brief One modulation step (AT+PARAMETER=<sf>,<bw code>,...)
+  */
+typedef struct {
+  uint8_t sf;                 /* Spreading factor */
+  uint8_t bw;                 /* Bandwidth code (7 = 125 kHz, 8 = 250 kHz, 9 = 500 kHz) */
+} LoRaRate_t;
+
+/* Rates from the most robust (index 0) to the fastest */
+extern const LoRaRate_t lora_adr_rates[LORA_ADR_RATES];
+
+/**
+  * @brief Signal reports of one boat since the last decision
+  */
+typedef struct {
+  int16_t snr_min;            /* Worst SNR, dB */
+  int16_t rssi_min;           /* Worst RSSI, dBm */
+  uint8_t samples;            /* Packets */
+} LoRaAdrPeer_t;
+
+/**
+  * @brief Rate controller state
+  */
+typedef struct {
+  uint8_t  rate;              /* Index of the rate in use */
+  uint8_t  home;              /* Index of the configured rate */
+  uint8_t  hold;              /* Decisions left before speeding up again */
+  int16_t  margin_db10;       /* Worst margin at the last decision, 0.1 dB */
+  LoRaAdrPeer_t peer[LORA_ADR_PEERS];
+
+  /* Statistics */
+  uint32_t faster;            /* Switches to a faster rate */
+  uint32_t slower;            /* Switches to a slower rate */
+  uint32_t fallbacks;         /* Returns to the home rate on link loss */
+  uint32_t aborted;           /* Switches not acknowledged by every boat */
+} LoRaAdr_t;
+
+/**
+  * @brief Find a rate
+  * @param sf: Spreading factor
+  * @param bw: Bandwidth code
+  * @retval Index into lora_adr_rates, -1 if the modulation is not a step
+  */
+int8_t lora_adr_find(uint8_t sf, uint8_t bw);
+
+/**
+  * @brief Start at the home rate
+  * @param a: Rate controller
+  * @param home: Index of the configured rate
+  */
+void lora_adr_init(LoRaAdr_t* a, uint8_t home);
+
+/**
+  * @brief Record the signal report of a packet
+  * @param a: Rate controller
+  * @param peer: Boat, 0..LORA_ADR_PEERS-1
+  * @param rssi: RSSI, dBm
+  * @param snr: SNR, dB
+  */
+void lora_adr_on_packet(LoRaAdr_t* a, uint8_t peer, int16_t rssi, int16_t snr);
+
+/**
+  * @brief Margin a boat would have at a rate, from its reports at the current one
+  * @param a: Rate controller
+  * @param peer: Boat with at least one report
+  * @param rate: Index of the rate
+  * @retval Margin in 0.1 dB
+  */
+int16_t lora_adr_margin(const LoRaAdr_t* a, uint8_t peer, uint8_t rate);
+
+/**
+  * @brief Choose the next rate once every active boat has reported enough
+  * Starts new report windows when it decides.
+  * @param a: Rate controller
+  * @param peers: Active boats, bit i = peer i
+  * @retval Index of the rate to switch to, -1 to stay
+  */
+int8_t lora_adr_decide(LoRaAdr_t* a, uint8_t peers);
+
+/**
+  * @brief Note a completed switch and start new report windows
+  * @param a: Rate controller
+  * @param rate: Index of the rate now in use
+  */
+void lora_adr_switched(LoRaAdr_t* a, uint8_t rate);
+
+/**
+  * @brief Note a return to the home rate on link loss
+  * @param a: Rate controller
+  */
+void lora_adr_fallback(LoRaAdr_t* a);
+
+#endif /* __LORA_ADR_H */
@@ -0,0 +1,35 @@
+/* lora_airtime.h - LoRa time-on-air calculator (Semtech AN1200.13 formula) */
+#ifndef __LORA_AIRTIME_H
+#define __LORA_AIRTIME_H
+
+#include <stdint.h>
+
+/**
+  * @brief Radio modulation parameters (AT+PARAMETER=<sf>,<bw>,<cr>,<preamble>)
+  */
+typedef struct {
+  uint8_t  sf;                /* Spreading factor 7..12 */
+  uint32_t bw_hz;             /* Bandwidth in Hz */
+  uint8_t  cr;                /* Coding rate 1..4 (4/5 .. 4/8) */
+  uint16_t preamble;          /* Programmed preamble length in symbols */
+} LoRaPhy_t;
+
+/* AT+PARAMETER=9,7,1,12: SF9, 125 kHz, 4/5, 12 symbol preamble */
+#define LORA_PHY_DEFAULT { 9, 125000, 1, 12 }
+
+/**
+  * @brief Bandwidth in Hz for an AT+PARAMETER bandwidth code
+  * @param code: 0 (7.8 kHz) .. 9 (500 kHz)
+  * @retval Bandwidth in Hz, 0 for an invalid code
+  */
+uint32_t lora_bw_hz(uint32_t code);
+
+/**
+  * @brief Time on air for one packet (explicit header, payload CRC on)
+  * @param phy: Modulation parameters
+  * @param payload_len: Payload length in bytes
+  * @retval Time on air in microseconds
+  */
+uint32_t lora_airtime_us(const LoRaPhy_t* phy, uint16_t payload_len);
+
+#endif /* __LORA_AIRTIME_H */
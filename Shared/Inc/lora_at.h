@@ -0,0 +1,159 @@
+/* lora_at.h - REYAX RYLR LoRa module AT interface: command engine and +RCV parser */
+#ifndef __LORA_AT_H
+#define __LORA_AT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Reply timeout per command and retries before the script fails */
+#define LORA_AT_TIMEOUT_MS  300
+#define LORA_AT_RETRIES     3
+
+/* Commands sent ahead of their replies */
+#define LORA_AT_WINDOW      2
+
+/**
+  * @brief Writes one command line to the module (must not block for long)
+  */
+typedef void (*LoRaAtSendFn)(const char* cmd);
+
+/**
+  * @brief Command engine state
+  */
+typedef enum {
+  LORA_AT_IDLE = 0,           /* No script run yet */
+  LORA_AT_BUSY,               /* Script in progress */
+  LORA_AT_DONE,               /* Every command acknowledged */
+  LORA_AT_FAILED              /* A command exhausted its retries */
+} LoRaAtState_t;
+
+/**
+  * @brief Non-blocking AT command engine
+  * Runs a script of commands, keeping up to LORA_AT_WINDOW in flight. The
+  * module answers strictly in order with +OK or +ERR=<n>, so each reply
+  * completes the oldest outstanding command. On error or timeout the
+  * failed command and those after it are sent again, but only once the
+  * replies still due for the commands after it have come in (or another
+  * timeout has passed), so no late reply is matched to a re-sent command.
+  * Hardware independent: time is passed in and output goes through the
+  * send callback.
+  */
+typedef struct {
+  LoRaAtSendFn send;          /* Line output */
+  const char* const* script;  /* Commands of the running script */
+  uint8_t  count;             /* Number of commands */
+  volatile uint8_t state;     /* LoRaAtState_t */
+  uint8_t  acked;             /* Commands acknowledged */
+  uint8_t  sent;              /* Commands sent */
+  uint8_t  tries;             /* Failed attempts of the oldest outstanding command */
+  uint8_t  drain;             /* Replies still due for commands to be re-sent */
+  uint32_t deadline_ms;       /* Reply deadline of the oldest outstanding command */
+  uint32_t start_ms;          /* Script start */
+  uint32_t done_ms;           /* Script completion (ready) */
+
+  /* Statistics */
+  uint32_t oks;               /* +OK replies (including AT+SEND when idle) */
+  uint32_t errors;            /* +ERR replies */
+  uint32_t timeouts;          /* Commands that timed out */
+  uint32_t retries;           /* Commands re-sent */
+  uint32_t drained;           /* Late replies of re-sent commands discarded */
+} LoRaAt_t;
+
+/**
+  * @brief Start a command script
+  * @param at: Engine state (send must be set)
+  * @param script: Commands without line ending (must stay valid)
+  * @param count: Number of commands
+  * @param now_ms: Current time in milliseconds
+  */
+void lora_at_run(LoRaAt_t* at, const char* const* script, uint8_t count, uint32_t now_ms);
+
+/**
+  * @brief Handle reply timeouts; call periodically
+  * @param at: Engine state
+  * @param now_ms: Current time in milliseconds
+  */
+void lora_at_poll(LoRaAt_t* at, uint32_t now_ms);
+
+/**
+  * @brief Offer a received line to the engine
+  * @param at: Engine state
+  * @param line: Line from the module without CR/LF
+  * @param now_ms: Current time in milliseconds
+  * @retval 1 if the line was a command reply and has been consumed
+  */
+uint8_t lora_at_on_line(LoRaAt_t* at, const char* line, uint32_t now_ms);
+
+/**
+  * @brief Check whether the last script completed
+  * @param at: Engine state
+  * @retval 1 once every command was acknowledged
+  */
+static inline uint8_t lora_at_ready(const LoRaAt_t* at) {
+  return at->state == LORA_AT_DONE;
+}
+
+/**
+  * @brief Module settings programmed at boot
+  */
+typedef struct {
+  uint16_t address;           /* AT+ADDRESS */
+  uint8_t  network;           /* AT+NETWORKID */
+  uint32_t band_hz;           /* AT+BAND */
+  uint8_t  sf;                /* AT+PARAMETER=<sf>,<bw code>,<cr>,<preamble> */
+  uint8_t  bw;
+  uint8_t  cr;
+  uint16_t preamble;
+} LoRaAtConfig_t;
+
+#define LORA_AT_CONFIG_LINES  4
+#define LORA_AT_CONFIG_LEN    32
+
+/**
+  * @brief Configuration script built from settings
+  */
+typedef struct {
+  char line[LORA_AT_CONFIG_LINES][LORA_AT_CONFIG_LEN];
+  const char* script[LORA_AT_CONFIG_LINES];   /* For lora_at_run */
+} LoRaAtScript_t;
+
+/**
+  * @brief Build the configuration script for a set of module settings
+  * @param s: Script storage (must stay valid while the script runs)
+  * @param cfg: Module settings
+  * @retval Number of commands
+  */
+uint8_t lora_at_config_script(LoRaAtScript_t* s, const LoRaAtConfig_t* cfg);
+
+/**
+  * @brief Build a script that only reprograms the modulation (AT+PARAMETER),
+  * for a data rate change at run time
+  * @param s: Script storage (must stay valid while the script runs)
+  * @param cfg: Module settings (sf, bw, cr and preamble used)
+  * @retval Number of commands
+  */
+uint8_t lora_at_phy_script(LoRaAtScript_t* s, const LoRaAtConfig_t* cfg);
+
+/**
+  * @brief Received packet, parsed from "+RCV=<addr>,<len>,<data>,<rssi>,<snr>"
+  */
+typedef struct {
+  uint16_t addr;              /* Sender address */
+  uint16_t len;               /* Payload length in bytes */
+  char*    data;              /* Payload (points into the parsed line) */
+  int16_t  rssi;              /* Received signal strength, dBm */
+  int16_t  snr;               /* Signal to noise ratio, dB */
+} LoRaRcv_t;
+
+/**
+  * @brief Parse a +RCV line
+  * The payload is located by its length field rather than by commas, so it
+  * may contain commas or binary frame bytes. The payload is null-terminated
+  * in place.
+  * @param line: Received line without CR/LF (modified)
+  * @param rcv: Parsed packet
+  * @retval 1 if the line is a well-formed +RCV, 0 otherwise
+  */
+uint8_t lora_at_parse_rcv(char* line, LoRaRcv_t* rcv);
+
+#endif /* __LORA_AT_H */
@@ -0,0 +1,111 @@
+/* nmea.h - Incremental, allocation-free NMEA 0183 parser with fixed-point output */
+#ifndef __NMEA_H
+#define __NMEA_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+  * @brief Sentence types recognised by the parser
+  * Any talker ID is accepted (GP, GN, GL, GA, ...)
+  */
+typedef enum {
+  NMEA_NONE = 0,
+  NMEA_RMC,
+  NMEA_GGA,
+  NMEA_VTG,
+  NMEA_GSA,
+  NMEA_GSV
+} NmeaType_t;
+
+/**
+  * @brief Navigation data accumulated from all sentence types
+  * Every field is fixed point; no floating point is used by the parser.
+  */
+typedef struct {
+  int32_t  lat_e7;            /* Latitude, degrees * 1e7 (south negative) */
+  int32_t  lon_e7;            /* Longitude, degrees * 1e7 (west negative) */
+  uint8_t  fix_valid;         /* RMC status: 1 = active (A), 0 = void (V) */
+  uint32_t time_ms;           /* UTC time of day in milliseconds */
+  uint32_t date;              /* UTC date as ddmmyy */
+  uint32_t speed_mknots;      /* Speed over ground, knots * 1000 */
+  uint32_t speed_mkmh;        /* Speed over ground, km/h * 1000 (VTG) */
+  uint16_t course_cdeg;       /* Course over ground, degrees * 100 */
+  uint8_t  fix_quality;       /* GGA fix quality (0 = none, 1 = GPS, 2 = DGPS...) */
+  uint8_t  num_sats;          /* GGA satellites used */
+  int32_t  alt_cm;            /* GGA altitude above MSL, centimetres */
+  uint8_t  fix_mode;          /* GSA mode: 1 = none, 2 = 2D, 3 = 3D */
+  uint16_t pdop_x100;         /* GSA dilution of precision * 100 */
+  uint16_t hdop_x100;         /* GGA/GSA horizontal DOP * 100 */
+  uint16_t vdop_x100;         /* GSA vertical DOP * 100 */
+  uint8_t  sats_in_view;      /* GSV satellites in view */
+} NmeaData_t;
+
+/**
+  * @brief Parser state
+  * Fields are decoded as characters arrive; the checksum is accumulated
+  * on the fly and decoded values are only committed to data when it matches.
+  */
+typedef struct {
+  uint8_t    state;           /* Internal state machine position */
+  uint8_t    sum;             /* Running XOR of characters between $ and * */
+  uint8_t    sum_rx;          /* Checksum received after * */
+  uint8_t    len;             /* Characters in current sentence (overrun guard) */
+  uint8_t    field;           /* Current field index (0 = address) */
+  NmeaType_t type;            /* Sentence type decoded from the address */
+  char       addr[5];         /* Address field (talker + type) */
+  uint8_t    addr_len;
+
+  /* Current field accumulator */
+  uint8_t    f_len;           /* Characters in field */
+  uint8_t    f_neg;           /* Leading minus sign */
+  uint8_t    f_dot;           /* Decimal point seen */
+  uint8_t    f_frac_digits;   /* Fraction digits kept */
+  char       f_first;         /* First character (single-letter fields) */
+  uint32_t   f_int;           /* Integer part */
+  uint32_t   f_frac;          /* Fraction digits (up to NMEA_FRAC_MAX) */
+
+  NmeaData_t work;            /* Values decoded from the current sentence */
+  NmeaData_t data;            /* Last checksum-verified values */
+
+  /* Statistics */
+  uint32_t   sentences;       /* Sentences accepted */
+  uint32_t   checksum_errors; /* Sentences rejected for bad checksum */
+} NmeaParser_t;
+
+/* Fraction digits kept per field (enough for 1e-5 minute resolution) */
+#define NMEA_FRAC_MAX 5
+
+/**
+  * @brief Reset the parser and clear all decoded data
+  * @param p: Parser state
+  */
+void nmea_init(NmeaParser_t* p);
+
+/**
+  * @brief Feed one received character
+  * @param p: Parser state
+  * @param c: Character from the GPS UART
+  * @retval Type of the sentence completed by this character with a valid
+  *         checksum (p->data updated), NMEA_NONE otherwise
+  */
+NmeaType_t nmea_feed(NmeaParser_t* p, char c);
+
+/**
+  * @brief Format fixed-point degrees as decimal text (e.g. "-122.4194155")
+  * @param buf: Output buffer
+  * @param size: Size of output buffer
+  * @param deg_e7: Degrees * 1e7
+  * @retval Number of characters written as by snprintf
+  */
+int nmea_format_deg_e7(char* buf, size_t size, int32_t deg_e7);
+
+/**
+  * @brief Parse decimal degree text (e.g. "37.7749") into degrees * 1e7
+  * @param s: Text to parse
+  * @param end: If not NULL, receives pointer to first unparsed character
+  * @retval Degrees * 1e7
+  */
+int32_t nmea_parse_deg_e7(const char* s, const char** end);
+
+#endif /* __NMEA_H */
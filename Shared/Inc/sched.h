@@ -0,0 +1,84 @@
+/* sched.h - Tick-based cooperative scheduler with ISR event flags and run-time statistics */
+#ifndef __SCHED_H
+#define __SCHED_H
+
+#include "main.h"
+#include <stdint.h>
+
+/**
+  * @brief Task body; must return quickly and never block
+  */
+typedef void (*SchedFn)(void);
+
+/**
+  * @brief Task descriptor and statistics
+  * A task is released every period_ms, and whenever one of its event
+  * flags is signalled. Tasks run to completion in table order.
+  */
+typedef struct {
+  const char* name;           /* Short name reported by sched statistics */
+  SchedFn     fn;             /* Task body */
+  uint16_t    period_ms;      /* Release period, 0 = event driven only */
+  uint16_t    deadline_ms;    /* Max release-to-start delay, 0 = none */
+  uint32_t    budget_us;      /* Max execution time, 0 = none */
+  uint32_t    events;         /* Event flags that release the task */
+
+  /* Run-time state */
+  uint32_t    release_ms;     /* Tick of the pending periodic release */
+  uint32_t    signal_ms;      /* Tick of the oldest pending event release */
+  uint32_t    runs;           /* Completed runs */
+  uint32_t    total_us;       /* Sum of execution times (average = total/runs) */
+  uint32_t    max_us;         /* Longest execution time */
+  uint32_t    overruns;       /* Runs that exceeded budget_us */
+  uint32_t    misses;         /* Releases (periodic or event) started after deadline_ms */
+} SchedTask_t;
+
+/**
+  * @brief Static initializer for a task descriptor
+  */
+#define SCHED_TASK(nm, f, period, deadline, budget, ev) { \
+  .name = (nm), .fn = (f), .period_ms = (period), .deadline_ms = (deadline), \
+  .budget_us = (budget), .events = (ev) }
+
+/**
+  * @brief Register the task table and reset statistics
+  * @param tasks: Task table, highest priority first
+  * @param count: Number of tasks
+  */
+void sched_init(SchedTask_t* tasks, uint8_t count);
+
+/**
+  * @brief Signal event flags (safe from ISRs)
+  * @param events: Flags to set
+  */
+void sched_signal(uint32_t events);
+
+/**
+  * @brief Run all released tasks once, then sleep until the next interrupt
+  * Call repeatedly from the main loop
+  */
+void sched_run(void);
+
+/**
+  * @brief Clear all run-time statistics
+  */
+void sched_reset_stats(void);
+
+/**
+  * @brief Number of registered tasks
+  */
+uint8_t sched_task_count(void);
+
+/**
+  * @brief Task descriptor by index (statistics are read only)
+  * @param i: Task index (0..sched_task_count()-1)
+  */
+const SchedTask_t* sched_task(uint8_t i);
+
+/**
+  * @brief Microsecond timestamp from HAL tick and SysTick counter
+  * Thread context only; wraps every ~71 minutes
+  */
+uint32_t sched_now_us(void);
+
+#endif /* __SCHED_H */
@@ -0,0 +1,167 @@
+/* tdma.h - Time-slotted LoRa schedule shared by the controller and its boats */
+#ifndef __TDMA_H
+#define __TDMA_H
+
+#include "frame.h"
+#include "lora_airtime.h"
+#include <stdint.h>
+
+/*
+ * One channel carries the controller's downlinks and the uplinks of up to
+ * TDMA_BOATS_MAX boats. Time is divided into frames, each a downlink
+ * window followed by one uplink slot. The slots go to the boats in turn,
+ * so a superframe of `boats` frames gives every boat one slot:
+ *
+ *   | down | up 0 | down | up 1 | ... | down | up n-1 |   (repeats)
+ *
+ * Each window is the time on air of the longest frame sent in it
+ * (TDMA_DOWN_BYTES, TDMA_UP_BYTES at the programmed modulation) plus the
+ * link delay and TDMA_GUARD_MS. A frame may only start when it ends at
+ * least TDMA_GUARD_MS before its window closes and the sender's previous
+ * frame is off the air, so downlinks and uplinks never overlap.
+ *
+ * The controller owns the clock. Every TDMA_SYNC_FRAMES frames it opens
+ * the downlink window with a broadcast SYNC frame (FrameSync_t) carrying
+ * the schedule and its position in it. A boat places that frame's start
+ * at the reception time less the SYNC time on air, the send offset and
+ * TDMA_LINK_DELAY_MS, then runs on its own tick. A boat that has heard no
+ * SYNC for TDMA_SYNC_LOST_FRAMES frames stops transmitting until the next
+ * one.
+ *
+ * Both ends run from RC oscillators that may differ by a few percent, so
+ * between SYNC frames the boat's slot drifts against the controller's
+ * windows. The boat measures the drift from one SYNC to the next and runs
+ * its frames that much faster or slower. Every other frame from the
+ * controller is heard inside its downlink window, ending TDMA_GUARD_MS
+ * before the window closes; a frame the boat's timing places outside those
+ * bounds moves the boat's frame start by the least amount that explains
+ * it, at most TDMA_ALIGN_MAX_MS.
+ *
+ * Hardware independent: time is passed in, in milliseconds.
+ */
+
+#define TDMA_BOATS_MAX         8
+#define TDMA_GUARD_MS          20     /* Timing error between controller and boats */
+#define TDMA_LINK_DELAY_MS     6      /* AT+SEND line to the module, +RCV line back */
+#define TDMA_DOWN_BYTES        52     /* Longest downlink: GCMD frame, FRAME_CMD_TEXT_MAX characters */
+#define TDMA_UP_BYTES          24     /* Longest uplink: GPS frame, every byte escaped */
+#define TDMA_SYNC_FRAMES       8      /* Frames between SYNC frames */
+#define TDMA_SYNC_LOST_FRAMES  32     /* Frames without SYNC before a boat falls silent */
+#define TDMA_ALIGN_MAX_MS      TDMA_GUARD_MS  /* Largest correction from one downlink */
+#define TDMA_DRIFT_MAX_PPM     50000  /* Largest clock drift followed, 5% */
+
+/**
+  * @brief Schedule and timing of one node
+  */
+typedef struct {
+  /* Schedule */
+  uint16_t base;              /* Address of the boat in uplink slot 0 */
+  uint8_t  boats;             /* Uplink slots per superframe, 1..TDMA_BOATS_MAX */
+  uint16_t down_ms;           /* Downlink window per frame */
+  uint16_t up_ms;             /* Uplink slot per frame */
+
+  /* Timing */
+  uint8_t  synced;            /* Frame timing known */
+  uint8_t  follower;          /* Timing taken from SYNC frames (boat) */
+  uint32_t start_ms;          /* Start of frame 0 of a superframe */
+  uint32_t sync_ms;           /* Last SYNC heard (boat) */
+  uint32_t busy_ms;           /* Own frame on air until */
+  int32_t  drift_ppm;         /* Own clock against the controller's (boat) */
+  int32_t  align_ms;          /* Downlink corrections since the last SYNC (boat) */
+
+  /* Statistics */
+  uint32_t sent;              /* Frames let through */
+  uint32_t syncs;             /* SYNC frames sent (controller) or adopted (boat) */
+  uint32_t sync_losses;       /* Timing dropped for lack of SYNC (boat) */
+  uint32_t aligns;            /* Corrections from downlinks (boat) */
+} Tdma_t;
+
+/**
+  * @brief Position in the schedule
+  */
+typedef struct {
+  uint32_t frame;             /* Frames since start_ms */
+  uint8_t  up;                /* 0: downlink window, 1: uplink slot */
+  uint8_t  slot;              /* Boat owning this frame's uplink slot */
+  uint32_t start_ms;          /* Window start */
+  uint32_t end_ms;            /* Window end */
+} TdmaWindow_t;
+
+/**
+  * @brief Size the windows for a modulation and a number of boats
+  * @param t: Schedule (timing left unchanged)
+  * @param phy: Programmed modulation
+  * @param base: Address of the boat in uplink slot 0
+  * @param boats: Uplink slots per superframe, clamped to 1..TDMA_BOATS_MAX
+  */
+void tdma_plan(Tdma_t* t, const LoRaPhy_t* phy, uint16_t base, uint8_t boats);
+
+/**
+  * @brief Start frame 0 now (controller)
+  */
+void tdma_start(Tdma_t* t, uint32_t now);
+
+/**
+  * @brief Frame length in ms
+  */
+static inline uint32_t tdma_frame_ms(const Tdma_t* t) {
+  return (uint32_t)t->down_ms + t->up_ms;
+}
+
+/**
+  * @brief Window at a given time
+  * @param t: Schedule
+  * @param now: Current tick in ms
+  * @param w: Window (filled when synchronised)
+  * @retval 1 if the timing is known
+  */
+uint8_t tdma_window(const Tdma_t* t, uint32_t now, TdmaWindow_t* w);
+
+/**
+  * @brief Check whether a frame fits an empty window at all
+  * @param t: Schedule
+  * @param up: 1 for the uplink slot, 0 for the downlink window
+  * @param air_us: Time on air of the frame
+  */
+uint8_t tdma_fits(const Tdma_t* t, uint8_t up, uint32_t air_us);
+
+/**
+  * @brief Claim the channel for one frame
+  * Succeeds in the sender's own window when the frame ends TDMA_GUARD_MS
+  * before the window closes and the previous frame is off the air; the
+  * frame must then be sent at once.
+  * @param t: Schedule
+  * @param up: 1 for a boat's uplink, 0 for a controller downlink
+  * @param slot: Sending boat's slot (uplink)
+  * @param air_us: Time on air of the frame
+  * @param now: Current tick in ms
+  * @retval 1 if the frame may be sent now
+  */
+uint8_t tdma_may_send(Tdma_t* t, uint8_t up, uint8_t slot, uint32_t air_us, uint32_t now);
+
+/**
+  * @brief Build the SYNC payload for a frame sent now (controller)
+  * @retval 1 if built, 0 if there is no valid window (not started or stale)
+  */
+uint8_t tdma_sync_build(const Tdma_t* t, uint32_t now, FrameSync_t* s);
+
+/**
+  * @brief Take the schedule and timing from a received SYNC (boat)
+  * @param t: Schedule
+  * @param s: Received SYNC payload
+  * @param air_us: Time on air of the SYNC frame
+  * @param rx_ms: Tick the +RCV line was complete
+  * @retval 1 if adopted, 0 if the payload is invalid
+  */
+uint8_t tdma_on_sync(Tdma_t* t, const FrameSync_t* s, uint32_t air_us, uint32_t rx_ms);
+
+/**
+  * @brief Keep the timing on a downlink other than SYNC (boat)
+  * @param t: Schedule
+  * @param air_us: Time on air of the received frame
+  * @param rx_ms: Tick the +RCV line was complete
+  * @retval Correction of the frame start in ms, 0 if the timing held
+  */
+int32_t tdma_on_downlink(Tdma_t* t, uint32_t air_us, uint32_t rx_ms);
+
+#endif /* __TDMA_H */
@@ -0,0 +1,91 @@
+/* uart_rx.h - DMA circular-buffer UART receive engine with idle-line framing */
+#ifndef __UART_RX_H
+#define __UART_RX_H
+
+#include "main.h"
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+  * @brief Line handler invoked for every complete line
+  * @param line: Null-terminated line without CR/LF (writable, valid until return)
+  */
+typedef void (*UartRxLineFn)(char* line);
+
+/**
+  * @brief Byte handler for raw (unframed) mode
+  * @param c: Received character
+  */
+typedef void (*UartRxByteFn)(char c);
+
+/**
+  * @brief Receive engine state for one UART
+  * The DMA writes into dma_buf in circular mode; HT/TC/IDLE events advance
+  * dma_tail and the new bytes are assembled into lines in software.
+  */
+typedef struct {
+  UART_HandleTypeDef* huart;    /* UART the engine is attached to */
+  uint8_t*  dma_buf;            /* DMA circular buffer */
+  uint16_t  dma_size;           /* Size of dma_buf in bytes */
+  uint16_t  dma_tail;           /* Next unread index in dma_buf (dma_size = wrap to 0) */
+  char*     line;               /* Line assembly buffer */
+  uint16_t  line_max;           /* Size of line buffer including terminator */
+  uint16_t  line_len;           /* Characters currently assembled */
+  uint8_t   discard;            /* 1 while dropping the rest of an overlong line */
+  char      start_char;         /* Lines must start with this char (0 = any) */
+  UartRxLineFn on_line;         /* Called for each complete line */
+  UartRxByteFn on_byte;         /* Raw mode: called for every byte instead */
+
+  /* Statistics */
+  uint32_t  bytes;              /* Total bytes received */
+  uint32_t  lines;              /* Complete lines delivered */
+  uint32_t  overflows;          /* Lines dropped for exceeding line_max */
+} UartRx_t;
+
+/**
+  * @brief Static initializer for a receive engine
+  * @param h: UART handle pointer (RX DMA must be linked in circular mode)
+  * @param dma: DMA circular buffer array
+  * @param ln: Line assembly buffer array
+  * @param start: Required first character of a line, 0 for any
+  * @param fn: Line handler
+  */
+#define UART_RX_INIT(h, dma, ln, start, fn) { \
+  .huart = (h), .dma_buf = (dma), .dma_size = sizeof(dma), \
+  .line = (ln), .line_max = sizeof(ln), .start_char = (start), .on_line = (fn) }
+
+/**
+  * @brief Static initializer for a raw-mode engine (no line assembly)
+  * Used for streaming parsers that consume one byte at a time
+  * @param h: UART handle pointer
+  * @param dma: DMA circular buffer array
+  * @param fn: Byte handler
+  */
+#define UART_RX_INIT_RAW(h, dma, fn) { \
+  .huart = (h), .dma_buf = (dma), .dma_size = sizeof(dma), .on_byte = (fn) }
+
+/**
+  * @brief Start (or restart after an error) circular DMA reception
+  * @param rx: Engine state
+  * @retval HAL status from HAL_UARTEx_ReceiveToIdle_DMA
+  */
+HAL_StatusTypeDef uart_rx_start(UartRx_t* rx);
+
+/**
+  * @brief Consume bytes written by DMA up to a new write position
+  * Call from HAL_UARTEx_RxEventCallback (half, full and idle events)
+  * @param rx: Engine state
+  * @param pos: DMA write position reported by HAL (0..dma_size)
+  */
+void uart_rx_on_event(UartRx_t* rx, uint16_t pos);
+
+/**
+  * @brief Feed raw bytes into the line assembler
+  * Independent of the UART/DMA hardware
+  * @param rx: Engine state
+  * @param data: Received bytes
+  * @param len: Number of bytes
+  */
+void uart_rx_feed(UartRx_t* rx, const uint8_t* data, size_t len);
+
+#endif /* __UART_RX_H */
@@ -0,0 +1,114 @@
+/* uart_tx.h - Non-blocking DMA UART transmit queue with back-pressure policy */
+#ifndef __UART_TX_H
+#define __UART_TX_H
+
+#include "main.h"
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+  * @brief Message class, selects the back-pressure policy
+  */
+typedef enum {
+  UART_TX_TELEMETRY = 0,      /* Drop oldest queued telemetry when full */
+  UART_TX_CONTROL   = 1       /* Never evicted; queued ahead of telemetry, dropped only if its ring is full */
+} UartTxClass_t;
+
+/**
+  * @brief Byte ring of length-prefixed messages (one per class)
+  */
+typedef struct {
+  uint8_t*  buf;              /* Storage */
+  uint16_t  size;             /* Size of buf in bytes */
+  uint16_t  head;             /* Write index */
+  uint16_t  tail;             /* Read index */
+  uint16_t  used;             /* Bytes in use including length prefixes */
+} UartTxRing_t;
+
+/**
+  * @brief Transmit queue state for one UART
+  * Messages are queued per class and copied into dma_buf in batches;
+  * the DMA completion callback starts the next batch. Control messages
+  * always go out before queued telemetry. Writers never wait: a control
+  * writer that must not lose a message checks uart_tx_room first.
+  */
+typedef struct {
+  UART_HandleTypeDef* huart;  /* UART the queue is attached to (TX DMA linked) */
+  uint8_t*  dma_buf;          /* Staging buffer the DMA reads from */
+  uint16_t  dma_size;         /* Size of dma_buf; also the longest message */
+  volatile uint8_t busy;      /* 1 while a DMA transfer is in flight */
+  UartTxRing_t ctrl;          /* Control messages */
+  UartTxRing_t telem;         /* Telemetry messages */
+
+  /* Statistics */
+  uint32_t  bytes;            /* Payload bytes accepted */
+  uint32_t  drops;            /* Telemetry messages dropped (evicted or rejected), failed transfers */
+  uint32_t  ctrl_drops;       /* Control messages dropped (ring full or too long) */
+  uint16_t  peak;             /* Peak queued bytes (both classes) */
+  uint32_t  batches;          /* DMA transfers started */
+  uint32_t  last_batch;       /* Transfer that carries the last queued message */
+} UartTx_t;
+
+/**
+  * @brief Static initializer for a transmit queue
+  * @param h: UART handle pointer (TX DMA must be linked in normal mode)
+  * @param dma: DMA staging buffer array
+  * @param cbuf: Control ring storage array
+  * @param tbuf: Telemetry ring storage array
+  */
+#define UART_TX_INIT(h, dma, cbuf, tbuf) { \
+  .huart = (h), .dma_buf = (dma), .dma_size = sizeof(dma), \
+  .ctrl = { .buf = (cbuf), .size = sizeof(cbuf) }, \
+  .telem = { .buf = (tbuf), .size = sizeof(tbuf) } }
+
+/**
+  * @brief Queue a message for transmission
+  * Telemetry evicts the oldest queued telemetry to make room. Control is
+  * dropped and counted in ctrl_drops if its ring is full; it never waits.
+  * Safe to call from thread and interrupt context.
+  * @param tx: Queue state
+  * @param data: Message bytes
+  * @param len: Message length (at most dma_size and 255)
+  * @param cls: Message class
+  * @retval 1 if queued, 0 if dropped
+  */
+uint8_t uart_tx_write(UartTx_t* tx, const void* data, uint16_t len, UartTxClass_t cls);
+
+/**
+  * @brief Queue a null-terminated line followed by CR LF
+  * @param tx: Queue state
+  * @param s: Line without line ending
+  * @param cls: Message class
+  * @retval 1 if queued, 0 if dropped
+  */
+uint8_t uart_tx_line(UartTx_t* tx, const char* s, UartTxClass_t cls);
+
+/**
+  * @brief Longest message the class's ring takes now without dropping one
+  * @param tx: Queue state
+  * @param cls: Message class
+  * @retval Message length in bytes, 0 if the ring is full
+  */
+uint16_t uart_tx_room(const UartTx_t* tx, UartTxClass_t cls);
+
+/**
+  * @brief Bytes currently queued (both classes, excluding in-flight DMA)
+  * @param tx: Queue state
+  */
+uint16_t uart_tx_queued(const UartTx_t* tx);
+
+/**
+  * @brief DMA transfer complete; start the next batch
+  * Call from HAL_UART_TxCpltCallback
+  * @param tx: Queue state
+  */
+void uart_tx_on_complete(UartTx_t* tx);
+
+/**
+  * @brief Recover after a UART error aborted the transfer in flight
+  * Call from HAL_UART_ErrorCallback
+  * @param tx: Queue state
+  */
+void uart_tx_on_error(UartTx_t* tx);
+
+#endif /* __UART_TX_H */
@@ -0,0 +1,201 @@
+/* cmd_arq.c - Selective-repeat acknowledged delivery for LoRa commands */
+#include "cmd_arq.h"
+#include <string.h>
+
+/**
+  * @brief Put a command slot on the air
+  */
+static void arq_transmit(CmdArqTx_t* tx, CmdArqSlot_t* s, uint32_t now) {
+  Frame_t f;
+  /* A single receiver is addressed directly, a group by broadcast */
+  f.type = (s->missing & (s->missing - 1)) ? FRAME_GCMD : FRAME_CMD;
+  f.seq = s->seq;
+  f.u.cmd.session = tx->session;
+  f.u.cmd.group = s->missing;
+  f.u.cmd.len = s->len;
+  memcpy(f.u.cmd.text, s->text, s->len + 1);
+
+  if(s->tries) tx->retransmits++;
+  s->tries++;
+  s->sent_ms = now;
+  tx->transmissions++;
+  tx->send(&f);
+}
+
+/**
+  * @brief Timeout for a slot: the base timeout doubled per retransmission,
+  * never before an ACK could arrive
+  */
+static uint32_t arq_timeout(const CmdArqTx_t* tx, const CmdArqSlot_t* s) {
+  uint32_t base = (tx->rto_ms > tx->rto_floor_ms) ? tx->rto_ms : tx->rto_floor_ms;
+  uint32_t max = (tx->rto_floor_ms > CMD_ARQ_RTO_MAX_MS) ? tx->rto_floor_ms : CMD_ARQ_RTO_MAX_MS;
+  uint32_t rto = base << (s->tries - 1);
+  return (rto > max) ? max : rto;
+}
+
+/**
+  * @brief Report the outcome of a command and free its slot
+  */
+static void arq_finish(CmdArqTx_t* tx, CmdArqSlot_t* s) {
+  s->tries = 0;
+  if(s->missing) tx->failed++;
+  if(tx->done) tx->done(s->text, s->group, (uint8_t)(s->group & ~s->missing));
+}
+
+/**
+  * @brief Mix boot entropy into the session
+  * Every input bit reaches the low bytes (lowbias32 hash)
+  */
+void cmd_arq_seed(CmdArqTx_t* tx, uint32_t entropy) {
+  uint32_t h = tx->seed ^ entropy;
+  h ^= h >> 16;
+  h *= 0x7FEB352DU;
+  h ^= h >> 15;
+  h *= 0x846CA68BU;
+  h ^= h >> 16;
+  tx->seed = h;
+}
+
+/**
+  * @brief Queue a command and send it
+  */
+uint8_t cmd_arq_send(CmdArqTx_t* tx, const char* text, uint8_t group, uint32_t now) {
+  size_t len = strlen(text);
+  CmdArqSlot_t* s = NULL;
+
+  for(uint8_t i = 0; i < CMD_ARQ_WINDOW && !s; i++) {
+    if(!tx->slot[i].tries) s = &tx->slot[i];
+  }
+  if(!s || len == 0 || len > FRAME_CMD_TEXT_MAX || !group) {
+    tx->rejected++;
+    return 0;
+  }
+
+  /* Session and first sequence number from the boot entropy; the first
+   * command's tick alone repeats when it is sent automatically */
+  if(!tx->session) {
+    cmd_arq_seed(tx, now);
+    tx->session = (uint8_t)tx->seed;
+    if(!tx->session) tx->session = 1;
+    tx->next_seq = (uint8_t)(tx->seed >> 8);
+  }
+
+  memcpy(s->text, text, len + 1);
+  s->len = (uint8_t)len;
+  s->seq = tx->next_seq++;
+  s->group = group;
+  s->missing = group;
+  s->tries = 0;
+  s->first_ms = now;
+  tx->queued++;
+
+  arq_transmit(tx, s, now);
+  return 1;
+}
+
+/**
+  * @brief Resend commands whose timeout expired, give up on exhausted ones
+  */
+void cmd_arq_poll(CmdArqTx_t* tx, uint32_t now) {
+  for(uint8_t i = 0; i < CMD_ARQ_WINDOW; i++) {
+    CmdArqSlot_t* s = &tx->slot[i];
+    if(!s->tries || now - s->sent_ms < arq_timeout(tx, s)) continue;
+
+    if(s->tries >= CMD_ARQ_TRIES) {
+      arq_finish(tx, s);
+      continue;
+    }
+    arq_transmit(tx, s, now);
+  }
+}
+
+/**
+  * @brief Record the commands an ACK confirms for its sender
+  */
+void cmd_arq_on_ack(CmdArqTx_t* tx, const FrameAck_t* ack, uint8_t from, uint32_t now) {
+  if(!tx->session || ack->session != tx->session || from >= 8) return;
+
+  for(uint8_t i = 0; i < CMD_ARQ_WINDOW; i++) {
+    CmdArqSlot_t* s = &tx->slot[i];
+    if(!s->tries || !(s->missing & (1U << from))) continue;
+
+    uint8_t back = (uint8_t)(ack->top - s->seq);
+    if(back >= 32 || !(ack->bitmap & (1UL << back))) continue;
+
+    s->missing &= (uint8_t)~(1U << from);
+    if(s->missing) continue;
+
+    uint32_t latency = now - s->first_ms;
+    tx->delivered++;
+    tx->latency_total_ms += latency;
+    if(latency > tx->latency_max_ms) tx->latency_max_ms = latency;
+
+    /* Only first-try deliveries are unambiguous timing samples */
+    if(s->tries == 1) {
+      tx->srtt_ms = tx->srtt_ms ? tx->srtt_ms + ((int32_t)latency - (int32_t)tx->srtt_ms) / 8 : latency;
+      uint32_t rto = 2 * tx->srtt_ms;
+      if(rto < CMD_ARQ_RTO_MIN_MS) rto = CMD_ARQ_RTO_MIN_MS;
+      if(rto > CMD_ARQ_RTO_MAX_MS) rto = CMD_ARQ_RTO_MAX_MS;
+      tx->rto_ms = rto;
+    }
+
+    arq_finish(tx, s);
+  }
+}
+
+/**
+  * @brief Give up every command awaiting acknowledgement
+  */
+void cmd_arq_flush(CmdArqTx_t* tx) {
+  for(uint8_t i = 0; i < CMD_ARQ_WINDOW; i++) {
+    if(tx->slot[i].tries) arq_finish(tx, &tx->slot[i]);
+  }
+}
+
+/**
+  * @brief Number of commands awaiting acknowledgement
+  */
+uint8_t cmd_arq_pending(const CmdArqTx_t* tx) {
+  uint8_t n = 0;
+  for(uint8_t i = 0; i < CMD_ARQ_WINDOW; i++) {
+    if(tx->slot[i].tries) n++;
+  }
+  return n;
+}
+
+/**
+  * @brief Record a received command and build the ACK to send back
+  */
+uint8_t cmd_arq_receive(CmdArqRx_t* rx, const Frame_t* f, FrameAck_t* ack) {
+  uint8_t fresh = 0;
+
+  if(f->u.cmd.session != rx->session) {
+    /* New sender session: start the window at this command */
+    rx->session = f->u.cmd.session;
+    rx->top = f->seq;
+    rx->seen = 1;
+    fresh = 1;
+  }
+  else {
+    int8_t d = (int8_t)(f->seq - rx->top);
+    if(d > 0) {
+      rx->seen = (d >= 32) ? 0 : rx->seen << d;
+      rx->seen |= 1;
+      rx->top = f->seq;
+      fresh = 1;
+    }
+    else if(-d < 32 && !(rx->seen & (1UL << -d))) {
+      /* Arrived after a later command (its first copy was lost) */
+      rx->seen |= 1UL << -d;
+      fresh = 1;
+    }
+  }
+
+  if(fresh) rx->accepted++;
+  else rx->duplicates++;
+
+  ack->session = rx->session;
+  ack->top = rx->top;
+  ack->bitmap = rx->seen;
+  return fresh;
+}
@@ -0,0 +1,229 @@
+/* config.c - Persistent key-value configuration store */
+#include "config.h"
+#include "frame.h"
+#include <string.h>
+#include <stdlib.h>
+
+/**
+  * @brief Word of an area
+  */
+static uint32_t cfg_read(const Config_t* c, uint8_t area, uint32_t off) {
+  return *(const volatile uint32_t*)(c->base[area] + off);
+}
+
+/**
+  * @brief Program a word and read it back
+  */
+static uint8_t cfg_write(Config_t* c, uint8_t area, uint32_t off, uint32_t word) {
+  if(c->program(c->base[area] + off, word) && cfg_read(c, area, off) == word) {
+    return 1;
+  }
+  c->errors++;
+  return 0;
+}
+
+/**
+  * @brief CRC of a record: key, epoch, value (little endian)
+  */
+static uint16_t cfg_record_crc(uint8_t key, uint8_t epoch, uint32_t value) {
+  uint8_t b[6] = { key, epoch, (uint8_t)value, (uint8_t)(value >> 8),
+                   (uint8_t)(value >> 16), (uint8_t)(value >> 24) };
+  return frame_crc16(b, sizeof(b));
+}
+
+/**
+  * @brief Header word of a record
+  */
+static uint32_t cfg_record_header(uint8_t key, uint8_t epoch, uint32_t value) {
+  return key | (uint32_t)epoch << 8 | (uint32_t)cfg_record_crc(key, epoch, value) << 16;
+}
+
+/**
+  * @brief Second header word of an area: epoch and CRC over magic and epoch
+  */
+static uint32_t cfg_area_header(uint16_t epoch) {
+  uint8_t b[6] = { (uint8_t)CONFIG_MAGIC, (uint8_t)(CONFIG_MAGIC >> 8), (uint8_t)(CONFIG_MAGIC >> 16),
+                   (uint8_t)(CONFIG_MAGIC >> 24), (uint8_t)epoch, (uint8_t)(epoch >> 8) };
+  return epoch | (uint32_t)frame_crc16(b, sizeof(b)) << 16;
+}
+
+/**
+  * @brief Check the header of an area
+  * @param epoch: Epoch of a valid area, 0 otherwise
+  * @retval 1 if valid
+  */
+static uint8_t cfg_area_valid(const Config_t* c, uint8_t area, uint16_t* epoch) {
+  *epoch = 0;
+  if(cfg_read(c, area, 0) != CONFIG_MAGIC) return 0;
+
+  uint32_t h = cfg_read(c, area, 4);
+  if(h != cfg_area_header((uint16_t)h)) return 0;
+
+  *epoch = (uint16_t)h;
+  return 1;
+}
+
+/**
+  * @brief Check whether a value is acceptable for a key
+  */
+static uint8_t cfg_in_range(const Config_t* c, uint8_t key, uint32_t value) {
+  return key < c->count && value >= c->keys[key].min && value <= c->keys[key].max;
+}
+
+/**
+  * @brief Append a record to the active area
+  */
+static uint8_t cfg_append(Config_t* c, uint8_t key, uint32_t value) {
+  if(!c->formatted || c->next + CONFIG_RECORD_SIZE > c->size) return 0;
+
+  /* Value first: the header word commits the record */
+  uint8_t ok = cfg_write(c, c->area, c->next, value) &&
+               cfg_write(c, c->area, c->next + 4, cfg_record_header(key, (uint8_t)c->epoch, value));
+
+  /* A torn record ends the replay; the next one goes after it */
+  c->next += CONFIG_RECORD_SIZE;
+  if(ok) c->writes++;
+  return ok;
+}
+
+/**
+  * @brief Write the values that differ from their defaults to the other
+  * area, then its header, and make it active
+  * @param values: Values to store
+  */
+static uint8_t cfg_compact(Config_t* c, const uint32_t* values) {
+  uint8_t area = c->area ^ 1;
+  uint16_t epoch = c->epoch + 1;
+  uint32_t off = CONFIG_HEADER_SIZE;
+
+  if(c->erase && !c->erase(area)) {
+    c->errors++;
+    return 0;
+  }
+
+  for(uint8_t k = 0; k < c->count; k++) {
+    if(values[k] == c->keys[k].def) continue;
+    if(off + CONFIG_RECORD_SIZE > c->size) return 0;
+    if(!cfg_write(c, area, off, values[k]) ||
+       !cfg_write(c, area, off + 4, cfg_record_header(k, (uint8_t)epoch, values[k]))) {
+      return 0;
+    }
+    off += CONFIG_RECORD_SIZE;
+  }
+
+  /* The magic stays from an earlier use on EEPROM; the epoch word commits */
+  if(!cfg_write(c, area, 0, CONFIG_MAGIC) || !cfg_write(c, area, 4, cfg_area_header(epoch))) {
+    return 0;
+  }
+
+  c->area = area;
+  c->epoch = epoch;
+  c->formatted = 1;
+  c->next = off;
+  c->compactions++;
+  return 1;
+}
+
+/**
+  * @brief Load the stored values
+  */
+void config_init(Config_t* c) {
+  uint16_t e0, e1;
+  uint8_t v0 = cfg_area_valid(c, 0, &e0);
+  uint8_t v1 = cfg_area_valid(c, 1, &e1);
+
+  for(uint8_t k = 0; k < c->count; k++) {
+    c->values[k] = c->keys[k].def;
+  }
+  c->loaded = 0;
+  c->writes = 0;
+  c->compactions = 0;
+  c->errors = 0;
+
+  if(!v0 && !v1) {
+    /* Blank: the first SET formats area 0 */
+    c->area = 1;
+    c->epoch = 0;
+    c->formatted = 0;
+    c->next = 0;
+    return;
+  }
+
+  c->area = (v0 && (!v1 || (int16_t)(e0 - e1) > 0)) ? 0 : 1;
+  c->epoch = c->area ? e1 : e0;
+  c->formatted = 1;
+
+  /* Replay up to the first record that is blank, torn or from an older epoch */
+  uint32_t off = CONFIG_HEADER_SIZE;
+  for(; off + CONFIG_RECORD_SIZE <= c->size; off += CONFIG_RECORD_SIZE) {
+    uint32_t value = cfg_read(c, c->area, off);
+    uint32_t h = cfg_read(c, c->area, off + 4);
+    uint8_t key = (uint8_t)h;
+    if((uint8_t)(h >> 8) != (uint8_t)c->epoch || h != cfg_record_header(key, (uint8_t)c->epoch, value)) {
+      break;
+    }
+    if(cfg_in_range(c, key, value)) {
+      c->values[key] = value;
+    }
+    c->loaded++;
+  }
+  c->next = off;
+}
+
+/**
+  * @brief Change and store a value
+  */
+ConfigStatus_t config_set(Config_t* c, uint8_t key, uint32_t value) {
+  if(key >= c->count) return CONFIG_UNKNOWN;
+  if(!cfg_in_range(c, key, value)) return CONFIG_RANGE;
+  if(c->values[key] == value) return CONFIG_OK;
+
+  if(!cfg_append(c, key, value)) {
+    /* Area full, never formatted or a failed write: move to the other area */
+    uint32_t old = c->values[key];
+    c->values[key] = value;
+    if(!cfg_compact(c, c->values)) {
+      c->values[key] = old;
+      return CONFIG_FAILED;
+    }
+    return CONFIG_OK;
+  }
+
+  c->values[key] = value;
+  return CONFIG_OK;
+}
+
+/**
+  * @brief Key index by name
+  */
+int16_t config_find(const Config_t* c, const char* name) {
+  for(uint8_t k = 0; k < c->count; k++) {
+    if(strcmp(c->keys[k].name, name) == 0) return k;
+  }
+  return -1;
+}
+
+/**
+  * @brief Change and store a value given as text
+  */
+ConfigStatus_t config_set_text(Config_t* c, const char* arg, int16_t* key) {
+  char name[24];
+  const char* comma = strchr(arg, ',');
+  size_t len = comma ? (size_t)(comma - arg) : strlen(arg);
+
+  *key = -1;
+  if(len >= sizeof(name)) return CONFIG_UNKNOWN;
+  memcpy(name, arg, len);
+  name[len] = 0;
+
+  *key = config_find(c, name);
+  if(*key < 0) return CONFIG_UNKNOWN;
+  if(!comma || comma[1] < '0' || comma[1] > '9') return CONFIG_RANGE;
+
+  char* end;
+  /* Decimal only: a leading 0 must not read as octal */
+  unsigned long value = strtoul(comma + 1, &end, 10);
+  if(*end || value > 0xFFFFFFFFUL) return CONFIG_RANGE;
+
+  return config_set(c, (uint8_t)*key, (uint32_t)value);
+}
@@ -0,0 +1,38 @@
+/* ctrl_arb.c - Arbitration between the joystick and the app as control source */
+#include "ctrl_arb.h"
+
+/**
+  * @brief Hand control to a source
+  */
+static CtrlArbReason_t arb_switch(CtrlArb_t* a, uint8_t source, CtrlArbReason_t why, uint32_t now_ms) {
+  a->source = source;
+  a->since_ms = now_ms;
+  if(source == CTRL_SRC_APP) a->to_app++;
+  else a->to_joystick++;
+  if(why == CTRL_ARB_TIMEOUT) a->timeouts++;
+  return why;
+}
+
+/**
+  * @brief Decide which source is in control
+  */
+CtrlArbReason_t ctrl_arb_update(CtrlArb_t* a, uint8_t joy_active, uint8_t app_update, uint32_t now_ms) {
+  uint8_t held = now_ms - a->since_ms >= a->hold_ms;
+
+  if(app_update) a->app_ms = now_ms;
+
+  if(a->source == CTRL_SRC_APP) {
+    if(now_ms - a->app_ms >= a->app_timeout_ms) {
+      return arb_switch(a, CTRL_SRC_JOYSTICK, CTRL_ARB_TIMEOUT, now_ms);
+    }
+    if(joy_active && held) {
+      return arb_switch(a, CTRL_SRC_JOYSTICK, CTRL_ARB_PRIORITY, now_ms);
+    }
+    return CTRL_ARB_NONE;
+  }
+
+  if(app_update && !joy_active && held) {
+    return arb_switch(a, CTRL_SRC_APP, CTRL_ARB_IDLE, now_ms);
+  }
+  return CTRL_ARB_NONE;
+}
@@ -0,0 +1,49 @@
+/* ctrl_map.c - Calibrated control value to servo pulse mapping */
+#include "ctrl_map.h"
+
+/* Segment width of the curve table in Q15 */
+#define CTRL_MAP_SEG_SHIFT 10
+
+/**
+  * @brief Fill a curve table for e percent expo at run time
+  */
+void ctrl_map_build_curve(uint16_t* curve, uint8_t expo) {
+  if(expo > 100) expo = 100;
+  for(uint32_t i = 0; i < CTRL_MAP_POINTS; i++) {
+    curve[i] = CTRL_MAP_EXPO(i, expo);
+  }
+}
+
+/**
+  * @brief Shape a magnitude through a curve table
+  */
+uint32_t ctrl_map_curve(const uint16_t* curve, uint32_t x) {
+  uint32_t seg = x >> CTRL_MAP_SEG_SHIFT;
+  if(seg >= CTRL_MAP_POINTS - 1) {
+    return curve[CTRL_MAP_POINTS - 1];
+  }
+
+  uint32_t frac = x & ((1U << CTRL_MAP_SEG_SHIFT) - 1);
+  uint32_t y0 = curve[seg], y1 = curve[seg + 1];
+  return y0 + (((y1 - y0) * frac) >> CTRL_MAP_SEG_SHIFT);
+}
+
+/**
+  * @brief Pulse width for a control value
+  */
+uint16_t ctrl_map_us(const CtrlMapCal_t* cal, int16_t v) {
+  int32_t a = (v < 0) ? -(int32_t)v : v;
+  if(a > FRAME_CTRL_MAX) a = FRAME_CTRL_MAX;
+
+  /* Magnitude in Q15, then through the curve */
+  uint32_t x = ((uint32_t)a * CTRL_MAP_ONE + FRAME_CTRL_MAX / 2) / FRAME_CTRL_MAX;
+  uint32_t y = ctrl_map_curve(cal->curve, x);
+
+  /* Scale onto the half of the range on the value's side of the centre */
+  if(v < 0) {
+    uint32_t span = cal->center_us - cal->min_us;
+    return (uint16_t)(cal->center_us - ((span * y + CTRL_MAP_ONE / 2) >> 15));
+  }
+  uint32_t span = cal->max_us - cal->center_us;
+  return (uint16_t)(cal->center_us + ((span * y + CTRL_MAP_ONE / 2) >> 15));
+}
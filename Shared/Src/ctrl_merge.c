@@ -0,0 +1,55 @@
+/* ctrl_merge.c - Coalescing of per-axis control updates into combined frames */
+#include "ctrl_merge.h"
+
+/**
+  * @brief Start a new minute when the current one is over
+  */
+static void merge_minute(CtrlMerge_t* m, uint32_t now_ms) {
+  uint32_t since = now_ms - m->minute_ms;
+  if(since < CTRL_MERGE_MINUTE_MS) return;
+
+  /* A minute without any update counts as an empty one */
+  m->saved_last_minute = (since < 2 * CTRL_MERGE_MINUTE_MS) ? m->minute_saved : 0;
+  m->minute_saved = 0;
+  m->minute_ms = now_ms - since % CTRL_MERGE_MINUTE_MS;
+}
+
+/**
+  * @brief Take an update of one axis
+  */
+void ctrl_merge_update(CtrlMerge_t* m, uint8_t axis, int16_t value, uint32_t now_ms) {
+  if(axis > CTRL_MERGE_RUDDER) return;
+
+  m->value[axis] = value;
+  m->updates++;
+  m->pending++;
+  if(!m->open) {
+    m->open = 1;
+    m->open_ms = now_ms;
+  }
+}
+
+/**
+  * @brief Close the window once it has run its time
+  */
+uint8_t ctrl_merge_poll(CtrlMerge_t* m, uint32_t now_ms, int16_t out[2]) {
+  merge_minute(m, now_ms);
+  if(!m->open || now_ms - m->open_ms < m->window_ms) return 0;
+
+  out[CTRL_MERGE_THRUST] = m->value[CTRL_MERGE_THRUST];
+  out[CTRL_MERGE_RUDDER] = m->value[CTRL_MERGE_RUDDER];
+  m->minute_saved += m->pending - 1;
+  m->frames++;
+  m->pending = 0;
+  m->open = 0;
+  return 1;
+}
+
+/**
+  * @brief Discard the open window without emitting it
+  */
+void ctrl_merge_drop(CtrlMerge_t* m) {
+  m->dropped += m->pending;
+  m->pending = 0;
+  m->open = 0;
+}
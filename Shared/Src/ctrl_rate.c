@@ -0,0 +1,53 @@
+/* ctrl_rate.c - Change-driven adaptive send rate for control frames */
+#include "ctrl_rate.h"
+
+static uint16_t absdiff(int16_t x, int16_t y) {
+  int32_t d = (int32_t)x - (int32_t)y;
+  return (uint16_t)(d < 0 ? -d : d);
+}
+
+/**
+  * @brief Decide whether to send a new sample
+  */
+CtrlRateReason_t ctrl_rate_update(CtrlRate_t* r, int16_t a, int16_t b, uint32_t now_ms) {
+  CtrlRateReason_t why = CTRL_RATE_NONE;
+  uint32_t since = now_ms - r->last_send_ms;
+
+  if(!r->primed) {
+    why = CTRL_RATE_CHANGE;
+    r->last_motion_ms = now_ms;
+  }
+  else {
+    if(a != r->prev[0] || b != r->prev[1]) {
+      r->last_motion_ms = now_ms;
+    }
+
+    uint16_t delta = absdiff(a, r->sent[0]);
+    uint16_t db = absdiff(b, r->sent[1]);
+    if(db > delta) delta = db;
+
+    uint8_t moving = (now_ms - r->last_motion_ms) < r->hold_ms;
+
+    if(delta >= r->threshold && since >= r->min_gap_ms) {
+      why = CTRL_RATE_CHANGE;
+    }
+    else if(moving && since >= r->active_ms) {
+      why = CTRL_RATE_ACTIVE;
+    }
+    else if(since >= r->heartbeat_ms) {
+      why = CTRL_RATE_HEARTBEAT;
+    }
+  }
+
+  r->prev[0] = a;
+  r->prev[1] = b;
+
+  if(why != CTRL_RATE_NONE) {
+    r->primed = 1;
+    r->sent[0] = a;
+    r->sent[1] = b;
+    r->last_send_ms = now_ms;
+    r->sends[why]++;
+  }
+  return why;
+}
@@ -0,0 +1,247 @@
+/* frame.c - Compact binary control/telemetry frames for the LoRa link */
+#include "frame.h"
+
+/* Header, sequence and CRC */
+#define FRAME_OVERHEAD 4
+
+/* Largest unescaped frame */
+#define FRAME_MAX_RAW  (FRAME_OVERHEAD + 2 + FRAME_CMD_TEXT_MAX)
+
+/* Length of a variable-length payload, checked per type */
+#define FRAME_LEN_VARIABLE (-2)
+
+/**
+  * @brief Payload length for a frame type
+  * @retval Length in bytes, FRAME_LEN_VARIABLE, or -1 for unknown types
+  */
+static int frame_payload_len(uint8_t type) {
+  switch(type) {
+  case FRAME_CTRL: return 3;
+  case FRAME_GPS:  return 8;
+  case FRAME_CMD:  return FRAME_LEN_VARIABLE;
+  case FRAME_GCMD: return FRAME_LEN_VARIABLE;
+  case FRAME_ACK:  return 6;
+  case FRAME_LINK: return 4;
+  case FRAME_SYNC: return 9;
+  case FRAME_RATE: return 3;
+  default:         return -1;
+  }
+}
+
+/**
+  * @brief Bytes ahead of the text in a CMD or GCMD payload
+  */
+static int frame_cmd_header(uint8_t type) {
+  return type == FRAME_GCMD ? 2 : 1;
+}
+
+static void put_be32(uint8_t* p, int32_t v) {
+  p[0] = (uint8_t)((uint32_t)v >> 24);
+  p[1] = (uint8_t)((uint32_t)v >> 16);
+  p[2] = (uint8_t)((uint32_t)v >> 8);
+  p[3] = (uint8_t)v;
+}
+
+static int32_t get_be32(const uint8_t* p) {
+  return (int32_t)(((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+                   ((uint32_t)p[2] << 8) | p[3]);
+}
+
+/**
+  * @brief Sign-extend a 12-bit value
+  */
+static int16_t sext12(uint16_t v) {
+  return (int16_t)((int16_t)((v & 0x0FFF) ^ 0x0800) - 0x0800);
+}
+
+static int16_t clamp_ctrl(int16_t v) {
+  if(v > FRAME_CTRL_MAX) return FRAME_CTRL_MAX;
+  if(v < -FRAME_CTRL_MAX) return -FRAME_CTRL_MAX;
+  return v;
+}
+
+/**
+  * @brief CRC-16/CCITT-FALSE
+  */
+uint16_t frame_crc16(const uint8_t* data, size_t len) {
+  uint16_t crc = 0xFFFF;
+  for(size_t i = 0; i < len; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for(uint8_t b = 0; b < 8; b++) {
+      crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+  }
+  return crc;
+}
+
+/**
+  * @brief Encode and escape a frame
+  */
+size_t frame_encode(const Frame_t* f, char* out, size_t size) {
+  uint8_t raw[FRAME_MAX_RAW];
+  int plen = frame_payload_len(f->type);
+  if(plen == FRAME_LEN_VARIABLE) {
+    if(f->u.cmd.len == 0 || f->u.cmd.len > FRAME_CMD_TEXT_MAX) return 0;
+    plen = frame_cmd_header(f->type) + f->u.cmd.len;
+  }
+  if(plen < 0) return 0;
+
+  raw[0] = (uint8_t)(0x80 | (FRAME_VERSION << 4) | (f->type & 0x0F));
+  raw[1] = f->seq;
+
+  uint8_t* p = &raw[2];
+  switch(f->type) {
+  case FRAME_CTRL: {
+    uint16_t t = (uint16_t)clamp_ctrl(f->u.ctrl.thrust) & 0x0FFF;
+    uint16_t r = (uint16_t)clamp_ctrl(f->u.ctrl.rudder) & 0x0FFF;
+    p[0] = (uint8_t)(t >> 4);
+    p[1] = (uint8_t)(((t & 0x0F) << 4) | (r >> 8));
+    p[2] = (uint8_t)r;
+    break;
+  }
+  case FRAME_GPS:
+    put_be32(&p[0], f->u.gps.lat_e7);
+    put_be32(&p[4], f->u.gps.lon_e7);
+    break;
+  case FRAME_CMD:
+  case FRAME_GCMD: {
+    int h = frame_cmd_header(f->type);
+    p[0] = f->u.cmd.session;
+    if(f->type == FRAME_GCMD) p[1] = f->u.cmd.group;
+    for(uint8_t i = 0; i < f->u.cmd.len; i++) p[h + i] = (uint8_t)f->u.cmd.text[i];
+    break;
+  }
+  case FRAME_ACK:
+    p[0] = f->u.ack.session;
+    p[1] = f->u.ack.top;
+    put_be32(&p[2], (int32_t)f->u.ack.bitmap);
+    break;
+  case FRAME_LINK:
+    p[0] = f->u.link.failsafe;
+    p[1] = f->u.link.events;
+    p[2] = (uint8_t)(f->u.link.gap_ms >> 8);
+    p[3] = (uint8_t)f->u.link.gap_ms;
+    break;
+  case FRAME_SYNC:
+    p[0] = (uint8_t)(f->u.sync.base >> 8);
+    p[1] = (uint8_t)f->u.sync.base;
+    p[2] = f->u.sync.boats;
+    p[3] = f->u.sync.frame;
+    p[4] = f->u.sync.offset_ms;
+    p[5] = (uint8_t)(f->u.sync.down_ms >> 8);
+    p[6] = (uint8_t)f->u.sync.down_ms;
+    p[7] = (uint8_t)(f->u.sync.up_ms >> 8);
+    p[8] = (uint8_t)f->u.sync.up_ms;
+    break;
+  case FRAME_RATE:
+    p[0] = f->u.rate.sf;
+    p[1] = f->u.rate.bw;
+    p[2] = f->u.rate.frames;
+    break;
+  }
+
+  size_t n = 2 + (size_t)plen;
+  uint16_t crc = frame_crc16(raw, n);
+  raw[n++] = (uint8_t)(crc >> 8);
+  raw[n++] = (uint8_t)crc;
+
+  /* Escape NUL, CR, LF and the escape byte itself */
+  size_t o = 0;
+  for(size_t i = 0; i < n; i++) {
+    uint8_t b = raw[i];
+    if(b == 0x00 || b == '\r' || b == '\n' || b == FRAME_ESC) {
+      if(o + 2 >= size) return 0;
+      out[o++] = (char)FRAME_ESC;
+      out[o++] = (char)(b ^ 0x20);
+    }
+    else {
+      if(o + 1 >= size) return 0;
+      out[o++] = (char)b;
+    }
+  }
+  out[o] = 0;
+  return o;
+}
+
+/**
+  * @brief Unescape, verify and decode a frame
+  */
+uint8_t frame_decode(const char* in, size_t len, Frame_t* f) {
+  uint8_t raw[FRAME_MAX_RAW];
+  size_t n = 0;
+
+  for(size_t i = 0; i < len; i++) {
+    uint8_t b = (uint8_t)in[i];
+    if(b == FRAME_ESC) {
+      if(++i >= len) return 0;
+      b = (uint8_t)in[i] ^ 0x20;
+    }
+    if(n >= sizeof(raw)) return 0;
+    raw[n++] = b;
+  }
+
+  if(n < FRAME_OVERHEAD) return 0;
+  if((raw[0] & 0xF0) != (0x80 | (FRAME_VERSION << 4))) return 0;
+
+  uint8_t type = raw[0] & 0x0F;
+  int plen = frame_payload_len(type);
+  if(plen == FRAME_LEN_VARIABLE) {
+    /* Session (and group) byte and at least one character of text */
+    if(n < (size_t)(FRAME_OVERHEAD + frame_cmd_header(type) + 1)) return 0;
+    plen = (int)(n - FRAME_OVERHEAD);
+  }
+  if(plen < 0 || n != (size_t)plen + FRAME_OVERHEAD) return 0;
+
+  uint16_t crc = (uint16_t)((raw[n - 2] << 8) | raw[n - 1]);
+  if(frame_crc16(raw, n - 2) != crc) return 0;
+
+  f->type = type;
+  f->seq = raw[1];
+
+  const uint8_t* p = &raw[2];
+  switch(type) {
+  case FRAME_CTRL:
+    f->u.ctrl.thrust = sext12((uint16_t)((p[0] << 4) | (p[1] >> 4)));
+    f->u.ctrl.rudder = sext12((uint16_t)(((p[1] & 0x0F) << 8) | p[2]));
+    break;
+  case FRAME_GPS:
+    f->u.gps.lat_e7 = get_be32(&p[0]);
+    f->u.gps.lon_e7 = get_be32(&p[4]);
+    break;
+  case FRAME_CMD:
+  case FRAME_GCMD: {
+    int h = frame_cmd_header(type);
+    f->u.cmd.session = p[0];
+    f->u.cmd.group = (type == FRAME_GCMD) ? p[1] : 0;
+    f->u.cmd.len = (uint8_t)(plen - h);
+    if(f->u.cmd.len > FRAME_CMD_TEXT_MAX) return 0;
+    for(uint8_t i = 0; i < f->u.cmd.len; i++) f->u.cmd.text[i] = (char)p[h + i];
+    f->u.cmd.text[f->u.cmd.len] = 0;
+    break;
+  }
+  case FRAME_ACK:
+    f->u.ack.session = p[0];
+    f->u.ack.top = p[1];
+    f->u.ack.bitmap = (uint32_t)get_be32(&p[2]);
+    break;
+  case FRAME_LINK:
+    f->u.link.failsafe = p[0];
+    f->u.link.events = p[1];
+    f->u.link.gap_ms = (uint16_t)((p[2] << 8) | p[3]);
+    break;
+  case FRAME_SYNC:
+    f->u.sync.base = (uint16_t)((p[0] << 8) | p[1]);
+    f->u.sync.boats = p[2];
+    f->u.sync.frame = p[3];
+    f->u.sync.offset_ms = p[4];
+    f->u.sync.down_ms = (uint16_t)((p[5] << 8) | p[6]);
+    f->u.sync.up_ms = (uint16_t)((p[7] << 8) | p[8]);
+    break;
+  case FRAME_RATE:
+    f->u.rate.sf = p[0];
+    f->u.rate.bw = p[1];
+    f->u.rate.frames = p[2];
+    break;
+  }
+  return 1;
+}
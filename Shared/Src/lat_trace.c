@@ -0,0 +1,92 @@
+/* lat_trace.c - Stick-to-servo latency trace records (LAT_TRACE builds only) */
+#include "lat_trace.h"
+
+#ifdef LAT_TRACE
+
+#include "main.h"
+#include <stdio.h>
+
+typedef struct {
+  uint32_t t_us;
+  uint8_t  stage;
+  uint8_t  seq;
+} LatRecord_t;
+
+static LatRecord_t lat_ring[LAT_TRACE_DEPTH];
+static uint8_t  lat_head;           /* Free-running write counter */
+static uint8_t  lat_tail;           /* Free-running read counter */
+static uint32_t lat_drops;
+
+static const char* const lat_names[LAT_STAGES] = LAT_STAGE_NAMES;
+
+/**
+  * @brief Microsecond timestamp, safe from interrupt context
+  */
+uint32_t lat_trace_now_us(void) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+
+  uint32_t ms = HAL_GetTick();
+  uint32_t val = SysTick->VAL;
+  uint32_t load = SysTick->LOAD + 1;
+
+  /* The counter reloaded but the tick interrupt has not run yet (called
+   * from a higher priority ISR or with interrupts masked) */
+  if((SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) && val > load / 2) {
+    ms++;
+  }
+
+  __set_PRIMASK(primask);
+  return ms * 1000 + (load - 1 - val) / (load / 1000);
+}
+
+/**
+  * @brief Queue a trace record (thread or interrupt context)
+  */
+void lat_trace_record(LatStage_t stage, uint8_t seq, uint32_t t_us) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+
+  if((uint8_t)(lat_head - lat_tail) >= LAT_TRACE_DEPTH) {
+    lat_drops++;
+  }
+  else {
+    LatRecord_t* r = &lat_ring[lat_head % LAT_TRACE_DEPTH];
+    r->t_us = t_us;
+    r->stage = (uint8_t)stage;
+    r->seq = seq;
+    lat_head++;
+  }
+
+  __set_PRIMASK(primask);
+}
+
+/**
+  * @brief Take the oldest record and format it as a trace line
+  */
+uint8_t lat_trace_next(char* line, size_t size) {
+  LatRecord_t r;
+
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  if(lat_head == lat_tail) {
+    __set_PRIMASK(primask);
+    return 0;
+  }
+  r = lat_ring[lat_tail % LAT_TRACE_DEPTH];
+  lat_tail++;
+  __set_PRIMASK(primask);
+
+  const char* name = (r.stage < LAT_STAGES) ? lat_names[r.stage] : "?";
+  snprintf(line, size, "LT,%s,%u,%lu", name, r.seq, (unsigned long)r.t_us);
+  return 1;
+}
+
+/**
+  * @brief Records dropped because the queue was full
+  */
+uint32_t lat_trace_dropped(void) {
+  return lat_drops;
+}
+
+#endif /* LAT_TRACE */
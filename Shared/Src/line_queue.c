@@ -0,0 +1,48 @@
+/* line_queue.c - Lock-free single-producer/single-consumer queue of text lines */
+#include "line_queue.h"
+
+/**
+  * @brief Copy a line into the next free slot (producer side)
+  */
+uint8_t line_queue_push(LineQueue_t* q, const char* line) {
+  uint8_t used = (uint8_t)(q->head - q->tail);
+
+  if(used >= q->count) {
+    q->dropped++;
+    return 0;
+  }
+
+  char* slot = &q->slots[(q->head & (q->count - 1)) * q->slot_size];
+  uint16_t n = 0;
+  while(line[n] && n < q->slot_size - 1) {
+    slot[n] = line[n];
+    n++;
+  }
+  slot[n] = 0;
+
+  /* Slot contents must be visible before the consumer sees the new head */
+  __DMB();
+  q->head++;
+
+  q->pushed++;
+  if(used + 1 > q->high_water) q->high_water = used + 1;
+  return 1;
+}
+
+/**
+  * @brief Oldest queued line (consumer side)
+  */
+char* line_queue_front(LineQueue_t* q) {
+  if(q->head == q->tail) return NULL;
+  __DMB();
+  return &q->slots[(q->tail & (q->count - 1)) * q->slot_size];
+}
+
+/**
+  * @brief Release the oldest slot (consumer side)
+  */
+void line_queue_pop(LineQueue_t* q) {
+  if(q->head == q->tail) return;
+  __DMB();
+  q->tail++;
+}
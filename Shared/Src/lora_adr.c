@@ -0,0 +1,151 @@
+/* lora_adr.c - Adaptive LoRa data rate: link margin per boat and rate choice */
+#include "lora_adr.h"
+
+/* Receiver noise figure, 0.1 dB */
+#define ADR_NOISE_FIGURE_DB10  60
+
+/* Thermal noise in 125 kHz, 0.1 dBm: -174 dBm/Hz + 10 log10(125000) */
+#define ADR_NOISE_125K_DBM10   (-1740 + 510)
+
+const LoRaRate_t lora_adr_rates[LORA_ADR_RATES] = {
+  { 12, 7 }, { 11, 7 }, { 10, 7 }, { 9, 7 }, { 8, 7 }, { 7, 7 }, { 7, 8 }, { 7, 9 }
+};
+
+/**
+  * @brief Noise bandwidth above 125 kHz, 0.1 dB (3 dB per doubling)
+  */
+static int16_t adr_bw_db10(uint8_t bw) {
+  return (int16_t)(30 * ((int16_t)bw - 7));
+}
+
+/**
+  * @brief Lowest SNR the spreading factor demodulates at, 0.1 dB
+  */
+static int16_t adr_snr_floor_db10(uint8_t sf) {
+  return (int16_t)(-75 - 25 * ((int16_t)sf - 7));
+}
+
+/**
+  * @brief Sensitivity of a rate, 0.1 dBm
+  */
+static int16_t adr_sensitivity_dbm10(const LoRaRate_t* r) {
+  return (int16_t)(ADR_NOISE_125K_DBM10 + ADR_NOISE_FIGURE_DB10 + adr_bw_db10(r->bw) +
+                   adr_snr_floor_db10(r->sf));
+}
+
+/**
+  * @brief Worst margin of a set of boats at a rate
+  */
+static int16_t adr_worst(const LoRaAdr_t* a, uint8_t peers, uint8_t rate) {
+  int16_t worst = INT16_MAX;
+  for(uint8_t i = 0; i < LORA_ADR_PEERS; i++) {
+    if(!(peers & (1U << i))) continue;
+    int16_t m = lora_adr_margin(a, i, rate);
+    if(m < worst) worst = m;
+  }
+  return worst;
+}
+
+/**
+  * @brief Start new report windows
+  */
+static void adr_reset_peers(LoRaAdr_t* a) {
+  for(uint8_t i = 0; i < LORA_ADR_PEERS; i++) {
+    a->peer[i].samples = 0;
+  }
+}
+
+/**
+  * @brief Find a rate
+  */
+int8_t lora_adr_find(uint8_t sf, uint8_t bw) {
+  for(uint8_t i = 0; i < LORA_ADR_RATES; i++) {
+    if(lora_adr_rates[i].sf == sf && lora_adr_rates[i].bw == bw) return (int8_t)i;
+  }
+  return -1;
+}
+
+/**
+  * @brief Start at the home rate
+  */
+void lora_adr_init(LoRaAdr_t* a, uint8_t home) {
+  *a = (LoRaAdr_t){ 0 };
+  a->rate = home;
+  a->home = home;
+}
+
+/**
+  * @brief Record the signal report of a packet
+  */
+void lora_adr_on_packet(LoRaAdr_t* a, uint8_t peer, int16_t rssi, int16_t snr) {
+  if(peer >= LORA_ADR_PEERS) return;
+
+  LoRaAdrPeer_t* p = &a->peer[peer];
+  if(!p->samples || snr < p->snr_min) p->snr_min = snr;
+  if(!p->samples || rssi < p->rssi_min) p->rssi_min = rssi;
+  if(p->samples < UINT8_MAX) p->samples++;
+}
+
+/**
+  * @brief Margin a boat would have at a rate
+  */
+int16_t lora_adr_margin(const LoRaAdr_t* a, uint8_t peer, uint8_t rate) {
+  const LoRaAdrPeer_t* p = &a->peer[peer];
+  const LoRaRate_t* r = &lora_adr_rates[rate];
+  const LoRaRate_t* cur = &lora_adr_rates[a->rate];
+
+  int16_t snr = (int16_t)(p->snr_min * 10 - (adr_bw_db10(r->bw) - adr_bw_db10(cur->bw)) -
+                          adr_snr_floor_db10(r->sf));
+  int16_t rssi = (int16_t)(p->rssi_min * 10 - adr_sensitivity_dbm10(r));
+  return snr < rssi ? snr : rssi;
+}
+
+/**
+  * @brief Choose the next rate once every active boat has reported enough
+  */
+int8_t lora_adr_decide(LoRaAdr_t* a, uint8_t peers) {
+  if(!peers) return -1;
+  for(uint8_t i = 0; i < LORA_ADR_PEERS; i++) {
+    if((peers & (1U << i)) && a->peer[i].samples < LORA_ADR_SAMPLES) return -1;
+  }
+
+  int8_t next = -1;
+  a->margin_db10 = adr_worst(a, peers, a->rate);
+
+  if(a->margin_db10 < (LORA_ADR_MARGIN_DB - LORA_ADR_HYST_DB) * 10) {
+    /* Short of margin: the fastest slower rate that has it, else the most robust */
+    for(int8_t r = (int8_t)a->rate - 1; r >= 0 && next < 0; r--) {
+      if(r == 0 || adr_worst(a, peers, (uint8_t)r) >= LORA_ADR_MARGIN_DB * 10) next = r;
+    }
+  }
+  else if(a->hold) {
+    a->hold--;
+  }
+  else if(a->rate + 1 < LORA_ADR_RATES &&
+          adr_worst(a, peers, (uint8_t)(a->rate + 1)) >= LORA_ADR_MARGIN_DB * 10) {
+    next = (int8_t)(a->rate + 1);
+  }
+
+  adr_reset_peers(a);
+  return next;
+}
+
+/**
+  * @brief Note a completed switch
+  */
+void lora_adr_switched(LoRaAdr_t* a, uint8_t rate) {
+  if(rate > a->rate) a->faster++;
+  else if(rate < a->rate) a->slower++;
+  a->rate = rate;
+  adr_reset_peers(a);
+}
+
+/**
+  * @brief Note a return to the home rate on link loss
+  */
+void lora_adr_fallback(LoRaAdr_t* a) {
+  a->rate = a->home;
+  a->hold = LORA_ADR_HOLD;
+  a->fallbacks++;
+  adr_reset_peers(a);
+}
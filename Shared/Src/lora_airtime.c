@@ -0,0 +1,33 @@
+/* lora_airtime.c - LoRa time-on-air calculator (Semtech AN1200.13 formula) */
+#include "lora_airtime.h"
+
+/**
+  * @brief Bandwidth in Hz for an AT+PARAMETER bandwidth code
+  */
+uint32_t lora_bw_hz(uint32_t code) {
+  static const uint32_t bw[] = { 7800, 10400, 15600, 20800, 31250, 41700, 62500, 125000, 250000, 500000 };
+  return (code < sizeof(bw) / sizeof(bw[0])) ? bw[code] : 0;
+}
+
+/**
+  * @brief Time on air for one packet (explicit header, payload CRC on)
+  * Integer-only implementation of
+  *   Tpacket = (Npreamble + 4.25) * Tsym
+  *           + (8 + max(ceil((8PL - 4SF + 28 + 16) / (4(SF - 2DE))) * (CR + 4), 0)) * Tsym
+  */
+uint32_t lora_airtime_us(const LoRaPhy_t* phy, uint16_t payload_len) {
+  uint32_t tsym_us = (uint32_t)(((uint64_t)1000000 << phy->sf) / phy->bw_hz);
+
+  /* Low data rate optimisation is mandated when a symbol exceeds 16 ms */
+  int32_t de = (tsym_us > 16000) ? 1 : 0;
+
+  int32_t num = 8 * (int32_t)payload_len - 4 * (int32_t)phy->sf + 28 + 16;
+  int32_t den = 4 * ((int32_t)phy->sf - 2 * de);
+  int32_t blocks = (num > 0) ? (num + den - 1) / den : 0;
+  uint32_t payload_syms = 8 + (uint32_t)blocks * (phy->cr + 4);
+
+  /* Preamble is Npreamble + 4.25 symbols; keep quarter-symbol precision */
+  uint32_t preamble_q = (uint32_t)phy->preamble * 4 + 17;
+
+  return (preamble_q * tsym_us) / 4 + payload_syms * tsym_us;
+}
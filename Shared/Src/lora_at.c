@@ -0,0 +1,204 @@
+/* lora_at.c - REYAX RYLR LoRa module AT interface: command engine and +RCV parser */
+#include "lora_at.h"
+#include <string.h>
+#include <stdio.h>
+
+/**
+  * @brief Parse a signed decimal number
+  * @param s: Text to parse, advanced past the digits
+  * @param v: Parsed value
+  * @retval 1 if at least one digit was read
+  */
+static uint8_t parse_int(const char** s, int32_t* v) {
+  const char* p = *s;
+  uint8_t neg = 0;
+  int32_t n = 0;
+
+  if(*p == '-') { neg = 1; p++; }
+  if(*p < '0' || *p > '9') return 0;
+
+  while(*p >= '0' && *p <= '9') {
+    n = n * 10 + (*p++ - '0');
+  }
+
+  *v = neg ? -n : n;
+  *s = p;
+  return 1;
+}
+
+/**
+  * @brief Send commands until the window is full
+  */
+static void at_fill(LoRaAt_t* at, uint32_t now_ms) {
+  if(at->sent == at->acked) {
+    at->deadline_ms = now_ms + LORA_AT_TIMEOUT_MS;
+  }
+  while(at->sent < at->count && (uint8_t)(at->sent - at->acked) < LORA_AT_WINDOW) {
+    at->send(at->script[at->sent++]);
+  }
+}
+
+/**
+  * @brief Re-send the oldest outstanding command and those after it
+  * Commands already sent may still be answered; those replies are awaited
+  * and discarded first, else they would complete the re-sent commands.
+  * @param due: Replies that may still come
+  */
+static void at_retry(LoRaAt_t* at, uint8_t due, uint32_t now_ms) {
+  if(++at->tries > LORA_AT_RETRIES) {
+    at->state = LORA_AT_FAILED;
+    return;
+  }
+  at->retries++;
+  at->drain = due;
+  at->sent = at->acked;
+  if(at->drain) {
+    at->deadline_ms = now_ms + LORA_AT_TIMEOUT_MS;
+    return;
+  }
+  at_fill(at, now_ms);
+}
+
+/**
+  * @brief Start a command script
+  */
+void lora_at_run(LoRaAt_t* at, const char* const* script, uint8_t count, uint32_t now_ms) {
+  at->script = script;
+  at->count = count;
+  at->acked = 0;
+  at->sent = 0;
+  at->tries = 0;
+  at->drain = 0;
+  at->start_ms = now_ms;
+  at->done_ms = now_ms;
+
+  if(count == 0) {
+    at->state = LORA_AT_DONE;
+    return;
+  }
+
+  at->state = LORA_AT_BUSY;
+  at_fill(at, now_ms);
+}
+
+/**
+  * @brief Handle reply timeouts
+  */
+void lora_at_poll(LoRaAt_t* at, uint32_t now_ms) {
+  if(at->state != LORA_AT_BUSY) return;
+
+  if((int32_t)(now_ms - at->deadline_ms) >= 0) {
+    /* Replies still due never came: re-send now */
+    if(at->drain) {
+      at->drain = 0;
+      at_fill(at, now_ms);
+      return;
+    }
+    /* The oldest reply may only be late: wait for it as well */
+    at->timeouts++;
+    at_retry(at, (uint8_t)(at->sent - at->acked), now_ms);
+  }
+}
+
+/**
+  * @brief Offer a received line to the engine
+  */
+uint8_t lora_at_on_line(LoRaAt_t* at, const char* line, uint32_t now_ms) {
+  uint8_t ok = (strncmp(line, "+OK", 3) == 0 || strncmp(line, "OK", 2) == 0);
+  uint8_t err = (strncmp(line, "+ERR", 4) == 0 || strncmp(line, "ERROR", 5) == 0);
+
+  if(!ok && !err) return 0;
+
+  if(ok) at->oks++;
+  else at->errors++;
+
+  /* Replies outside a script belong to AT+SEND; only counted */
+  if(at->state != LORA_AT_BUSY) return 1;
+
+  /* Late reply of a command waiting to be re-sent */
+  if(at->drain) {
+    at->drained++;
+    if(--at->drain == 0) at_fill(at, now_ms);
+    return 1;
+  }
+  if(at->sent == at->acked) return 1;
+
+  if(err) {
+    at_retry(at, (uint8_t)(at->sent - at->acked - 1U), now_ms);
+    return 1;
+  }
+
+  at->acked++;
+  at->tries = 0;
+
+  if(at->acked == at->count) {
+    at->state = LORA_AT_DONE;
+    at->done_ms = now_ms;
+    return 1;
+  }
+
+  at->deadline_ms = now_ms + LORA_AT_TIMEOUT_MS;
+  at_fill(at, now_ms);
+  return 1;
+}
+
+/**
+  * @brief Parse a +RCV line
+  */
+uint8_t lora_at_parse_rcv(char* line, LoRaRcv_t* rcv) {
+  if(strncmp(line, "+RCV=", 5) != 0) return 0;
+
+  const char* p = line + 5;
+  int32_t addr, len, rssi = 0, snr = 0;
+
+  if(!parse_int(&p, &addr) || *p++ != ',') return 0;
+  if(!parse_int(&p, &len) || *p++ != ',') return 0;
+  if(len < 0 || strlen(p) < (size_t)len) return 0;
+
+  char* data = line + (p - line);
+  const char* tail = p + len;
+
+  /* RSSI and SNR follow the payload; tolerate modules that omit them */
+  if(*tail == ',') {
+    tail++;
+    if(parse_int(&tail, &rssi) && *tail == ',') {
+      tail++;
+      parse_int(&tail, &snr);
+    }
+  }
+
+  data[len] = 0;
+
+  rcv->addr = (uint16_t)addr;
+  rcv->len = (uint16_t)len;
+  rcv->data = data;
+  rcv->rssi = (int16_t)rssi;
+  rcv->snr = (int16_t)snr;
+  return 1;
+}
+
+/**
+  * @brief Build the configuration script for a set of module settings
+  */
+uint8_t lora_at_config_script(LoRaAtScript_t* s, const LoRaAtConfig_t* cfg) {
+  snprintf(s->line[0], LORA_AT_CONFIG_LEN, "AT+ADDRESS=%u", (unsigned)cfg->address);
+  snprintf(s->line[1], LORA_AT_CONFIG_LEN, "AT+NETWORKID=%u", (unsigned)cfg->network);
+  snprintf(s->line[2], LORA_AT_CONFIG_LEN, "AT+BAND=%lu", (unsigned long)cfg->band_hz);
+  snprintf(s->line[3], LORA_AT_CONFIG_LEN, "AT+PARAMETER=%u,%u,%u,%u", (unsigned)cfg->sf,
+           (unsigned)cfg->bw, (unsigned)cfg->cr, (unsigned)cfg->preamble);
+
+  for(uint8_t i = 0; i < LORA_AT_CONFIG_LINES; i++) {
+    s->script[i] = s->line[i];
+  }
+  return LORA_AT_CONFIG_LINES;
+}
+
+/**
+  * @brief Build a script that only reprograms the modulation
+  */
+uint8_t lora_at_phy_script(LoRaAtScript_t* s, const LoRaAtConfig_t* cfg) {
+  snprintf(s->line[0], LORA_AT_CONFIG_LEN, "AT+PARAMETER=%u,%u,%u,%u", (unsigned)cfg->sf,
+           (unsigned)cfg->bw, (unsigned)cfg->cr, (unsigned)cfg->preamble);
+  s->script[0] = s->line[0];
+  return 1;
+}
@@ -0,0 +1,318 @@
+/* nmea.c - Incremental, allocation-free NMEA 0183 parser with fixed-point output */
+#include "nmea.h"
+#include <stdio.h>
+#include <string.h>
+
+/* Parser states */
+#define ST_IDLE   0   /* Waiting for '$' */
+#define ST_BODY   1   /* Between '$' and '*' */
+#define ST_CS_HI  2   /* First checksum hex digit */
+#define ST_CS_LO  3   /* Second checksum hex digit */
+
+/* Longest sentence accepted before resynchronising (spec limit is 82) */
+#define NMEA_MAX_LEN 100
+
+static const uint32_t pow10_tab[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000 };
+
+/**
+  * @brief Convert a hex digit to its value
+  * @retval 0-15, or 0xFF if not a hex digit
+  */
+static uint8_t hex_val(char c) {
+  if(c >= '0' && c <= '9') return (uint8_t)(c - '0');
+  if(c >= 'A' && c <= 'F') return (uint8_t)(c - 'A' + 10);
+  if(c >= 'a' && c <= 'f') return (uint8_t)(c - 'a' + 10);
+  return 0xFF;
+}
+
+/**
+  * @brief Current field fraction rescaled to a number of decimal digits
+  */
+static uint32_t field_frac(const NmeaParser_t* p, uint8_t digits) {
+  if(p->f_frac_digits <= digits) {
+    return p->f_frac * pow10_tab[digits - p->f_frac_digits];
+  }
+  return p->f_frac / pow10_tab[p->f_frac_digits - digits];
+}
+
+/**
+  * @brief Current field as unsigned fixed point with the given decimals
+  */
+static uint32_t field_fixed(const NmeaParser_t* p, uint8_t digits) {
+  return p->f_int * pow10_tab[digits] + field_frac(p, digits);
+}
+
+/**
+  * @brief Current field (DDMM.MMMMM / DDDMM.MMMMM) as degrees * 1e7
+  */
+static int32_t field_ddmm_e7(const NmeaParser_t* p) {
+  uint32_t deg = p->f_int / 100;
+  uint32_t min_e5 = (p->f_int % 100) * 100000 + field_frac(p, 5);
+
+  /* minutes * 1e5 -> degrees * 1e7 is a factor of 100/60 = 5/3 */
+  return (int32_t)(deg * 10000000 + (min_e5 * 5 + 1) / 3);
+}
+
+/**
+  * @brief Current field (hhmmss.sss) as milliseconds since midnight
+  */
+static uint32_t field_time_ms(const NmeaParser_t* p) {
+  uint32_t hh = p->f_int / 10000;
+  uint32_t mm = (p->f_int / 100) % 100;
+  uint32_t ss = p->f_int % 100;
+  return ((hh * 60 + mm) * 60 + ss) * 1000 + field_frac(p, 3);
+}
+
+/**
+  * @brief Decode the sentence type from the address field
+  */
+static NmeaType_t addr_type(const NmeaParser_t* p) {
+  if(p->addr_len != 5) return NMEA_NONE;
+
+  const char* t = &p->addr[2];
+  if(memcmp(t, "RMC", 3) == 0) return NMEA_RMC;
+  if(memcmp(t, "GGA", 3) == 0) return NMEA_GGA;
+  if(memcmp(t, "VTG", 3) == 0) return NMEA_VTG;
+  if(memcmp(t, "GSA", 3) == 0) return NMEA_GSA;
+  if(memcmp(t, "GSV", 3) == 0) return NMEA_GSV;
+  return NMEA_NONE;
+}
+
+/**
+  * @brief Store a completed field into the working data
+  */
+static void field_end(NmeaParser_t* p) {
+  NmeaData_t* w = &p->work;
+  uint8_t f = p->field;
+  uint8_t empty = (p->f_len == 0);
+
+  switch(p->type) {
+  case NMEA_RMC:
+    if(f == 2) w->fix_valid = (p->f_first == 'A' || p->f_first == 'a');
+    else if(empty) break;
+    else if(f == 1) w->time_ms = field_time_ms(p);
+    else if(f == 3) w->lat_e7 = field_ddmm_e7(p);
+    else if(f == 4 && p->f_first == 'S') w->lat_e7 = -w->lat_e7;
+    else if(f == 5) w->lon_e7 = field_ddmm_e7(p);
+    else if(f == 6 && p->f_first == 'W') w->lon_e7 = -w->lon_e7;
+    else if(f == 7) w->speed_mknots = field_fixed(p, 3);
+    else if(f == 8) w->course_cdeg = (uint16_t)field_fixed(p, 2);
+    else if(f == 9) w->date = p->f_int;
+    break;
+
+  case NMEA_GGA:
+    if(empty) break;
+    if(f == 1) w->time_ms = field_time_ms(p);
+    else if(f == 2) w->lat_e7 = field_ddmm_e7(p);
+    else if(f == 3 && p->f_first == 'S') w->lat_e7 = -w->lat_e7;
+    else if(f == 4) w->lon_e7 = field_ddmm_e7(p);
+    else if(f == 5 && p->f_first == 'W') w->lon_e7 = -w->lon_e7;
+    else if(f == 6) w->fix_quality = (uint8_t)p->f_int;
+    else if(f == 7) w->num_sats = (uint8_t)p->f_int;
+    else if(f == 8) w->hdop_x100 = (uint16_t)field_fixed(p, 2);
+    else if(f == 9) {
+      int32_t cm = (int32_t)field_fixed(p, 2);
+      w->alt_cm = p->f_neg ? -cm : cm;
+    }
+    break;
+
+  case NMEA_VTG:
+    if(empty) break;
+    if(f == 1) w->course_cdeg = (uint16_t)field_fixed(p, 2);
+    else if(f == 5) w->speed_mknots = field_fixed(p, 3);
+    else if(f == 7) w->speed_mkmh = field_fixed(p, 3);
+    break;
+
+  case NMEA_GSA:
+    if(empty) break;
+    if(f == 2) w->fix_mode = (uint8_t)p->f_int;
+    else if(f == 15) w->pdop_x100 = (uint16_t)field_fixed(p, 2);
+    else if(f == 16) w->hdop_x100 = (uint16_t)field_fixed(p, 2);
+    else if(f == 17) w->vdop_x100 = (uint16_t)field_fixed(p, 2);
+    break;
+
+  case NMEA_GSV:
+    if(empty) break;
+    if(f == 3) w->sats_in_view = (uint8_t)p->f_int;
+    break;
+
+  default:
+    break;
+  }
+}
+
+/**
+  * @brief Clear the field accumulator
+  */
+static void field_reset(NmeaParser_t* p) {
+  p->f_len = 0;
+  p->f_neg = 0;
+  p->f_dot = 0;
+  p->f_frac_digits = 0;
+  p->f_first = 0;
+  p->f_int = 0;
+  p->f_frac = 0;
+}
+
+/**
+  * @brief Reset the parser and clear all decoded data
+  */
+void nmea_init(NmeaParser_t* p) {
+  memset(p, 0, sizeof(*p));
+  p->state = ST_IDLE;
+}
+
+/**
+  * @brief Feed one received character
+  */
+NmeaType_t nmea_feed(NmeaParser_t* p, char c) {
+  /* '$' always starts a new sentence, even mid-sentence (resync) */
+  if(c == '$') {
+    p->state = ST_BODY;
+    p->sum = 0;
+    p->len = 0;
+    p->field = 0;
+    p->type = NMEA_NONE;
+    p->addr_len = 0;
+    p->work = p->data;
+    field_reset(p);
+    return NMEA_NONE;
+  }
+
+  switch(p->state) {
+  case ST_BODY:
+    if(++p->len > NMEA_MAX_LEN) {
+      p->state = ST_IDLE;
+      break;
+    }
+
+    if(c == '*') {
+      if(p->field > 0) field_end(p);
+      p->state = ST_CS_HI;
+      break;
+    }
+
+    p->sum ^= (uint8_t)c;
+
+    if(c == ',') {
+      if(p->field == 0) {
+        p->type = addr_type(p);
+        /* Skip the rest of sentences we do not decode */
+        if(p->type == NMEA_NONE) {
+          p->state = ST_IDLE;
+          break;
+        }
+      }
+      else {
+        field_end(p);
+      }
+      p->field++;
+      field_reset(p);
+      break;
+    }
+
+    if(c == '\r' || c == '\n') {
+      /* Line ended without a checksum - reject */
+      p->state = ST_IDLE;
+      break;
+    }
+
+    if(p->field == 0) {
+      if(p->addr_len < sizeof(p->addr)) p->addr[p->addr_len] = c;
+      p->addr_len++;
+      break;
+    }
+
+    if(p->f_len == 0) p->f_first = c;
+    p->f_len++;
+
+    if(c >= '0' && c <= '9') {
+      if(!p->f_dot) {
+        p->f_int = p->f_int * 10 + (uint32_t)(c - '0');
+      }
+      else if(p->f_frac_digits < NMEA_FRAC_MAX) {
+        p->f_frac = p->f_frac * 10 + (uint32_t)(c - '0');
+        p->f_frac_digits++;
+      }
+    }
+    else if(c == '.') {
+      p->f_dot = 1;
+    }
+    else if(c == '-' && p->f_len == 1) {
+      p->f_neg = 1;
+    }
+    break;
+
+  case ST_CS_HI: {
+    uint8_t v = hex_val(c);
+    if(v == 0xFF) {
+      p->state = ST_IDLE;
+      break;
+    }
+    p->sum_rx = (uint8_t)(v << 4);
+    p->state = ST_CS_LO;
+    break;
+  }
+
+  case ST_CS_LO: {
+    uint8_t v = hex_val(c);
+    p->state = ST_IDLE;
+    if(v == 0xFF) break;
+
+    if((uint8_t)(p->sum_rx | v) != p->sum) {
+      p->checksum_errors++;
+      break;
+    }
+
+    p->data = p->work;
+    p->sentences++;
+    return p->type;
+  }
+
+  default:
+    break;
+  }
+
+  return NMEA_NONE;
+}
+
+/**
+  * @brief Format fixed-point degrees as decimal text
+  */
+int nmea_format_deg_e7(char* buf, size_t size, int32_t deg_e7) {
+  uint32_t a = (deg_e7 < 0) ? (uint32_t)(-(int64_t)deg_e7) : (uint32_t)deg_e7;
+  return snprintf(buf, size, "%s%lu.%07lu", (deg_e7 < 0) ? "-" : "",
+                  (unsigned long)(a / 10000000UL), (unsigned long)(a % 10000000UL));
+}
+
+/**
+  * @brief Parse decimal degree text into degrees * 1e7
+  */
+int32_t nmea_parse_deg_e7(const char* s, const char** end) {
+  uint8_t neg = 0;
+  uint32_t ip = 0, fp = 0;
+  uint8_t fd = 0;
+
+  if(*s == '-') { neg = 1; s++; }
+  else if(*s == '+') { s++; }
+
+  while(*s >= '0' && *s <= '9') {
+    ip = ip * 10 + (uint32_t)(*s++ - '0');
+  }
+
+  if(*s == '.') {
+    s++;
+    while(*s >= '0' && *s <= '9') {
+      if(fd < 7) {
+        fp = fp * 10 + (uint32_t)(*s - '0');
+        fd++;
+      }
+      s++;
+    }
+  }
+
+  if(end) *end = s;
+
+  int32_t v = (int32_t)(ip * 10000000UL + fp * pow10_tab[7 - fd]);
+  return neg ? -v : v;
+}
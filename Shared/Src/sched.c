@@ -0,0 +1,161 @@
+/* sched.c - Tick-based cooperative scheduler with ISR event flags and run-time statistics */
+#include "sched.h"
+
+static SchedTask_t* sched_tasks;
+static uint8_t sched_count;
+static volatile uint32_t sched_events;
+static uint32_t sched_event_mask;    /* Union of all task event flags */
+
+/**
+  * @brief Register the task table and reset statistics
+  */
+void sched_init(SchedTask_t* tasks, uint8_t count) {
+  sched_tasks = tasks;
+  sched_count = count;
+  sched_events = 0;
+
+  sched_event_mask = 0;
+
+  uint32_t now = HAL_GetTick();
+  for(uint8_t i = 0; i < count; i++) {
+    tasks[i].release_ms = now;
+    sched_event_mask |= tasks[i].events;
+  }
+  sched_reset_stats();
+}
+
+/**
+  * @brief Signal event flags (safe from ISRs)
+  * Cortex-M0+ has no exclusive access instructions, so the
+  * read-modify-write is protected by masking interrupts. A task released
+  * by the first of its flags remembers the tick, for its deadline.
+  */
+void sched_signal(uint32_t events) {
+  uint32_t now = HAL_GetTick();
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  for(uint8_t i = 0; i < sched_count; i++) {
+    SchedTask_t* t = &sched_tasks[i];
+    if((events & t->events) && !(sched_events & t->events)) {
+      t->signal_ms = now;
+    }
+  }
+  sched_events |= events;
+  __set_PRIMASK(primask);
+}
+
+/**
+  * @brief Atomically take the pending flags in a mask
+  */
+static uint32_t sched_take(uint32_t mask) {
+  __disable_irq();
+  uint32_t ev = sched_events & mask;
+  sched_events &= ~ev;
+  __enable_irq();
+  return ev;
+}
+
+/**
+  * @brief Microsecond timestamp from HAL tick and SysTick counter
+  */
+uint32_t sched_now_us(void) {
+  uint32_t ms, val;
+
+  /* Re-read if the tick interrupt fired between the two reads */
+  do {
+    ms = HAL_GetTick();
+    val = SysTick->VAL;
+  } while(ms != HAL_GetTick());
+
+  uint32_t load = SysTick->LOAD + 1;
+  return ms * 1000 + (load - 1 - val) / (load / 1000);
+}
+
+/**
+  * @brief Run one task and update its statistics
+  */
+static void sched_exec(SchedTask_t* t, uint32_t late_ms) {
+  if(t->deadline_ms && late_ms > t->deadline_ms) {
+    t->misses++;
+  }
+
+  uint32_t t0 = sched_now_us();
+  t->fn();
+  uint32_t dt = sched_now_us() - t0;
+
+  t->runs++;
+  t->total_us += dt;
+  if(dt > t->max_us) t->max_us = dt;
+  if(t->budget_us && dt > t->budget_us) t->overruns++;
+}
+
+/**
+  * @brief Run all released tasks once, then sleep until the next interrupt
+  */
+void sched_run(void) {
+  uint8_t ran = 0;
+
+  for(uint8_t i = 0; i < sched_count; i++) {
+    SchedTask_t* t = &sched_tasks[i];
+    uint32_t now = HAL_GetTick();
+
+    if(t->events && sched_take(t->events)) {
+      /* Tick read after the take: a flag signalled since is not early */
+      sched_exec(t, HAL_GetTick() - t->signal_ms);
+      ran = 1;
+      continue;
+    }
+
+    if(t->period_ms && (int32_t)(now - t->release_ms) >= 0) {
+      uint32_t late = now - t->release_ms;
+      t->release_ms += t->period_ms;
+
+      /* Skip releases missed while far behind instead of bursting */
+      if((int32_t)(now - t->release_ms) >= 0) {
+        t->release_ms = now + t->period_ms;
+      }
+
+      sched_exec(t, late);
+      ran = 1;
+    }
+  }
+
+  /* Nothing released: sleep until SysTick or a peripheral interrupt.
+   * Interrupts are masked across the check so an event signalled just
+   * before WFI still wakes the core immediately. */
+  if(!ran) {
+    __disable_irq();
+    if(!(sched_events & sched_event_mask)) {
+      __WFI();
+    }
+    __enable_irq();
+  }
+}
+
+/**
+  * @brief Clear all run-time statistics
+  */
+void sched_reset_stats(void) {
+  for(uint8_t i = 0; i < sched_count; i++) {
+    SchedTask_t* t = &sched_tasks[i];
+    t->runs = 0;
+    t->total_us = 0;
+    t->max_us = 0;
+    t->overruns = 0;
+    t->misses = 0;
+  }
+}
+
+/**
+  * @brief Number of registered tasks
+  */
+uint8_t sched_task_count(void) {
+  return sched_count;
+}
+
+/**
+  * @brief Task descriptor by index
+  */
+const SchedTask_t* sched_task(uint8_t i) {
+  return (i < sched_count) ? &sched_tasks[i] : 0;
+}
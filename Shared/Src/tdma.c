@@ -0,0 +1,188 @@
+/* tdma.c - Time-slotted LoRa schedule shared by the controller and its boats */
+#include "tdma.h"
+
+/**
+  * @brief Time on air rounded up to whole milliseconds
+  */
+static uint32_t tdma_air_ms(uint32_t air_us) {
+  return (air_us + 999U) / 1000U;
+}
+
+/**
+  * @brief Check whether a boat's timing has gone stale
+  */
+static uint8_t tdma_stale(const Tdma_t* t, uint32_t now) {
+  return t->follower && now - t->sync_ms > TDMA_SYNC_LOST_FRAMES * tdma_frame_ms(t);
+}
+
+/**
+  * @brief Start of frame 0 at a given time, with the boat's drift since SYNC
+  */
+static uint32_t tdma_start_at(const Tdma_t* t, uint32_t now) {
+  int64_t since = (int32_t)(now - t->sync_ms);
+  return t->start_ms + (uint32_t)(int32_t)(since * t->drift_ppm / 1000000);
+}
+
+/**
+  * @brief Size the windows for a modulation and a number of boats
+  */
+void tdma_plan(Tdma_t* t, const LoRaPhy_t* phy, uint16_t base, uint8_t boats) {
+  if(boats < 1) boats = 1;
+  if(boats > TDMA_BOATS_MAX) boats = TDMA_BOATS_MAX;
+
+  t->base = base;
+  t->boats = boats;
+  t->down_ms = (uint16_t)(tdma_air_ms(lora_airtime_us(phy, TDMA_DOWN_BYTES)) +
+                          TDMA_LINK_DELAY_MS + TDMA_GUARD_MS);
+  t->up_ms = (uint16_t)(tdma_air_ms(lora_airtime_us(phy, TDMA_UP_BYTES)) +
+                        TDMA_LINK_DELAY_MS + TDMA_GUARD_MS);
+}
+
+/**
+  * @brief Start frame 0 now
+  */
+void tdma_start(Tdma_t* t, uint32_t now) {
+  t->start_ms = now;
+  t->synced = 1;
+  t->follower = 0;
+}
+
+/**
+  * @brief Window at a given time
+  */
+uint8_t tdma_window(const Tdma_t* t, uint32_t now, TdmaWindow_t* w) {
+  if(!t->synced || tdma_stale(t, now)) return 0;
+
+  uint32_t frame_ms = tdma_frame_ms(t);
+  uint32_t elapsed = now - tdma_start_at(t, now);
+  uint32_t pos = elapsed % frame_ms;
+  uint32_t frame_start = now - pos;
+
+  w->frame = elapsed / frame_ms;
+  w->slot = (uint8_t)(w->frame % t->boats);
+  w->up = pos >= t->down_ms;
+  w->start_ms = w->up ? frame_start + t->down_ms : frame_start;
+  w->end_ms = w->up ? frame_start + frame_ms : frame_start + t->down_ms;
+  return 1;
+}
+
+/**
+  * @brief Check whether a frame fits an empty window at all
+  */
+uint8_t tdma_fits(const Tdma_t* t, uint8_t up, uint32_t air_us) {
+  uint32_t window = up ? t->up_ms : t->down_ms;
+  return TDMA_LINK_DELAY_MS + tdma_air_ms(air_us) + TDMA_GUARD_MS <= window;
+}
+
+/**
+  * @brief Claim the channel for one frame
+  */
+uint8_t tdma_may_send(Tdma_t* t, uint8_t up, uint8_t slot, uint32_t air_us, uint32_t now) {
+  TdmaWindow_t w;
+
+  if(t->synced && tdma_stale(t, now)) {
+    t->synced = 0;
+    t->sync_losses++;
+  }
+  if(!tdma_window(t, now, &w)) return 0;
+  if(w.up != up || (up && w.slot != slot)) return 0;
+  if((int32_t)(now - t->busy_ms) < 0) return 0;
+
+  uint32_t end = now + TDMA_LINK_DELAY_MS + tdma_air_ms(air_us);
+  if((int32_t)(w.end_ms - end) < TDMA_GUARD_MS) return 0;
+
+  t->busy_ms = end;
+  t->sent++;
+  return 1;
+}
+
+/**
+  * @brief Build the SYNC payload for a frame sent now
+  */
+uint8_t tdma_sync_build(const Tdma_t* t, uint32_t now, FrameSync_t* s) {
+  TdmaWindow_t w;
+  if(!tdma_window(t, now, &w)) return 0;
+
+  uint32_t offset = now - w.start_ms;
+  s->base = t->base;
+  s->boats = t->boats;
+  s->frame = w.slot;
+  s->offset_ms = (uint8_t)(offset > 255 ? 255 : offset);
+  s->down_ms = t->down_ms;
+  s->up_ms = t->up_ms;
+  return 1;
+}
+
+/**
+  * @brief Take the schedule and timing from a received SYNC
+  */
+uint8_t tdma_on_sync(Tdma_t* t, const FrameSync_t* s, uint32_t air_us, uint32_t rx_ms) {
+  if(s->boats < 1 || s->boats > TDMA_BOATS_MAX || s->frame >= s->boats || !s->down_ms || !s->up_ms) {
+    return 0;
+  }
+
+  /* Same schedule, timing still valid: how far the boat's clock ran off
+   * since the last SYNC, the downlink corrections included */
+  uint8_t same = t->synced && t->follower && !tdma_stale(t, rx_ms) && t->boats == s->boats &&
+                 t->down_ms == s->down_ms && t->up_ms == s->up_ms;
+  uint32_t predicted = tdma_start_at(t, rx_ms);
+  uint32_t since = rx_ms - t->sync_ms;
+
+  t->base = s->base;
+  t->boats = s->boats;
+  t->down_ms = s->down_ms;
+  t->up_ms = s->up_ms;
+
+  /* Send time at the controller, then back to the superframe start */
+  uint32_t sent = rx_ms - tdma_air_ms(air_us) - TDMA_LINK_DELAY_MS;
+  t->start_ms = sent - s->offset_ms - (uint32_t)s->frame * tdma_frame_ms(t);
+
+  if(same && since >= tdma_frame_ms(t)) {
+    int32_t super_ms = (int32_t)(tdma_frame_ms(t) * t->boats);
+    int32_t err = (int32_t)(t->start_ms - predicted) % super_ms;
+    if(err > super_ms / 2) err -= super_ms;
+    if(err < -super_ms / 2) err += super_ms;
+    t->drift_ppm += (int32_t)((int64_t)(err + t->align_ms) * 1000000 / (int32_t)since);
+    if(t->drift_ppm > TDMA_DRIFT_MAX_PPM) t->drift_ppm = TDMA_DRIFT_MAX_PPM;
+    if(t->drift_ppm < -TDMA_DRIFT_MAX_PPM) t->drift_ppm = -TDMA_DRIFT_MAX_PPM;
+  }
+  else if(!same) {
+    t->drift_ppm = 0;
+  }
+  t->align_ms = 0;
+  t->synced = 1;
+  t->follower = 1;
+  t->sync_ms = rx_ms;
+  t->syncs++;
+  return 1;
+}
+
+/**
+  * @brief Keep the timing on a downlink other than SYNC
+  */
+int32_t tdma_on_downlink(Tdma_t* t, uint32_t air_us, uint32_t rx_ms) {
+  if(!t->follower || !t->synced) return 0;
+
+  /* Send time at the controller and the latest start that still ends the
+   * frame TDMA_GUARD_MS before the downlink window closes */
+  uint32_t len = TDMA_LINK_DELAY_MS + tdma_air_ms(air_us);
+  if(len + TDMA_GUARD_MS > t->down_ms) return 0;
+  uint32_t sent = rx_ms - len;
+  uint32_t latest = t->down_ms - TDMA_GUARD_MS - len;
+
+  uint32_t frame_ms = tdma_frame_ms(t);
+  uint32_t pos = (sent - tdma_start_at(t, sent)) % frame_ms;
+  if(pos <= latest) return 0;
+
+  /* Either the boat's frame starts too early (move it later) or the frame
+   * came before the boat's next one began (move it earlier) */
+  int32_t shift = (pos - latest < frame_ms - pos) ? (int32_t)(pos - latest)
+                                                  : -(int32_t)(frame_ms - pos);
+  if(shift > TDMA_ALIGN_MAX_MS) shift = TDMA_ALIGN_MAX_MS;
+  if(shift < -TDMA_ALIGN_MAX_MS) shift = -TDMA_ALIGN_MAX_MS;
+
+  t->start_ms += (uint32_t)shift;
+  t->align_ms += shift;
+  t->aligns++;
+  return shift;
+}
@@ -0,0 +1,80 @@
+/* uart_rx.c - DMA circular-buffer UART receive engine with idle-line framing */
+#include "uart_rx.h"
+
+/**
+  * @brief Start (or restart) circular DMA reception with idle-line detection
+  */
+HAL_StatusTypeDef uart_rx_start(UartRx_t* rx) {
+  rx->dma_tail = 0;
+  rx->line_len = 0;
+  rx->discard = 0;
+  return HAL_UARTEx_ReceiveToIdle_DMA(rx->huart, rx->dma_buf, rx->dma_size);
+}
+
+/**
+  * @brief Feed raw bytes into the line assembler
+  * Lines end on CR or LF; empty lines are skipped. Overlong lines are
+  * dropped up to the next line ending instead of being delivered truncated.
+  * In raw mode every byte goes straight to the byte handler.
+  */
+void uart_rx_feed(UartRx_t* rx, const uint8_t* data, size_t len) {
+  rx->bytes += len;
+
+  if(rx->on_byte) {
+    for(size_t i = 0; i < len; i++) {
+      rx->on_byte((char)data[i]);
+    }
+    return;
+  }
+
+  for(size_t i = 0; i < len; i++) {
+    char c = (char)data[i];
+
+    if(c == '\n' || c == '\r') {
+      if(rx->line_len > 0 && !rx->discard) {
+        rx->line[rx->line_len] = 0;
+        rx->lines++;
+        rx->on_line(rx->line);
+      }
+      rx->line_len = 0;
+      rx->discard = 0;
+      continue;
+    }
+
+    if(rx->discard) continue;
+
+    /* Wait for the start character before accumulating */
+    if(rx->line_len == 0 && rx->start_char && c != rx->start_char) continue;
+
+    if(rx->line_len < rx->line_max - 1) {
+      rx->line[rx->line_len++] = c;
+    }
+    else {
+      /* Line too long - drop it */
+      rx->overflows++;
+      rx->line_len = 0;
+      rx->discard = 1;
+    }
+  }
+}
+
+/**
+  * @brief Consume bytes written by DMA since the last event
+  * Handles wrap-around of the circular buffer. The tail is kept at
+  * dma_size after a transfer-complete event rather than folded to 0, so the
+  * same end position reported again (TC followed by IDLE) reads nothing.
+  */
+void uart_rx_on_event(UartRx_t* rx, uint16_t pos) {
+  if(pos > rx->dma_size) return;
+
+  if(pos > rx->dma_tail) {
+    uart_rx_feed(rx, &rx->dma_buf[rx->dma_tail], pos - rx->dma_tail);
+  }
+  else if(pos < rx->dma_tail) {
+    /* DMA wrapped: finish the end of the buffer, then the start */
+    uart_rx_feed(rx, &rx->dma_buf[rx->dma_tail], rx->dma_size - rx->dma_tail);
+    uart_rx_feed(rx, rx->dma_buf, pos);
+  }
+
+  rx->dma_tail = pos;
+}
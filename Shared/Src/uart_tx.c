@@ -0,0 +1,176 @@
+/* uart_tx.c - Non-blocking DMA UART transmit queue with back-pressure policy */
+#include "uart_tx.h"
+#include <string.h>
+
+static inline uint32_t tx_lock(void) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  return primask;
+}
+
+static inline void tx_unlock(uint32_t primask) {
+  __set_PRIMASK(primask);
+}
+
+/**
+  * @brief Copy bytes into the ring at head, wrapping as needed
+  */
+static void ring_put(UartTxRing_t* r, const uint8_t* src, uint16_t len) {
+  for(uint16_t i = 0; i < len; i++) {
+    r->buf[r->head] = src[i];
+    if(++r->head == r->size) r->head = 0;
+  }
+  r->used += len;
+}
+
+/**
+  * @brief Copy bytes out of the ring at tail (dst may be NULL to discard)
+  */
+static void ring_get(UartTxRing_t* r, uint8_t* dst, uint16_t len) {
+  for(uint16_t i = 0; i < len; i++) {
+    if(dst) dst[i] = r->buf[r->tail];
+    if(++r->tail == r->size) r->tail = 0;
+  }
+  r->used -= len;
+}
+
+/**
+  * @brief Length of the oldest message in the ring, 0 if empty
+  */
+static uint16_t ring_front_len(const UartTxRing_t* r) {
+  return r->used ? r->buf[r->tail] : 0;
+}
+
+/**
+  * @brief Start a DMA transfer of queued messages if the UART is idle
+  * Packs whole messages into the staging buffer, control first.
+  * Must be called with interrupts disabled.
+  */
+static void tx_kick(UartTx_t* tx) {
+  if(tx->busy) return;
+
+  uint16_t n = 0;
+  UartTxRing_t* rings[2] = { &tx->ctrl, &tx->telem };
+
+  for(uint8_t i = 0; i < 2; i++) {
+    UartTxRing_t* r = rings[i];
+    uint16_t len;
+    while((len = ring_front_len(r)) != 0 && n + len <= tx->dma_size) {
+      ring_get(r, NULL, 1);
+      ring_get(r, &tx->dma_buf[n], len);
+      n += len;
+    }
+  }
+
+  if(n == 0) return;
+
+  tx->busy = 1;
+  if(HAL_UART_Transmit_DMA(tx->huart, tx->dma_buf, n) != HAL_OK) {
+    tx->busy = 0;
+    tx->drops++;
+    return;
+  }
+  tx->batches++;
+}
+
+/**
+  * @brief Queue a message made of two segments
+  */
+static uint8_t tx_enqueue(UartTx_t* tx, const uint8_t* a, uint16_t alen,
+                          const uint8_t* b, uint16_t blen, UartTxClass_t cls) {
+  uint16_t len = alen + blen;
+  UartTxRing_t* r = (cls == UART_TX_CONTROL) ? &tx->ctrl : &tx->telem;
+
+  if(len == 0 || len > tx->dma_size || len > 255 || len + 1 > r->size) {
+    if(cls == UART_TX_CONTROL) tx->ctrl_drops++;
+    else tx->drops++;
+    return 0;
+  }
+
+  uint32_t primask = tx_lock();
+
+  if(r->used + len + 1 > r->size) {
+    if(cls == UART_TX_CONTROL) {
+      /* Control is never evicted, and waiting would stall the caller */
+      tx->ctrl_drops++;
+      tx_unlock(primask);
+      return 0;
+    }
+    /* Drop oldest telemetry until the new message fits */
+    while(r->used + len + 1 > r->size) {
+      ring_get(r, NULL, (uint16_t)(ring_front_len(r) + 1));
+      tx->drops++;
+    }
+  }
+
+  uint8_t hdr = (uint8_t)len;
+  ring_put(r, &hdr, 1);
+  ring_put(r, a, alen);
+  if(blen) ring_put(r, b, blen);
+  tx->bytes += len;
+
+  uint16_t q = (uint16_t)(tx->ctrl.used + tx->telem.used);
+  if(q > tx->peak) tx->peak = q;
+
+  /* The next transfer started picks the message up (unless the staging
+   * buffer fills with older messages first) */
+  tx->last_batch = tx->batches + 1;
+  tx_kick(tx);
+  tx_unlock(primask);
+  return 1;
+}
+
+/**
+  * @brief Queue a message for transmission
+  */
+uint8_t uart_tx_write(UartTx_t* tx, const void* data, uint16_t len, UartTxClass_t cls) {
+  return tx_enqueue(tx, (const uint8_t*)data, len, NULL, 0, cls);
+}
+
+/**
+  * @brief Queue a null-terminated line followed by CR LF
+  */
+uint8_t uart_tx_line(UartTx_t* tx, const char* s, UartTxClass_t cls) {
+  return tx_enqueue(tx, (const uint8_t*)s, (uint16_t)strlen(s),
+                    (const uint8_t*)"\r\n", 2, cls);
+}
+
+/**
+  * @brief Longest message the class's ring takes now without dropping one
+  */
+uint16_t uart_tx_room(const UartTx_t* tx, UartTxClass_t cls) {
+  const UartTxRing_t* r = (cls == UART_TX_CONTROL) ? &tx->ctrl : &tx->telem;
+  uint16_t used = r->used;
+  uint16_t room = (used + 1 < r->size) ? (uint16_t)(r->size - used - 1) : 0;
+  if(room > tx->dma_size) room = tx->dma_size;
+  if(room > 255) room = 255;
+  return room;
+}
+
+/**
+  * @brief Bytes currently queued (both classes, excluding in-flight DMA)
+  */
+uint16_t uart_tx_queued(const UartTx_t* tx) {
+  return (uint16_t)(tx->ctrl.used + tx->telem.used);
+}
+
+/**
+  * @brief DMA transfer complete; start the next batch
+  */
+void uart_tx_on_complete(UartTx_t* tx) {
+  uint32_t primask = tx_lock();
+  tx->busy = 0;
+  tx_kick(tx);
+  tx_unlock(primask);
+}
+
+/**
+  * @brief Recover after a UART error aborted the transfer in flight
+  * Receive-side errors leave the transmitter running; only restart once
+  * HAL reports the transmitter idle.
+  */
+void uart_tx_on_error(UartTx_t* tx) {
+  if(tx->busy && tx->huart->gState == HAL_UART_STATE_READY) {
+    uart_tx_on_complete(tx);
+  }
+}
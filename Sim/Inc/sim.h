@@ -0,0 +1,69 @@
+/* sim.h - Interfaces between the host simulation modules */
+#ifndef __SIM_H
+#define __SIM_H
+
+#include "main.h"
+#include <stdint.h>
+#include <stddef.h>
+
+/* Poll interval for file descriptors (UART backends, radio socket) */
+#define SIM_FD_POLL_NS  100000ULL
+
+/**
+  * @brief Monotonic time in nanoseconds
+  * CLOCK_MONOTONIC, so trace timestamps of both boards line up
+  */
+uint64_t sim_now_ns(void);
+
+/**
+  * @brief Board time in milliseconds (HAL_GetTick) for a host time
+  */
+uint32_t sim_board_ms(uint64_t now);
+
+/**
+  * @brief Numeric environment setting
+  * @param name: Variable name
+  * @param def: Value when unset or empty
+  */
+uint32_t sim_env_u32(const char* name, uint32_t def);
+
+/**
+  * @brief Print a timestamped trace line on stderr when SIM_TRACE is set
+  * Format: "<seconds>.<micros> <board> <message>"
+  */
+void sim_trace(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+
+/* ---- UART ---- */
+
+typedef struct SimUart SimUart_t;
+
+/**
+  * @brief Device side of a UART: receives what the firmware transmits
+  */
+typedef void (*SimUartSinkFn)(const uint8_t* data, size_t len);
+
+/**
+  * @brief Attach an emulated device instead of a file descriptor
+  */
+void sim_uart_set_sink(SimUart_t* u, SimUartSinkFn sink);
+
+/**
+  * @brief Queue bytes on the line towards the MCU
+  * They reach the DMA buffer at the configured baud rate.
+  */
+void sim_uart_inject(SimUart_t* u, const void* data, size_t len);
+
+void sim_uart_poll(uint64_t now);
+void sim_uart_report(void);
+
+/* ---- LoRa module ---- */
+
+/**
+  * @brief Connect the RYLR emulator to a UART
+  */
+void sim_lora_attach(SimUart_t* u);
+
+void sim_lora_poll(uint64_t now);
+void sim_lora_report(void);
+
+#endif /* __SIM_H */
@@ -0,0 +1,17 @@
+/* sim_cmsis.h - Move the Cortex-M interrupt intrinsics out of the way on the host */
+#ifndef __SIM_CMSIS_H
+#define __SIM_CMSIS_H
+
+/* Included before the vendor headers: cmsis_gcc.h then defines its
+ * inline-assembly versions under these unused names, and sim_hal.h points
+ * the real names at the interrupt emulation. */
+#define __enable_irq    cmsis_enable_irq
+#define __disable_irq   cmsis_disable_irq
+#define __get_PRIMASK   cmsis_get_PRIMASK
+#define __set_PRIMASK   cmsis_set_PRIMASK
+#define __get_IPSR      cmsis_get_IPSR
+#define __DMB           cmsis_DMB
+#define __DSB           cmsis_DSB
+#define __ISB           cmsis_ISB
+
+#endif /* __SIM_CMSIS_H */
@@ -0,0 +1,107 @@
+/* sim_hal.h - Host simulation layer: interrupt emulation and peripheral redirects
+ *
+ * The firmware is compiled unchanged against the vendor HAL headers. The
+ * HAL functions it calls are implemented on the host (Sim/Src), and the
+ * few peripherals it touches at register level (SysTick, SCB, DWT, TIMx,
+ * RCC, PWR) are redirected to plain structs in host memory.
+ *
+ * Interrupts are emulated: pending UART, DMA, ADC and radio events are
+ * delivered by sim_poll(), which runs from HAL_GetTick(), __WFI() and on
+ * every unmask. Callbacks therefore interrupt the firmware only at those
+ * points, never while PRIMASK is set and never inside another callback.
+ */
+#ifndef __SIM_HAL_H
+#define __SIM_HAL_H
+
+#include <stdint.h>
+
+/**
+  * @brief Deliver all pending emulated interrupts
+  * No-op while interrupts are masked or when already in a callback
+  */
+void sim_poll(void);
+
+/**
+  * @brief Emulated WFI: sleep briefly, then deliver pending interrupts
+  */
+void sim_wfi(void);
+
+void     sim_enable_irq(void);
+void     sim_disable_irq(void);
+uint32_t sim_get_PRIMASK(void);
+void     sim_set_PRIMASK(uint32_t primask);
+uint32_t sim_get_IPSR(void);
+
+#undef __enable_irq
+#undef __disable_irq
+#undef __get_PRIMASK
+#undef __set_PRIMASK
+#undef __get_IPSR
+#undef __WFI
+#undef __DMB
+#undef __DSB
+#undef __ISB
+#define __enable_irq    sim_enable_irq
+#define __disable_irq   sim_disable_irq
+#define __get_PRIMASK   sim_get_PRIMASK
+#define __set_PRIMASK   sim_set_PRIMASK
+#define __get_IPSR      sim_get_IPSR
+#define __WFI()         sim_wfi()
+#define __DMB()         __sync_synchronize()
+#define __DSB()         __sync_synchronize()
+#define __ISB()         __sync_synchronize()
+
+/* Register-level peripherals backed by host memory */
+extern SysTick_Type sim_systick;
+#undef SysTick
+#define SysTick (&sim_systick)
+
+extern SCB_Type sim_scb;
+#undef SCB
+#define SCB (&sim_scb)
+
+#ifdef DWT
+extern DWT_Type sim_dwt;
+extern CoreDebug_Type sim_coredebug;
+#undef DWT
+#undef CoreDebug
+#define DWT       (&sim_dwt)
+#define CoreDebug (&sim_coredebug)
+#endif
+
+extern RCC_TypeDef sim_rcc;
+extern PWR_TypeDef sim_pwr;
+#undef RCC
+#undef PWR
+#define RCC (&sim_rcc)
+#define PWR (&sim_pwr)
+
+/* Timers by number; sim_tim[n] is TIMn */
+#define SIM_TIM_COUNT 8
+extern TIM_TypeDef sim_tim[SIM_TIM_COUNT];
+#ifdef TIM1
+#undef TIM1
+#define TIM1 (&sim_tim[1])
+#endif
+#ifdef TIM2
+#undef TIM2
+#define TIM2 (&sim_tim[2])
+#endif
+#ifdef TIM3
+#undef TIM3
+#define TIM3 (&sim_tim[3])
+#endif
+#ifdef TIM4
+#undef TIM4
+#define TIM4 (&sim_tim[4])
+#endif
+#ifdef TIM6
+#undef TIM6
+#define TIM6 (&sim_tim[6])
+#endif
+#ifdef TIM7
+#undef TIM7
+#define TIM7 (&sim_tim[7])
+#endif
+
+#endif /* __SIM_HAL_H */
@@ -0,0 +1,9 @@
+/* stm32l0xx_hal.h - Host build shadow of the vendor HAL header */
+#ifndef __SIM_STM32L0xx_HAL_H
+#define __SIM_STM32L0xx_HAL_H
+
+#include "sim_cmsis.h"
+#include_next "stm32l0xx_hal.h"
+#include "sim_hal.h"
+
+#endif /* __SIM_STM32L0xx_HAL_H */
@@ -0,0 +1,521 @@
+/* sim_hal.c - Host implementation of the core HAL: tick, interrupts, clocks, GPIO, ADC, timers */
+#include "sim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Emulated WFI sleep; bounds the interrupt latency seen by an idle loop */
+#define SIM_WFI_US      200
+
+/* A main loop reading the same tick this often is polling idle; sleeping
+ * then lets the other boards of a multi-board test share a small host */
+#define SIM_SPIN_READS  64
+#define SIM_SPIN_US     50
+
+uint32_t SystemCoreClock = SIM_CORE_HZ;
+
+SysTick_Type sim_systick;
+#ifdef DWT
+DWT_Type sim_dwt;
+CoreDebug_Type sim_coredebug;
+#endif
+RCC_TypeDef sim_rcc;
+PWR_TypeDef sim_pwr;
+SCB_Type    sim_scb;
+TIM_TypeDef sim_tim[SIM_TIM_COUNT];
+
+static volatile uint8_t sim_masked = 0;   /* Emulated PRIMASK */
+static volatile uint8_t sim_in_isr = 0;   /* A callback is running */
+static uint64_t sim_start_ns;
+static int32_t  sim_clock_ppm;            /* SIM_CLOCK_PPM: board clock error */
+static uint64_t sim_end_ns;               /* SIM_DURATION_MS deadline, 0 = none */
+static uint8_t  sim_tracing;
+
+/* Input pins: level from SIM_P<port><pin>, else the configured pull */
+#define SIM_PORTS 3
+static int8_t  pin_env[SIM_PORTS][16];
+static uint8_t pin_pullup[SIM_PORTS][16];
+
+static void sim_pwm_poll(void);
+#ifdef HAL_TIM_MODULE_ENABLED
+static void sim_tim_poll(uint64_t now);
+#endif
+#ifdef HAL_ADC_MODULE_ENABLED
+static void sim_adc_poll(uint64_t now);
+#endif
+
+/**
+  * @brief Monotonic time in nanoseconds
+  */
+uint64_t sim_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/**
+  * @brief Numeric environment setting
+  */
+uint32_t sim_env_u32(const char* name, uint32_t def) {
+  const char* v = getenv(name);
+  if(!v || !*v) return def;
+  return (uint32_t)strtoul(v, NULL, 0);
+}
+
+/**
+  * @brief Board time in microseconds, running SIM_CLOCK_PPM fast or slow
+  */
+static uint64_t sim_board_us(uint64_t now) {
+  uint64_t ns = now - sim_start_ns;
+  return (uint64_t)((int64_t)ns + (int64_t)ns / 1000000 * sim_clock_ppm) / 1000ULL;
+}
+
+/**
+  * @brief Board time in milliseconds (HAL_GetTick) for a host time
+  */
+uint32_t sim_board_ms(uint64_t now) {
+  return (uint32_t)(sim_board_us(now) / 1000ULL);
+}
+
+/**
+  * @brief Timestamped trace line on stderr
+  */
+void sim_trace(const char* fmt, ...) {
+  if(!sim_tracing) return;
+
+  uint64_t us = sim_now_ns() / 1000;
+  char msg[256];
+  va_list ap;
+  va_start(ap, fmt);
+  vsnprintf(msg, sizeof(msg), fmt, ap);
+  va_end(ap);
+
+  fprintf(stderr, "%llu.%06llu %s %s\n", (unsigned long long)(us / 1000000),
+          (unsigned long long)(us % 1000000), SIM_BOARD, msg);
+}
+
+/**
+  * @brief Print the per-peripheral counters at exit
+  */
+static void sim_report(void) {
+  /* Board clock zero on the host monotonic clock, to line up both boards' logs */
+  fprintf(stderr, "SIM %s EPOCH %llu us\n", SIM_BOARD, (unsigned long long)(sim_start_ns / 1000));
+  sim_uart_report();
+  sim_lora_report();
+}
+
+/**
+  * @brief Derive SysTick->VAL and DWT->CYCCNT from the host clock
+  */
+static void sim_clock_update(uint64_t now) {
+  uint64_t us = sim_board_us(now);
+  uint32_t load = sim_systick.LOAD + 1;
+  sim_systick.VAL = load - 1 - (uint32_t)((us % 1000) * (load / 1000));
+#ifdef DWT
+  if(sim_dwt.CTRL & DWT_CTRL_CYCCNTENA_Msk) {
+    sim_dwt.CYCCNT = (uint32_t)(us * (SystemCoreClock / 1000000U));
+  }
+#endif
+}
+
+/**
+  * @brief Deliver all pending emulated interrupts
+  */
+void sim_poll(void) {
+  if(sim_masked || sim_in_isr) return;
+
+  uint64_t now = sim_now_ns();
+  if(sim_end_ns && now >= sim_end_ns) exit(0);
+
+  sim_in_isr = 1;
+  sim_clock_update(now);
+  sim_uart_poll(now);
+  sim_lora_poll(now);
+#ifdef HAL_ADC_MODULE_ENABLED
+  sim_adc_poll(now);
+#endif
+#ifdef HAL_TIM_MODULE_ENABLED
+  sim_tim_poll(now);
+#endif
+  sim_pwm_poll();
+  sim_in_isr = 0;
+}
+
+/**
+  * @brief Emulated WFI
+  * Pending interrupts wake the core but run only once PRIMASK is cleared,
+  * as on the target.
+  */
+void sim_wfi(void) {
+  usleep(SIM_WFI_US);
+  sim_poll();
+}
+
+void sim_enable_irq(void) {
+  sim_masked = 0;
+  sim_poll();
+}
+
+void sim_disable_irq(void) {
+  sim_masked = 1;
+}
+
+uint32_t sim_get_PRIMASK(void) {
+  return sim_masked;
+}
+
+void sim_set_PRIMASK(uint32_t primask) {
+  sim_masked = (uint8_t)(primask & 1U);
+  if(!sim_masked) sim_poll();
+}
+
+uint32_t sim_get_IPSR(void) {
+  return sim_in_isr ? 16U : 0U;
+}
+
+/* ---- Core ---- */
+
+/**
+  * @brief Start the simulation; called first by both firmware images
+  */
+HAL_StatusTypeDef HAL_Init(void) {
+  char name[16];
+
+  sim_start_ns = sim_now_ns();
+  sim_tracing = (uint8_t)sim_env_u32("SIM_TRACE", 0);
+  sim_clock_ppm = (int32_t)sim_env_u32("SIM_CLOCK_PPM", 0);
+  uint32_t duration = sim_env_u32("SIM_DURATION_MS", 0);
+  if(duration) sim_end_ns = sim_start_ns + (uint64_t)duration * 1000000ULL;
+
+  sim_systick.LOAD = SystemCoreClock / 1000U - 1U;
+
+  for(int p = 0; p < SIM_PORTS; p++) {
+    for(int i = 0; i < 16; i++) {
+      snprintf(name, sizeof(name), "SIM_P%c%d", 'A' + p, i);
+      pin_env[p][i] = getenv(name) ? (int8_t)(sim_env_u32(name, 0) != 0) : -1;
+    }
+  }
+
+  atexit(sim_report);
+  return HAL_OK;
+}
+
+uint32_t HAL_GetTick(void) {
+  static uint32_t last_ms, reads;
+
+  sim_poll();
+  uint64_t now = sim_now_ns();
+  sim_clock_update(now);
+  uint32_t ms = sim_board_ms(now);
+
+  if(ms != last_ms) {
+    last_ms = ms;
+    reads = 0;
+  }
+  else if(++reads >= SIM_SPIN_READS && !sim_in_isr && !sim_masked) {
+    reads = 0;
+    usleep(SIM_SPIN_US);
+  }
+  return ms;
+}
+
+void HAL_Delay(uint32_t Delay) {
+  uint64_t end = sim_now_ns() + (uint64_t)Delay * 1000000ULL;
+  while(sim_now_ns() < end) {
+    usleep(SIM_WFI_US);
+    sim_poll();
+  }
+}
+
+/* Device UID: the same across reboots of a board, SIM_UID picks word 0 */
+uint32_t HAL_GetUIDw0(void) {
+  return sim_env_u32("SIM_UID", 0x00390021U);
+}
+
+uint32_t HAL_GetUIDw1(void) {
+  return 0x484E5003U;
+}
+
+uint32_t HAL_GetUIDw2(void) {
+  return 0x20383751U;
+}
+
+HAL_StatusTypeDef HAL_RCC_OscConfig(const RCC_OscInitTypeDef* RCC_OscInitStruct) {
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RCC_ClockConfig(const RCC_ClkInitTypeDef* RCC_ClkInitStruct, uint32_t FLatency) {
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RCCEx_PeriphCLKConfig(RCC_PeriphCLKInitTypeDef* PeriphClkInit) {
+  return HAL_OK;
+}
+
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority) {
+}
+
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn) {
+}
+
+/* ---- GPIO ---- */
+
+static int sim_port(GPIO_TypeDef* port) {
+  if(port == GPIOA) return 0;
+  if(port == GPIOB) return 1;
+  if(port == GPIOC) return 2;
+  return -1;
+}
+
+void HAL_GPIO_Init(GPIO_TypeDef* GPIOx, GPIO_InitTypeDef* GPIO_Init) {
+  int p = sim_port(GPIOx);
+  if(p < 0) return;
+
+  for(int i = 0; i < 16; i++) {
+    if(GPIO_Init->Pin & (1U << i)) {
+      pin_pullup[p][i] = (GPIO_Init->Pull == GPIO_PULLUP);
+    }
+  }
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin) {
+  int p = sim_port(GPIOx);
+  if(p < 0) return GPIO_PIN_RESET;
+
+  for(int i = 0; i < 16; i++) {
+    if(GPIO_Pin & (1U << i)) {
+      uint8_t level = pin_env[p][i] >= 0 ? (uint8_t)pin_env[p][i] : pin_pullup[p][i];
+      return level ? GPIO_PIN_SET : GPIO_PIN_RESET;
+    }
+  }
+  return GPIO_PIN_RESET;
+}
+
+/* ---- ADC ---- */
+
+#ifdef HAL_ADC_MODULE_ENABLED
+/*
+ * Conversions are triggered by TIM6 TRGO (the only trigger the firmware
+ * uses) and written to the DMA buffer in circular mode, one sample per
+ * selected channel in ascending channel order. Channel levels come from
+ * SIM_ADC<n> (default mid-scale); SIM_ADC_SWEEP=<n>[,...] drives the listed
+ * channels with a triangle wave around mid-scale, period SIM_ADC_PERIOD_MS,
+ * from SIM_ADC_SWEEP_AT_MS on (default 0).
+ */
+#define SIM_ADC_CHANNELS 19
+
+static ADC_HandleTypeDef* adc_handle;
+static uint16_t* adc_buf;
+static uint32_t  adc_len;
+static uint32_t  adc_idx;
+static uint32_t  adc_chsel;
+static uint64_t  adc_next_ns;
+static uint16_t  adc_level[SIM_ADC_CHANNELS];
+static uint32_t  adc_sweep;                    /* Swept channels, bit n = channel n */
+static uint32_t  adc_period_ms;
+static uint32_t  adc_sweep_at_ms;              /* Swept channels at mid-scale until then */
+
+__attribute__((weak)) void HAL_ADC_ConvHalfCpltCallback(ADC_HandleTypeDef* hadc) {
+}
+
+__attribute__((weak)) void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef* hadc) {
+}
+
+/**
+  * @brief Level of one channel at a given time
+  */
+static uint16_t sim_adc_sample(uint8_t ch, uint64_t now) {
+  uint64_t ms = (now - sim_start_ns) / 1000000ULL;
+  if((adc_sweep & (1U << ch)) && ms < adc_sweep_at_ms) return 2048;
+  if(adc_sweep & (1U << ch)) {
+    uint32_t q = (uint32_t)((ms - adc_sweep_at_ms) % adc_period_ms) * 4096U / adc_period_ms;
+    /* 0..4096 over one period: up to the top, down to the bottom, back */
+    int32_t tri = (q < 1024) ? (int32_t)q : (q < 3072) ? 2048 - (int32_t)q : (int32_t)q - 4096;
+    return (uint16_t)(2048 + tri * 2047 / 1024);
+  }
+  return adc_level[ch];
+}
+
+HAL_StatusTypeDef HAL_ADC_Init(ADC_HandleTypeDef* hadc) {
+  hadc->State = HAL_ADC_STATE_READY;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ADC_ConfigChannel(ADC_HandleTypeDef* hadc, ADC_ChannelConfTypeDef* sConfig) {
+  if(sConfig->Rank == ADC_RANK_NONE) {
+    adc_chsel &= ~(sConfig->Channel & ADC_CHANNEL_MASK);
+  }
+  else {
+    adc_chsel |= sConfig->Channel & ADC_CHANNEL_MASK;
+  }
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ADCEx_Calibration_Start(ADC_HandleTypeDef* hadc, uint32_t SingleDiff) {
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ADC_Start_DMA(ADC_HandleTypeDef* hadc, uint32_t* pData, uint32_t Length) {
+  char name[16];
+
+  for(uint8_t ch = 0; ch < SIM_ADC_CHANNELS; ch++) {
+    snprintf(name, sizeof(name), "SIM_ADC%u", ch);
+    adc_level[ch] = (uint16_t)sim_env_u32(name, 2048);
+  }
+  adc_sweep = 0;
+  const char* sweep = getenv("SIM_ADC_SWEEP");
+  while(sweep && *sweep) {
+    char* end;
+    unsigned long ch = strtoul(sweep, &end, 0);
+    if(end == sweep) break;
+    if(ch < SIM_ADC_CHANNELS) adc_sweep |= 1U << ch;
+    sweep = (*end == ',') ? end + 1 : end;
+  }
+  adc_period_ms = sim_env_u32("SIM_ADC_PERIOD_MS", 4000);
+  if(!adc_period_ms) adc_period_ms = 1;
+  adc_sweep_at_ms = sim_env_u32("SIM_ADC_SWEEP_AT_MS", 0);
+
+  adc_handle = hadc;
+  adc_buf = (uint16_t*)pData;
+  adc_len = Length;
+  adc_idx = 0;
+  adc_next_ns = 0;
+  return HAL_OK;
+}
+
+/**
+  * @brief Run the scans triggered by TIM6 since the last poll
+  */
+static void sim_adc_poll(uint64_t now) {
+  TIM_TypeDef* tim = &sim_tim[6];
+  if(!adc_buf || !adc_len || !(tim->CR1 & TIM_CR1_CEN)) return;
+
+  uint64_t period = (uint64_t)(tim->PSC + 1) * (tim->ARR + 1) * 1000000000ULL / SystemCoreClock;
+  if(!period) return;
+
+  /* Resynchronise after a long stall instead of replaying it */
+  if(!adc_next_ns || (now > adc_next_ns && now - adc_next_ns > period * adc_len)) {
+    adc_next_ns = now + period;
+  }
+
+  while(adc_next_ns <= now) {
+    for(uint8_t ch = 0; ch < SIM_ADC_CHANNELS; ch++) {
+      if(!(adc_chsel & (1U << ch))) continue;
+
+      adc_buf[adc_idx++] = sim_adc_sample(ch, adc_next_ns);
+      if(adc_idx == adc_len / 2) {
+        HAL_ADC_ConvHalfCpltCallback(adc_handle);
+      }
+      else if(adc_idx == adc_len) {
+        adc_idx = 0;
+        HAL_ADC_ConvCpltCallback(adc_handle);
+      }
+    }
+    adc_next_ns += period;
+  }
+}
+#endif /* HAL_ADC_MODULE_ENABLED */
+
+/* ---- Timers / PWM ---- */
+
+#ifdef HAL_TIM_MODULE_ENABLED
+HAL_StatusTypeDef HAL_TIM_PWM_Init(TIM_HandleTypeDef* htim) {
+  htim->Instance->PSC = htim->Init.Prescaler;
+  htim->Instance->ARR = htim->Init.Period;
+  htim->State = HAL_TIM_STATE_READY;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_ConfigChannel(TIM_HandleTypeDef* htim, const TIM_OC_InitTypeDef* sConfig,
+                                            uint32_t Channel) {
+  (&htim->Instance->CCR1)[Channel / 4U] = sConfig->Pulse;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef* htim, uint32_t Channel) {
+  htim->Instance->CCER |= 1U << Channel;
+  htim->Instance->CR1 |= TIM_CR1_CEN;
+  return HAL_OK;
+}
+
+void HAL_TIM_MspPostInit(TIM_HandleTypeDef* htim) {
+}
+
+/*
+ * Update interrupts of timers started with HAL_TIM_Base_Start_IT, one
+ * HAL_TIM_PeriodElapsedCallback per elapsed period, timer clock
+ * SystemCoreClock.
+ */
+static TIM_HandleTypeDef* tim_it[SIM_TIM_COUNT];
+static uint64_t tim_next_ns[SIM_TIM_COUNT];
+
+__attribute__((weak)) void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef* htim) {
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Init(TIM_HandleTypeDef* htim) {
+  htim->Instance->PSC = htim->Init.Prescaler;
+  htim->Instance->ARR = htim->Init.Period;
+  htim->State = HAL_TIM_STATE_READY;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef* htim) {
+  ptrdiff_t n = htim->Instance - sim_tim;
+  if(n < 0 || n >= SIM_TIM_COUNT) return HAL_ERROR;
+
+  htim->Instance->DIER |= TIM_DIER_UIE;
+  htim->Instance->CR1 |= TIM_CR1_CEN;
+  tim_it[n] = htim;
+  tim_next_ns[n] = 0;
+  return HAL_OK;
+}
+
+/**
+  * @brief Run the update interrupts due since the last poll
+  */
+static void sim_tim_poll(uint64_t now) {
+  for(int n = 1; n < SIM_TIM_COUNT; n++) {
+    TIM_TypeDef* tim = &sim_tim[n];
+    if(!tim_it[n] || !(tim->CR1 & TIM_CR1_CEN) || !(tim->DIER & TIM_DIER_UIE)) continue;
+
+    uint64_t period = (uint64_t)(tim->PSC + 1) * (tim->ARR + 1) * 1000000000ULL / SystemCoreClock;
+    if(!period) continue;
+
+    /* Resynchronise after a long stall instead of replaying it */
+    if(!tim_next_ns[n] || (now > tim_next_ns[n] && now - tim_next_ns[n] > period * 16)) {
+      tim_next_ns[n] = now + period;
+    }
+
+    while(tim_next_ns[n] <= now) {
+      HAL_TIM_PeriodElapsedCallback(tim_it[n]);
+      tim_next_ns[n] += period;
+    }
+  }
+}
+#endif /* HAL_TIM_MODULE_ENABLED */
+
+/**
+  * @brief Trace every change of an enabled PWM output
+  */
+static void sim_pwm_poll(void) {
+  static uint32_t last[SIM_TIM_COUNT][4];
+
+  for(int n = 1; n < SIM_TIM_COUNT; n++) {
+    TIM_TypeDef* tim = &sim_tim[n];
+    if(!(tim->CR1 & TIM_CR1_CEN)) continue;
+
+    for(int ch = 0; ch < 4; ch++) {
+      if(!(tim->CCER & (1U << (ch * 4)))) continue;
+
+      uint32_t ccr = (&tim->CCR1)[ch];
+      if(ccr == last[n][ch]) continue;
+      last[n][ch] = ccr;
+
+      uint32_t us = (uint32_t)((uint64_t)ccr * (tim->PSC + 1) * 1000000ULL / SystemCoreClock);
+      sim_trace("PWM TIM%d CH%d %lu us", n, ch + 1, (unsigned long)us);
+    }
+  }
+}
@@ -0,0 +1,415 @@
+/* sim_lora.c - REYAX RYLR module emulator: AT command set over a UDP radio link */
+#include "sim.h"
+#include "lora_airtime.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+/*
+ * The module answers AT+ADDRESS/NETWORKID/BAND/PARAMETER/SEND with +OK and
+ * reports received packets as +RCV=<src>,<len>,<data>,<rssi>,<snr>.
+ *
+ * All boards share one channel. A packet going on air is announced to
+ * every SIM_LORA_PEER with a start datagram; once its time on air
+ * (lora_airtime_us for the programmed AT+PARAMETER) has passed, an end
+ * datagram carries the payload. Packets are sent one at a time. A
+ * receiver counts a collision, and drops the packet, when it overlapped
+ * another packet with the same modulation or the receiver's own
+ * transmission (half duplex). It drops packets for another address or
+ * network ID and packets sent with different modulation settings.
+ *
+ * Environment:
+ *   SIM_LORA_PORT   local UDP port (radio disabled when unset)
+ *   SIM_LORA_PEER   UDP ports of the other boards: <port>[,...]
+ *   SIM_LORA_LOSS   random packet loss in percent
+ *   SIM_LORA_OUTAGE outages, all packets sent in them are lost:
+ *                   <start_ms>+<length_ms>[,...] in board time
+ *   SIM_LORA_RSSI   reported RSSI in dBm, negated (default 60 -> -60)
+ *   SIM_LORA_SNR    reported SNR in dB (default 10)
+ *   SIM_SEED        loss pattern seed
+ */
+
+#define LORA_LINE_MAX   256
+#define LORA_DATA_MAX   240     /* AT+SEND payload limit */
+#define LORA_QUEUE      4
+#define LORA_OUTAGES    8
+#define LORA_PEERS      16
+#define LORA_HEARD      8       /* Packets being received at once */
+
+typedef struct {
+  uint16_t dst;
+  uint8_t  len;
+  char     data[LORA_DATA_MAX + 1];
+} SimLoRaPkt_t;
+
+/* A packet on air from another board */
+typedef struct {
+  uint16_t port;                /* Sender's UDP port, 0 = free */
+  uint8_t  sf;
+  uint32_t bw_hz;
+  uint8_t  corrupt;             /* Overlapped another packet */
+} SimLoRaHeard_t;
+
+static SimUart_t* lora_uart;
+static char     lora_line[LORA_LINE_MAX];
+static uint16_t lora_line_len;
+
+/* Module configuration */
+static uint16_t  lora_addr = 0;
+static uint8_t   lora_netid = 18;
+static LoRaPhy_t lora_phy = LORA_PHY_DEFAULT;
+
+/* Transmitter */
+static SimLoRaPkt_t lora_txq[LORA_QUEUE];
+static uint8_t  lora_tx_head;
+static uint8_t  lora_tx_count;
+static uint64_t lora_tx_end_ns;         /* End of the packet on air, 0 = idle */
+
+/* Radio link */
+static int lora_sock = -1;
+static struct sockaddr_in lora_peer[LORA_PEERS];
+static uint8_t  lora_peers;
+static SimLoRaHeard_t lora_heard[LORA_HEARD];
+static uint32_t lora_loss_pct;
+static int      lora_rssi;
+static int      lora_snr;
+static unsigned int lora_seed;
+static uint32_t lora_outage[LORA_OUTAGES][2];   /* Start and end, board ms */
+static uint8_t  lora_outages;
+static uint64_t lora_last_read_ns;
+
+/* Statistics */
+static uint32_t lora_sent, lora_received, lora_lost, lora_collisions, lora_queue_drops;
+
+/**
+  * @brief Send a response line to the MCU
+  */
+static void lora_reply(const char* s) {
+  sim_uart_inject(lora_uart, s, strlen(s));
+  sim_uart_inject(lora_uart, "\r\n", 2);
+}
+
+/**
+  * @brief Send a datagram to every other board
+  * Start: S,<netid>,<src>,<dst>,<sf>,<bw_hz>
+  * End:   E,<netid>,<src>,<dst>,<sf>,<bw_hz>,<payload>, or L,... for a
+  *        packet lost on the way
+  */
+static void lora_broadcast(char kind, const SimLoRaPkt_t* p) {
+  char msg[LORA_DATA_MAX + 48];
+  int n = snprintf(msg, sizeof(msg), "%c,%u,%u,%u,%u,%lu,%s", kind, lora_netid, lora_addr, p->dst,
+                   lora_phy.sf, (unsigned long)lora_phy.bw_hz, kind == 'E' ? p->data : "");
+
+  for(uint8_t i = 0; lora_sock >= 0 && i < lora_peers; i++) {
+    sendto(lora_sock, msg, (size_t)n, 0, (struct sockaddr*)&lora_peer[i], sizeof(lora_peer[i]));
+  }
+}
+
+/**
+  * @brief Put the packet at the head of the queue on air
+  */
+static void lora_tx_start(uint64_t now) {
+  SimLoRaPkt_t* p = &lora_txq[lora_tx_head];
+  uint32_t air = lora_airtime_us(&lora_phy, p->len);
+  lora_tx_end_ns = now + (uint64_t)air * 1000ULL;
+  sim_trace("LORA TX dst=%u len=%u air=%luus", p->dst, p->len, (unsigned long)air);
+
+  /* Half duplex: whatever is being received is lost */
+  for(uint8_t i = 0; i < LORA_HEARD; i++) {
+    lora_heard[i].corrupt = 1;
+  }
+  lora_broadcast('S', p);
+}
+
+/**
+  * @brief AT+SEND=<dst>,<len>,<data>
+  * The payload is taken by length, so it may contain commas
+  */
+static void lora_cmd_send(const char* args) {
+  char* end;
+  unsigned long dst = strtoul(args, &end, 10);
+  if(*end != ',') { lora_reply("+ERR=4"); return; }
+  unsigned long len = strtoul(end + 1, &end, 10);
+  if(*end != ',') { lora_reply("+ERR=4"); return; }
+  const char* data = end + 1;
+
+  if(len > LORA_DATA_MAX) { lora_reply("+ERR=13"); return; }
+  if(strlen(data) != len) { lora_reply("+ERR=5"); return; }
+
+  if(lora_tx_count >= LORA_QUEUE) {
+    lora_queue_drops++;
+    lora_reply("+ERR=10");
+    return;
+  }
+
+  SimLoRaPkt_t* p = &lora_txq[(lora_tx_head + lora_tx_count) % LORA_QUEUE];
+  p->dst = (uint16_t)dst;
+  p->len = (uint8_t)len;
+  memcpy(p->data, data, len);
+  p->data[len] = 0;
+  lora_tx_count++;
+  lora_reply("+OK");
+
+  if(!lora_tx_end_ns) lora_tx_start(sim_now_ns());
+}
+
+/**
+  * @brief Execute one AT command line from the MCU
+  */
+static void lora_command(const char* line) {
+  unsigned int sf, bw, cr, pre;
+
+  if(strcmp(line, "AT") == 0) {
+    lora_reply("+OK");
+  }
+  else if(strncmp(line, "AT+SEND=", 8) == 0) {
+    lora_cmd_send(line + 8);
+  }
+  else if(strncmp(line, "AT+ADDRESS=", 11) == 0) {
+    lora_addr = (uint16_t)strtoul(line + 11, NULL, 10);
+    lora_reply("+OK");
+  }
+  else if(strncmp(line, "AT+NETWORKID=", 13) == 0) {
+    lora_netid = (uint8_t)strtoul(line + 13, NULL, 10);
+    lora_reply("+OK");
+  }
+  else if(strncmp(line, "AT+BAND=", 8) == 0) {
+    lora_reply("+OK");
+  }
+  else if(strncmp(line, "AT+PARAMETER=", 13) == 0) {
+    if(sscanf(line + 13, "%u,%u,%u,%u", &sf, &bw, &cr, &pre) == 4 &&
+       sf >= 5 && sf <= 12 && lora_bw_hz(bw) && cr >= 1 && cr <= 4) {
+      lora_phy.sf = (uint8_t)sf;
+      lora_phy.bw_hz = lora_bw_hz(bw);
+      lora_phy.cr = (uint8_t)cr;
+      lora_phy.preamble = (uint16_t)pre;
+      lora_reply("+OK");
+    }
+    else {
+      lora_reply("+ERR=4");
+    }
+  }
+  else {
+    lora_reply("+ERR=4");
+  }
+}
+
+/**
+  * @brief Bytes written by the MCU to the module UART
+  */
+static void lora_from_mcu(const uint8_t* data, size_t len) {
+  for(size_t i = 0; i < len; i++) {
+    char c = (char)data[i];
+
+    if(c == '\r' || c == '\n') {
+      if(lora_line_len) {
+        lora_line[lora_line_len] = 0;
+        lora_command(lora_line);
+      }
+      lora_line_len = 0;
+    }
+    else if(lora_line_len < LORA_LINE_MAX - 1) {
+      lora_line[lora_line_len++] = c;
+    }
+  }
+}
+
+/**
+  * @brief Parse SIM_LORA_OUTAGE
+  */
+static void lora_parse_outages(void) {
+  const char* p = getenv("SIM_LORA_OUTAGE");
+  char* end;
+
+  while(p && *p && lora_outages < LORA_OUTAGES) {
+    unsigned long start = strtoul(p, &end, 10);
+    if(*end != '+') break;
+    unsigned long len = strtoul(end + 1, &end, 10);
+    lora_outage[lora_outages][0] = (uint32_t)start;
+    lora_outage[lora_outages][1] = (uint32_t)(start + len);
+    lora_outages++;
+    p = (*end == ',') ? end + 1 : NULL;
+  }
+}
+
+/**
+  * @brief Whether a packet finishing now falls in an outage
+  */
+static uint8_t lora_in_outage(uint64_t now) {
+  uint32_t ms = sim_board_ms(now);
+  for(uint8_t i = 0; i < lora_outages; i++) {
+    if(ms >= lora_outage[i][0] && ms < lora_outage[i][1]) return 1;
+  }
+  return 0;
+}
+
+/**
+  * @brief Connect the RYLR emulator to a UART
+  */
+void sim_lora_attach(SimUart_t* u) {
+  lora_uart = u;
+  sim_uart_set_sink(u, lora_from_mcu);
+
+  lora_loss_pct = sim_env_u32("SIM_LORA_LOSS", 0);
+  lora_rssi = -(int)sim_env_u32("SIM_LORA_RSSI", 60);
+  lora_snr = (int)sim_env_u32("SIM_LORA_SNR", 10);
+  lora_seed = sim_env_u32("SIM_SEED", 1);
+  lora_parse_outages();
+
+  uint32_t port = sim_env_u32("SIM_LORA_PORT", 0);
+  if(!port) return;
+
+  struct sockaddr_in local = { .sin_family = AF_INET, .sin_port = htons((uint16_t)port),
+                               .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+  lora_sock = socket(AF_INET, SOCK_DGRAM, 0);
+  if(lora_sock < 0 || bind(lora_sock, (struct sockaddr*)&local, sizeof(local)) != 0) {
+    perror("SIM_LORA_PORT");
+    exit(1);
+  }
+  fcntl(lora_sock, F_SETFL, O_NONBLOCK);
+
+  const char* p = getenv("SIM_LORA_PEER");
+  char* end;
+  while(p && *p && lora_peers < LORA_PEERS) {
+    unsigned long peer = strtoul(p, &end, 10);
+    if(end == p) break;
+    lora_peer[lora_peers].sin_family = AF_INET;
+    lora_peer[lora_peers].sin_port = htons((uint16_t)peer);
+    lora_peer[lora_peers].sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    lora_peers++;
+    p = (*end == ',') ? end + 1 : NULL;
+  }
+}
+
+/**
+  * @brief Packet on air from a board, NULL if none
+  */
+static SimLoRaHeard_t* lora_heard_find(uint16_t port) {
+  for(uint8_t i = 0; i < LORA_HEARD; i++) {
+    if(lora_heard[i].port == port) return &lora_heard[i];
+  }
+  return NULL;
+}
+
+/**
+  * @brief A packet from another board goes on air
+  * It and every packet it overlaps with the same modulation are lost
+  */
+static void lora_heard_start(uint16_t port, uint8_t sf, uint32_t bw_hz) {
+  SimLoRaHeard_t* h = lora_heard_find(port);
+  if(!h) h = lora_heard_find(0);
+  if(!h) return;
+
+  h->port = port;
+  h->sf = sf;
+  h->bw_hz = bw_hz;
+  h->corrupt = lora_tx_end_ns != 0;
+
+  for(uint8_t i = 0; i < LORA_HEARD; i++) {
+    SimLoRaHeard_t* o = &lora_heard[i];
+    if(o != h && o->port && o->sf == sf && o->bw_hz == bw_hz) {
+      o->corrupt = 1;
+      h->corrupt = 1;
+    }
+  }
+}
+
+/**
+  * @brief Deliver a finished packet from another board as +RCV
+  * @param msg: End datagram (see lora_broadcast)
+  * @param port: Sender's UDP port
+  */
+static void lora_receive(const char* msg, uint16_t port) {
+  unsigned int netid, src, dst, sf;
+  unsigned long bw;
+  char kind;
+  int off = 0;
+
+  if(sscanf(msg, "%c,%u,%u,%u,%u,%lu,%n", &kind, &netid, &src, &dst, &sf, &bw, &off) != 6 || !off) return;
+  if(kind == 'S') {
+    lora_heard_start(port, (uint8_t)sf, (uint32_t)bw);
+    return;
+  }
+
+  SimLoRaHeard_t* h = lora_heard_find(port);
+  uint8_t corrupt = !h || h->corrupt;
+  if(h) h->port = 0;
+
+  if(kind != 'E') return;
+  if(netid != lora_netid || (dst != 0 && dst != lora_addr)) return;
+  if(sf != lora_phy.sf || bw != lora_phy.bw_hz) return;
+
+  if(corrupt) {
+    lora_collisions++;
+    sim_trace("LORA COLLISION src=%u", src);
+    return;
+  }
+
+  /* +RCV=<src>,<len>,<payload>,<rssi>,<snr>, every number at its widest;
+   * a payload longer than any AT+SEND is traced and dropped */
+  const char* data = msg + off;
+  char line[sizeof("+RCV=4294967295,4294967295,,-2147483648,-2147483648") + LORA_DATA_MAX];
+  int n = snprintf(line, sizeof(line), "+RCV=%u,%u,%s,%d,%d", src, (unsigned)strlen(data), data,
+                   lora_rssi, lora_snr);
+  if(n < 0 || (size_t)n >= sizeof(line)) {
+    sim_trace("LORA OVERRUN src=%u len=%u", src, (unsigned)strlen(data));
+    return;
+  }
+  lora_received++;
+  sim_trace("LORA RX src=%u dst=%u len=%u", src, dst, (unsigned)strlen(data));
+  lora_reply(line);
+}
+
+/**
+  * @brief Finish packets on air and receive datagrams from the peer
+  */
+void sim_lora_poll(uint64_t now) {
+  if(!lora_uart) return;
+
+  if(lora_tx_end_ns && now >= lora_tx_end_ns) {
+    SimLoRaPkt_t* p = &lora_txq[lora_tx_head];
+
+    if(lora_in_outage(now) ||
+       (lora_loss_pct && (uint32_t)(rand_r(&lora_seed) % 100) < lora_loss_pct)) {
+      lora_lost++;
+      sim_trace("LORA LOST dst=%u", p->dst);
+      lora_broadcast('L', p);
+    }
+    else {
+      lora_broadcast('E', p);
+    }
+    lora_sent++;
+
+    lora_tx_head = (uint8_t)((lora_tx_head + 1) % LORA_QUEUE);
+    lora_tx_count--;
+    lora_tx_end_ns = 0;
+    if(lora_tx_count) lora_tx_start(now);
+  }
+
+  if(lora_sock >= 0 && now - lora_last_read_ns >= SIM_FD_POLL_NS) {
+    char msg[LORA_DATA_MAX + 48];
+    struct sockaddr_in from;
+    socklen_t from_len = sizeof(from);
+    ssize_t r;
+
+    lora_last_read_ns = now;
+    while((r = recvfrom(lora_sock, msg, sizeof(msg) - 1, 0, (struct sockaddr*)&from, &from_len)) > 0) {
+      msg[r] = 0;
+      lora_receive(msg, ntohs(from.sin_port));
+      from_len = sizeof(from);
+    }
+  }
+}
+
+void sim_lora_report(void) {
+  if(!lora_uart) return;
+  fprintf(stderr, "SIM %s LORA sent=%lu received=%lu lost=%lu collisions=%lu queue_drops=%lu\n", SIM_BOARD,
+          (unsigned long)lora_sent, (unsigned long)lora_received, (unsigned long)lora_lost,
+          (unsigned long)lora_collisions, (unsigned long)lora_queue_drops);
+}
@@ -0,0 +1,172 @@
+/* sim_nvm.c - Non-volatile memory: L0 data EEPROM and F4 flash, host memory at the real address */
+#include "sim.h"
+
+#ifdef HAL_FLASH_MODULE_ENABLED
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ * The firmware reads its non-volatile memory through plain pointers, so
+ * the emulation maps host memory at the device address (free in a Linux
+ * process) before main() runs. Writes go through the HAL and are refused
+ * while the memory is locked.
+ *
+ *   L0 data EEPROM  words rewritten freely, erased bytes read 0
+ *   F4 flash        programming only clears bits, sector erase sets 0xFF;
+ *                   the program image itself is not loaded
+ *
+ * Environment:
+ *   SIM_EEPROM   L0 data EEPROM backing file
+ *   SIM_FLASH    F4 flash backing file
+ * A backing file is created if missing, so the contents survive a
+ * restart; without one the memory starts erased.
+ */
+
+#ifdef DATA_EEPROM_BASE
+#define SIM_NVM_BASE    DATA_EEPROM_BASE
+#define SIM_NVM_SIZE    (DATA_EEPROM_BANK2_END - DATA_EEPROM_BASE + 1U)
+#define SIM_NVM_ERASED  0x00
+#define SIM_NVM_ENV     "SIM_EEPROM"
+#else
+#define SIM_NVM_BASE    FLASH_BASE
+#define SIM_NVM_SIZE    (FLASH_END - FLASH_BASE + 1U)
+#define SIM_NVM_ERASED  0xFF
+#define SIM_NVM_ENV     "SIM_FLASH"
+#endif
+
+static uint8_t  nvm_unlocked;
+static uint32_t nvm_writes;
+
+/**
+  * @brief Map the memory before the firmware starts
+  */
+__attribute__((constructor)) static void sim_nvm_map(void) {
+  const char* path = getenv(SIM_NVM_ENV);
+  int flags = MAP_FIXED_NOREPLACE;
+  int fd = -1;
+  uint8_t fresh = 1;
+
+  if(path && *path) {
+    fd = open(path, O_RDWR | O_CREAT, 0644);
+    struct stat st;
+    if(fd < 0 || fstat(fd, &st) != 0) {
+      perror(path);
+      exit(1);
+    }
+    fresh = (st.st_size == 0);
+    if(ftruncate(fd, SIM_NVM_SIZE) != 0) {
+      perror(path);
+      exit(1);
+    }
+    flags |= MAP_SHARED;
+  }
+  else {
+    flags |= MAP_PRIVATE | MAP_ANONYMOUS;
+  }
+
+  void* p = mmap((void*)SIM_NVM_BASE, SIM_NVM_SIZE, PROT_READ | PROT_WRITE, flags, fd, 0);
+  if(p != (void*)SIM_NVM_BASE) {
+    perror("SIM NVM mmap");
+    exit(1);
+  }
+  if(fd >= 0) close(fd);
+
+  if(fresh && SIM_NVM_ERASED) {
+    memset(p, SIM_NVM_ERASED, SIM_NVM_SIZE);
+  }
+}
+
+/**
+  * @brief Write one unit of 1, 2 or 4 bytes
+  */
+static HAL_StatusTypeDef sim_nvm_write(uint32_t addr, uint32_t len, uint32_t data) {
+  if(!nvm_unlocked || addr < SIM_NVM_BASE || addr % len || addr - SIM_NVM_BASE + len > SIM_NVM_SIZE) {
+    return HAL_ERROR;
+  }
+
+  uint8_t* dst = (uint8_t*)(uintptr_t)addr;
+  for(uint32_t i = 0; i < len; i++) {
+    uint8_t b = (uint8_t)(data >> (8 * i));     /* Little endian, as on target */
+    dst[i] = SIM_NVM_ERASED ? (dst[i] & b) : b;
+  }
+
+  nvm_writes++;
+  sim_trace("NVM 0x%08lx %lu bytes (%lu writes)", (unsigned long)addr,
+            (unsigned long)len, (unsigned long)nvm_writes);
+  return HAL_OK;
+}
+
+#ifdef DATA_EEPROM_BASE
+
+HAL_StatusTypeDef HAL_FLASHEx_DATAEEPROM_Unlock(void) {
+  nvm_unlocked = 1;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_DATAEEPROM_Lock(void) {
+  nvm_unlocked = 0;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_DATAEEPROM_Erase(uint32_t Address) {
+  return sim_nvm_write(Address & ~3U, 4, 0);
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_DATAEEPROM_Program(uint32_t TypeProgram, uint32_t Address, uint32_t Data) {
+  uint32_t len = (TypeProgram == FLASH_TYPEPROGRAMDATA_WORD) ? 4 :
+                 (TypeProgram == FLASH_TYPEPROGRAMDATA_HALFWORD) ? 2 : 1;
+  return sim_nvm_write(Address, len, Data);
+}
+
+#else
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void) {
+  nvm_unlocked = 1;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Lock(void) {
+  nvm_unlocked = 0;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data) {
+  if(TypeProgram == FLASH_TYPEPROGRAM_DOUBLEWORD) {
+    if(sim_nvm_write(Address, 4, (uint32_t)Data) != HAL_OK) return HAL_ERROR;
+    return sim_nvm_write(Address + 4, 4, (uint32_t)(Data >> 32));
+  }
+  uint32_t len = (TypeProgram == FLASH_TYPEPROGRAM_WORD) ? 4 :
+                 (TypeProgram == FLASH_TYPEPROGRAM_HALFWORD) ? 2 : 1;
+  return sim_nvm_write(Address, len, (uint32_t)Data);
+}
+
+/**
+  * @brief Sector erase (STM32F446: 4 x 16 KB, 64 KB, 3 x 128 KB)
+  */
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef* pEraseInit, uint32_t* SectorError) {
+  static const uint32_t kb[] = { 16, 16, 16, 16, 64, 128, 128, 128 };
+  *SectorError = 0xFFFFFFFFU;
+  if(!nvm_unlocked || pEraseInit->TypeErase != FLASH_TYPEERASE_SECTORS) return HAL_ERROR;
+
+  for(uint32_t s = pEraseInit->Sector; s < pEraseInit->Sector + pEraseInit->NbSectors; s++) {
+    if(s >= sizeof(kb) / sizeof(kb[0])) {
+      *SectorError = s;
+      return HAL_ERROR;
+    }
+    uint32_t off = 0;
+    for(uint32_t i = 0; i < s; i++) off += kb[i] * 1024U;
+    memset((void*)(uintptr_t)(SIM_NVM_BASE + off), SIM_NVM_ERASED, kb[s] * 1024U);
+    sim_trace("NVM erase sector %lu", (unsigned long)s);
+  }
+  return HAL_OK;
+}
+
+#endif /* DATA_EEPROM_BASE */
+
+#endif /* HAL_FLASH_MODULE_ENABLED */
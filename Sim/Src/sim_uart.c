@@ -0,0 +1,364 @@
+/* sim_uart.c - Host UARTs: circular RX DMA and TX DMA paced at the baud rate */
+#define _GNU_SOURCE
+#include "sim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/stat.h>
+
+/*
+ * Each UART is backed by one of (environment SIM_<instance>, e.g. SIM_USART1):
+ *   pty[:link]   a pseudo terminal; its name is printed and optionally
+ *                symlinked, so a terminal or test script can attach
+ *   stdio        stdin/stdout
+ *   <path>       a FIFO or character device (read/write) or a regular
+ *                file (read only, e.g. an NMEA log to replay)
+ * The LoRa UART defaults to the RYLR emulator (sim_lora.c); other unset
+ * UARTs are disconnected. Bytes move at 10 bit times each (8N1).
+ */
+
+#define SIM_UARTS       6
+#define SIM_UART_FIFO   4096
+
+struct SimUart {
+  UART_HandleTypeDef* huart;
+  const char* name;
+  int      fd_in;                 /* -1 = nothing to read */
+  int      fd_out;                /* -1 = output discarded */
+  SimUartSinkFn sink;             /* Emulated device, replaces fd_out */
+  uint64_t byte_ns;               /* Time on the wire per byte */
+  uint64_t last_read_ns;
+
+  /* Device -> MCU */
+  uint8_t  fifo[SIM_UART_FIFO];   /* Bytes waiting for the wire */
+  uint16_t fifo_head;
+  uint16_t fifo_count;
+  uint64_t rx_line_ns;            /* Wire busy until */
+  uint8_t* rx_buf;                /* Circular DMA buffer */
+  uint16_t rx_size;
+  uint16_t rx_pos;                /* DMA write position */
+  uint16_t rx_reported;           /* Position of the last RX event */
+
+  /* MCU -> device */
+  const uint8_t* tx_data;         /* DMA transfer in flight */
+  uint16_t tx_len;
+  uint64_t tx_line_ns;            /* Wire busy until */
+
+  /* Statistics */
+  uint32_t rx_bytes;
+  uint32_t tx_bytes;
+  uint32_t rx_lost;               /* Dropped: FIFO full or RX DMA not running */
+};
+
+static SimUart_t sim_uarts[SIM_UARTS];
+static uint8_t sim_uart_count = 0;
+
+__attribute__((weak)) void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef* huart, uint16_t Size) {
+}
+
+__attribute__((weak)) void HAL_UART_TxCpltCallback(UART_HandleTypeDef* huart) {
+}
+
+__attribute__((weak)) void HAL_UART_ErrorCallback(UART_HandleTypeDef* huart) {
+}
+
+static const char* sim_uart_name(USART_TypeDef* inst) {
+#ifdef USART1
+  if(inst == USART1) return "USART1";
+#endif
+#ifdef USART2
+  if(inst == USART2) return "USART2";
+#endif
+#ifdef USART3
+  if(inst == USART3) return "USART3";
+#endif
+#ifdef UART4
+  if(inst == UART4) return "UART4";
+#endif
+#ifdef USART4
+  if(inst == USART4) return "USART4";
+#endif
+#ifdef USART5
+  if(inst == USART5) return "USART5";
+#endif
+#ifdef UART5
+  if(inst == UART5) return "UART5";
+#endif
+#ifdef USART6
+  if(inst == USART6) return "USART6";
+#endif
+  return "UART";
+}
+
+static SimUart_t* sim_uart_find(UART_HandleTypeDef* huart) {
+  for(uint8_t i = 0; i < sim_uart_count; i++) {
+    if(sim_uarts[i].huart == huart) return &sim_uarts[i];
+  }
+  return NULL;
+}
+
+/**
+  * @brief Open a pseudo terminal in raw mode
+  * @param link: Optional symlink to create to the slave side
+  * @retval Master fd, -1 on failure
+  */
+static int sim_uart_open_pty(const char* name, const char* link) {
+  int fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if(fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0) return -1;
+
+  const char* pts = ptsname(fd);
+  struct termios tio;
+
+  /* Hold the slave open so the master does not see EIO between clients */
+  int slave = open(pts, O_RDWR | O_NOCTTY);
+  if(slave >= 0 && tcgetattr(slave, &tio) == 0) {
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+  }
+
+  if(link && *link) {
+    unlink(link);
+    if(symlink(pts, link) != 0) perror(link);
+  }
+
+  fprintf(stderr, "SIM %s %s on %s\n", SIM_BOARD, name, pts);
+  return fd;
+}
+
+/**
+  * @brief Connect a UART to its configured backend
+  */
+static void sim_uart_open(SimUart_t* u) {
+  char var[16];
+  snprintf(var, sizeof(var), "SIM_%s", u->name);
+  const char* cfg = getenv(var);
+
+  u->fd_in = -1;
+  u->fd_out = -1;
+
+  if(!cfg || !*cfg) {
+    if(strcmp(u->name, SIM_LORA_UART) == 0) sim_lora_attach(u);
+    return;
+  }
+
+  if(strncmp(cfg, "pty", 3) == 0) {
+    u->fd_in = u->fd_out = sim_uart_open_pty(u->name, cfg[3] == ':' ? cfg + 4 : NULL);
+  }
+  else if(strcmp(cfg, "stdio") == 0) {
+    fcntl(0, F_SETFL, fcntl(0, F_GETFL) | O_NONBLOCK);
+    u->fd_in = 0;
+    u->fd_out = 1;
+  }
+  else {
+    struct stat st;
+    if(stat(cfg, &st) == 0 && S_ISREG(st.st_mode)) {
+      u->fd_in = open(cfg, O_RDONLY | O_NONBLOCK);
+    }
+    else {
+      u->fd_in = u->fd_out = open(cfg, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    }
+    if(u->fd_in < 0) perror(cfg);
+  }
+}
+
+/**
+  * @brief Attach an emulated device instead of a file descriptor
+  */
+void sim_uart_set_sink(SimUart_t* u, SimUartSinkFn sink) {
+  u->sink = sink;
+}
+
+/**
+  * @brief Queue bytes on the line towards the MCU
+  */
+void sim_uart_inject(SimUart_t* u, const void* data, size_t len) {
+  const uint8_t* p = data;
+
+  if(u->fifo_count == 0) {
+    uint64_t now = sim_now_ns();
+    if(u->rx_line_ns < now) u->rx_line_ns = now;
+  }
+
+  for(size_t i = 0; i < len; i++) {
+    if(u->fifo_count >= SIM_UART_FIFO) {
+      u->rx_lost += (uint32_t)(len - i);
+      return;
+    }
+    u->fifo[(u->fifo_head + u->fifo_count) % SIM_UART_FIFO] = p[i];
+    u->fifo_count++;
+  }
+}
+
+/**
+  * @brief Hand transmitted bytes to the device side
+  */
+static void sim_uart_out(SimUart_t* u, const uint8_t* data, size_t len) {
+  u->tx_bytes += (uint32_t)len;
+  if(u->sink) {
+    u->sink(data, len);
+  }
+  else if(u->fd_out >= 0) {
+    if(write(u->fd_out, data, len) < 0 && errno != EAGAIN) {
+      u->fd_out = -1;
+    }
+  }
+}
+
+/**
+  * @brief Move bytes whose time on the wire has passed into the DMA buffer
+  * Raises the half, full and idle RX events like the DMA and IDLE flag do
+  */
+static void sim_uart_rx_pump(SimUart_t* u, uint64_t now) {
+  if(!u->fifo_count || now < u->rx_line_ns) return;
+
+  if(!u->rx_buf || u->huart->RxState != HAL_UART_STATE_BUSY_RX) {
+    u->rx_lost += u->fifo_count;
+    u->fifo_count = 0;
+    return;
+  }
+
+  uint64_t n = (now - u->rx_line_ns) / u->byte_ns;
+  if(n > u->fifo_count) n = u->fifo_count;
+  if(!n) return;
+  u->rx_line_ns += n * u->byte_ns;
+
+  uint16_t half = u->rx_size / 2;
+  while(n) {
+    uint16_t stop = (u->rx_pos < half) ? half : u->rx_size;
+    uint16_t k = (uint16_t)((n < (uint64_t)(stop - u->rx_pos)) ? n : (uint64_t)(stop - u->rx_pos));
+
+    for(uint16_t i = 0; i < k; i++) {
+      u->rx_buf[u->rx_pos++] = u->fifo[u->fifo_head];
+      u->fifo_head = (uint16_t)((u->fifo_head + 1) % SIM_UART_FIFO);
+    }
+    u->fifo_count -= k;
+    u->rx_bytes += k;
+    n -= k;
+
+    if(u->rx_pos == half || u->rx_pos == u->rx_size) {
+      uint16_t pos = u->rx_pos;
+      if(u->rx_pos == u->rx_size) u->rx_pos = 0;
+      u->rx_reported = u->rx_pos;
+      HAL_UARTEx_RxEventCallback(u->huart, pos);
+    }
+  }
+
+  /* Line went idle */
+  if(!u->fifo_count && u->rx_pos != u->rx_reported) {
+    u->rx_reported = u->rx_pos;
+    HAL_UARTEx_RxEventCallback(u->huart, u->rx_pos);
+  }
+}
+
+/**
+  * @brief Service every UART: read backends, deliver RX, complete TX
+  */
+void sim_uart_poll(uint64_t now) {
+  uint8_t buf[256];
+
+  for(uint8_t i = 0; i < sim_uart_count; i++) {
+    SimUart_t* u = &sim_uarts[i];
+
+    if(u->fd_in >= 0 && now - u->last_read_ns >= SIM_FD_POLL_NS) {
+      u->last_read_ns = now;
+      size_t room = SIM_UART_FIFO - u->fifo_count;
+      if(room > sizeof(buf)) room = sizeof(buf);
+      ssize_t r = room ? read(u->fd_in, buf, room) : 0;
+      if(r > 0) sim_uart_inject(u, buf, (size_t)r);
+    }
+
+    sim_uart_rx_pump(u, now);
+
+    if(u->tx_data && now >= u->tx_line_ns) {
+      const uint8_t* data = u->tx_data;
+      u->tx_data = NULL;
+      sim_uart_out(u, data, u->tx_len);
+      u->huart->gState = HAL_UART_STATE_READY;
+      HAL_UART_TxCpltCallback(u->huart);
+    }
+  }
+}
+
+void sim_uart_report(void) {
+  for(uint8_t i = 0; i < sim_uart_count; i++) {
+    SimUart_t* u = &sim_uarts[i];
+    fprintf(stderr, "SIM %s %s rx=%lu tx=%lu lost=%lu\n", SIM_BOARD, u->name,
+            (unsigned long)u->rx_bytes, (unsigned long)u->tx_bytes, (unsigned long)u->rx_lost);
+  }
+}
+
+/* ---- HAL UART API ---- */
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef* huart) {
+  SimUart_t* u = sim_uart_find(huart);
+
+  if(!u) {
+    if(sim_uart_count >= SIM_UARTS) return HAL_ERROR;
+    u = &sim_uarts[sim_uart_count++];
+    u->huart = huart;
+    u->name = sim_uart_name(huart->Instance);
+    sim_uart_open(u);
+  }
+
+  u->byte_ns = 10ULL * 1000000000ULL / (huart->Init.BaudRate ? huart->Init.BaudRate : 9600);
+  huart->gState = HAL_UART_STATE_READY;
+  huart->RxState = HAL_UART_STATE_READY;
+  huart->ErrorCode = HAL_UART_ERROR_NONE;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef* huart, const uint8_t* pData, uint16_t Size,
+                                    uint32_t Timeout) {
+  SimUart_t* u = sim_uart_find(huart);
+  if(!u || huart->gState != HAL_UART_STATE_READY) return HAL_BUSY;
+
+  huart->gState = HAL_UART_STATE_BUSY_TX;
+
+  /* Busy-wait for the bytes to leave; interrupts keep running meanwhile */
+  uint64_t now = sim_now_ns();
+  uint64_t start = (u->tx_line_ns > now) ? u->tx_line_ns : now;
+  uint64_t limit = now + (uint64_t)Timeout * 1000000ULL;
+  uint16_t n = Size;
+  if(start + n * u->byte_ns > limit) {
+    n = (uint16_t)((limit > start) ? (limit - start) / u->byte_ns : 0);
+  }
+  u->tx_line_ns = start + n * u->byte_ns;
+
+  while(sim_now_ns() < u->tx_line_ns) {
+    sim_poll();
+  }
+
+  sim_uart_out(u, pData, n);
+  huart->gState = HAL_UART_STATE_READY;
+  return (n == Size) ? HAL_OK : HAL_TIMEOUT;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef* huart, const uint8_t* pData, uint16_t Size) {
+  SimUart_t* u = sim_uart_find(huart);
+  if(!u || huart->gState != HAL_UART_STATE_READY) return HAL_BUSY;
+  if(!pData || !Size) return HAL_ERROR;
+
+  uint64_t now = sim_now_ns();
+  huart->gState = HAL_UART_STATE_BUSY_TX;
+  u->tx_data = pData;
+  u->tx_len = Size;
+  u->tx_line_ns = ((u->tx_line_ns > now) ? u->tx_line_ns : now) + Size * u->byte_ns;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UARTEx_ReceiveToIdle_DMA(UART_HandleTypeDef* huart, uint8_t* pData, uint16_t Size) {
+  SimUart_t* u = sim_uart_find(huart);
+  if(!u) return HAL_ERROR;
+  if(!pData || !Size) return HAL_ERROR;
+
+  u->rx_buf = pData;
+  u->rx_size = Size;
+  u->rx_pos = 0;
+  u->rx_reported = 0;
+  huart->RxState = HAL_UART_STATE_BUSY_RX;
+  return HAL_OK;
+}
@@ -0,0 +1,172 @@
+/* config_test.c - Replay, compaction, power loss and wear of the configuration store
+ *
+ * Runs the store on two RAM areas, once with data EEPROM semantics (words
+ * rewritten freely, erased reads 0) and once with flash semantics
+ * (programming only clears bits, areas erased to 0xFF), and checks that:
+ *   - a blank store loads the defaults and out-of-range or malformed SETs
+ *     are refused
+ *   - after thousands of random SETs (many area switches) a reload gives
+ *     exactly the values last set
+ *   - a reset before any word of a SET leaves every key at its old value
+ *     or, for the key being set, the new one
+ *   - programming is spread evenly: no word is written much more often
+ *     than one write per area-full of SETs
+ */
+#include "config.h"
+#include <stdio.h>
+#include <string.h>
+
+#define AREA_SIZE   256
+#define AREA_WORDS  (AREA_SIZE / 4)
+#define SETS        5000
+
+static const ConfigKey_t keys[] = {
+  { "ADDRESS",   2,         0, 65535 },
+  { "BAND",      915000000, 433000000, 928000000 },
+  { "SF",        9,         7, 12 },
+  { "DEADBAND",  100,       0, 1000 },
+  { "FLAG",      1,         0, 1 },
+};
+#define KEYS (sizeof(keys) / sizeof(keys[0]))
+
+static uint32_t mem[2][AREA_WORDS];
+static uint32_t wear[2][AREA_WORDS];      /* Programs per word */
+static uint8_t  flash_mode;
+static int32_t  fail_after = -1;          /* Programs until the simulated reset, -1 = never */
+
+static uint8_t program(uintptr_t addr, uint32_t word) {
+  if(fail_after == 0) return 0;
+  if(fail_after > 0) fail_after--;
+
+  uint8_t a = addr >= (uintptr_t)mem[1];
+  uint32_t i = (uint32_t)(addr - (uintptr_t)mem[a]) / 4;
+  wear[a][i]++;
+  mem[a][i] = flash_mode ? (mem[a][i] & word) : word;
+  return 1;
+}
+
+static uint8_t erase(uint8_t area) {
+  if(fail_after == 0) return 0;
+  memset(mem[area], 0xFF, sizeof(mem[area]));
+  return 1;
+}
+
+static uint32_t values[KEYS];
+
+static void boot(Config_t* c) {
+  *c = (Config_t)CONFIG_INIT(keys, KEYS, values, (uintptr_t)mem[0], (uintptr_t)mem[1],
+                             AREA_SIZE, program, flash_mode ? erase : NULL);
+  config_init(c);
+}
+
+static uint32_t rnd_state = 1;
+static uint32_t rnd(void) {
+  rnd_state = rnd_state * 1103515245U + 12345U;
+  return rnd_state >> 8;
+}
+
+static uint32_t random_value(uint8_t k) {
+  return keys[k].min + rnd() % (keys[k].max - keys[k].min + 1);
+}
+
+static int check(const char* mode) {
+  Config_t c;
+  uint32_t expect[KEYS];
+  unsigned compactions = 0;
+
+  memset(mem, flash_mode ? 0xFF : 0x00, sizeof(mem));
+  memset(wear, 0, sizeof(wear));
+
+  /* Blank store, range checks */
+  boot(&c);
+  for(uint8_t k = 0; k < KEYS; k++) {
+    if(config_get(&c, k) != keys[k].def) {
+      printf("%s: blank store, key %u is %lu\n", mode, k, (unsigned long)config_get(&c, k));
+      return 1;
+    }
+    expect[k] = keys[k].def;
+  }
+  int16_t key;
+  if(config_set(&c, 2, 13) != CONFIG_RANGE || config_set(&c, KEYS, 0) != CONFIG_UNKNOWN ||
+     config_set_text(&c, "SF,x", &key) != CONFIG_RANGE || config_set_text(&c, "SF,7z", &key) != CONFIG_RANGE ||
+     config_set_text(&c, "NOPE,1", &key) != CONFIG_UNKNOWN || key != -1 ||
+     config_set_text(&c, "SF,0x9", &key) != CONFIG_RANGE ||
+     config_set_text(&c, "SF,010", &key) != CONFIG_OK || config_get(&c, 2) != 10 ||
+     config_set_text(&c, "SF,7", &key) != CONFIG_OK || key != 2 || config_get(&c, 2) != 7) {
+    printf("%s: SET validation\n", mode);
+    return 1;
+  }
+  expect[2] = 7;
+
+  /* Random SETs with reloads */
+  for(unsigned i = 0; i < SETS; i++) {
+    uint8_t k = (uint8_t)(rnd() % KEYS);
+    uint32_t v = random_value(k);
+    if(config_set(&c, k, v) != CONFIG_OK) {
+      printf("%s: SET %u failed\n", mode, i);
+      return 1;
+    }
+    expect[k] = v;
+
+    if(rnd() % 50 == 0) {
+      compactions += c.compactions;
+      boot(&c);
+      for(uint8_t j = 0; j < KEYS; j++) {
+        if(config_get(&c, j) != expect[j]) {
+          printf("%s: after %u SETs key %u reloads as %lu, expected %lu\n", mode, i + 1, j,
+                 (unsigned long)config_get(&c, j), (unsigned long)expect[j]);
+          return 1;
+        }
+      }
+    }
+  }
+  compactions += c.compactions;
+
+  /* Reset after every possible number of programmed words */
+  unsigned resets = 0;
+  for(int32_t n = 0; n < 40; n++) {
+    uint8_t k = (uint8_t)(rnd() % KEYS);
+    uint32_t v = random_value(k);
+    while(v == expect[k]) v = random_value(k);
+
+    fail_after = n;
+    config_set(&c, k, v);
+    fail_after = -1;
+    boot(&c);
+    resets++;
+
+    for(uint8_t j = 0; j < KEYS; j++) {
+      uint32_t got = config_get(&c, j);
+      if(got != expect[j] && !(j == k && got == v)) {
+        printf("%s: reset after %ld words, key %u is %lu\n", mode, (long)n, j, (unsigned long)got);
+        return 1;
+      }
+    }
+    expect[k] = config_get(&c, k);
+  }
+
+  /* Wear: each word once per area-full of SETs, give or take the headers */
+  uint32_t max_wear = 0, total = 0;
+  for(uint8_t a = 0; a < 2; a++) {
+    for(uint32_t i = 0; i < AREA_WORDS; i++) {
+      total += wear[a][i];
+      if(wear[a][i] > max_wear) max_wear = wear[a][i];
+    }
+  }
+  uint32_t mean = total / (2 * AREA_WORDS);
+  int fail = max_wear > 2 * mean + 2;
+
+  printf("%-6s %u SETs, %u area switches, %u resets recovered, wear mean %lu max %lu per word%s\n", mode,
+         SETS, compactions, resets, (unsigned long)mean, (unsigned long)max_wear, fail ? "  FAIL" : "");
+  return fail;
+}
+
+int main(void) {
+  int fail = 0;
+  flash_mode = 0;
+  fail |= check("eeprom");
+  flash_mode = 1;
+  fail |= check("flash");
+  printf(fail ? "FAIL\n" : "PASS\n");
+  return fail;
+}
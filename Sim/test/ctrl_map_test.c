@@ -0,0 +1,107 @@
+/* ctrl_map_test.c - Monotonicity, endpoints and resolution of the servo pulse mapping
+ *
+ * Sweeps every FRAME_CTRL value through ctrl_map_us for a set of
+ * calibrations and checks that:
+ *   - the compile-time curve tables start at 0 and end at 1.0, and the
+ *     run-time builder gives the same tables
+ *   - the pulse never decreases as the value increases
+ *   - -max, 0 and +max give min_us, center_us and max_us exactly
+ *   - adjacent values differ by at most one microsecond and every
+ *     microsecond of the range is produced (full timer resolution), for
+ *     expo up to 50%
+ */
+#include "ctrl_map.h"
+#include <stdio.h>
+
+static const uint16_t curve_0[CTRL_MAP_POINTS] = CTRL_MAP_CURVE(0);
+static const uint16_t curve_30[CTRL_MAP_POINTS] = CTRL_MAP_CURVE(30);
+static const uint16_t curve_50[CTRL_MAP_POINTS] = CTRL_MAP_CURVE(50);
+static const uint16_t curve_100[CTRL_MAP_POINTS] = CTRL_MAP_CURVE(100);
+
+static const struct {
+  const char*  name;
+  CtrlMapCal_t cal;
+  unsigned     expo;
+} cases[] = {
+  { "linear",            { 1000, 1500, 2000, curve_0 },   0 },
+  { "rudder trim+30",    { 1000, 1530, 2000, curve_30 },  30 },
+  { "throttle one-side", { 1000, 1000, 2000, curve_30 },  30 },
+  { "narrow trim-40",    { 1100, 1460, 1900, curve_50 },  50 },
+  { "full expo",         { 1000, 1500, 2000, curve_100 }, 100 },
+};
+
+static int check(const char* name, const CtrlMapCal_t* cal, unsigned expo) {
+  static uint8_t seen[65536];
+  int fail = 0;
+  unsigned max_step = 0, distinct = 0;
+  uint16_t prev = 0;
+
+  if(cal->curve[0] != 0 || cal->curve[CTRL_MAP_POINTS - 1] != CTRL_MAP_ONE) {
+    printf("%s: curve ends %u..%u\n", name, cal->curve[0], cal->curve[CTRL_MAP_POINTS - 1]);
+    fail = 1;
+  }
+
+  for(unsigned i = cal->min_us; i <= cal->max_us; i++) seen[i] = 0;
+
+  for(int32_t v = -FRAME_CTRL_MAX; v <= FRAME_CTRL_MAX; v++) {
+    uint16_t us = ctrl_map_us(cal, (int16_t)v);
+    if(us < cal->min_us || us > cal->max_us) {
+      printf("%s: %ld -> %u us out of range\n", name, (long)v, us);
+      return 1;
+    }
+    if(v > -FRAME_CTRL_MAX) {
+      if(us < prev) {
+        printf("%s: not monotonic at %ld (%u -> %u us)\n", name, (long)v, prev, us);
+        fail = 1;
+      }
+      if((unsigned)(us - prev) > max_step) max_step = us - prev;
+    }
+    if(!seen[us]) distinct++;
+    seen[us] = 1;
+    prev = us;
+  }
+
+  uint16_t lo = ctrl_map_us(cal, -FRAME_CTRL_MAX);
+  uint16_t mid = ctrl_map_us(cal, 0);
+  uint16_t hi = ctrl_map_us(cal, FRAME_CTRL_MAX);
+  if(lo != cal->min_us || mid != cal->center_us || hi != cal->max_us) {
+    printf("%s: endpoints %u/%u/%u us, expected %u/%u/%u\n", name, lo, mid, hi,
+           cal->min_us, cal->center_us, cal->max_us);
+    fail = 1;
+  }
+
+  unsigned range = cal->max_us - cal->min_us + 1U;
+  if(expo <= 50 && (max_step > 1 || distinct != range)) {
+    printf("%s: resolution %u of %u us reached, largest step %u us\n", name, distinct, range, max_step);
+    fail = 1;
+  }
+
+  printf("%-18s expo %3u%%: %4u distinct pulses over %4u us, largest step %u us%s\n", name, expo,
+         distinct, range, max_step, fail ? "  FAIL" : "");
+  return fail;
+}
+
+static int check_build(unsigned expo, const uint16_t* expected) {
+  uint16_t curve[CTRL_MAP_POINTS];
+  ctrl_map_build_curve(curve, (uint8_t)expo);
+  for(unsigned i = 0; i < CTRL_MAP_POINTS; i++) {
+    if(curve[i] != expected[i]) {
+      printf("expo %u: built entry %u is %u, table has %u\n", expo, i, curve[i], expected[i]);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int main(void) {
+  int fail = 0;
+  fail |= check_build(0, curve_0);
+  fail |= check_build(30, curve_30);
+  fail |= check_build(50, curve_50);
+  fail |= check_build(100, curve_100);
+  for(size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    fail |= check(cases[i].name, &cases[i].cal, cases[i].expo);
+  }
+  printf(fail ? "FAIL\n" : "PASS\n");
+  return fail;
+}
@@ -0,0 +1,138 @@
+/* frame_test.c - Binary frame codec of the LoRa link
+ *
+ * Encodes a table of frames of every type and checks that:
+ *   - each decodes back to the same values, and the escaped bytes never
+ *     contain NUL, CR or LF
+ *   - payload bytes equal to NUL, CR, LF or FRAME_ESC are escaped
+ *   - signed 12-bit CTRL values keep their sign, and values beyond
+ *     FRAME_CTRL_MAX are clamped
+ *   - any single-bit error, any truncation and any trailing byte is
+ *     rejected
+ *   - CRC-16/CCITT-FALSE gives the standard check value, and frames that
+ *     cannot be encoded (unknown type, bad text length, small buffer) are
+ *     refused
+ */
+#include "frame.h"
+#include <stdio.h>
+#include <string.h>
+
+static const struct {
+  const char* name;
+  Frame_t     f;                  /* Encoded */
+  Frame_t     expect;             /* Decoded, all zero = same as f */
+} cases[] = {
+  { "CTRL zero",         { .type = FRAME_CTRL, .seq = 1, .u.ctrl = { 0, 0 } } },
+  { "CTRL full scale",   { .type = FRAME_CTRL, .seq = 2, .u.ctrl = { FRAME_CTRL_MAX, -FRAME_CTRL_MAX } } },
+  { "CTRL -1, -1000",    { .type = FRAME_CTRL, .seq = 3, .u.ctrl = { -1, -1000 } } },
+  { "CTRL 1, -2048",     { .type = FRAME_CTRL, .seq = 4, .u.ctrl = { 1, -2048 } },
+                         { .type = FRAME_CTRL, .seq = 4, .u.ctrl = { 1, -FRAME_CTRL_MAX } } },
+  { "CTRL clamped",      { .type = FRAME_CTRL, .seq = 5, .u.ctrl = { 3000, -30000 } },
+                         { .type = FRAME_CTRL, .seq = 5, .u.ctrl = { FRAME_CTRL_MAX, -FRAME_CTRL_MAX } } },
+  { "GPS negative",      { .type = FRAME_GPS,  .seq = 6, .u.gps = { -338612345, -1512098765 } } },
+  { "GPS escaped bytes", { .type = FRAME_GPS,  .seq = '\n', .u.gps = { 0x000A0D7D, 0x7D0D0A00 } } },
+  { "CMD",               { .type = FRAME_CMD,  .seq = 7, .u.cmd = { .session = 0x7D, .len = 4, .text = "STOP" } } },
+  { "CMD longest",       { .type = FRAME_CMD,  .seq = 8, .u.cmd = { .session = 1, .len = FRAME_CMD_TEXT_MAX,
+                             .text = "SET,FAILSAFE_TIMEOUT_MS,1234,0123456789A" } } },
+  { "GCMD",              { .type = FRAME_GCMD, .seq = 9, .u.cmd = { .session = 2, .group = 0x55, .len = 1, .text = "X" } } },
+  { "ACK",               { .type = FRAME_ACK,  .seq = 10, .u.ack = { 3, 200, 0x8000000DU } } },
+  { "LINK",              { .type = FRAME_LINK, .seq = 11, .u.link = { 1, 255, 65535 } } },
+  { "SYNC",              { .type = FRAME_SYNC, .seq = 12, .u.sync = { 100, 8, 7, 13, 142, 171 } } },
+  { "RATE",              { .type = FRAME_RATE, .seq = 13, .u.rate = { 10, 8, 3 } } },
+};
+#define CASES (sizeof(cases) / sizeof(cases[0]))
+
+static const Frame_t zero;
+
+/* Fields of the frame's type only: the union holds the others' leftovers */
+static int same(const Frame_t* a, const Frame_t* b) {
+  if(a->type != b->type || a->seq != b->seq) return 0;
+  switch(a->type) {
+  case FRAME_CTRL: return a->u.ctrl.thrust == b->u.ctrl.thrust && a->u.ctrl.rudder == b->u.ctrl.rudder;
+  case FRAME_GPS:  return a->u.gps.lat_e7 == b->u.gps.lat_e7 && a->u.gps.lon_e7 == b->u.gps.lon_e7;
+  case FRAME_CMD:
+  case FRAME_GCMD: return a->u.cmd.session == b->u.cmd.session && a->u.cmd.group == b->u.cmd.group &&
+                          a->u.cmd.len == b->u.cmd.len && strcmp(a->u.cmd.text, b->u.cmd.text) == 0;
+  case FRAME_ACK:  return a->u.ack.session == b->u.ack.session && a->u.ack.top == b->u.ack.top &&
+                          a->u.ack.bitmap == b->u.ack.bitmap;
+  case FRAME_LINK: return a->u.link.failsafe == b->u.link.failsafe && a->u.link.events == b->u.link.events &&
+                          a->u.link.gap_ms == b->u.link.gap_ms;
+  case FRAME_SYNC: return memcmp(&a->u.sync, &b->u.sync, sizeof(a->u.sync)) == 0;
+  case FRAME_RATE: return memcmp(&a->u.rate, &b->u.rate, sizeof(a->u.rate)) == 0;
+  default:         return 0;
+  }
+}
+
+static int check(unsigned c) {
+  const Frame_t* expect = memcmp(&cases[c].expect, &zero, sizeof(zero)) ? &cases[c].expect : &cases[c].f;
+  char enc[FRAME_MAX_ENCODED], bad[FRAME_MAX_ENCODED];
+  Frame_t f;
+  unsigned escapes = 0, accepted = 0;
+
+  size_t n = frame_encode(&cases[c].f, enc, sizeof(enc));
+  if(n == 0 || strlen(enc) != n || strpbrk(enc, "\r\n") || !frame_is_binary(enc, n)) {
+    printf("%-18s not encoded as one text-safe line\n", cases[c].name);
+    return 1;
+  }
+  for(size_t i = 0; i < n; i++) escapes += (uint8_t)enc[i] == FRAME_ESC;
+
+  memset(&f, 0, sizeof(f));
+  int fail = !frame_decode(enc, n, &f) || !same(&f, expect);
+
+  /* Every single-bit error */
+  for(size_t i = 0; i < n; i++) {
+    for(uint8_t b = 0; b < 8; b++) {
+      memcpy(bad, enc, n);
+      bad[i] ^= (char)(1 << b);
+      accepted += frame_decode(bad, n, &f);
+    }
+  }
+  /* Every truncation, and a trailing byte */
+  for(size_t len = 0; len < n; len++) accepted += frame_decode(enc, len, &f);
+  memcpy(bad, enc, n);
+  bad[n] = 'x';
+  accepted += frame_decode(bad, n + 1, &f);
+
+  if(accepted) fail = 1;
+  printf("%-18s %2u bytes, %u escaped, %u corrupt frames accepted%s\n", cases[c].name, (unsigned)n,
+         escapes, accepted, fail ? "  FAIL" : "");
+  return fail;
+}
+
+static int check_refused(void) {
+  static const uint8_t digits[] = "123456789";
+  char enc[FRAME_MAX_ENCODED];
+  Frame_t f = cases[0].f;
+  int fail = 0;
+
+  if(frame_crc16(digits, 9) != 0x29B1) {
+    printf("CRC-16 check value %04X, expected 29B1\n", frame_crc16(digits, 9));
+    fail = 1;
+  }
+
+  f.type = 0;
+  fail |= frame_encode(&f, enc, sizeof(enc)) != 0;
+  f.type = 15;
+  fail |= frame_encode(&f, enc, sizeof(enc)) != 0;
+
+  f = cases[7].f;
+  f.u.cmd.len = 0;
+  fail |= frame_encode(&f, enc, sizeof(enc)) != 0;
+  f.u.cmd.len = FRAME_CMD_TEXT_MAX + 1;
+  fail |= frame_encode(&f, enc, sizeof(enc)) != 0;
+
+  /* Room for every byte but the terminator */
+  f = cases[7].f;
+  size_t n = frame_encode(&f, enc, sizeof(enc));
+  fail |= frame_encode(&f, enc, n) != 0;
+
+  printf("Refused: unknown types, empty and overlong text, small buffer%s\n", fail ? "  FAIL" : "");
+  return fail;
+}
+
+int main(void) {
+  int fail = 0;
+  for(unsigned c = 0; c < CASES; c++) fail |= check(c);
+  fail |= check_refused();
+  printf(fail ? "FAIL\n" : "PASS\n");
+  return fail;
+}
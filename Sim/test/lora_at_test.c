@@ -0,0 +1,77 @@
+/* lora_at_test.c - Reply matching of the AT command engine
+ *
+ * Replays module replies and timeouts against a four-command script run
+ * with LORA_AT_WINDOW commands in flight and checks, for each case, the
+ * commands written to the module and the final state. A reply matched to
+ * the wrong command shows up as a command re-sent too early or the script
+ * completing before every command was answered:
+ *   - replies in order complete the script
+ *   - +ERR on the first or second of two commands in flight: the other's reply
+ *     still arrives and must not complete a re-sent command
+ *   - a timeout with a late reply behind it
+ *   - retries exhausted
+ */
+#include "lora_at.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char* const script[] = { "A", "B", "C", "D" };
+#define COUNT 4
+
+static char sent[64];                     /* Commands written, in order */
+
+static void send(const char* cmd) {
+  strncat(sent, cmd, sizeof(sent) - strlen(sent) - 1);
+}
+
+typedef enum { OK, ERR, WAIT } Step_t;    /* Reply +OK, reply +ERR, let ms pass */
+
+static const struct {
+  const char* name;
+  Step_t      steps[16];
+  uint16_t    ms[16];                     /* Time per WAIT step */
+  uint8_t     n;
+  const char* sent;
+  uint8_t     state;
+} cases[] = {
+  { "in order",             { OK, OK, OK, OK }, { 0 }, 4, "ABCD", LORA_AT_DONE },
+  { "ERR, reply in flight", { ERR, OK, OK, OK, OK, OK }, { 0 }, 6, "ABABCD", LORA_AT_DONE },
+  { "ERR on the second",    { OK, ERR, OK, OK, OK, OK }, { 0 }, 6, "ABCBCD", LORA_AT_DONE },
+  { "timeout, late reply",  { WAIT, OK, OK, OK, OK, OK, OK },
+                            { LORA_AT_TIMEOUT_MS }, 7, "ABABCD", LORA_AT_DONE },
+  { "timeout, no reply",    { WAIT, WAIT, OK, OK, OK, OK },
+                            { LORA_AT_TIMEOUT_MS, LORA_AT_TIMEOUT_MS }, 6, "ABABCD", LORA_AT_DONE },
+  { "retries exhausted",    { ERR, OK, ERR, OK, ERR, OK, ERR }, { 0 }, 7, "ABABABAB", LORA_AT_FAILED },
+};
+#define CASES (sizeof(cases) / sizeof(cases[0]))
+
+static int check(unsigned c) {
+  LoRaAt_t at = { .send = send };
+  uint32_t now = 0;
+
+  sent[0] = 0;
+  lora_at_run(&at, script, COUNT, now);
+
+  for(uint8_t i = 0, w = 0; i < cases[c].n; i++) {
+    if(cases[c].steps[i] == WAIT) {
+      now += cases[c].ms[w++];
+      lora_at_poll(&at, now);
+    }
+    else {
+      lora_at_on_line(&at, cases[c].steps[i] == OK ? "+OK" : "+ERR=4", now);
+    }
+  }
+
+  int fail = strcmp(sent, cases[c].sent) != 0 || at.state != cases[c].state;
+  printf("%-22s sent %-10s state %u, %lu retries, %lu late replies discarded%s\n", cases[c].name, sent,
+         at.state, (unsigned long)at.retries, (unsigned long)at.drained, fail ? "  FAIL" : "");
+  if(fail) printf("  expected sent %s state %u\n", cases[c].sent, cases[c].state);
+  return fail;
+}
+
+int main(void) {
+  int fail = 0;
+  for(unsigned c = 0; c < CASES; c++) fail |= check(c);
+  printf(fail ? "FAIL\n" : "PASS\n");
+  return fail;
+}
@@ -0,0 +1,288 @@
+/* nmea_bench.c - Streaming NMEA parser against the former strtok/atof parser
+ *
+ * Builds a corpus of RMC, GGA, VTG, GSA and GSV sentences with random
+ * values, and runs it through
+ *   - nmea_feed, one character at a time as the UART delivers them, and
+ *   - the line parser the boards used before (checksum with strrchr,
+ *     fields with strtok, coordinates with atof into double, then float),
+ *     extended to the GGA fields for the comparison.
+ * It checks that every RMC and GGA sentence decodes to the same values
+ * (positions to within 1e-7 degree of the double result, altitude and
+ * satellites exactly), and that VTG, GSA and GSV, which the old parser
+ * ignored, decode exactly to the values they were built from (course,
+ * speeds, fix mode, DOPs and satellites in view, with empty fields). It
+ * reports how far the old float positions were off, and prints the host
+ * time per RMC or GGA sentence of both. The old parser is handed complete
+ * lines, so its line assembly is not counted. Only the check can fail:
+ * the host's FPU hides the cost of atof and the double arithmetic, which
+ * run in software on both boards (the F446's FPU is single precision), so
+ * the ratio is a lower bound for them.
+ */
+#include "nmea.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SENTENCES   2000
+#define ROUNDS      50
+
+typedef struct {
+  char       line[96];
+  NmeaType_t type;
+  uint32_t   expect[4];       /* VTG, GSA, GSV: values built into the line */
+} Sentence_t;
+
+static Sentence_t corpus[SENTENCES];
+
+static uint32_t rnd_state = 1;
+static uint32_t rnd(void) {
+  rnd_state = rnd_state * 1103515245U + 12345U;
+  return rnd_state >> 8;
+}
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* Append *hh and CR/LF to a sentence body starting with $ */
+static void finish(char* s) {
+  uint8_t x = 0;
+  for(const char* p = s + 1; *p; p++) x ^= (uint8_t)*p;
+  sprintf(s + strlen(s), "*%02X\r\n", x);
+}
+
+static void build(void) {
+  for(int i = 0; i < SENTENCES; i++) {
+    Sentence_t* c = &corpus[i];
+    char lat[16], lon[16];
+    char ns = (rnd() & 1) ? 'N' : 'S', ew = (rnd() & 1) ? 'E' : 'W';
+
+    snprintf(lat, sizeof(lat), "%02u%02u.%05u", rnd() % 90, rnd() % 60, rnd() % 100000);
+    snprintf(lon, sizeof(lon), "%03u%02u.%05u", rnd() % 180, rnd() % 60, rnd() % 100000);
+
+    uint32_t* e = c->expect;
+    c->type = (NmeaType_t)(NMEA_RMC + i % 5);
+    switch(c->type) {
+    case NMEA_GGA:
+      snprintf(c->line, sizeof(c->line), "$GPGGA,123519.00,%s,%c,%s,%c,1,%02u,0.9,%u.%u,M,46.9,M,0,0000",
+               lat, ns, lon, ew, rnd() % 24, rnd() % 3000, rnd() % 10);
+      break;
+    case NMEA_VTG:
+      /* Course 1/100 degree, speeds 1/1000 knot and km/h */
+      e[0] = rnd() % 36000;
+      e[1] = rnd() % 100000;
+      e[2] = rnd() % 200000;
+      snprintf(c->line, sizeof(c->line), "$GPVTG,%03u.%02u,T,,M,%03u.%03u,N,%03u.%03u,K,A", e[0] / 100,
+               e[0] % 100, e[1] / 1000, e[1] % 1000, e[2] / 1000, e[2] % 1000);
+      break;
+    case NMEA_GSA:
+      /* Mode, PDOP, HDOP, VDOP * 100; unused satellite slots empty */
+      e[0] = 1 + rnd() % 3;
+      e[1] = rnd() % 2000;
+      e[2] = rnd() % 2000;
+      e[3] = rnd() % 2000;
+      snprintf(c->line, sizeof(c->line), "$GNGSA,A,%u,04,05,,09,12,,,24,,,,,%u.%02u,%u.%02u,%u.%02u", e[0],
+               e[1] / 100, e[1] % 100, e[2] / 100, e[2] % 100, e[3] / 100, e[3] % 100);
+      break;
+    case NMEA_GSV:
+      /* Satellites in view; one satellite without SNR */
+      e[0] = rnd() % 40;
+      snprintf(c->line, sizeof(c->line), "$GPGSV,3,1,%02u,03,03,111,00,04,15,270,,06,01,010,00,13,06,292,00",
+               e[0]);
+      break;
+    default:
+      snprintf(c->line, sizeof(c->line), "$GNRMC,123519.00,A,%s,%c,%s,%c,022.4,084.4,230394,003.1,W",
+               lat, ns, lon, ew);
+      break;
+    }
+    finish(c->line);
+  }
+}
+
+/* ---- Former parser: whole line, strtok and atof ---- */
+
+typedef struct {
+  double  lat, lon;
+  int32_t alt_cm;
+  uint8_t sats;
+} Legacy_t;
+
+static int legacy_checksum_ok(const char* s) {
+  if(!s || s[0] != '$') return 0;
+
+  const char* star = strrchr(s, '*');
+  if(!star || star - s < 2) return 0;
+
+  uint8_t x = 0;
+  for(const char* p = s + 1; p < star; ++p) x ^= (uint8_t)(*p);
+
+  uint8_t h = (uint8_t)((star[1] >= 'A' && star[1] <= 'F') ? 10 + star[1] - 'A' : star[1] - '0');
+  uint8_t l = (uint8_t)((star[2] >= 'A' && star[2] <= 'F') ? 10 + star[2] - 'A' : star[2] - '0');
+  return x == ((h << 4) | l);
+}
+
+static double legacy_ddmm(const char* ddmm, const char* hemi) {
+  double v = atof(ddmm);
+  int deg = (int)(v / 100.0);
+  double val = deg + (v - deg * 100.0) / 60.0;
+  return (*hemi == 'S' || *hemi == 'W') ? -val : val;
+}
+
+/* 1 = RMC, 2 = GGA, 0 = rejected */
+static int legacy_parse(char* line, Legacy_t* out) {
+  int gga = strncmp(line + 3, "GGA", 3) == 0;
+  if(!gga && strncmp(line + 3, "RMC", 3) != 0) return 0;
+  if(!legacy_checksum_ok(line)) return 0;
+
+  char* tok[16] = { 0 };
+  int n = 0;
+  char* p = strtok(line, ",");
+  while(p && n < 16) {
+    tok[n++] = p;
+    p = strtok(NULL, ",");
+  }
+
+  if(gga) {
+    if(n < 10) return 0;
+    out->lat = legacy_ddmm(tok[2], tok[3]);
+    out->lon = legacy_ddmm(tok[4], tok[5]);
+    out->sats = (uint8_t)atoi(tok[7]);
+    out->alt_cm = (int32_t)(atof(tok[9]) * 100.0 + 0.5);
+    return 2;
+  }
+  if(n < 7 || *tok[2] != 'A') return 0;
+  out->lat = legacy_ddmm(tok[3], tok[4]);
+  out->lon = legacy_ddmm(tok[5], tok[6]);
+  return 1;
+}
+
+static int32_t round_e7(double deg) {
+  double v = deg * 1e7;
+  return (int32_t)(v < 0 ? v - 0.5 : v + 0.5);
+}
+
+/* ---- Comparison ---- */
+
+/* VTG, GSA and GSV against the values they were built from */
+static int check_other(const Sentence_t* c, const NmeaData_t* d) {
+  const uint32_t* e = c->expect;
+  switch(c->type) {
+  case NMEA_VTG: return d->course_cdeg == e[0] && d->speed_mknots == e[1] && d->speed_mkmh == e[2];
+  case NMEA_GSA: return d->fix_mode == e[0] && d->pdop_x100 == e[1] && d->hdop_x100 == e[2] &&
+                        d->vdop_x100 == e[3];
+  case NMEA_GSV: return d->sats_in_view == e[0];
+  default:       return 0;
+  }
+}
+
+static int check(void) {
+  NmeaParser_t p;
+  int fail = 0, others = 0;
+  int32_t float_err = 0;
+
+  nmea_init(&p);
+  for(int i = 0; i < SENTENCES; i++) {
+    Sentence_t* c = &corpus[i];
+    char line[96];
+    Legacy_t old;
+    NmeaType_t got = NMEA_NONE;
+
+    for(const char* s = c->line; *s; s++) {
+      NmeaType_t t = nmea_feed(&p, *s);
+      if(t != NMEA_NONE) got = t;
+    }
+
+    if(c->type != NMEA_RMC && c->type != NMEA_GGA) {
+      others++;
+      if(got != c->type || !check_other(c, &p.data)) {
+        printf("sentence %d decoded wrong: %s", i, c->line);
+        fail = 1;
+      }
+      continue;
+    }
+
+    int gga = c->type == NMEA_GGA;
+    strcpy(line, c->line);
+    line[strcspn(line, "\r\n")] = 0;
+    int kind = legacy_parse(line, &old);
+
+    if(got != c->type || kind != (gga ? 2 : 1)) {
+      printf("sentence %d not decoded by both: %s", i, c->line);
+      fail = 1;
+      continue;
+    }
+
+    int32_t lat_e7 = round_e7(old.lat);
+    int32_t lon_e7 = round_e7(old.lon);
+    if(labs((long)(p.data.lat_e7 - lat_e7)) > 1 || labs((long)(p.data.lon_e7 - lon_e7)) > 1) {
+      printf("sentence %d: %ld,%ld e-7 deg, expected %ld,%ld: %s", i, (long)p.data.lat_e7,
+             (long)p.data.lon_e7, (long)lat_e7, (long)lon_e7, c->line);
+      fail = 1;
+    }
+    if(gga && (p.data.alt_cm != old.alt_cm || p.data.num_sats != old.sats)) {
+      printf("sentence %d: altitude %ld cm, %u satellites, expected %ld cm, %u: %s", i,
+             (long)p.data.alt_cm, p.data.num_sats, (long)old.alt_cm, old.sats, c->line);
+      fail = 1;
+    }
+
+    /* The old boards handed the position on as float */
+    int32_t e = labs((long)(round_e7((float)old.lat) - lat_e7));
+    if(e > float_err) float_err = e;
+    e = labs((long)(round_e7((float)old.lon) - lon_e7));
+    if(e > float_err) float_err = e;
+  }
+
+  printf("Decoded %d sentences (RMC and GGA) alike; old float positions off by up to %ld e-7 deg (%.1f m)\n",
+         SENTENCES - others, (long)float_err, float_err * 0.0111);
+  printf("Decoded %d VTG, GSA and GSV sentences exactly\n", others);
+  return fail;
+}
+
+static void bench(void) {
+  static char lines[SENTENCES][96];
+  volatile int32_t sink = 0;
+  NmeaParser_t p;
+  int positions = 0;
+
+  for(int i = 0; i < SENTENCES; i++) positions += corpus[i].type == NMEA_RMC || corpus[i].type == NMEA_GGA;
+
+  nmea_init(&p);
+  uint64_t t0 = now_ns();
+  for(int r = 0; r < ROUNDS; r++) {
+    for(int i = 0; i < SENTENCES; i++) {
+      if(corpus[i].type != NMEA_RMC && corpus[i].type != NMEA_GGA) continue;
+      for(const char* s = corpus[i].line; *s; s++) nmea_feed(&p, *s);
+      sink += p.data.lat_e7;
+    }
+  }
+  uint64_t t_new = now_ns() - t0;
+
+  t0 = now_ns();
+  for(int r = 0; r < ROUNDS; r++) {
+    for(int i = 0; i < SENTENCES; i++) {
+      Legacy_t old;
+      if(corpus[i].type != NMEA_RMC && corpus[i].type != NMEA_GGA) continue;
+      memcpy(lines[i], corpus[i].line, sizeof(lines[i]));
+      lines[i][strcspn(lines[i], "\r\n")] = 0;
+      legacy_parse(lines[i], &old);
+      sink += (int32_t)old.lat;
+    }
+  }
+  uint64_t t_old = now_ns() - t0;
+  (void)sink;
+
+  double n = (double)positions * ROUNDS;
+  printf("Host time per sentence: streaming %.0f ns, strtok/atof %.0f ns (%.1fx)\n",
+         t_new / n, t_old / n, (double)t_old / (double)(t_new ? t_new : 1));
+}
+
+int main(void) {
+  build();
+  int fail = check();
+  bench();
+  printf(fail ? "FAIL\n" : "PASS\n");
+  return fail;
+}
@@ -0,0 +1,72 @@
+#!/bin/sh
+# sim_adr.sh - Adaptive data rate: speeding up on a strong link, falling back on loss.
+#
+# Usage: sim_adr.sh <sim_controller> <sim_boat> [duration_ms]
+# The boat streams GPS over a strong link (SNR 10 dB, RSSI -60 dBm) and
+# LORA_ADR is switched on over Bluetooth. Controller and boat must step
+# together from SF9/125 kHz to SF7/500 kHz. A 5 s outage of the boat's
+# transmitter then has to bring both back to SF9/125 kHz, where the
+# controller must hear the boat again.
+
+CONTROLLER=$1
+BOAT=$2
+DURATION=${3:-34000}
+OUTAGE_MS=20000
+
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+BASE=$((20000 + ($$ % 20000) * 2))
+
+fail() {
+  echo "FAIL: $1"
+  exit 1
+}
+
+# RMC fixes at 9600 baud, one about every 70 ms, for the whole run
+i=0
+while [ $i -lt 500 ]; do
+  echo '$GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W*6A'
+  i=$((i + 1))
+done > "$DIR/gps.nmea"
+
+SIM_TRACE=1 SIM_DURATION_MS=$((DURATION + 1000)) \
+  SIM_LORA_PORT=$BASE SIM_LORA_PEER=$((BASE + 1)) \
+  SIM_LORA_OUTAGE=$OUTAGE_MS+5000 \
+  SIM_USART3="$DIR/gps.nmea" SIM_USART2=stdio \
+  "$BOAT" < /dev/null > "$DIR/boat.dbg" 2> "$DIR/boat.log" &
+BOAT_PID=$!
+
+{
+  sleep 1
+  echo "SET,LORA_ADR,1"
+  sleep $((DURATION / 1000 - 2))
+  echo "ADR"
+  sleep 0.2
+  echo "FLEET"
+  sleep 0.5
+} | SIM_TRACE=1 SIM_DURATION_MS=$DURATION \
+  SIM_LORA_PORT=$((BASE + 1)) SIM_LORA_PEER=$BASE \
+  SIM_USART1=stdio SIM_PA8=1 SIM_ADC_SWEEP=9 SIM_ADC_PERIOD_MS=2000 \
+  "$CONTROLLER" > "$DIR/bt.out" 2> "$DIR/controller.log"
+wait $BOAT_PID
+
+grep -h '^SIM .* LORA' "$DIR/controller.log" "$DIR/boat.log"
+tr -d '\r' < "$DIR/bt.out" | grep '^RATE,\|^ADR,'
+echo "Boat: $(tr -d '\r' < "$DIR/boat.dbg" | grep '^RATE,' | tr '\n' ' ')"
+
+# Controller and boat take the same steps, up to the fastest rate
+CTRL_STEPS=$(tr -d '\r' < "$DIR/bt.out" | grep '^RATE,' | cut -d, -f2,3 | tr '\n' ' ')
+BOAT_STEPS=$(tr -d '\r' < "$DIR/boat.dbg" | grep '^RATE,' | cut -d, -f2,3 | tr '\n' ' ')
+[ "$CTRL_STEPS" = "$BOAT_STEPS" ] || fail "controller and boat rates differ"
+tr -d '\r' < "$DIR/bt.out" | grep -qx 'RATE,7,9,FASTER' || fail "fastest rate not reached"
+
+# Outage: back home, and the boat heard there
+tr -d '\r' < "$DIR/bt.out" | grep -qx 'RATE,9,7,FALLBACK' || fail "no fallback on link loss"
+[ "$(tr -d '\r' < "$DIR/boat.dbg" | grep '^RATE,' | tail -1)" = "RATE,9,7" ] || fail "boat did not fall back"
+# FLEET,1,STATE,<address>,<age ms>,...
+AGE=$(tr -d '\r' < "$DIR/bt.out" | grep '^FLEET,1,STATE,' | cut -d, -f5)
+echo "Boat last heard ${AGE} ms before the end"
+[ -n "$AGE" ] && [ "$AGE" -ge 0 ] && [ "$AGE" -lt 2000 ] || fail "boat not heard after the fallback"
+
+echo "PASS"
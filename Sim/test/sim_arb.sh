@@ -0,0 +1,78 @@
+#!/bin/sh
+# sim_arb.sh - Joystick and app as control sources, one at a time.
+#
+# Usage: sim_arb.sh <sim_controller> <sim_boat>
+#  2.5 s  the app sends THRUST,60 while the sticks are idle: it takes over
+#         and the joystick stops sending, so the boat's throttle holds
+#  5 s    the app goes silent: control returns to the joystick on timeout
+#  8 s    the app sends again and takes over again
+# 10 s    the thrust stick moves: the joystick takes priority and the
+#         app's lines are dropped
+# The controller must report each hand-over as SOURCE,... and ARB.
+
+CONTROLLER=$1
+BOAT=$2
+
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+BASE=$((20000 + ($$ % 20000) * 2))
+
+fail() {
+  echo "FAIL: $1"
+  exit 1
+}
+
+# pairs <count>: THRUST/RUDDER pairs every 200 ms
+pairs() {
+  i=0
+  while [ $i -lt "$1" ]; do
+    printf 'THRUST,60\nRUDDER,0\n'
+    sleep 0.2
+    i=$((i + 1))
+  done
+}
+
+SIM_TRACE=1 SIM_DURATION_MS=14000 \
+  SIM_LORA_PORT=$BASE SIM_LORA_PEER=$((BASE + 1)) \
+  "$BOAT" < /dev/null > /dev/null 2> "$DIR/boat.log" &
+BOAT_PID=$!
+
+{
+  sleep 2.5
+  pairs 12
+  sleep 3
+  pairs 20
+  sleep 0.5
+  echo "ARB"
+  sleep 0.5
+} | SIM_TRACE=1 SIM_DURATION_MS=13500 \
+  SIM_LORA_PORT=$((BASE + 1)) SIM_LORA_PEER=$BASE \
+  SIM_USART1=stdio SIM_PA8=1 \
+  SIM_ADC_SWEEP=9 SIM_ADC_PERIOD_MS=4000 SIM_ADC_SWEEP_AT_MS=10000 \
+  "$CONTROLLER" > "$DIR/bt.out" 2> "$DIR/controller.log"
+wait $BOAT_PID
+
+grep -h '^SIM .* LORA' "$DIR/controller.log" "$DIR/boat.log"
+tr -d '\r' < "$DIR/bt.out" | grep '^SOURCE,\|^ARB,'
+
+SOURCES=$(tr -d '\r' < "$DIR/bt.out" | grep '^SOURCE,' | tr '\n' ' ')
+[ "$SOURCES" = "SOURCE,APP,IDLE SOURCE,JOYSTICK,TIMEOUT SOURCE,APP,IDLE SOURCE,JOYSTICK,PRIORITY " ] || \
+  fail "unexpected hand-overs"
+
+# ARB,<source>,<ms in control>,<to app>,<to joystick>,<timeouts>,<app lines dropped>
+ARB=$(tr -d '\r' < "$DIR/bt.out" | grep '^ARB,')
+echo "$ARB" | grep -q '^ARB,JOYSTICK,[0-9]*,2,2,1,[1-9][0-9]*$' || fail "unexpected ARB counters"
+
+# While the app drives, nothing else moves the throttle: it rises to the
+# app's value and holds until the timeout, then returns to idle (times
+# from the boat's first PWM line, at boot)
+grep 'PWM TIM' "$DIR/boat.log" | awk '
+  NR == 1 { t0 = $1 }
+  $4 != "TIM3" || $5 != "CH1" { next }
+  $1 - t0 >= 2.5 && $1 - t0 < 6.8 { if($(NF - 1) < v) down = 1; v = $(NF - 1) }
+  $1 - t0 >= 6.8 && $1 - t0 < 8.0 { last = $(NF - 1) }
+  END { printf "Throttle: %d us under the app, %d us after its timeout\n", v, last
+        exit (down || v <= 1000 || last != 1000) }' || fail "throttle not held by the app alone"
+
+echo "PASS"
@@ -0,0 +1,62 @@
+#!/bin/sh
+# sim_arq.sh - Acknowledged command delivery over a lossy radio link.
+#
+# Usage: sim_arq.sh <sim_controller> <sim_boat> [loss_pct]
+# Sends app commands over Bluetooth while both radios drop packets, then
+# reads the controller's ARQ counters: every command must be delivered.
+
+CONTROLLER=$1
+BOAT=$2
+LOSS=${3:-20}
+COMMANDS=10
+
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+BASE=$((20000 + ($$ % 20000) * 2))
+
+SIM_DURATION_MS=27000 SIM_LORA_LOSS=$LOSS SIM_SEED=3 \
+  SIM_LORA_PORT=$BASE SIM_LORA_PEER=$((BASE + 1)) \
+  "$BOAT" < /dev/null > /dev/null 2> "$DIR/boat.log" &
+BOAT_PID=$!
+
+# Commands 400 ms apart after the modules are configured, counters once the
+# last one has had its full retry budget (CMD_ARQ_TRIES, backoff to the cap)
+{
+  sleep 1.5
+  i=0
+  while [ $i -lt $COMMANDS ]; do
+    echo "CMD,STOP"
+    sleep 0.4
+    i=$((i + 1))
+  done
+  sleep 20
+  echo "ARQ"
+  sleep 1
+} | SIM_DURATION_MS=26000 SIM_LORA_LOSS=$LOSS SIM_SEED=4 \
+  SIM_LORA_PORT=$((BASE + 1)) SIM_LORA_PEER=$BASE \
+  SIM_USART1=stdio SIM_PA8=1 \
+  "$CONTROLLER" > "$DIR/bt.out" 2> "$DIR/controller.log"
+wait $BOAT_PID
+
+grep -h '^SIM .* LORA' "$DIR/controller.log" "$DIR/boat.log"
+grep '^CMD,' "$DIR/bt.out"
+
+# ARQ,<queued>,<delivered>,<failed>,<rejected>,<sent>,<resent>,<avg ms>,<max ms>,<rto ms>,<pending>
+ARQ=$(grep '^ARQ,' "$DIR/bt.out" | tr -d '\r')
+if [ -z "$ARQ" ]; then
+  echo "FAIL: no ARQ report"
+  exit 1
+fi
+echo "$ARQ" | awk -F, '{
+  printf "Commands: queued %d, delivered %d, failed %d, rejected %d\n", $2, $3, $4, $5
+  printf "Frames: sent %d, resent %d (%.0f%%)\n", $6, $7, $6 ? 100 * $7 / $6 : 0
+  printf "Delivery latency: mean %d ms, max %d ms, timeout %d ms\n", $8, $9, $10
+}'
+
+if [ "$(echo "$ARQ" | cut -d, -f2)" -ne $COMMANDS ] || [ "$(echo "$ARQ" | cut -d, -f3)" -ne $COMMANDS ]; then
+  echo "FAIL: not every command was delivered"
+  exit 1
+fi
+
+echo "PASS"
@@ -0,0 +1,70 @@
+#!/bin/sh
+# sim_cal.sh - Stick calibration session and its storage in data EEPROM.
+#
+# Usage: sim_cal.sh <sim_controller>
+# 1. Both sticks held in the bottom-right corner at power-up start a
+#    session; without any travel it must fail and store nothing.
+# 2. A session started over Bluetooth while both sticks sweep end to end
+#    must succeed and store end stops close to the ADC limits.
+# 3. After a restart with that EEPROM and the sticks at rest off mid-scale,
+#    the stored end stops must be loaded and the centres re-captured.
+# 4. A corrupted record must be ignored.
+
+CONTROLLER=$1
+
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+# run <name> <duration_ms> <input> <environment...>
+run() {
+  NAME=$1
+  DURATION=$2
+  INPUT=$3
+  shift 3
+  sh -c "$INPUT" | env SIM_DURATION_MS=$DURATION SIM_USART1=stdio SIM_PA8=1 \
+    SIM_EEPROM="$DIR/$NAME.eeprom" "$@" \
+    "$CONTROLLER" 2> "$DIR/$NAME.log" | tr -d '\r' | grep '^CAL,' > "$DIR/$NAME.bt"
+}
+
+fail() {
+  echo "FAIL: $1"
+  exit 1
+}
+
+# 1 and 2 run side by side, each session takes JOY_CAL_MS (10 s)
+run gesture 11500 "sleep 11.2; echo CAL,GET; sleep 1" SIM_ADC9=4095 SIM_ADC6=4095 &
+GESTURE_PID=$!
+run sweep 12000 "sleep 1; echo CAL; sleep 10.5; echo CAL,GET; sleep 1" \
+  SIM_ADC_SWEEP=6,9 SIM_ADC_PERIOD_MS=2000
+wait $GESTURE_PID
+
+cat "$DIR/gesture.bt" "$DIR/sweep.bt"
+
+grep -q '^CAL,FAILED$' "$DIR/gesture.bt" || fail "boot gesture session did not fail"
+grep -q '^CAL,DEFAULT,' "$DIR/gesture.bt" || fail "failed session changed the calibration"
+
+grep -q '^CAL,STARTED$' "$DIR/sweep.bt" || fail "session not started"
+grep -q '^CAL,OK$' "$DIR/sweep.bt" || fail "session did not succeed"
+STORED=$(grep '^CAL,STORED,' "$DIR/sweep.bt")
+[ -n "$STORED" ] || fail "calibration not stored"
+
+# CAL,<state>,<thrust min>,<center>,<max>,<rudder min>,<center>,<max>
+echo "$STORED" | awk -F, '{ exit !($3 < 100 && $5 > 3995 && $6 < 100 && $8 > 3995) }' ||
+  fail "end stops not captured"
+
+# ---- Restart ----
+cp "$DIR/sweep.eeprom" "$DIR/restart.eeprom"
+run restart 1500 "sleep 1; echo CAL,GET; sleep 1" SIM_ADC9=2100 SIM_ADC6=2000
+cat "$DIR/restart.bt"
+EXPECT=$(echo "$STORED" | awk -F, '{ printf "CAL,STORED,%s,2100,%s,%s,2000,%s", $3, $5, $6, $8 }')
+grep -qx "$EXPECT" "$DIR/restart.bt" || fail "stored calibration not loaded, expected $EXPECT"
+
+# ---- Corrupted record ----
+cp "$DIR/sweep.eeprom" "$DIR/corrupt.eeprom"
+SIZE=$(wc -c < "$DIR/corrupt.eeprom")
+printf '\377' | dd of="$DIR/corrupt.eeprom" bs=1 seek=$((SIZE - 8)) conv=notrunc 2> /dev/null
+run corrupt 1500 "sleep 1; echo CAL,GET; sleep 1"
+cat "$DIR/corrupt.bt"
+grep -q '^CAL,DEFAULT,' "$DIR/corrupt.bt" || fail "corrupted record accepted"
+
+echo "PASS"
@@ -0,0 +1,77 @@
+#!/bin/sh
+# sim_config.sh - Settings changed over Bluetooth and kept in data EEPROM.
+#
+# Usage: sim_config.sh <sim_controller>
+# 1. SET, sent back to back with other commands, must store valid values,
+#    and refuse unknown keys and values out of range without changing
+#    anything. No command may be dropped.
+# 2. After a restart with that EEPROM the values must be loaded, and the
+#    LoRa module must be configured from them (longer airtime at SF10).
+#    The multi-line replies, sent back to back, must all arrive complete
+#    and in order at 9600 baud, with no control line dropped (TXSTATS).
+
+CONTROLLER=$1
+
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+BASE=$((20000 + ($$ % 20000) * 2))
+
+# run <name> <duration_ms> <input>
+run() {
+  sh -c "$3" | env SIM_TRACE=1 SIM_DURATION_MS=$2 SIM_USART1=stdio SIM_PA8=1 \
+    SIM_EEPROM="$DIR/config.eeprom" SIM_LORA_PORT=$BASE SIM_LORA_PEER=$((BASE + 1)) \
+    SIM_ADC_SWEEP=9 SIM_ADC_PERIOD_MS=2000 \
+    "$CONTROLLER" 2> "$DIR/$1.log" | tr -d '\r' | grep -E '^(SET|GET|CONFIG|BTRX|STATS|FLEET|TXSTATS),' > "$DIR/$1.bt"
+}
+
+fail() {
+  echo "FAIL: $1"
+  exit 1
+}
+
+# Airtime of the first CTRL frame
+airtime() {
+  grep -m1 'LORA TX dst=1' "$DIR/$1.log" | sed 's/.*air=\([0-9]*\)us.*/\1/'
+}
+
+# All commands back to back: the Bluetooth receiver queues them
+run set 2500 "sleep 1; printf '%s\\n' SET,THRUST_DEADBAND,150 SET,LORA_SF,10 SET,LORA_SF,13 SET,NOPE,1 \
+  SET,CTRL_HOLD_MS,x GET,LORA_SF CONFIG BTRX; sleep 1"
+cat "$DIR/set.bt"
+
+grep -qx 'SET,OK,THRUST_DEADBAND,150' "$DIR/set.bt" || fail "valid SET refused"
+grep -qx 'SET,RANGE,LORA_SF,10' "$DIR/set.bt" || fail "out of range SET accepted"
+grep -qx 'SET,UNKNOWN' "$DIR/set.bt" || fail "unknown key accepted"
+grep -qx 'SET,RANGE,CTRL_HOLD_MS,500' "$DIR/set.bt" || fail "malformed value accepted"
+grep -qx 'GET,LORA_SF,10' "$DIR/set.bt" || fail "GET does not return the stored value"
+# CONFIG,<area>,<epoch>,<used>,<size>,<loaded>,<writes>,<switches>,<errors>: the
+# first SET formats area 0 (a switch), the second appends
+grep -q '^CONFIG,0,1,24,[0-9]*,0,1,1,0$' "$DIR/set.bt" || fail "unexpected store state"
+# BTRX,<queued>,<peak>,<lines>,<dropped>,<overlong>
+grep -q '^BTRX,[0-9]*,[0-9]*,8,0,0$' "$DIR/set.bt" || fail "Bluetooth commands dropped"
+
+# ---- Restart ----
+run restart 3500 "sleep 1; printf '%s\\n' GET STATS FLEET TXSTATS CONFIG; sleep 2"
+cat "$DIR/restart.bt"
+
+grep -qx 'GET,THRUST_DEADBAND,150' "$DIR/restart.bt" || fail "THRUST_DEADBAND not loaded"
+grep -qx 'GET,LORA_SF,10' "$DIR/restart.bt" || fail "LORA_SF not loaded"
+grep -qx 'GET,CTRL_HOLD_MS,500' "$DIR/restart.bt" || fail "refused SET changed a value"
+grep -q '^CONFIG,0,1,24,[0-9]*,2,0,0,0$' "$DIR/restart.bt" || fail "records not replayed"
+
+# One line per setting, task and boat, each reply complete before the next
+[ "$(grep -c '^GET,' "$DIR/restart.bt")" -eq 23 ] || fail "GET reply incomplete"
+[ "$(grep -c '^STATS,' "$DIR/restart.bt")" -ge 6 ] || fail "STATS reply incomplete"
+grep -q '^FLEET,1,STATE,' "$DIR/restart.bt" || fail "FLEET reply missing"
+ORDER=$(cut -d, -f1 "$DIR/restart.bt" | uniq | tr '\n' ' ')
+[ "$ORDER" = "GET STATS FLEET TXSTATS CONFIG " ] || fail "replies out of order: $ORDER"
+# TXSTATS,BT,<queued>,<peak>,<bytes>,<drops>,<control drops>
+grep -q '^TXSTATS,BT,.*,0$' "$DIR/restart.bt" || fail "Bluetooth replies dropped"
+
+SF9=$(airtime set)
+SF10=$(airtime restart)
+echo "CTRL airtime: ${SF9} us at SF9, ${SF10} us at SF10"
+[ -n "$SF9" ] && [ -n "$SF10" ] && [ "$SF10" -gt "$SF9" ] || fail "LoRa not configured from the settings"
+
+echo "PASS"
@@ -0,0 +1,86 @@
+#!/bin/sh
+# sim_drift.sh - Uplink slots kept on the controller's clock.
+#
+# Usage: sim_drift.sh <sim_controller> <sim_boat> [ppm]
+# Two links on separate channels, one boat's clock running slow and one
+# fast (SIM_CLOCK_PPM, default 2%: the boards' RC oscillators over
+# temperature), each boat streaming GPS while its controller sends CTRL
+# frames for a swept stick. Between SYNC frames a boat's uplink slot
+# drifts into the controller's downlink window unless the boat re-aligns
+# it on the downlinks it hears and, from its second SYNC on, runs at the
+# measured drift. No packet may collide after that and the controllers
+# must keep hearing the boats.
+
+CONTROLLER=$1
+BOAT=$2
+PPM=${3:-20000}
+DURATION=12000
+
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+BASE=$((20000 + ($$ % 10000) * 4))
+
+fail() {
+  echo "FAIL: $1"
+  exit 1
+}
+
+# RMC fixes at 9600 baud, one about every 70 ms, for the whole run
+i=0
+while [ $i -lt 200 ]; do
+  echo '$GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W*6A'
+  i=$((i + 1))
+done > "$DIR/gps.nmea"
+
+# link <name> <ppm> <port>: one controller and one boat on their own channel
+link() {
+  SIM_TRACE=1 SIM_DURATION_MS=$((DURATION + 1000)) SIM_CLOCK_PPM=$2 \
+    SIM_LORA_PORT=$3 SIM_LORA_PEER=$(($3 + 1)) \
+    SIM_USART3="$DIR/gps.nmea" \
+    "$BOAT" < /dev/null > /dev/null 2> "$DIR/$1.boat.log" &
+
+  # Thrust stick swept every 2 s: CTRL frames in most downlink windows
+  {
+    sleep $((DURATION / 1000 - 1))
+    echo "TDMA"
+    sleep 0.5
+  } | SIM_TRACE=1 SIM_DURATION_MS=$DURATION \
+    SIM_LORA_PORT=$(($3 + 1)) SIM_LORA_PEER=$3 \
+    SIM_USART1=stdio SIM_PA8=1 \
+    SIM_ADC_SWEEP=9 SIM_ADC_PERIOD_MS=2000 \
+    "$CONTROLLER" > "$DIR/$1.bt" 2> "$DIR/$1.controller.log"
+  wait
+}
+
+link slow -$PPM $BASE &
+link fast $PPM $((BASE + 2)) &
+wait
+
+for L in slow fast; do
+  grep -h '^SIM .* LORA' "$DIR/$L.controller.log" "$DIR/$L.boat.log"
+
+  # TDMA,<boats>,<frame ms>,<down ms>,<up ms>,<sent>,<syncs>,...
+  TDMA=$(tr -d '\r' < "$DIR/$L.bt" | grep '^TDMA,')
+  [ -n "$TDMA" ] || fail "no TDMA report ($L)"
+  FRAME=$(echo "$TDMA" | cut -d, -f3)
+
+  # Collisions on both ends, in all and from the boat's second SYNC on
+  TOTAL=$(grep -h '^SIM .* LORA' "$DIR/$L.controller.log" "$DIR/$L.boat.log" | \
+    sed 's/.*collisions=\([0-9]*\).*/\1/' | awk '{ s += $1 } END { print s + 0 }')
+  SYNC2=$(grep 'LORA RX src=100 dst=0' "$DIR/$L.boat.log" | sed -n 2p | cut -d' ' -f1)
+  [ -n "$SYNC2" ] || fail "boat heard one SYNC at most ($L)"
+  LATE=$(cat "$DIR/$L.controller.log" "$DIR/$L.boat.log" | \
+    awk -v t="$SYNC2" '/LORA COLLISION/ && $1 > t { n++ } END { print n + 0 }')
+  echo "Boat clock $L, $((FRAME * 8 * PPM / 1000000)) ms drift between SYNC frames:" \
+       "$TOTAL collisions, $LATE after the drift was measured"
+  [ "$LATE" -eq 0 ] || fail "packets collided ($L)"
+
+  # After the link is up the boat has a fix for nearly every slot
+  HEARD=$(grep -c 'LORA RX src=1 dst=100' "$DIR/$L.controller.log")
+  SLOTS=$(( (DURATION - 2000) / FRAME ))
+  echo "Uplinks heard: $HEARD of about $SLOTS slots"
+  [ "$HEARD" -ge $((SLOTS / 2)) ] || fail "controller lost the boat ($L)"
+done
+
+echo "PASS"
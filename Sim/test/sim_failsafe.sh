@@ -0,0 +1,81 @@
+#!/bin/sh
+# sim_failsafe.sh - Boat failsafe on link loss.
+#
+# Usage: sim_failsafe.sh <sim_controller> <sim_boat>
+# 1. Full thrust held steady (1 Hz heartbeat) with a 4 s radio outage on
+#    the controller: the boat must ramp the throttle down to idle, report
+#    the trip and the recovery over the link, and take full thrust again.
+#    A CMD,SET sent at full thrust must be refused (SET,ARMED): it may
+#    erase a flash sector and stall the boat.
+# 2. Thrust stick swept (fast refresh) with 30% random loss of CTRL
+#    frames: the failsafe must not trip.
+
+CONTROLLER=$1
+BOAT=$2
+
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+BASE=$((20000 + ($$ % 20000) * 2))
+
+# run <name> <duration_ms> <controller environment...>, Bluetooth input on stdin
+run() {
+  NAME=$1
+  DURATION=$2
+  shift 2
+  SIM_TRACE=1 SIM_DURATION_MS=$((DURATION + 1000)) \
+    SIM_LORA_PORT=$BASE SIM_LORA_PEER=$((BASE + 1)) \
+    SIM_USART2=stdio "$BOAT" < /dev/null > "$DIR/$NAME.boat.dbg" 2> "$DIR/$NAME.boat.log" &
+  BOAT_PID=$!
+  env SIM_DURATION_MS=$DURATION \
+    SIM_LORA_PORT=$((BASE + 1)) SIM_LORA_PEER=$BASE \
+    SIM_USART1=stdio SIM_PA8=1 "$@" \
+    "$CONTROLLER" > "$DIR/$NAME.bt" 2> "$DIR/$NAME.controller.log"
+  wait $BOAT_PID
+  grep -h '^SIM .* LORA' "$DIR/$NAME.controller.log" "$DIR/$NAME.boat.log"
+}
+
+# ---- Outage ----
+{ sleep 2; echo "CMD,SET,FAILSAFE_TIMEOUT_MS,1234"; sleep 10; } | \
+  run outage 12000 SIM_ADC9=0 SIM_LORA_OUTAGE=3000+4000
+tr -d '\r' < "$DIR/outage.bt" | grep '^FAILSAFE,'
+
+# Throttle pulses in order: full, ramp down to idle, full again
+grep 'PWM TIM3 CH1' "$DIR/outage.boat.log" | awk '{ print $(NF - 1) }' > "$DIR/thr"
+awk '
+  $1 == 2000 && !ramp { full = 1 }
+  full && !idle && $1 < 2000 && $1 > 1000 { ramp++ }
+  ramp && $1 == 1000 { idle = 1 }
+  idle && $1 == 2000 { back = 1 }
+  END {
+    printf "Throttle: %d ramp steps to idle, %s\n", ramp, back ? "recovered" : "not recovered"
+    exit !(full && ramp >= 10 && idle && back)
+  }' "$DIR/thr"
+OK=$?
+
+if [ $OK -ne 0 ]; then
+  echo "FAIL: throttle did not ramp to idle and recover"
+  exit 1
+fi
+if ! tr -d '\r' < "$DIR/outage.bt" | grep -q '^FAILSAFE,ACTIVE,1,'; then
+  echo "FAIL: failsafe trip not reported"
+  exit 1
+fi
+if ! tr -d '\r' < "$DIR/outage.bt" | grep -q '^FAILSAFE,CLEARED,1,'; then
+  echo "FAIL: recovery not reported"
+  exit 1
+fi
+tr -d '\r' < "$DIR/outage.boat.dbg" | grep '^SET,'
+if ! tr -d '\r' < "$DIR/outage.boat.dbg" | grep -qx 'SET,ARMED,FAILSAFE_TIMEOUT_MS,1234'; then
+  echo "FAIL: SET taken at full thrust"
+  exit 1
+fi
+
+# ---- Random loss ----
+run loss 8000 SIM_ADC_SWEEP=9 SIM_ADC_PERIOD_MS=2000 SIM_LORA_LOSS=30 SIM_SEED=5 < /dev/null
+if tr -d '\r' < "$DIR/loss.bt" | grep '^FAILSAFE,'; then
+  echo "FAIL: failsafe tripped under random loss"
+  exit 1
+fi
+
+echo "PASS"
@@ -0,0 +1,48 @@
+#!/bin/sh
+# sim_latency.sh - Stick-to-servo latency per stage from the LAT_TRACE
+# records of both boards, merged by lat_merge.
+#
+# Usage: sim_latency.sh <sim_controller> <sim_boat> <lat_merge> [duration_ms]
+# The controller's records arrive on the Bluetooth UART, the boat's on the
+# debug UART. The sim EPOCH lines give the exact clock offset between them.
+
+CONTROLLER=$1
+BOAT=$2
+MERGE=$3
+DURATION=${4:-5000}
+
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+BASE=$((20000 + ($$ % 20000) * 2))
+
+SIM_DURATION_MS=$((DURATION + 1000)) \
+  SIM_LORA_PORT=$BASE SIM_LORA_PEER=$((BASE + 1)) \
+  SIM_USART2=stdio \
+  "$BOAT" < /dev/null > "$DIR/boat.lt" 2> "$DIR/boat.log" &
+BOAT_PID=$!
+
+SIM_DURATION_MS=$DURATION \
+  SIM_LORA_PORT=$((BASE + 1)) SIM_LORA_PEER=$BASE \
+  SIM_ADC_SWEEP=9 SIM_ADC_PERIOD_MS=2000 \
+  SIM_USART1=stdio SIM_PA8=1 \
+  "$CONTROLLER" < /dev/null > "$DIR/controller.lt" 2> "$DIR/controller.log"
+wait $BOAT_PID
+
+EPOCH_C=$(awk '$3 == "EPOCH" { print $4 }' "$DIR/controller.log")
+EPOCH_B=$(awk '$3 == "EPOCH" { print $4 }' "$DIR/boat.log")
+if [ -z "$EPOCH_C" ] || [ -z "$EPOCH_B" ]; then
+  echo "FAIL: missing EPOCH report"
+  exit 1
+fi
+
+if ! "$MERGE" -o $((EPOCH_B - EPOCH_C)) "$DIR/controller.lt" "$DIR/boat.lt"; then
+  echo "FAIL: no frame traced end to end"
+  exit 1
+fi
+
+# Same logs with the clock offset estimated, as for target captures
+echo
+"$MERGE" "$DIR/controller.lt" "$DIR/boat.lt" | grep -E '^(Clock|TXE->RX|ADC->PWM)'
+
+echo "PASS"
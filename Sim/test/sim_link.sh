@@ -0,0 +1,65 @@
+#!/bin/sh
+# sim_link.sh - Run both boards over the emulated LoRa link and check that
+# joystick motion on the controller moves the boat's throttle servo, within
+# the output stage's slew limit.
+#
+# Usage: sim_link.sh <sim_controller> <sim_boat> [duration_ms]
+# Prints the CTRL frame rate and the AT+SEND-to-+RCV link latency.
+
+CONTROLLER=$1
+BOAT=$2
+DURATION=${3:-5000}
+
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+# Distinct ports per run so parallel CI jobs do not share a radio channel
+BASE=$((20000 + ($$ % 20000) * 2))
+
+SIM_TRACE=1 SIM_DURATION_MS=$((DURATION + 1000)) \
+  SIM_LORA_PORT=$BASE SIM_LORA_PEER=$((BASE + 1)) \
+  "$BOAT" 2> "$DIR/boat.log" &
+BOAT_PID=$!
+
+# Thrust stick (ADC channel 9) swept back and forth every 2 s
+SIM_TRACE=1 SIM_DURATION_MS=$DURATION \
+  SIM_LORA_PORT=$((BASE + 1)) SIM_LORA_PEER=$BASE \
+  SIM_ADC_SWEEP=9 SIM_ADC_PERIOD_MS=2000 \
+  "$CONTROLLER" 2> "$DIR/controller.log"
+wait $BOAT_PID
+
+cat "$DIR/controller.log" "$DIR/boat.log" | grep '^SIM '
+
+TX=$(grep -c 'LORA TX dst=1' "$DIR/controller.log")
+RX=$(grep -c 'LORA RX src=100 dst=1' "$DIR/boat.log")
+echo "CTRL frames: sent $TX, received $RX, $((TX * 60000 / DURATION)) per minute"
+
+# Frames are neither lost nor reordered, so the n-th TX matches the n-th RX
+grep 'LORA TX dst=1' "$DIR/controller.log" | cut -d' ' -f1 > "$DIR/tx.t"
+grep 'LORA RX src=100 dst=1' "$DIR/boat.log" | cut -d' ' -f1 > "$DIR/rx.t"
+paste "$DIR/tx.t" "$DIR/rx.t" | awk '
+  NF == 2 { d = ($2 - $1) * 1000; s += d; n++; if(d > m) m = d }
+  END { if(n) printf "Link latency: mean %.1f ms, max %.1f ms over %d frames\n", s / n, m, n }'
+
+if [ "$RX" -eq 0 ]; then
+  echo "FAIL: boat received no frames"
+  exit 1
+fi
+
+if ! grep 'PWM TIM3 CH1' "$DIR/boat.log" | grep -qv ' 1000 us'; then
+  echo "FAIL: throttle never left idle"
+  exit 1
+fi
+
+# Output stage: throttle moves at most 40 us per 20 ms PWM frame (pwm_out.h)
+grep 'PWM TIM3 CH1' "$DIR/boat.log" | awk '
+  NR > 1 { f = int(($1 - t) * 50 + 0.5); if(f < 1) f = 1; d = ($(NF - 1) - v) / f
+           if(d < 0) d = -d; if(d > m) m = d }
+  { t = $1; v = $(NF - 1) }
+  END { printf "Throttle: largest step %d us per frame\n", m; exit m > 40 }'
+if [ $? -ne 0 ]; then
+  echo "FAIL: throttle output not slew limited"
+  exit 1
+fi
+
+echo "PASS"
@@ -0,0 +1,68 @@
+#!/bin/sh
+# sim_merge.sh - App THRUST/RUDDER lines coalesced into combined CTRL frames.
+#
+# Usage: sim_merge.sh <sim_controller> <sim_boat>
+# The app sends a THRUST and a RUDDER line back to back every 100 ms. Each
+# pair must leave the controller as one CTRL frame (MERGE), so at most
+# about half as many CTRL frames as app lines go on air; a malformed value
+# is refused. The app starts once the joystick's boot-time activity is
+# over, so it gets control (ctrl_arb).
+
+CONTROLLER=$1
+BOAT=$2
+PAIRS=40
+
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+BASE=$((20000 + ($$ % 20000) * 2))
+
+fail() {
+  echo "FAIL: $1"
+  exit 1
+}
+
+SIM_TRACE=1 SIM_DURATION_MS=9000 \
+  SIM_LORA_PORT=$BASE SIM_LORA_PEER=$((BASE + 1)) \
+  "$BOAT" < /dev/null > /dev/null 2> "$DIR/boat.log" &
+BOAT_PID=$!
+
+{
+  sleep 2.5
+  i=0
+  while [ $i -lt $PAIRS ]; do
+    printf 'THRUST,%d\nRUDDER,%d\n' $((i % 100)) $((-i))
+    sleep 0.1
+    i=$((i + 1))
+  done
+  echo "THRUST,101"
+  sleep 0.3
+  echo "MERGE"
+  sleep 0.5
+} | SIM_TRACE=1 SIM_DURATION_MS=8500 \
+  SIM_LORA_PORT=$((BASE + 1)) SIM_LORA_PEER=$BASE \
+  SIM_USART1=stdio SIM_PA8=1 \
+  "$CONTROLLER" > "$DIR/bt.out" 2> "$DIR/controller.log"
+wait $BOAT_PID
+
+grep -h '^SIM .* LORA' "$DIR/controller.log" "$DIR/boat.log"
+tr -d '\r' < "$DIR/bt.out" | grep -qx 'THRUST,INVALID' || fail "out of range THRUST accepted"
+
+# MERGE,<updates>,<frames>,<saved>,<saved last minute>,<window ms>
+MERGE=$(tr -d '\r' < "$DIR/bt.out" | grep '^MERGE,')
+[ -n "$MERGE" ] || fail "no MERGE report"
+UPDATES=$(echo "$MERGE" | cut -d, -f2)
+FRAMES=$(echo "$MERGE" | cut -d, -f3)
+SAVED=$(echo "$MERGE" | cut -d, -f4)
+CTRL=$(grep -c 'LORA TX dst=1 ' "$DIR/controller.log")
+RX=$(grep -c 'LORA RX src=100 dst=1 ' "$DIR/boat.log")
+echo "App lines: $UPDATES, merged into $FRAMES CTRL frames ($SAVED saved)"
+echo "CTRL frames on air: $CTRL sent, $RX received (with joystick heartbeats)"
+
+[ "$UPDATES" -eq $((2 * PAIRS)) ] || fail "app lines lost"
+[ "$FRAMES" -le $((PAIRS + 2)) ] || fail "pairs not coalesced"
+[ "$SAVED" -eq $((UPDATES - FRAMES)) ] || fail "saved count inconsistent"
+[ "$CTRL" -le $((PAIRS + 10)) ] || fail "more CTRL frames on air than pairs"
+[ "$RX" -gt 0 ] || fail "boat received no CTRL frame"
+
+echo "PASS"
@@ -0,0 +1,52 @@
+#!/bin/sh
+# sim_reboot.sh - Commands after a controller reboot.
+#
+# Usage: sim_reboot.sh <sim_controller> <sim_boat> [reboots]
+# The boat runs throughout while the controller is restarted several
+# times, with the same device UID each time. Every run sends one command
+# (CMD,SET,FAILSAFE_TIMEOUT_MS,<n>) as its first: each must run exactly
+# once on the boat. A session repeated across a reboot would make the boat
+# drop the restarted sequence numbers as duplicates (cmd_arq.h).
+
+CONTROLLER=$1
+BOAT=$2
+REBOOTS=${3:-4}
+RUN_MS=4000
+
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+BASE=$((20000 + ($$ % 20000) * 2))
+
+fail() {
+  echo "FAIL: $1"
+  exit 1
+}
+
+SIM_TRACE=1 SIM_DURATION_MS=$(((REBOOTS + 1) * RUN_MS + 1000)) \
+  SIM_LORA_PORT=$BASE SIM_LORA_PEER=$((BASE + 1)) SIM_USART2=stdio \
+  "$BOAT" < /dev/null > "$DIR/boat.dbg" 2> "$DIR/boat.log" &
+BOAT_PID=$!
+
+# Run 0 plus one per reboot; the command goes out once the module is configured
+n=0
+while [ $n -le "$REBOOTS" ]; do
+  { sleep 1.5; echo "CMD,SET,FAILSAFE_TIMEOUT_MS,$((1000 + n))"; sleep 3; } | \
+    SIM_TRACE=1 SIM_DURATION_MS=$RUN_MS \
+    SIM_LORA_PORT=$((BASE + 1)) SIM_LORA_PEER=$BASE \
+    SIM_USART1=stdio SIM_PA8=1 \
+    "$CONTROLLER" > "$DIR/bt$n.out" 2> "$DIR/controller$n.log"
+  n=$((n + 1))
+done
+wait $BOAT_PID
+
+tr -d '\r' < "$DIR/boat.dbg" | grep '^SET,'
+
+n=0
+while [ $n -le "$REBOOTS" ]; do
+  RAN=$(tr -d '\r' < "$DIR/boat.dbg" | grep -cx "SET,OK,FAILSAFE_TIMEOUT_MS,$((1000 + n))")
+  [ "$RAN" -eq 1 ] || fail "first command of run $n ran $RAN times"
+  n=$((n + 1))
+done
+
+echo "PASS"
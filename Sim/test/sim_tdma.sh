@@ -0,0 +1,162 @@
+#!/bin/sh
+# sim_tdma.sh - Eight boats and the controller sharing one radio channel.
+#
+# Usage: sim_tdma.sh <sim_controller> <sim_boat> [duration_ms]
+# 1. Boats 2..8 get their LoRa address through the real path: CMD,SET from
+#    a controller over the radio, stored in each boat's flash file.
+# 2. All nine boards run on one channel, every boat streaming GPS. The
+#    selector picks boat 2 and TDMA_BOATS is set to 8 over Bluetooth; a
+#    group command then goes to boats 1, 3, 5 and 7 in one broadcast.
+# No packet may collide, the controller must hear every boat, only the
+# selected boat's throttle may move, exactly the grouped boats must run
+# the command once, FLEET must report every boat, and the controller's
+# receive queue must not drop a line.
+
+CONTROLLER=$1
+BOAT=$2
+DURATION=${3:-20000}
+BOATS=8
+GROUP=85
+
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+# Distinct ports per run so parallel CI jobs do not share a radio channel
+BASE=$((20000 + ($$ % 1000) * 40))
+
+fail() {
+  echo "FAIL: $1"
+  exit 1
+}
+
+# RMC fixes at 9600 baud, one about every 70 ms, for the whole run
+i=0
+while [ $i -lt 300 ]; do
+  echo '$GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W*6A'
+  i=$((i + 1))
+done > "$DIR/gps.nmea"
+
+# ---- Provisioning: boat n (default address 1) becomes address n ----
+n=2
+while [ $n -le $BOATS ]; do
+  P=$((BASE + 2 * n))
+  SIM_DURATION_MS=4000 SIM_FLASH="$DIR/boat$n.flash" \
+    SIM_LORA_PORT=$P SIM_LORA_PEER=$((P + 1)) SIM_USART2=stdio \
+    "$BOAT" < /dev/null > "$DIR/provision$n.dbg" 2> /dev/null &
+  { sleep 1.5; echo "CMD,SET,LORA_ADDRESS,$n"; sleep 2; } | \
+    SIM_DURATION_MS=3500 SIM_LORA_PORT=$((P + 1)) SIM_LORA_PEER=$P \
+    SIM_USART1=stdio SIM_PA8=1 \
+    "$CONTROLLER" > /dev/null 2> /dev/null &
+  n=$((n + 1))
+done
+wait
+
+n=2
+while [ $n -le $BOATS ]; do
+  tr -d '\r' < "$DIR/provision$n.dbg" | grep -qx "SET,OK,LORA_ADDRESS,$n" || fail "boat $n not provisioned"
+  n=$((n + 1))
+done
+
+# ---- Shared channel: boats on BASE+1..BASE+8, controller on BASE ----
+# peers <own port>: every other board's port
+peers() {
+  p=$BASE
+  list=
+  while [ $p -le $((BASE + BOATS)) ]; do
+    [ $p -ne "$1" ] && list="$list${list:+,}$p"
+    p=$((p + 1))
+  done
+  echo "$list"
+}
+
+n=1
+while [ $n -le $BOATS ]; do
+  FLASH="$DIR/boat$n.flash"
+  [ $n -eq 1 ] && FLASH=
+  SIM_TRACE=1 SIM_DURATION_MS=$((DURATION + 1000)) SIM_FLASH="$FLASH" \
+    SIM_LORA_PORT=$((BASE + n)) SIM_LORA_PEER=$(peers $((BASE + n))) \
+    SIM_USART3="$DIR/gps.nmea" SIM_USART2=stdio \
+    "$BOAT" < /dev/null > "$DIR/boat$n.dbg" 2> "$DIR/boat$n.log" &
+  n=$((n + 1))
+done
+
+# Selector at position 1 (PB6): boat 2. Thrust stick swept every 2 s
+{
+  sleep 1
+  echo "SET,TDMA_BOATS,$BOATS"
+  sleep 2
+  echo "GROUP,$GROUP,SET,FAILSAFE_TIMEOUT_MS,1234"
+  sleep $((DURATION / 1000 - 5))
+  echo "TDMA"
+  sleep 0.2
+  echo "ARQ"
+  sleep 0.2
+  echo "LORARX"
+  sleep 0.2
+  echo "FLEET"
+  sleep 0.5
+} | SIM_TRACE=1 SIM_DURATION_MS=$DURATION \
+  SIM_LORA_PORT=$BASE SIM_LORA_PEER=$(peers $BASE) \
+  SIM_USART1=stdio SIM_PA8=1 SIM_PB6=1 \
+  SIM_ADC_SWEEP=9 SIM_ADC_PERIOD_MS=2000 \
+  "$CONTROLLER" > "$DIR/bt.out" 2> "$DIR/controller.log"
+wait
+
+grep -h '^SIM .* LORA' "$DIR/controller.log" "$DIR"/boat?.log
+TDMA=$(tr -d '\r' < "$DIR/bt.out" | grep '^TDMA,')
+grep -q '^BOAT,2,2' "$DIR/bt.out" || fail "selector position not reported"
+
+# TDMA,<boats>,<frame ms>,<down ms>,<up ms>,<sent>,<syncs>,<waited>,<replaced>,<dropped>
+[ -n "$TDMA" ] || fail "no TDMA report"
+echo "$TDMA" | awk -F, '{
+  printf "Schedule: %d boats, %d ms frames (%d ms down, %d ms up), superframe %d ms\n", $2, $3, $4, $5, $2 * $3
+  printf "Downlink: %d frames, %d SYNC; %d waited, %d CTRL replaced, %d dropped\n", $6, $7, $8, $9, $10
+}'
+[ "$(echo "$TDMA" | cut -d, -f2)" -eq $BOATS ] || fail "TDMA_BOATS not applied"
+
+COLLISIONS=$(grep -h '^SIM .* LORA' "$DIR/controller.log" "$DIR"/boat?.log | \
+  sed 's/.*collisions=\([0-9]*\).*/\1/' | awk '{ s += $1 } END { print s + 0 }')
+echo "Collisions: $COLLISIONS"
+[ "$COLLISIONS" -eq 0 ] || fail "packets collided"
+
+n=1
+while [ $n -le $BOATS ]; do
+  HEARD=$(grep -c "LORA RX src=$n dst=100" "$DIR/controller.log")
+  echo "Boat $n: $HEARD uplinks heard"
+  [ "$HEARD" -gt 0 ] || fail "controller never heard boat $n"
+
+  MOVED=0
+  grep 'PWM TIM3 CH1' "$DIR/boat$n.log" | grep -qv ' 1000 us' && MOVED=1
+  if [ $n -eq 2 ]; then
+    [ $MOVED -eq 1 ] || fail "selected boat's throttle never left idle"
+  elif [ $MOVED -eq 1 ]; then
+    fail "boat $n followed the sticks"
+  fi
+
+  RAN=$(tr -d '\r' < "$DIR/boat$n.dbg" | grep -cx "SET,OK,FAILSAFE_TIMEOUT_MS,1234")
+  if [ $(( (GROUP >> (n - 1)) & 1 )) -eq 1 ]; then
+    [ "$RAN" -eq 1 ] || fail "boat $n ran the group command $RAN times"
+  else
+    [ "$RAN" -eq 0 ] || fail "boat $n is not in the group but ran its command"
+  fi
+
+  tr -d '\r' < "$DIR/bt.out" | grep -q "^FLEET,$n,STATE,$n,[0-9]" || fail "FLEET has no state for boat $n"
+  n=$((n + 1))
+done
+
+# GROUP,<OK|FAILED>,<group>,<acked>,<text>
+tr -d '\r' < "$DIR/bt.out" | grep '^GROUP,\|^ARQ,\|^FLEET,[0-9]*,STATE'
+tr -d '\r' < "$DIR/bt.out" | grep -qx "GROUP,OK,$((GROUP)),$((GROUP)),SET,FAILSAFE_TIMEOUT_MS,1234" || \
+  fail "group command not acknowledged by every boat"
+tr -d '\r' < "$DIR/bt.out" | grep -q '^FLEET,[13-8],GPS,' || fail "no tagged GPS from other boats"
+
+# LORARX,<queued>,<peak>,<handled>,<dropped>,<isr runs>,<isr avg us>,<isr max us>
+LORARX=$(tr -d '\r' < "$DIR/bt.out" | grep '^LORARX,')
+[ -n "$LORARX" ] || fail "no LORARX report"
+echo "$LORARX" | awk -F, '{
+  printf "Receive: %d lines handled, %d dropped, peak %d queued; RX interrupt %d runs, %d us avg, %d us max\n", $4, $5, $3, $6, $7, $8
+}'
+[ "$(echo "$LORARX" | cut -d, -f4)" -gt 0 ] || fail "no received line handled"
+[ "$(echo "$LORARX" | cut -d, -f5)" -eq 0 ] || fail "receive queue dropped lines"
+
+echo "PASS"
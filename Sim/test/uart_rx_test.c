@@ -0,0 +1,109 @@
+/* uart_rx_test.c - Line assembly of the DMA receive engine
+ *
+ * Replays byte streams through uart_rx_on_event the way the circular RX
+ * DMA and HAL_UARTEx_RxEventCallback deliver them: the DMA writes into a
+ * 16-byte buffer and raises a half-transfer event at 8 and a
+ * transfer-complete event at 16 (then wraps), and the line going idle
+ * raises an event at the current position. Each case lists the chunks
+ * the sender writes, each followed by an idle gap and shorter than the
+ * buffer (a longer burst overruns the DMA), and checks the lines
+ * delivered and the overlong lines counted:
+ *   - lines wrapping around the end of the DMA buffer
+ *   - lines longer than the assembly buffer, dropped up to the line end
+ *   - CR and LF of one line ending split across idle events
+ *   - half- and full-transfer events handled back to back, late
+ *   - the same position reported twice
+ *   - a start character, with the noise before it skipped
+ */
+#include "uart_rx.h"
+#include <stdio.h>
+#include <string.h>
+
+#define DMA_SIZE   16
+#define LINE_MAX   12
+
+/* Stands in for the HAL call made by uart_rx_start */
+HAL_StatusTypeDef HAL_UARTEx_ReceiveToIdle_DMA(UART_HandleTypeDef* huart, uint8_t* data, uint16_t size) {
+  return HAL_OK;
+}
+
+static const struct {
+  const char* name;
+  char        start;              /* Start character, 0 = any */
+  uint8_t     late;               /* Events handled only after the chunk, in a burst */
+  uint8_t     twice;              /* Every event reported twice */
+  const char* chunks[4];          /* Written by the sender, idle after each */
+  const char* lines;              /* Expected lines, joined with '|' */
+  uint32_t    overflows;
+} cases[] = {
+  { "single line",        0,   0, 0, { "ABC\r\n" },                          "ABC",             0 },
+  { "wrap-around",        0,   0, 0, { "0123456789\r\n", "abcdefghij\r\n" }, "0123456789|abcdefghij", 0 },
+  { "many wraps",         0,   0, 0, { "one\ntwo\nthree\nfour\nfive\nsix\n" }, "one|two|three|four|five|six", 0 },
+  { "overlong",           0,   0, 0, { "ABCDEFGHIJKLMNOP\r\nOK\n" },        "OK",              1 },
+  { "overlong over idle", 0,   0, 0, { "ABCDEFGH", "IJKLMNOP\n", "OK\n" },  "OK",              1 },
+  { "longest line",       0,   0, 0, { "ABCDEFGHIJK\nABCDEFGHIJKL\n" },     "ABCDEFGHIJK",     1 },
+  { "CR/LF split",        0,   0, 0, { "AB\r", "\nCD\n" },                  "AB|CD",           0 },
+  { "line split at idle", 0,   0, 0, { "HEL", "LO\r", "\n" },               "HELLO",           0 },
+  { "HT/TC back to back", 0,   1, 0, { "ABCDE\n", "FGHIJ\nKLMN\n" },       "ABCDE|FGHIJ|KLMN", 0 },
+  { "HT/TC in one line",  0,   1, 0, { "ABCDE", "FGHIJK\n" },              "ABCDEFGHIJK",     0 },
+  { "events twice",       0,   0, 1, { "0123456789\r\n", "abcdefghij\r\n" }, "0123456789|abcdefghij", 0 },
+  { "start character",    '$', 0, 0, { "xx$GP,1\r\nyy\n$GN,2\n" },         "$GP,1|$GN,2",     0 },
+};
+#define CASES (sizeof(cases) / sizeof(cases[0]))
+
+static char got[256];
+
+static void on_line(char* line) {
+  if(got[0]) strcat(got, "|");
+  strncat(got, line, sizeof(got) - strlen(got) - 1);
+}
+
+static uint8_t  dma_buf[DMA_SIZE];
+static uint16_t dma_pos;                  /* DMA write position */
+static uint16_t events[16];
+static uint8_t  event_count;
+
+/* Deliver an event now or keep it for a late burst */
+static void event(UartRx_t* rx, uint16_t pos, uint8_t late, uint8_t twice) {
+  for(uint8_t n = 0; n < (twice ? 2 : 1); n++) {
+    if(late) events[event_count++] = pos;
+    else uart_rx_on_event(rx, pos);
+  }
+}
+
+static int check(unsigned c) {
+  static char line[LINE_MAX];
+  UartRx_t rx = UART_RX_INIT(NULL, dma_buf, line, cases[c].start, on_line);
+
+  got[0] = 0;
+  dma_pos = 0;
+  uart_rx_start(&rx);
+
+  for(uint8_t k = 0; k < 4 && cases[c].chunks[k]; k++) {
+    event_count = 0;
+    for(const char* s = cases[c].chunks[k]; *s; s++) {
+      dma_buf[dma_pos++] = (uint8_t)*s;
+      if(dma_pos == DMA_SIZE / 2) event(&rx, dma_pos, cases[c].late, cases[c].twice);
+      if(dma_pos == DMA_SIZE) {
+        event(&rx, dma_pos, cases[c].late, cases[c].twice);
+        dma_pos = 0;
+      }
+    }
+    event(&rx, dma_pos, cases[c].late, cases[c].twice);
+
+    for(uint8_t e = 0; e < event_count; e++) uart_rx_on_event(&rx, events[e]);
+  }
+
+  int fail = strcmp(got, cases[c].lines) != 0 || rx.overflows != cases[c].overflows;
+  printf("%-20s %-30s %lu overlong%s\n", cases[c].name, got, (unsigned long)rx.overflows,
+         fail ? "  FAIL" : "");
+  if(fail) printf("  expected %s, %lu overlong\n", cases[c].lines, (unsigned long)cases[c].overflows);
+  return fail;
+}
+
+int main(void) {
+  int fail = 0;
+  for(unsigned c = 0; c < CASES; c++) fail |= check(c);
+  printf(fail ? "FAIL\n" : "PASS\n");
+  return fail;
+}
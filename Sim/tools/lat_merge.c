@@ -0,0 +1,227 @@
+/* lat_merge.c - Merge controller and boat latency traces into per-stage percentiles
+ *
+ * Usage: lat_merge [-o offset_us] [-a air_us] <controller.log> <boat.log>
+ *
+ * Both logs are scanned for LT,<stage>,<seq>,<t_us> records (lat_trace.h);
+ * anything else on the line or in the file is ignored, so raw captures of
+ * the Bluetooth link and the boat debug port can be used directly. Records
+ * are matched by CTRL frame sequence number, unwrapped past 255 on each
+ * board, so both logs must start within 128 frames of each other.
+ *
+ * The boards' clocks are unrelated. -o gives the boat-to-controller offset
+ * (controller time = boat time + offset), e.g. from the sim EPOCH lines.
+ * Without it the offset is estimated by pinning the fastest radio hop
+ * (TXE -> RX) to the time on air of a CTRL frame (-a, default: computed
+ * for LORA_PHY_DEFAULT), so that hop is then a lower-bound estimate.
+ */
+#include "lat_trace.h"
+#include "lora_airtime.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Escaped CTRL frame: header, seq, 3 payload bytes, CRC */
+#define CTRL_FRAME_LEN 7
+
+typedef struct {
+  int64_t t[LAT_STAGES];
+  uint8_t have;               /* Bit per stage */
+} LatFrame_t;
+
+typedef struct {
+  LatFrame_t* v;
+  int64_t     base;           /* Unwrapped sequence number of v[0] */
+  size_t      n;
+} LatFrames_t;
+
+/* Spans reported, in pipeline order */
+static const struct {
+  const char* name;
+  LatStage_t  from;
+  LatStage_t  to;
+} spans[] = {
+  { "ADC->BUILD",  LAT_ADC,      LAT_BUILD },
+  { "BUILD->TXS",  LAT_BUILD,    LAT_TX_START },
+  { "TXS->TXE",    LAT_TX_START, LAT_TX_END },
+  { "TXE->RX",     LAT_TX_END,   LAT_RX },
+  { "RX->PARSE",   LAT_RX,       LAT_PARSE },
+  { "PARSE->PWM",  LAT_PARSE,    LAT_PWM },
+  { "ADC->PWM",    LAT_ADC,      LAT_PWM },
+};
+
+static const char* const stage_names[LAT_STAGES] = LAT_STAGE_NAMES;
+
+static int stage_of(const char* name, size_t len) {
+  for(int i = 0; i < LAT_STAGES; i++) {
+    if(strlen(stage_names[i]) == len && strncmp(stage_names[i], name, len) == 0) return i;
+  }
+  return -1;
+}
+
+static LatFrame_t* frame_at(LatFrames_t* fr, int64_t seq) {
+  if(!fr->v) {
+    fr->base = seq;
+  }
+  if(seq < fr->base) return NULL;   /* Before the first record: unmatched anyway */
+
+  size_t i = (size_t)(seq - fr->base);
+  if(i >= fr->n) {
+    size_t n = fr->n ? fr->n : 256;
+    while(n <= i) n *= 2;
+    fr->v = realloc(fr->v, n * sizeof(*fr->v));
+    if(!fr->v) { perror("realloc"); exit(1); }
+    memset(&fr->v[fr->n], 0, (n - fr->n) * sizeof(*fr->v));
+    fr->n = n;
+  }
+  return &fr->v[i];
+}
+
+/**
+  * @brief Read one board's log into the frame table
+  * Sequence numbers and 32-bit timestamps are unwrapped against the last
+  * record seen, which tolerates the small reordering between stages.
+  * @retval Number of records read
+  */
+static size_t read_log(const char* path, LatFrames_t* fr) {
+  FILE* f = fopen(path, "r");
+  if(!f) { perror(path); exit(1); }
+
+  char line[512];
+  size_t records = 0;
+  int64_t seq_last = -1, t_last = -1;
+
+  while(fgets(line, sizeof(line), f)) {
+    char* p = strstr(line, "LT,");
+    if(!p) continue;
+    p += 3;
+
+    char* comma = strchr(p, ',');
+    if(!comma) continue;
+    int stage = stage_of(p, (size_t)(comma - p));
+    unsigned seq;
+    unsigned long t;
+    if(stage < 0 || sscanf(comma + 1, "%u,%lu", &seq, &t) != 2 || seq > 255) continue;
+
+    int64_t s = (seq_last < 0) ? seq : seq_last + (int8_t)(uint8_t)(seq - (uint8_t)seq_last);
+    int64_t tu = (t_last < 0) ? (int64_t)t : t_last + (int32_t)(uint32_t)(t - (uint32_t)t_last);
+    if(s > seq_last) seq_last = s;
+    if(tu > t_last) t_last = tu;
+
+    LatFrame_t* fm = frame_at(fr, s);
+    if(!fm) continue;
+    fm->t[stage] = tu;
+    fm->have |= (uint8_t)(1u << stage);
+    records++;
+  }
+
+  fclose(f);
+  return records;
+}
+
+static int cmp_i64(const void* a, const void* b) {
+  int64_t x = *(const int64_t*)a, y = *(const int64_t*)b;
+  return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile of a sorted array */
+static int64_t percentile(const int64_t* v, size_t n, unsigned pct) {
+  size_t rank = (n * pct + 99) / 100;
+  return v[rank ? rank - 1 : 0];
+}
+
+static void usage(void) {
+  fprintf(stderr, "usage: lat_merge [-o offset_us] [-a air_us] <controller.log> <boat.log>\n");
+  exit(2);
+}
+
+int main(int argc, char** argv) {
+  static const LoRaPhy_t phy = LORA_PHY_DEFAULT;
+  int64_t offset = 0;
+  int have_offset = 0;
+  int64_t air = lora_airtime_us(&phy, CTRL_FRAME_LEN);
+  int opt;
+
+  while((opt = getopt(argc, argv, "o:a:")) != -1) {
+    if(opt == 'o') { offset = strtoll(optarg, NULL, 10); have_offset = 1; }
+    else if(opt == 'a') air = strtoll(optarg, NULL, 10);
+    else usage();
+  }
+  if(argc - optind != 2) usage();
+
+  LatFrames_t ctl = { 0 }, boat = { 0 };
+  size_t nc = read_log(argv[optind], &ctl);
+  size_t nb = read_log(argv[optind + 1], &boat);
+  printf("Records: controller %zu, boat %zu\n", nc, nb);
+  if(!ctl.v || !boat.v) {
+    printf("Nothing to match\n");
+    return 1;
+  }
+
+  /* Both tables start at a raw sequence number: align the boat's onto the
+   * nearest controller frame, then copy the boat stages across */
+  int64_t boat_base = ctl.base + (int8_t)(uint8_t)(boat.base - ctl.base);
+  const uint8_t boat_mask = (1u << LAT_RX) | (1u << LAT_PARSE) | (1u << LAT_PWM);
+  size_t built = 0, received = 0;
+
+  for(size_t i = 0; i < boat.n; i++) {
+    if(!(boat.v[i].have & boat_mask)) continue;
+    LatFrame_t* fm = frame_at(&ctl, boat_base + (int64_t)i);
+    if(!fm) continue;
+    for(int st = LAT_RX; st < LAT_STAGES; st++) {
+      if(boat.v[i].have & (1u << st)) {
+        fm->t[st] = boat.v[i].t[st];
+        fm->have |= (uint8_t)(1u << st);
+      }
+    }
+  }
+
+  /* Clock offset: fastest radio hop equals the time on air */
+  if(!have_offset) {
+    int64_t best = INT64_MAX;
+    for(size_t i = 0; i < ctl.n; i++) {
+      LatFrame_t* fm = &ctl.v[i];
+      if((fm->have & (1u << LAT_TX_END)) && (fm->have & (1u << LAT_RX))) {
+        int64_t d = fm->t[LAT_RX] - fm->t[LAT_TX_END];
+        if(d < best) best = d;
+      }
+    }
+    if(best != INT64_MAX) offset = air - best;
+  }
+  printf("Clock offset: %lld us (%s)\n", (long long)offset,
+         have_offset ? "given" : "estimated, TXE->RX minimum pinned to time on air");
+
+  for(size_t i = 0; i < ctl.n; i++) {
+    LatFrame_t* fm = &ctl.v[i];
+    for(int st = LAT_RX; st < LAT_STAGES; st++) fm->t[st] += offset;
+    if(fm->have & (1u << LAT_BUILD)) built++;
+    if((fm->have & (1u << LAT_BUILD)) && (fm->have & boat_mask)) received++;
+  }
+  printf("CTRL frames: built %zu, received %zu\n\n", built, received);
+
+  int64_t* v = malloc(ctl.n * sizeof(*v));
+  if(!v) { perror("malloc"); return 1; }
+
+  printf("%-12s %6s %10s %10s %10s\n", "stage", "n", "p50 us", "p99 us", "max us");
+  for(size_t s = 0; s < sizeof(spans) / sizeof(spans[0]); s++) {
+    uint8_t need = (uint8_t)((1u << spans[s].from) | (1u << spans[s].to));
+    size_t n = 0;
+    for(size_t i = 0; i < ctl.n; i++) {
+      if((ctl.v[i].have & need) == need) {
+        v[n++] = ctl.v[i].t[spans[s].to] - ctl.v[i].t[spans[s].from];
+      }
+    }
+    if(!n) {
+      printf("%-12s %6d %10s %10s %10s\n", spans[s].name, 0, "-", "-", "-");
+      continue;
+    }
+    qsort(v, n, sizeof(*v), cmp_i64);
+    printf("%-12s %6zu %10lld %10lld %10lld\n", spans[s].name, n,
+           (long long)percentile(v, n, 50), (long long)percentile(v, n, 99), (long long)v[n - 1]);
+  }
+
+  free(v);
+  free(ctl.v);
+  free(boat.v);
+  return received ? 0 : 1;
+}